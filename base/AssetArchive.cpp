@@ -0,0 +1,641 @@
+#include "AssetArchive.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "stb_image.h"
+
+// defined by the stb_image_write implementation in OpenGLUtils.cpp
+extern "C" unsigned char* stbi_zlib_compress(unsigned char* data, int dataLength, int* outLength, int quality);
+
+namespace utils
+{
+    namespace
+    {
+        constexpr int kDeflateQuality = 8;
+        constexpr uint32_t kMaxBucketBits = 24;
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        uint32_t getBucket(uint64_t hash, uint32_t bucketBits)
+        {
+            return bucketBits == 0 ? 0 : uint32_t(hash >> (64 - bucketBits));
+        }
+
+        bool readFile(const std::string& filename, std::vector<unsigned char>& bytes)
+        {
+            std::ifstream is(filename, std::ios::binary);
+            if (!is.is_open())
+            {
+                return false;
+            }
+            bytes.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+            return !is.bad();
+        }
+    }
+
+    uint64_t hashAssetBytes(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string normalizeAssetPath(const std::string& path)
+    {
+        std::string normalized;
+        normalized.reserve(path.size());
+        const bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\');
+        if (absolute)
+        {
+            normalized += '/';
+        }
+
+        // where the components start, ".." at the front of relative paths can't be resolved and is kept
+        const size_t rootSize = normalized.size();
+        size_t begin = 0;
+        while (begin <= path.size())
+        {
+            size_t end = path.find_first_of("/\\", begin);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+
+            const size_t length = end - begin;
+            if (length == 2 && path[begin] == '.' && path[begin + 1] == '.')
+            {
+                const size_t last = normalized.find_last_of('/');
+                const size_t lastBegin = last == std::string::npos || last < rootSize ? rootSize : last + 1;
+                if (normalized.size() > rootSize && normalized.compare(lastBegin, std::string::npos, "..") != 0)
+                {
+                    normalized.resize(lastBegin > rootSize ? lastBegin - 1 : rootSize);
+                }
+                else
+                {
+                    normalized += normalized.size() > rootSize ? "/.." : "..";
+                }
+            }
+            else if (length > 0 && !(length == 1 && path[begin] == '.'))
+            {
+                if (normalized.size() > rootSize)
+                {
+                    normalized += '/';
+                }
+                normalized.append(path, begin, length);
+            }
+            begin = end + 1;
+        }
+        return normalized;
+    }
+
+    AssetArchive::~AssetArchive()
+    {
+        close();
+    }
+
+    bool AssetArchive::open(const std::string& filename, bool verifyContents)
+    {
+        close();
+
+#if defined(_WIN32)
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            std::cerr << "Cannot open the asset archive: " << filename << std::endl;
+            return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        HANDLE mapping = nullptr;
+        const void* base = nullptr;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        {
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        }
+        if (mapping != nullptr)
+        {
+            base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+        if (base == nullptr)
+        {
+            std::cerr << "Cannot map the asset archive: " << filename << std::endl;
+            if (mapping != nullptr)
+            {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            return false;
+        }
+
+        mFileHandle = file;
+        mMappingHandle = mapping;
+        mMappedSize = uint64_t(fileSize.QuadPart);
+#else
+        const int file = ::open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            std::cerr << "Cannot open the asset archive: " << filename << std::endl;
+            return false;
+        }
+
+        struct stat status;
+        void* base = MAP_FAILED;
+        if (fstat(file, &status) == 0 && status.st_size > 0)
+        {
+            base = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        }
+
+        // the mapping keeps the file alive
+        ::close(file);
+        if (base == MAP_FAILED)
+        {
+            std::cerr << "Cannot map the asset archive: " << filename << std::endl;
+            return false;
+        }
+        mMappedSize = uint64_t(status.st_size);
+#endif
+
+        mBase = static_cast<const unsigned char*>(base);
+        mFilename = filename;
+        mVerifyContents = verifyContents;
+
+        if (!validate(mMappedSize))
+        {
+            std::cerr << "Invalid asset archive: " << filename << std::endl;
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    bool AssetArchive::validate(uint64_t fileSize)
+    {
+        if (fileSize < sizeof(AssetPackHeader))
+        {
+            return false;
+        }
+
+        const AssetPackHeader& header = *reinterpret_cast<const AssetPackHeader*>(mBase);
+        if (header.magic != kAssetPackMagic || header.version != kAssetPackVersion || header.bucketBits > kMaxBucketBits
+            || header.indexOffset > fileSize || header.pathsOffset > fileSize || header.pathsSize > fileSize)
+        {
+            return false;
+        }
+
+        const uint64_t bucketCount = (uint64_t(1) << header.bucketBits) + 1;
+        const uint64_t entriesOffset = header.indexOffset + alignUp(bucketCount * sizeof(uint32_t), alignof(AssetPackEntry));
+        if (header.indexOffset % alignof(AssetPackEntry) != 0
+            || entriesOffset + uint64_t(header.entryCount) * sizeof(AssetPackEntry) > fileSize
+            || header.pathsOffset < entriesOffset + uint64_t(header.entryCount) * sizeof(AssetPackEntry)
+            || header.pathsSize == 0 || header.pathsOffset + header.pathsSize > fileSize
+            || mBase[header.pathsOffset + header.pathsSize - 1] != 0)
+        {
+            return false;
+        }
+
+        const uint32_t* buckets = reinterpret_cast<const uint32_t*>(mBase + header.indexOffset);
+        for (uint64_t i = 0; i + 1 < bucketCount; ++i)
+        {
+            if (buckets[i] > buckets[i + 1])
+            {
+                return false;
+            }
+        }
+        if (buckets[0] != 0 || buckets[bucketCount - 1] != header.entryCount)
+        {
+            return false;
+        }
+
+        const AssetPackEntry* entries = reinterpret_cast<const AssetPackEntry*>(mBase + entriesOffset);
+        for (uint32_t i = 0; i < header.entryCount; ++i)
+        {
+            const AssetPackEntry& entry = entries[i];
+            if (entry.codec >= ASSET_CODEC_COUNT || entry.pathOffset >= header.pathsSize
+                || entry.offset > fileSize || entry.storedSize > fileSize - entry.offset
+                || (entry.codec == ASSET_CODEC_NONE && entry.storedSize != entry.size))
+            {
+                return false;
+            }
+        }
+
+        mHeader = &header;
+        mBuckets = buckets;
+        mEntries = entries;
+        mPaths = reinterpret_cast<const char*>(mBase + header.pathsOffset);
+        return true;
+    }
+
+    void AssetArchive::close()
+    {
+        if (mBase != nullptr)
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(mBase);
+            CloseHandle(mMappingHandle);
+            CloseHandle(mFileHandle);
+            mMappingHandle = nullptr;
+            mFileHandle = nullptr;
+#else
+            munmap(const_cast<unsigned char*>(mBase), size_t(mMappedSize));
+#endif
+        }
+
+        mBase = nullptr;
+        mMappedSize = 0;
+        mHeader = nullptr;
+        mBuckets = nullptr;
+        mEntries = nullptr;
+        mPaths = nullptr;
+        mFilename.clear();
+    }
+
+    uint32_t AssetArchive::find(const std::string& path) const
+    {
+        if (mHeader == nullptr)
+        {
+            return kInvalidEntry;
+        }
+
+        const std::string normalized = normalizeAssetPath(path);
+        const uint64_t hash = hashAssetBytes(normalized.data(), normalized.size());
+        const uint32_t bucket = getBucket(hash, mHeader->bucketBits);
+
+        const AssetPackEntry* begin = mEntries + mBuckets[bucket];
+        const AssetPackEntry* end = mEntries + mBuckets[bucket + 1];
+        const AssetPackEntry* entry = std::lower_bound(begin, end, hash, [](const AssetPackEntry& entry, uint64_t hash)
+        {
+            return entry.pathHash < hash;
+        });
+        for (; entry != end && entry->pathHash == hash; ++entry)
+        {
+            if (normalized == mPaths + entry->pathOffset)
+            {
+                return uint32_t(entry - mEntries);
+            }
+        }
+        return kInvalidEntry;
+    }
+
+    bool AssetArchive::getView(uint32_t entry, AssetData& data) const
+    {
+        if (mHeader == nullptr || entry >= mHeader->entryCount || mEntries[entry].codec != ASSET_CODEC_NONE)
+        {
+            return false;
+        }
+
+        const AssetPackEntry& packEntry = mEntries[entry];
+        data.view(mBase + packEntry.offset, size_t(packEntry.size));
+        return true;
+    }
+
+    bool AssetArchive::read(uint32_t entry, AssetData& data) const
+    {
+        if (mHeader == nullptr || entry >= mHeader->entryCount)
+        {
+            return false;
+        }
+
+        const AssetPackEntry& packEntry = mEntries[entry];
+        if (packEntry.codec == ASSET_CODEC_NONE)
+        {
+            getView(entry, data);
+        }
+        else
+        {
+            std::vector<unsigned char> bytes(size_t(packEntry.size));
+            const int written = stbi_zlib_decode_buffer(reinterpret_cast<char*>(bytes.data()), int(bytes.size()),
+                reinterpret_cast<const char*>(mBase + packEntry.offset), int(packEntry.storedSize));
+            if (written < 0 || uint64_t(written) != packEntry.size)
+            {
+                std::cerr << "Cannot decompress " << getPath(entry) << " from " << mFilename << std::endl;
+                data.assign(std::vector<unsigned char>());
+                return false;
+            }
+            data.assign(std::move(bytes));
+        }
+
+        if (mVerifyContents && hashAssetBytes(data.data, data.size) != packEntry.contentHash)
+        {
+            std::cerr << "Content hash mismatch for " << getPath(entry) << " in " << mFilename << std::endl;
+            data.assign(std::vector<unsigned char>());
+            return false;
+        }
+        return true;
+    }
+
+    void AssetArchive::readAsync(const uint32_t* entries, uint32_t count, AssetData* outputs, JobCounter& counter, JobPriority priority) const
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            // views cost nothing, only decompression and verification are worth a job
+            if (!mVerifyContents && getView(entries[i], outputs[i]))
+            {
+                continue;
+            }
+
+            const uint32_t entry = entries[i];
+            AssetData* output = &outputs[i];
+            JobSystem::global().run([this, entry, output]()
+            {
+                read(entry, *output);
+            }, &counter, priority);
+        }
+    }
+
+    void AssetArchiveWriter::add(const std::string& path, std::vector<unsigned char> data, AssetCodec codec)
+    {
+        PendingEntry pending;
+        pending.path = normalizeAssetPath(path);
+        pending.data = std::move(data);
+        pending.entry.codec = codec;
+        mEntries.push_back(std::move(pending));
+    }
+
+    bool AssetArchiveWriter::addFile(const std::string& path, const std::string& filename, AssetCodec codec)
+    {
+        std::vector<unsigned char> bytes;
+        if (!readFile(filename, bytes))
+        {
+            std::cerr << "Cannot read " << filename << std::endl;
+            return false;
+        }
+        add(path, std::move(bytes), codec);
+        return true;
+    }
+
+    bool AssetArchiveWriter::write(const std::string& filename)
+    {
+        JobSystem::global().parallelFor(uint32_t(mEntries.size()), 1, [this](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                PendingEntry& pending = mEntries[i];
+                AssetPackEntry& entry = pending.entry;
+                entry.pathHash = hashAssetBytes(pending.path.data(), pending.path.size());
+                entry.contentHash = hashAssetBytes(pending.data.data(), pending.data.size());
+                entry.size = pending.data.size();
+                pending.compressed.clear();
+
+                if (entry.codec == ASSET_CODEC_DEFLATE && !pending.data.empty() && pending.data.size() < size_t(INT32_MAX))
+                {
+                    int compressedSize = 0;
+                    unsigned char* compressed = stbi_zlib_compress(pending.data.data(), int(pending.data.size()), &compressedSize, kDeflateQuality);
+                    if (compressed != nullptr && uint64_t(compressedSize) <= entry.size - entry.size / 4)
+                    {
+                        pending.compressed.assign(compressed, compressed + compressedSize);
+                    }
+                    free(compressed);
+                }
+
+                if (pending.compressed.empty())
+                {
+                    entry.codec = ASSET_CODEC_NONE;
+                }
+                entry.storedSize = entry.codec == ASSET_CODEC_NONE ? entry.size : pending.compressed.size();
+            }
+        });
+
+        std::sort(mEntries.begin(), mEntries.end(), [](const PendingEntry& a, const PendingEntry& b)
+        {
+            return a.entry.pathHash != b.entry.pathHash ? a.entry.pathHash < b.entry.pathHash : a.path < b.path;
+        });
+        for (size_t i = 1; i < mEntries.size(); ++i)
+        {
+            if (mEntries[i].path == mEntries[i - 1].path)
+            {
+                std::cerr << "Asset " << mEntries[i].path << " was added twice" << std::endl;
+                return false;
+            }
+        }
+
+        std::ofstream os(filename, std::ios::binary | std::ios::trunc);
+        if (!os.is_open())
+        {
+            std::cerr << "Cannot write the asset archive: " << filename << std::endl;
+            return false;
+        }
+
+        AssetPackHeader header;
+        header.entryCount = uint32_t(mEntries.size());
+        while (header.bucketBits < kMaxBucketBits && (uint64_t(1) << header.bucketBits) < mEntries.size())
+        {
+            ++header.bucketBits;
+        }
+
+        const std::vector<char> padding(kAssetPackAlignment, 0);
+        uint64_t offset = kAssetPackAlignment;
+        os.write(padding.data(), std::streamsize(offset));
+
+        mSize = 0;
+        mStoredSize = 0;
+        std::string paths;
+        for (PendingEntry& pending : mEntries)
+        {
+            AssetPackEntry& entry = pending.entry;
+            entry.offset = offset;
+            entry.pathOffset = uint32_t(paths.size());
+            paths += pending.path;
+            paths += '\0';
+
+            const std::vector<unsigned char>& stored = entry.codec == ASSET_CODEC_NONE ? pending.data : pending.compressed;
+            os.write(reinterpret_cast<const char*>(stored.data()), std::streamsize(stored.size()));
+            const uint64_t next = alignUp(offset + stored.size(), kAssetPackAlignment);
+            os.write(padding.data(), std::streamsize(next - offset - stored.size()));
+            offset = next;
+
+            mSize += entry.size;
+            mStoredSize += entry.storedSize;
+        }
+        if (paths.empty())
+        {
+            paths += '\0';
+        }
+
+        std::vector<uint32_t> buckets((size_t(1) << header.bucketBits) + 1, 0);
+        for (const PendingEntry& pending : mEntries)
+        {
+            ++buckets[getBucket(pending.entry.pathHash, header.bucketBits) + 1];
+        }
+        for (size_t i = 1; i < buckets.size(); ++i)
+        {
+            buckets[i] += buckets[i - 1];
+        }
+
+        header.indexOffset = offset;
+        const uint64_t bucketBytes = buckets.size() * sizeof(uint32_t);
+        os.write(reinterpret_cast<const char*>(buckets.data()), std::streamsize(bucketBytes));
+        os.write(padding.data(), std::streamsize(alignUp(bucketBytes, alignof(AssetPackEntry)) - bucketBytes));
+        for (const PendingEntry& pending : mEntries)
+        {
+            os.write(reinterpret_cast<const char*>(&pending.entry), sizeof(AssetPackEntry));
+        }
+
+        header.pathsOffset = header.indexOffset + alignUp(bucketBytes, alignof(AssetPackEntry)) + mEntries.size() * sizeof(AssetPackEntry);
+        header.pathsSize = paths.size();
+        os.write(paths.data(), std::streamsize(paths.size()));
+
+        // the header goes in last, a pack that failed halfway never looks valid
+        os.seekp(0);
+        os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        os.close();
+        if (!os)
+        {
+            std::cerr << "Failed writing the asset archive: " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    AssetFileSystem& AssetFileSystem::global()
+    {
+        static AssetFileSystem fileSystem;
+        return fileSystem;
+    }
+
+    bool AssetFileSystem::mount(const std::string& archiveFilename, const std::string& root, bool verifyContents)
+    {
+        std::ifstream probe(archiveFilename, std::ios::binary);
+        if (!probe.is_open())
+        {
+            return false;
+        }
+        probe.close();
+
+        Mount mount;
+        mount.root = normalizeAssetPath(root);
+        if (!mount.root.empty() && mount.root.back() != '/')
+        {
+            mount.root += '/';
+        }
+        mount.archive.reset(new AssetArchive());
+        if (!mount.archive->open(archiveFilename, verifyContents))
+        {
+            return false;
+        }
+
+        for (const Mount& mounted : mMounts)
+        {
+            if (mounted.root == mount.root)
+            {
+                std::cerr << "Another archive is already mounted at " << root << ", " << archiveFilename << " is ignored" << std::endl;
+                return false;
+            }
+        }
+
+        // a pack built before the last edit under root must not shadow the edited files
+        namespace fs = std::filesystem;
+        std::error_code error;
+        const fs::file_time_type packTime = fs::last_write_time(archiveFilename, error);
+        for (fs::recursive_directory_iterator it(root, error), end; !error && it != end; it.increment(error))
+        {
+            std::error_code timeError;
+            if (!it->is_regular_file(timeError) || it->path().extension() == ".pack" || it->last_write_time(timeError) <= packTime || timeError)
+            {
+                continue;
+            }
+
+            const std::string path = normalizeAssetPath(it->path().lexically_relative(root).generic_string());
+            if (mount.archive->find(path) != AssetArchive::kInvalidEntry)
+            {
+                mount.stale.insert(path);
+            }
+        }
+        if (!mount.stale.empty())
+        {
+            std::cerr << archiveFilename << " is older than " << mount.stale.size() << " of the files under " << root
+                << ", reading them from disk. Rebuild it with the data_pack target" << std::endl;
+        }
+
+        mMounts.push_back(std::move(mount));
+        return true;
+    }
+
+    void AssetFileSystem::unmountAll()
+    {
+        mMounts.clear();
+    }
+
+    bool AssetFileSystem::read(const std::string& filename, AssetData& data) const
+    {
+        if (!mMounts.empty())
+        {
+            const std::string path = normalizeAssetPath(filename);
+            for (const Mount& mount : mMounts)
+            {
+                if (path.compare(0, mount.root.size(), mount.root) != 0)
+                {
+                    continue;
+                }
+
+                const std::string relative = path.substr(mount.root.size());
+                if (mount.stale.count(relative) != 0)
+                {
+                    continue;
+                }
+
+                const uint32_t entry = mount.archive->find(relative);
+                if (entry != AssetArchive::kInvalidEntry && mount.archive->read(entry, data))
+                {
+                    mArchiveReads.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+        std::vector<unsigned char> bytes;
+        if (!readFile(filename, bytes))
+        {
+            mFailedReads.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        data.assign(std::move(bytes));
+        mFileReads.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool AssetFileSystem::readString(const std::string& filename, std::string& text) const
+    {
+        AssetData data;
+        if (!read(filename, data))
+        {
+            return false;
+        }
+        text.assign(reinterpret_cast<const char*>(data.data), data.size);
+        return true;
+    }
+
+    AssetFileSystemStats AssetFileSystem::getStats() const
+    {
+        AssetFileSystemStats stats;
+        stats.archiveReads = mArchiveReads.load(std::memory_order_relaxed);
+        stats.fileReads = mFileReads.load(std::memory_order_relaxed);
+        stats.failedReads = mFailedReads.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
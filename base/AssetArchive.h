@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "JobSystem.h"
+
+namespace utils
+{
+    enum AssetCodec : uint32_t
+    {
+        ASSET_CODEC_NONE,
+        // zlib streams from stb, the codec field leaves room for LZ4 or zstd
+        ASSET_CODEC_DEFLATE,
+        ASSET_CODEC_COUNT,
+    };
+
+    // Layout of an asset pack, little endian:
+    //   header     - at offset 0, padded to kAssetPackAlignment
+    //   entry data - every entry starts on a kAssetPackAlignment boundary
+    //   index      - (1 << bucketBits) + 1 bucket starts, then the entries sorted by path hash. The top bucketBits
+    //                of a hash select the bucket, so a lookup only compares the few entries of one bucket
+    //   paths      - null terminated normalized paths, to tell hash collisions apart
+    constexpr uint32_t kAssetPackMagic = 0x4b415041; // "APAK"
+    constexpr uint32_t kAssetPackVersion = 1;
+    constexpr uint64_t kAssetPackAlignment = 4096;
+
+    struct AssetPackHeader
+    {
+        uint32_t magic = kAssetPackMagic;
+        uint32_t version = kAssetPackVersion;
+        uint32_t entryCount = 0;
+        uint32_t bucketBits = 0;
+        uint64_t indexOffset = 0;
+        uint64_t pathsOffset = 0;
+        uint64_t pathsSize = 0;
+    };
+
+    struct AssetPackEntry
+    {
+        uint64_t pathHash = 0;
+
+        // of the original bytes, checked by AssetArchive::read when the archive was opened with verification
+        uint64_t contentHash = 0;
+
+        uint64_t offset = 0;
+        uint64_t storedSize = 0;
+        uint64_t size = 0;
+        AssetCodec codec = ASSET_CODEC_NONE;
+        uint32_t pathOffset = 0;
+    };
+
+    // FNV-1a, for paths and contents
+    uint64_t hashAssetBytes(const void* data, size_t size);
+
+    // forward slashes without "." and ".." components, "shaders/cubes/../common/a.glsl" becomes "shaders/common/a.glsl"
+    std::string normalizeAssetPath(const std::string& path);
+
+    // the bytes of one asset, either a view into a mapped archive or owned storage for decompressed and loose files
+    struct AssetData
+    {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> storage;
+
+        void assign(std::vector<unsigned char>&& bytes)
+        {
+            storage = std::move(bytes);
+            data = storage.data();
+            size = storage.size();
+        }
+        void view(const unsigned char* bytes, size_t count)
+        {
+            storage.clear();
+            data = bytes;
+            size = count;
+        }
+    };
+
+    // a read-only memory mapped asset pack, lookups and reads are safe from any thread once opened
+    class AssetArchive
+    {
+    public:
+        static constexpr uint32_t kInvalidEntry = ~0u;
+
+        AssetArchive() = default;
+        ~AssetArchive();
+
+        AssetArchive(const AssetArchive&) = delete;
+        AssetArchive& operator=(const AssetArchive&) = delete;
+
+        bool open(const std::string& filename, bool verifyContents = false);
+        void close();
+        bool isOpen() const { return mBase != nullptr; }
+
+        // path relative to the packed directory, kInvalidEntry if it isn't in the archive
+        uint32_t find(const std::string& path) const;
+
+        uint32_t getEntryCount() const { return mHeader != nullptr ? mHeader->entryCount : 0; }
+        const AssetPackEntry& getEntry(uint32_t entry) const { return mEntries[entry]; }
+        const char* getPath(uint32_t entry) const { return mPaths + mEntries[entry].pathOffset; }
+
+        // zero-copy view of an uncompressed entry, false for compressed ones
+        bool getView(uint32_t entry, AssetData& data) const;
+
+        // a view when the entry is stored uncompressed, decompressed into data's storage otherwise
+        bool read(uint32_t entry, AssetData& data) const;
+
+        // reads every entry into the matching output, compressed ones are decompressed on the global job system
+        // and their outputs are valid once counter is done. Entries that fail to decompress leave their output empty
+        void readAsync(const uint32_t* entries, uint32_t count, AssetData* outputs, JobCounter& counter, JobPriority priority = JOB_PRIORITY_LOW) const;
+
+    private:
+        bool validate(uint64_t fileSize);
+
+        std::string mFilename;
+        bool mVerifyContents = false;
+
+        const unsigned char* mBase = nullptr;
+        uint64_t mMappedSize = 0;
+#if defined(_WIN32)
+        void* mFileHandle = nullptr;
+        void* mMappingHandle = nullptr;
+#endif
+
+        const AssetPackHeader* mHeader = nullptr;
+        const uint32_t* mBuckets = nullptr;
+        const AssetPackEntry* mEntries = nullptr;
+        const char* mPaths = nullptr;
+    };
+
+    // builds an asset pack, entries are compressed in parallel when the pack is written
+    class AssetArchiveWriter
+    {
+    public:
+        // compressed entries that don't shrink by at least a quarter are stored as they are, inflating costs more
+        // load time than reading the bytes saved
+        void add(const std::string& path, std::vector<unsigned char> data, AssetCodec codec = ASSET_CODEC_DEFLATE);
+        bool addFile(const std::string& path, const std::string& filename, AssetCodec codec = ASSET_CODEC_DEFLATE);
+
+        bool write(const std::string& filename);
+
+        uint64_t getSize() const { return mSize; }
+        uint64_t getStoredSize() const { return mStoredSize; }
+
+    private:
+        struct PendingEntry
+        {
+            std::string path;
+            std::vector<unsigned char> data;
+            std::vector<unsigned char> compressed;
+            AssetPackEntry entry;
+        };
+
+        std::vector<PendingEntry> mEntries;
+        uint64_t mSize = 0;
+        uint64_t mStoredSize = 0;
+    };
+
+    struct AssetFileSystemStats
+    {
+        uint64_t archiveReads = 0;
+        uint64_t fileReads = 0;
+        uint64_t failedReads = 0;
+    };
+
+    // Mounted archives in front of the data directory. A path under a mount's root is looked up in its archive
+    // first and read from disk when the archive doesn't have it, so loose files keep working as a fallback.
+    // Mount during startup; reads are thread-safe. Loose files edited after the pack was built are read from disk
+    // with a warning at mount time, building any example rebuilds the pack (data_pack target).
+    class AssetFileSystem
+    {
+    public:
+        static AssetFileSystem& global();
+
+        // quietly returns false when the archive doesn't exist. Scans root once for loose files newer than the archive
+        bool mount(const std::string& archiveFilename, const std::string& root, bool verifyContents = false);
+        void unmountAll();
+
+        bool read(const std::string& filename, AssetData& data) const;
+        bool readString(const std::string& filename, std::string& text) const;
+
+        AssetFileSystemStats getStats() const;
+
+    private:
+        struct Mount
+        {
+            std::string root;
+            std::unique_ptr<AssetArchive> archive;
+
+            // paths relative to root whose loose file is newer than the packed entry
+            std::unordered_set<std::string> stale;
+        };
+
+        std::vector<Mount> mMounts;
+
+        mutable std::atomic<uint64_t> mArchiveReads{ 0 };
+        mutable std::atomic<uint64_t> mFileReads{ 0 };
+        mutable std::atomic<uint64_t> mFailedReads{ 0 };
+    };
+}
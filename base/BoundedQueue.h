@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+namespace utils
+{
+    // blocking multi-producer multi-consumer queue, push blocks while full to apply backpressure
+    template<typename T>
+    class BoundedQueue
+    {
+    public:
+        explicit BoundedQueue(size_t capacity) : mCapacity(capacity > 0 ? capacity : 1) {}
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // returns false if the queue was closed
+        bool push(T value)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotFull.wait(lock, [this]() { return mClosed || mItems.size() < mCapacity; });
+            if (mClosed)
+            {
+                return false;
+            }
+
+            mItems.push_back(std::move(value));
+            lock.unlock();
+            mNotEmpty.notify_one();
+            return true;
+        }
+
+        // returns false once the queue is closed and drained
+        bool pop(T& value)
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotEmpty.wait(lock, [this]() { return mClosed || !mItems.empty(); });
+            if (mItems.empty())
+            {
+                return false;
+            }
+
+            value = std::move(mItems.front());
+            mItems.pop_front();
+            lock.unlock();
+            mNotFull.notify_one();
+            return true;
+        }
+
+        // wakes all waiters, remaining items can still be popped
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mClosed = true;
+            }
+            mNotFull.notify_all();
+            mNotEmpty.notify_all();
+        }
+
+        size_t size() const
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mItems.size();
+        }
+
+        size_t capacity() const { return mCapacity; }
+
+    private:
+        const size_t mCapacity;
+        std::deque<T> mItems;
+        mutable std::mutex mMutex;
+        std::condition_variable mNotFull;
+        std::condition_variable mNotEmpty;
+        bool mClosed = false;
+    };
+}
@@ -0,0 +1,1001 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+#include "JobSystem.h"
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BVH_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // SAH costs of testing a node's four boxes and of testing one primitive, in the same unit
+        constexpr float kTraversalCost = 1.0f;
+        constexpr float kIntersectionCost = 1.0f;
+
+        // binning of larger ranges is split over the pool
+        constexpr uint32_t kParallelBinning = 1u << 16;
+        constexpr uint32_t kBinningGrain = 1u << 14;
+
+        // a node pops one entry and pushes at most four, and the build stops splitting at kMaxDepth
+        constexpr uint32_t kStackSize = 3 * Bvh::kMaxDepth + 4;
+
+        // splits through the middle of the range, for primitives whose centroids all coincide
+        constexpr uint32_t kMedianSplit = 3;
+
+        struct Bin
+        {
+            Aabb bounds;
+            uint32_t count = 0;
+        };
+
+        struct Bins
+        {
+            Bin bins[3][Bvh::kBins];
+
+            void merge(const Bins& other, uint32_t binCount)
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    for (uint32_t bin = 0; bin < binCount; ++bin)
+                    {
+                        bins[axis][bin].bounds.grow(other.bins[axis][bin].bounds);
+                        bins[axis][bin].count += other.bins[axis][bin].count;
+                    }
+                }
+            }
+        };
+
+        struct BuildRange
+        {
+            uint32_t begin = 0;
+            uint32_t end = 0;
+            Aabb bounds;
+            Aabb centroids;
+
+            // set once evaluateSplit ran, leaf or the split to apply
+            bool evaluated = false;
+            bool leaf = false;
+            uint32_t axis = 0;
+            uint32_t bin = 0;
+            Aabb splitBounds[2];
+
+            uint32_t getCount() const { return end - begin; }
+        };
+
+        struct BuildPrimitive
+        {
+            Aabb bounds;
+            glm::vec3 centroid;
+            uint32_t index;
+        };
+
+        struct BuildContext
+        {
+            // partitioned in place, so the primitives of a range are contiguous in memory at every level
+            std::vector<BuildPrimitive> primitives;
+            BvhNode* nodes = nullptr;
+            ThreadPool* pool = nullptr;
+
+            std::atomic<uint32_t> nodeCount{ 0 };
+            std::atomic<uint32_t> leafCount{ 0 };
+            std::atomic<uint32_t> maxDepth{ 0 };
+            JobCounter counter;
+        };
+
+        int countTrailingZeros(uint32_t mask)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return int(index);
+#else
+            return __builtin_ctz(mask);
+#endif
+        }
+
+        glm::vec3 getCentroid(const Aabb& box)
+        {
+            return (box.min + box.max) * 0.5f;
+        }
+
+        // small ranges have as many bins as primitives, sweeping kBins for them costs more than the binning
+        uint32_t getBinCount(const BuildRange& range)
+        {
+            return std::min(std::max(range.getCount(), 2u), Bvh::kBins);
+        }
+
+        // the same expression for binning and partitioning, so both put a primitive into the same bin
+        uint32_t getBin(float centroid, float min, float scale, uint32_t binCount)
+        {
+            return std::min(uint32_t(std::max((centroid - min) * scale, 0.0f)), binCount - 1);
+        }
+
+        glm::vec3 getBinScale(const BuildRange& range)
+        {
+            const glm::vec3 extent = range.centroids.max - range.centroids.min;
+            glm::vec3 scale(0.0f);
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                scale[axis] = extent[axis] > 0.0f ? float(getBinCount(range)) / extent[axis] : 0.0f;
+                scale[axis] = std::isfinite(scale[axis]) ? scale[axis] : 0.0f;
+            }
+            return scale;
+        }
+
+        void binRange(const BuildContext& context, const BuildRange& range, const glm::vec3& scale, uint32_t begin, uint32_t end, Bins& bins)
+        {
+            const uint32_t binCount = getBinCount(range);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const BuildPrimitive& primitive = context.primitives[i];
+                const glm::vec3& centroid = primitive.centroid;
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    Bin& bin = bins.bins[axis][getBin(centroid[axis], range.centroids.min[axis], scale[axis], binCount)];
+                    bin.bounds.grow(primitive.bounds);
+                    ++bin.count;
+                }
+            }
+        }
+
+        void updateMaxDepth(BuildContext& context, uint32_t depth)
+        {
+            uint32_t current = context.maxDepth.load(std::memory_order_relaxed);
+            while (depth > current && !context.maxDepth.compare_exchange_weak(current, depth, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        // decides between a leaf and the cheapest binned split of the range
+        void evaluateSplit(BuildContext& context, BuildRange& range)
+        {
+            range.evaluated = true;
+            const uint32_t count = range.getCount();
+            if (count <= 1)
+            {
+                range.leaf = true;
+                return;
+            }
+
+            const glm::vec3 scale = getBinScale(range);
+            const uint32_t binCount = getBinCount(range);
+            if (scale.x == 0.0f && scale.y == 0.0f && scale.z == 0.0f)
+            {
+                // nothing to bin, only leaves that got too large are halved
+                range.leaf = count <= Bvh::kMaxLeafSize;
+                range.axis = kMedianSplit;
+                return;
+            }
+
+            Bins bins;
+            if (context.pool != nullptr && count >= kParallelBinning)
+            {
+                std::mutex mutex;
+                context.pool->parallelFor(count, kBinningGrain, [&](uint32_t begin, uint32_t end)
+                {
+                    Bins local;
+                    binRange(context, range, scale, range.begin + begin, range.begin + end, local);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    bins.merge(local, binCount);
+                });
+            }
+            else
+            {
+                binRange(context, range, scale, range.begin, range.end, bins);
+            }
+
+            // sweep from the right to know the cost of every right side, then from the left
+            float bestCost = FLT_MAX;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                if (scale[axis] == 0.0f)
+                {
+                    continue;
+                }
+
+                const Bin* axisBins = bins.bins[axis];
+                float rightCosts[Bvh::kBins];
+                Aabb right;
+                uint32_t rightCount = 0;
+                for (uint32_t bin = binCount - 1; bin > 0; --bin)
+                {
+                    right.grow(axisBins[bin].bounds);
+                    rightCount += axisBins[bin].count;
+                    rightCosts[bin] = right.getSurfaceArea() * float(rightCount);
+                }
+
+                Aabb left;
+                uint32_t leftCount = 0;
+                for (uint32_t bin = 0; bin + 1 < binCount; ++bin)
+                {
+                    left.grow(axisBins[bin].bounds);
+                    leftCount += axisBins[bin].count;
+                    if (leftCount == 0 || leftCount == count)
+                    {
+                        continue;
+                    }
+
+                    const float cost = left.getSurfaceArea() * float(leftCount) + rightCosts[bin + 1];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        range.axis = axis;
+                        range.bin = bin + 1;
+                    }
+                }
+            }
+
+            if (bestCost == FLT_MAX)
+            {
+                range.leaf = count <= Bvh::kMaxLeafSize;
+                range.axis = kMedianSplit;
+                return;
+            }
+
+            const float area = range.bounds.getSurfaceArea();
+            const float splitCost = kTraversalCost + (area > 0.0f ? kIntersectionCost * bestCost / area : 0.0f);
+            if (count <= Bvh::kMaxLeafSize && kIntersectionCost * float(count) <= splitCost)
+            {
+                range.leaf = true;
+                return;
+            }
+
+            const Bin* axisBins = bins.bins[range.axis];
+            for (uint32_t bin = 0; bin < binCount; ++bin)
+            {
+                const uint32_t side = bin < range.bin ? 0 : 1;
+                range.splitBounds[side].grow(axisBins[bin].bounds);
+            }
+        }
+
+        void applySplit(BuildContext& context, const BuildRange& range, BuildRange& left, BuildRange& right)
+        {
+            BuildPrimitive* primitives = context.primitives.data();
+            uint32_t middle = range.begin + range.getCount() / 2;
+            if (range.axis == kMedianSplit)
+            {
+                left.bounds = range.bounds;
+                left.centroids = range.centroids;
+                right.bounds = range.bounds;
+                right.centroids = range.centroids;
+            }
+            else
+            {
+                // the centroid bounds of both sides are collected on the way, binning only tracks the boxes
+                const uint32_t axis = range.axis;
+                const float min = range.centroids.min[axis];
+                const float scale = getBinScale(range)[axis];
+                const uint32_t binCount = getBinCount(range);
+                uint32_t i = range.begin;
+                uint32_t j = range.end;
+                while (i < j)
+                {
+                    const glm::vec3& centroid = primitives[i].centroid;
+                    if (getBin(centroid[axis], min, scale, binCount) < range.bin)
+                    {
+                        left.centroids.grow(centroid);
+                        ++i;
+                    }
+                    else
+                    {
+                        right.centroids.grow(centroid);
+                        std::swap(primitives[i], primitives[--j]);
+                    }
+                }
+                middle = i;
+
+                left.bounds = range.splitBounds[0];
+                right.bounds = range.splitBounds[1];
+            }
+
+            left.begin = range.begin;
+            left.end = middle;
+            right.begin = middle;
+            right.end = range.end;
+        }
+
+        void setSlot(BvhNode& node, uint32_t slot, const Aabb& bounds, uint32_t child, uint32_t count)
+        {
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                node.bounds[axis][slot] = bounds.min[axis];
+                node.bounds[axis + 3][slot] = bounds.max[axis];
+            }
+            node.children[slot] = child;
+            node.counts[slot] = count;
+        }
+
+        Aabb getNodeBounds(const BvhNode& node)
+        {
+            // empty slots are inverted and don't change the union
+            Aabb bounds;
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                bounds.grow(Aabb{ glm::vec3(node.bounds[0][slot], node.bounds[1][slot], node.bounds[2][slot]),
+                    glm::vec3(node.bounds[3][slot], node.bounds[4][slot], node.bounds[5][slot]) });
+            }
+            return bounds;
+        }
+
+        void buildNode(BuildContext& context, uint32_t nodeIndex, const BuildRange& range, uint32_t depth)
+        {
+            updateMaxDepth(context, depth);
+
+            BuildRange children[4];
+            children[0] = range;
+            uint32_t childCount = 1;
+            while (childCount < 4)
+            {
+                // splitting the largest child first removes the most expected work from every ray
+                int32_t largest = -1;
+                float largestArea = -1.0f;
+                for (uint32_t i = 0; i < childCount; ++i)
+                {
+                    const float area = children[i].bounds.getSurfaceArea();
+                    if (!children[i].leaf && area > largestArea)
+                    {
+                        largest = int32_t(i);
+                        largestArea = area;
+                    }
+                }
+                if (largest < 0)
+                {
+                    break;
+                }
+
+                BuildRange& child = children[largest];
+                if (!child.evaluated)
+                {
+                    evaluateSplit(context, child);
+                }
+                if (child.leaf)
+                {
+                    continue;
+                }
+
+                BuildRange left;
+                BuildRange right;
+                applySplit(context, child, left, right);
+                children[largest] = left;
+                children[childCount++] = right;
+            }
+
+            // the children that weren't split here find out whether they are leaves, or keep their split for their node
+            for (uint32_t i = 0; i < childCount; ++i)
+            {
+                if (!children[i].leaf && !children[i].evaluated)
+                {
+                    evaluateSplit(context, children[i]);
+                }
+                if (depth + 1 >= Bvh::kMaxDepth)
+                {
+                    children[i].leaf = true;
+                }
+            }
+
+            BvhNode& node = context.nodes[nodeIndex];
+            uint32_t childNodes[4] = {};
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                if (slot >= childCount)
+                {
+                    setSlot(node, slot, Aabb(), BvhNode::kEmpty, 0);
+                }
+                else if (children[slot].leaf)
+                {
+                    setSlot(node, slot, children[slot].bounds, children[slot].begin, children[slot].getCount());
+                    context.leafCount.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    childNodes[slot] = context.nodeCount.fetch_add(1, std::memory_order_relaxed);
+                    setSlot(node, slot, children[slot].bounds, childNodes[slot], 0);
+                }
+            }
+
+            for (uint32_t slot = 0; slot < childCount; ++slot)
+            {
+                if (children[slot].leaf)
+                {
+                    continue;
+                }
+
+                if (context.pool != nullptr && children[slot].getCount() >= Bvh::kParallelThreshold)
+                {
+                    const BuildRange child = children[slot];
+                    const uint32_t childNode = childNodes[slot];
+                    context.pool->getJobSystem().run([&context, child, childNode, depth]()
+                    {
+                        buildNode(context, childNode, child, depth + 1);
+                    }, &context.counter);
+                }
+                else
+                {
+                    buildNode(context, childNodes[slot], children[slot], depth + 1);
+                }
+            }
+        }
+
+        // Visits the leaves a ray enters, nearest inner children first. leaf(first, count, tMax) tests primitives
+        // [first, first + count) and lowers tMax on a hit, which prunes everything further away. The nearest
+        // child hit is visited next without going through the stack, the others are pushed far to near
+        template <typename LeafFunction>
+        void traverseRay(const Bvh& bvh, const Ray& ray, float tMax, LeafFunction&& leaf)
+        {
+            const std::vector<BvhNode>& nodes = bvh.getNodes();
+            if (nodes.empty())
+            {
+                return;
+            }
+
+            // the slab a ray enters first depends only on the sign of its direction
+            const glm::vec3 inverse = 1.0f / ray.direction;
+            uint32_t nearRows[3];
+            uint32_t farRows[3];
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                nearRows[axis] = ray.direction[axis] >= 0.0f ? axis : axis + 3;
+                farRows[axis] = ray.direction[axis] >= 0.0f ? axis + 3 : axis;
+            }
+
+            struct Entry
+            {
+                uint32_t node;
+                float tNear;
+            };
+            Entry stack[kStackSize];
+            uint32_t stackSize = 0;
+
+#if defined(BVH_X86)
+            const __m128 originX = _mm_set1_ps(ray.origin.x);
+            const __m128 originY = _mm_set1_ps(ray.origin.y);
+            const __m128 originZ = _mm_set1_ps(ray.origin.z);
+            const __m128 inverseX = _mm_set1_ps(inverse.x);
+            const __m128 inverseY = _mm_set1_ps(inverse.y);
+            const __m128 inverseZ = _mm_set1_ps(inverse.z);
+#endif
+
+            uint32_t nodeIndex = 0;
+            while (true)
+            {
+                const BvhNode& node = nodes[nodeIndex];
+                alignas(16) float tNear[4];
+                uint32_t mask = 0;
+                uint32_t innerMask = 0;
+#if defined(BVH_X86)
+                const __m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[nearRows[0]]), originX), inverseX);
+                const __m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[nearRows[1]]), originY), inverseY);
+                const __m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[nearRows[2]]), originZ), inverseZ);
+                const __m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[farRows[0]]), originX), inverseX);
+                const __m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[farRows[1]]), originY), inverseY);
+                const __m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[farRows[2]]), originZ), inverseZ);
+                const __m128 enter = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, _mm_setzero_ps()));
+                const __m128 exit = _mm_min_ps(_mm_min_ps(farX, farY), _mm_min_ps(farZ, _mm_set1_ps(tMax)));
+                mask = uint32_t(_mm_movemask_ps(_mm_cmple_ps(enter, exit)));
+                _mm_store_ps(tNear, enter);
+                const __m128i counts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(node.counts));
+                innerMask = uint32_t(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(counts, _mm_setzero_si128()))));
+#else
+                for (uint32_t slot = 0; slot < 4; ++slot)
+                {
+                    float enter = 0.0f;
+                    float exit = tMax;
+                    for (uint32_t axis = 0; axis < 3; ++axis)
+                    {
+                        enter = std::max(enter, (node.bounds[nearRows[axis]][slot] - ray.origin[axis]) * inverse[axis]);
+                        exit = std::min(exit, (node.bounds[farRows[axis]][slot] - ray.origin[axis]) * inverse[axis]);
+                    }
+                    tNear[slot] = enter;
+                    mask |= enter <= exit ? 1u << slot : 0u;
+                    innerMask |= node.counts[slot] == 0 ? 1u << slot : 0u;
+                }
+#endif
+
+                for (uint32_t leaves = mask & ~innerMask; leaves != 0; leaves &= leaves - 1)
+                {
+                    const uint32_t slot = uint32_t(countTrailingZeros(leaves));
+                    if (tNear[slot] <= tMax)
+                    {
+                        leaf(node.children[slot], node.counts[slot], tMax);
+                    }
+                }
+
+                uint32_t inner = mask & innerMask;
+                if (inner != 0 && (inner & (inner - 1)) == 0)
+                {
+                    nodeIndex = node.children[countTrailingZeros(inner)];
+                    continue;
+                }
+
+                if (inner != 0)
+                {
+                    // two to four children, sorted far to near by insertion
+                    uint32_t order[4];
+                    uint32_t hits = 0;
+                    for (; inner != 0; inner &= inner - 1)
+                    {
+                        const uint32_t slot = uint32_t(countTrailingZeros(inner));
+                        uint32_t i = hits++;
+                        for (; i > 0 && tNear[order[i - 1]] < tNear[slot]; --i)
+                        {
+                            order[i] = order[i - 1];
+                        }
+                        order[i] = slot;
+                    }
+                    for (uint32_t i = 0; i + 1 < hits; ++i)
+                    {
+                        stack[stackSize++] = { node.children[order[i]], tNear[order[i]] };
+                    }
+                    nodeIndex = node.children[order[hits - 1]];
+                    continue;
+                }
+
+                // nothing left below this node, resume with the nearest pushed node still in front of a hit
+                while (stackSize > 0 && stack[stackSize - 1].tNear > tMax)
+                {
+                    --stackSize;
+                }
+                if (stackSize == 0)
+                {
+                    break;
+                }
+                nodeIndex = stack[--stackSize].node;
+            }
+        }
+
+        // Moller-Trumbore against a triangle stored as its first vertex and two edges, both sides hit
+        bool intersectTriangle(const Ray& ray, const glm::vec3* triangle, float tMax, float& t, float& u, float& v)
+        {
+            const glm::vec3& edge1 = triangle[1];
+            const glm::vec3& edge2 = triangle[2];
+            const glm::vec3 p = glm::cross(ray.direction, edge2);
+            const float determinant = glm::dot(edge1, p);
+            if (determinant == 0.0f)
+            {
+                return false;
+            }
+
+            const float inverseDeterminant = 1.0f / determinant;
+            const glm::vec3 s = ray.origin - triangle[0];
+            u = glm::dot(s, p) * inverseDeterminant;
+            if (u < 0.0f || u > 1.0f)
+            {
+                return false;
+            }
+
+            const glm::vec3 q = glm::cross(s, edge1);
+            v = glm::dot(ray.direction, q) * inverseDeterminant;
+            if (v < 0.0f || u + v > 1.0f)
+            {
+                return false;
+            }
+
+            t = glm::dot(edge2, q) * inverseDeterminant;
+            return t >= 0.0f && t < tMax;
+        }
+
+        glm::vec3 getPosition(const float* positions, uint32_t stride, uint32_t vertex)
+        {
+            const float* position = positions + size_t(vertex) * stride;
+            return glm::vec3(position[0], position[1], position[2]);
+        }
+    }
+
+    Aabb Aabb::transformed(const glm::mat4& transform) const
+    {
+        if (isEmpty())
+        {
+            return *this;
+        }
+
+        // the extent along each new axis is the sum of the absolute projections of the old extents
+        const glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+        const glm::vec3 extent = (max - min) * 0.5f;
+        glm::vec3 newExtent(0.0f);
+        for (uint32_t column = 0; column < 3; ++column)
+        {
+            newExtent += glm::abs(glm::vec3(transform[column])) * extent[column];
+        }
+        return Aabb{ center - newExtent, center + newExtent };
+    }
+
+    bool Bvh::build(const Aabb* bounds, uint32_t count, ThreadPool* pool)
+    {
+        const Clock::time_point start = Clock::now();
+        mNodes.clear();
+        mPrimitives.clear();
+        mPrimitiveBounds.clear();
+        mBounds = Aabb();
+        mStats = BvhBuildStats();
+
+        if (count == 0)
+        {
+            return true;
+        }
+        if (bounds == nullptr)
+        {
+            std::cerr << "Bvh build needs the bounds of its " << count << " primitives" << std::endl;
+            return false;
+        }
+
+        mPrimitiveBounds.assign(bounds, bounds + count);
+
+        BuildContext context;
+        context.pool = pool;
+        context.primitives.resize(count);
+
+        BuildRange root;
+        root.begin = 0;
+        root.end = count;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            context.primitives[i] = { bounds[i], getCentroid(bounds[i]), i };
+            root.bounds.grow(bounds[i]);
+            root.centroids.grow(context.primitives[i].centroid);
+        }
+
+        // every node but the root has at least two children, so there are at most count nodes. Pages of the
+        // scratch array that are never written are never touched either
+        std::unique_ptr<BvhNode[]> nodes(new BvhNode[count]);
+        context.nodes = nodes.get();
+        context.nodeCount = 1;
+        buildNode(context, 0, root, 0);
+        if (pool != nullptr)
+        {
+            pool->getJobSystem().wait(context.counter);
+        }
+
+        mNodes.assign(nodes.get(), nodes.get() + context.nodeCount.load());
+        mPrimitives.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mPrimitives[i] = context.primitives[i].index;
+        }
+        mBounds = root.bounds;
+
+        mStats.nodes = uint32_t(mNodes.size());
+        mStats.leaves = context.leafCount.load();
+        mStats.maxDepth = context.maxDepth.load();
+        mStats.buildTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        return true;
+    }
+
+    void Bvh::refit(const Aabb* bounds)
+    {
+        if (mNodes.empty())
+        {
+            return;
+        }
+
+        mPrimitiveBounds.assign(bounds, bounds + mPrimitives.size());
+        for (size_t nodeIndex = mNodes.size(); nodeIndex-- > 0;)
+        {
+            BvhNode& node = mNodes[nodeIndex];
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                if (node.children[slot] == BvhNode::kEmpty)
+                {
+                    continue;
+                }
+
+                Aabb slotBounds;
+                if (node.counts[slot] > 0)
+                {
+                    for (uint32_t i = node.children[slot]; i < node.children[slot] + node.counts[slot]; ++i)
+                    {
+                        slotBounds.grow(bounds[mPrimitives[i]]);
+                    }
+                }
+                else
+                {
+                    slotBounds = getNodeBounds(mNodes[node.children[slot]]);
+                }
+                setSlot(node, slot, slotBounds, node.children[slot], node.counts[slot]);
+            }
+        }
+        mBounds = getNodeBounds(mNodes[0]);
+    }
+
+    void Bvh::queryAabb(const Aabb& box, std::vector<uint32_t>& result) const
+    {
+        if (mNodes.empty())
+        {
+            return;
+        }
+
+        uint32_t stack[kStackSize];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const BvhNode& node = mNodes[stack[--stackSize]];
+            uint32_t mask = 0;
+#if defined(BVH_X86)
+            __m128 overlap = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                overlap = _mm_and_ps(overlap, _mm_cmple_ps(_mm_load_ps(node.bounds[axis]), _mm_set1_ps(box.max[axis])));
+                overlap = _mm_and_ps(overlap, _mm_cmpge_ps(_mm_load_ps(node.bounds[axis + 3]), _mm_set1_ps(box.min[axis])));
+            }
+            mask = uint32_t(_mm_movemask_ps(overlap));
+#else
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                bool overlap = true;
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    overlap = overlap && node.bounds[axis][slot] <= box.max[axis] && node.bounds[axis + 3][slot] >= box.min[axis];
+                }
+                mask |= overlap ? 1u << slot : 0u;
+            }
+#endif
+
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                if ((mask & (1u << slot)) == 0)
+                {
+                    continue;
+                }
+                if (node.counts[slot] == 0)
+                {
+                    stack[stackSize++] = node.children[slot];
+                    continue;
+                }
+
+                for (uint32_t i = node.children[slot]; i < node.children[slot] + node.counts[slot]; ++i)
+                {
+                    const Aabb& bounds = mPrimitiveBounds[mPrimitives[i]];
+                    if (glm::all(glm::lessThanEqual(bounds.min, box.max)) && glm::all(glm::greaterThanEqual(bounds.max, box.min)))
+                    {
+                        result.push_back(mPrimitives[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    void Bvh::querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const
+    {
+        if (mNodes.empty())
+        {
+            return;
+        }
+
+        // the squared distance from the center to the nearest point of the box, huge for inverted boxes
+        const float radiusSquared = radius * radius;
+        auto distanceSquared = [&center](const glm::vec3& min, const glm::vec3& max)
+        {
+            const glm::vec3 distance = glm::max(min - center, glm::vec3(0.0f)) + glm::max(center - max, glm::vec3(0.0f));
+            return glm::dot(distance, distance);
+        };
+
+        uint32_t stack[kStackSize];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const BvhNode& node = mNodes[stack[--stackSize]];
+            uint32_t mask = 0;
+#if defined(BVH_X86)
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                const __m128 position = _mm_set1_ps(center[axis]);
+                const __m128 below = _mm_max_ps(_mm_sub_ps(_mm_load_ps(node.bounds[axis]), position), _mm_setzero_ps());
+                const __m128 above = _mm_max_ps(_mm_sub_ps(position, _mm_load_ps(node.bounds[axis + 3])), _mm_setzero_ps());
+                const __m128 distance = _mm_add_ps(below, above);
+                sum = _mm_add_ps(sum, _mm_mul_ps(distance, distance));
+            }
+            mask = uint32_t(_mm_movemask_ps(_mm_cmple_ps(sum, _mm_set1_ps(radiusSquared))));
+#else
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                const glm::vec3 min(node.bounds[0][slot], node.bounds[1][slot], node.bounds[2][slot]);
+                const glm::vec3 max(node.bounds[3][slot], node.bounds[4][slot], node.bounds[5][slot]);
+                mask |= distanceSquared(min, max) <= radiusSquared ? 1u << slot : 0u;
+            }
+#endif
+
+            for (uint32_t slot = 0; slot < 4; ++slot)
+            {
+                if ((mask & (1u << slot)) == 0)
+                {
+                    continue;
+                }
+                if (node.counts[slot] == 0)
+                {
+                    stack[stackSize++] = node.children[slot];
+                    continue;
+                }
+
+                for (uint32_t i = node.children[slot]; i < node.children[slot] + node.counts[slot]; ++i)
+                {
+                    const Aabb& bounds = mPrimitiveBounds[mPrimitives[i]];
+                    if (distanceSquared(bounds.min, bounds.max) <= radiusSquared)
+                    {
+                        result.push_back(mPrimitives[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    bool MeshBvh::build(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+        ThreadPool* pool)
+    {
+        mIndices.clear();
+        mTriangles.clear();
+        if (positions == nullptr || indices == nullptr || stride < 3 || indexCount % 3 != 0)
+        {
+            std::cerr << "Mesh BVH needs positions of at least three floats and whole triangles" << std::endl;
+            return false;
+        }
+        for (uint32_t i = 0; i < indexCount; ++i)
+        {
+            if (indices[i] >= vertexCount)
+            {
+                std::cerr << "Mesh BVH index " << i << " references vertex " << indices[i] << " of " << vertexCount << std::endl;
+                return false;
+            }
+        }
+
+        mIndices.assign(indices, indices + indexCount);
+        std::vector<Aabb> bounds(indexCount / 3);
+        for (uint32_t triangle = 0; triangle < indexCount / 3; ++triangle)
+        {
+            for (uint32_t corner = 0; corner < 3; ++corner)
+            {
+                bounds[triangle].grow(getPosition(positions, stride, indices[triangle * 3 + corner]));
+            }
+        }
+
+        if (!mBvh.build(bounds.data(), uint32_t(bounds.size()), pool))
+        {
+            return false;
+        }
+        updateTriangles(positions, stride, nullptr);
+        return true;
+    }
+
+    bool MeshBvh::build(const Mesh& mesh, ThreadPool* pool)
+    {
+        // the mesh factories store four floats per position
+        return build(mesh.mVertices.data(), uint32_t(mesh.mVertices.size() / 4), 4, mesh.mIndices.data(), uint32_t(mesh.mIndices.size()), pool);
+    }
+
+    void MeshBvh::refit(const float* positions, uint32_t stride)
+    {
+        std::vector<Aabb> bounds(mIndices.size() / 3);
+        updateTriangles(positions, stride, &bounds);
+        mBvh.refit(bounds.data());
+    }
+
+    void MeshBvh::updateTriangles(const float* positions, uint32_t stride, std::vector<Aabb>* bounds)
+    {
+        // copied in leaf order, a leaf's triangles are next to each other in memory
+        const std::vector<uint32_t>& order = mBvh.getPrimitives();
+        mTriangles.resize(order.size() * 3);
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const uint32_t* triangle = &mIndices[size_t(order[i]) * 3];
+            const glm::vec3 a = getPosition(positions, stride, triangle[0]);
+            const glm::vec3 b = getPosition(positions, stride, triangle[1]);
+            const glm::vec3 c = getPosition(positions, stride, triangle[2]);
+            mTriangles[i * 3 + 0] = a;
+            mTriangles[i * 3 + 1] = b - a;
+            mTriangles[i * 3 + 2] = c - a;
+
+            if (bounds != nullptr)
+            {
+                Aabb& box = (*bounds)[order[i]];
+                box.grow(a);
+                box.grow(b);
+                box.grow(c);
+            }
+        }
+    }
+
+    bool MeshBvh::intersect(const Ray& ray, RayHit& hit) const
+    {
+        const std::vector<uint32_t>& order = mBvh.getPrimitives();
+        bool found = false;
+        traverseRay(mBvh, ray, std::min(ray.tMax, hit.t), [&](uint32_t first, uint32_t count, float& tMax)
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                float t;
+                float u;
+                float v;
+                if (intersectTriangle(ray, &mTriangles[size_t(i) * 3], tMax, t, u, v))
+                {
+                    tMax = t;
+                    hit.t = t;
+                    hit.object = RayHit::kNone;
+                    hit.triangle = order[i];
+                    hit.u = u;
+                    hit.v = v;
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+
+    bool SceneBvh::build(const BvhInstance* instances, uint32_t count, ThreadPool* pool)
+    {
+        mInstances.clear();
+        mBounds.clear();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (instances[i].mesh == nullptr)
+            {
+                std::cerr << "Scene BVH instance " << i << " has no mesh" << std::endl;
+                return false;
+            }
+        }
+
+        mInstances.resize(count);
+        mBounds.resize(count);
+        updateInstances(instances, count);
+        return mBvh.build(mBounds.data(), count, pool);
+    }
+
+    void SceneBvh::refit(const BvhInstance* instances)
+    {
+        updateInstances(instances, uint32_t(mInstances.size()));
+        mBvh.refit(mBounds.data());
+    }
+
+    void SceneBvh::updateInstances(const BvhInstance* instances, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mInstances[i].mesh = instances[i].mesh;
+            mInstances[i].worldToObject = glm::inverse(instances[i].transform);
+            mBounds[i] = instances[i].mesh->getBounds().transformed(instances[i].transform);
+        }
+    }
+
+    bool SceneBvh::intersect(const Ray& ray, RayHit& hit) const
+    {
+        const std::vector<uint32_t>& order = mBvh.getPrimitives();
+        bool found = false;
+        traverseRay(mBvh, ray, std::min(ray.tMax, hit.t), [&](uint32_t first, uint32_t count, float& tMax)
+        {
+            for (uint32_t i = first; i < first + count; ++i)
+            {
+                // an affine transform keeps distances along the ray in multiples of the direction
+                const Instance& instance = mInstances[order[i]];
+                Ray local;
+                local.origin = glm::vec3(instance.worldToObject * glm::vec4(ray.origin, 1.0f));
+                local.direction = glm::mat3(instance.worldToObject) * ray.direction;
+                local.tMax = tMax;
+                if (instance.mesh->intersect(local, hit))
+                {
+                    tMax = hit.t;
+                    hit.object = order[i];
+                    found = true;
+                }
+            }
+        });
+        return found;
+    }
+}
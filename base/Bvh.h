@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+#include "Ray.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    struct Aabb
+    {
+        glm::vec3 min = glm::vec3(FLT_MAX);
+        glm::vec3 max = glm::vec3(-FLT_MAX);
+
+        void grow(const glm::vec3& point)
+        {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+
+        void grow(const Aabb& other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+
+        bool isEmpty() const { return min.x > max.x; }
+
+        float getSurfaceArea() const
+        {
+            const glm::vec3 extent = max - min;
+            return isEmpty() ? 0.0f : 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+        }
+
+        // the box around the eight transformed corners
+        Aabb transformed(const glm::mat4& transform) const;
+    };
+
+    struct RayHit
+    {
+        static constexpr uint32_t kNone = ~0u;
+
+        float t = FLT_MAX;
+        // index of the SceneBvh instance, kNone for MeshBvh queries
+        uint32_t object = kNone;
+        // index into the mesh's index buffer divided by three
+        uint32_t triangle = kNone;
+        // barycentrics of the second and third vertex
+        float u = 0.0f;
+        float v = 0.0f;
+
+        bool isHit() const { return triangle != kNone; }
+    };
+
+    // Four children per node in structure of arrays form, so one SSE instruction tests a ray or a box against
+    // all of them. 128 bytes, two cache lines. Empty slots have inverted bounds that no query overlaps.
+    struct alignas(64) BvhNode
+    {
+        static constexpr uint32_t kEmpty = ~0u;
+
+        // minX, minY, minZ, maxX, maxY, maxZ of the four children
+        float bounds[6][4];
+
+        // a node index when count is 0, otherwise the first of count entries in Bvh::getPrimitives()
+        uint32_t children[4];
+        uint32_t counts[4];
+    };
+
+    struct BvhBuildStats
+    {
+        double buildTime = 0.0;
+        uint32_t nodes = 0;
+        uint32_t leaves = 0;
+        uint32_t maxDepth = 0;
+    };
+
+    // Bounding volume hierarchy over boxes, built top down with binned SAH splits. A node is filled by splitting
+    // the child with the largest surface area until it has four, large subtrees are built as jobs. Parents
+    // come before their children in the node array, which refit walks backwards.
+    class Bvh
+    {
+    public:
+        static constexpr uint32_t kBins = 16;
+        static constexpr uint32_t kMaxLeafSize = 8;
+        static constexpr uint32_t kMaxDepth = 48;
+
+        // subtrees with fewer primitives are built on the thread that split them
+        static constexpr uint32_t kParallelThreshold = 8192;
+
+        bool build(const Aabb* bounds, uint32_t count, ThreadPool* pool = nullptr);
+
+        // new bounds for the same primitives, the tree keeps its topology and only gets looser
+        void refit(const Aabb* bounds);
+
+        // primitives whose bounds overlap, appended to result
+        void queryAabb(const Aabb& box, std::vector<uint32_t>& result) const;
+        void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+
+        bool isEmpty() const { return mNodes.empty(); }
+        const Aabb& getBounds() const { return mBounds; }
+
+        const std::vector<BvhNode>& getNodes() const { return mNodes; }
+        // primitive indices in leaf order
+        const std::vector<uint32_t>& getPrimitives() const { return mPrimitives; }
+        const BvhBuildStats& getStats() const { return mStats; }
+
+    private:
+        std::vector<BvhNode> mNodes;
+        std::vector<uint32_t> mPrimitives;
+        std::vector<Aabb> mPrimitiveBounds;
+        Aabb mBounds;
+        BvhBuildStats mStats;
+    };
+
+    // the bottom level, a Bvh over the triangles of one mesh
+    class MeshBvh
+    {
+    public:
+        // positions holds stride floats per vertex, the first three are the position
+        bool build(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+            ThreadPool* pool = nullptr);
+        bool build(const Mesh& mesh, ThreadPool* pool = nullptr);
+
+        // moved vertices of the same mesh, e.g. after skinning
+        void refit(const float* positions, uint32_t stride);
+
+        // closest hit closer than ray.tMax and hit.t, returns whether hit was updated
+        bool intersect(const Ray& ray, RayHit& hit) const;
+
+        // triangles whose bounds overlap, a superset of the triangles touching the box or sphere
+        void queryAabb(const Aabb& box, std::vector<uint32_t>& triangles) const { mBvh.queryAabb(box, triangles); }
+        void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& triangles) const { mBvh.querySphere(center, radius, triangles); }
+
+        const Aabb& getBounds() const { return mBvh.getBounds(); }
+        uint32_t getTriangleCount() const { return uint32_t(mIndices.size() / 3); }
+        const Bvh& getBvh() const { return mBvh; }
+
+    private:
+        void updateTriangles(const float* positions, uint32_t stride, std::vector<Aabb>* bounds);
+
+        Bvh mBvh;
+        std::vector<uint32_t> mIndices;
+
+        // first vertex and the two edges from it of every triangle, in leaf order
+        std::vector<glm::vec3> mTriangles;
+    };
+
+    struct BvhInstance
+    {
+        const MeshBvh* mesh = nullptr;
+        glm::mat4 transform = glm::mat4(1.0f);
+    };
+
+    // the top level, a Bvh over the world space bounds of mesh instances. Rays are moved into each
+    // instance's object space, so instances share their MeshBvh
+    class SceneBvh
+    {
+    public:
+        bool build(const BvhInstance* instances, uint32_t count, ThreadPool* pool = nullptr);
+
+        // new transforms for the same instances, cheaper than a build for a few frames of animation
+        void refit(const BvhInstance* instances);
+
+        bool intersect(const Ray& ray, RayHit& hit) const;
+
+        // instances whose world space bounds overlap
+        void queryAabb(const Aabb& box, std::vector<uint32_t>& instances) const { mBvh.queryAabb(box, instances); }
+        void querySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& instances) const { mBvh.querySphere(center, radius, instances); }
+
+        const Aabb& getBounds() const { return mBvh.getBounds(); }
+        const Bvh& getBvh() const { return mBvh; }
+
+    private:
+        void updateInstances(const BvhInstance* instances, uint32_t count);
+
+        struct Instance
+        {
+            const MeshBvh* mesh;
+            glm::mat4 worldToObject;
+        };
+
+        Bvh mBvh;
+        std::vector<Instance> mInstances;
+        std::vector<Aabb> mBounds;
+    };
+}
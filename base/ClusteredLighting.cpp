@@ -0,0 +1,440 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CLUSTERS_X86 1
+#include <immintrin.h>
+#endif
+
+// the AVX2 test is compiled for its instruction set individually and selected at runtime
+#if defined(CLUSTERS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        enum BoundsComponent : uint32_t
+        {
+            BOUNDS_MIN_X,
+            BOUNDS_MIN_Y,
+            BOUNDS_MIN_Z,
+            BOUNDS_MAX_X,
+            BOUNDS_MAX_Y,
+            BOUNDS_MAX_Z,
+        };
+
+        // offset and count of a cluster's lights in the index list
+        struct GpuCluster
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        GLsizeiptr alignSize(GLsizeiptr size, GLsizeiptr alignment)
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        // bit i is set when the sphere touches froxel offset + i
+        uint32_t testSpheresScalar(const std::vector<float>* bounds, size_t offset, const glm::vec4& sphere)
+        {
+            uint32_t mask = 0;
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                float distanceSquared = 0.0f;
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    const float center = sphere[axis];
+                    const float outside = std::max(std::max(bounds[BOUNDS_MIN_X + axis][offset + i] - center, center - bounds[BOUNDS_MAX_X + axis][offset + i]), 0.0f);
+                    distanceSquared += outside * outside;
+                }
+                mask |= distanceSquared <= sphere.w * sphere.w ? 1u << i : 0u;
+            }
+            return mask;
+        }
+
+#if defined(CLUSTERS_X86)
+        TARGET_AVX2 uint32_t testSpheresAvx2(const std::vector<float>* bounds, size_t offset, const glm::vec4& sphere)
+        {
+            const __m256 zero = _mm256_setzero_ps();
+            __m256 distanceSquared = zero;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                const __m256 center = _mm256_set1_ps(sphere[axis]);
+                const __m256 low = _mm256_sub_ps(_mm256_loadu_ps(bounds[BOUNDS_MIN_X + axis].data() + offset), center);
+                const __m256 high = _mm256_sub_ps(center, _mm256_loadu_ps(bounds[BOUNDS_MAX_X + axis].data() + offset));
+                const __m256 outside = _mm256_max_ps(_mm256_max_ps(low, high), zero);
+                distanceSquared = _mm256_add_ps(distanceSquared, _mm256_mul_ps(outside, outside));
+            }
+            const __m256 inside = _mm256_cmp_ps(distanceSquared, _mm256_set1_ps(sphere.w * sphere.w), _CMP_LE_OQ);
+            return uint32_t(_mm256_movemask_ps(inside));
+        }
+#endif
+    }
+
+    ClusteredLighting::~ClusteredLighting()
+    {
+        destroy();
+    }
+
+    bool ClusteredLighting::init(const ClusterGridSettings& settings)
+    {
+        destroy();
+
+        if (settings.tilesX == 0 || settings.tilesY == 0 || settings.slices == 0 || settings.maxLights == 0 || settings.maxLightIndices == 0)
+        {
+            std::cerr << "Clustered lighting needs at least one cluster, light and light index" << std::endl;
+            return false;
+        }
+
+        mSettings = settings;
+        mSimdLevel = getSupportedSimdLevel();
+        mRowStride = (settings.tilesX + 7) / 8 * 8;
+
+        const size_t clusterCount = size_t(settings.tilesX) * settings.tilesY * settings.slices;
+        for (std::vector<float>& bounds : mBounds)
+        {
+            bounds.assign(size_t(mRowStride) * settings.tilesY * settings.slices, 0.0f);
+        }
+        mSliceLights.assign(settings.slices, std::vector<uint32_t>());
+        mClusterLights.assign(clusterCount, std::vector<uint32_t>());
+        mLightBounds.reserve(settings.maxLights);
+        mProjection = glm::mat4(0.0f);
+
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        mRangeSizes[0] = alignSize(GLsizeiptr(settings.maxLights) * sizeof(GpuLight), alignment);
+        mRangeSizes[1] = alignSize(GLsizeiptr(clusterCount) * sizeof(GpuCluster), alignment);
+        mRangeSizes[2] = alignSize(GLsizeiptr(settings.maxLightIndices) * sizeof(uint32_t), alignment);
+        mRangeOffsets[0] = 0;
+        mRangeOffsets[1] = mRangeSizes[0];
+        mRangeOffsets[2] = mRangeSizes[0] + mRangeSizes[1];
+
+        if (!mBuffer.init(mRangeOffsets[2] + mRangeSizes[2], alignment))
+        {
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void ClusteredLighting::destroy()
+    {
+        mBuffer.destroy();
+
+        mLightBounds.clear();
+        mSliceLights.clear();
+        mClusterLights.clear();
+        mLightCount = 0;
+        mStats = ClusteredLightingStats();
+    }
+
+    void ClusteredLighting::setSimdLevel(SimdLevel level)
+    {
+        mSimdLevel = clampSimdLevel(level);
+    }
+
+    void ClusteredLighting::update(const glm::mat4& view, const glm::mat4& projection, const Light* lights, uint32_t count, ThreadPool* pool)
+    {
+        if (!mBuffer.isMapped())
+        {
+            return;
+        }
+
+        // the fence covers everything submitted so far, including the draws that read the previous region
+        mBuffer.release();
+        char* region = static_cast<char*>(mBuffer.acquire());
+
+        if (projection != mProjection)
+        {
+            buildClusterBounds(projection);
+        }
+
+        const Clock::time_point start = Clock::now();
+        mStats = ClusteredLightingStats();
+        mStats.droppedLights = count > mSettings.maxLights ? count - mSettings.maxLights : 0;
+        mLightCount = std::min(count, mSettings.maxLights);
+
+        // view space bounding spheres and the froxels they can reach
+        mLightBounds.resize(mLightCount);
+        auto bound = [&](uint32_t begin, uint32_t end)
+        {
+            const float tilesX = float(mSettings.tilesX);
+            const float tilesY = float(mSettings.tilesY);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const Light& light = lights[i];
+                LightBounds& bounds = mLightBounds[i];
+
+                glm::vec3 center = light.position;
+                float radius = light.range;
+                if (light.type == LIGHT_SPOT)
+                {
+                    // the smallest sphere around the cone
+                    const float angle = std::min(light.outerAngle, 1.5f);
+                    const glm::vec3 direction = glm::normalize(light.direction);
+                    if (angle > 0.785398f)
+                    {
+                        center += direction * (light.range * std::cos(angle));
+                        radius = light.range * std::sin(angle);
+                    }
+                    else
+                    {
+                        radius = light.range / (2.0f * std::cos(angle));
+                        center += direction * radius;
+                    }
+                }
+
+                const glm::vec3 viewCenter = glm::vec3(view * glm::vec4(center, 1.0f));
+                bounds.sphere = glm::vec4(viewCenter, radius);
+
+                const float nearest = -viewCenter.z - radius;
+                const float farthest = -viewCenter.z + radius;
+                if (farthest < mNear || nearest > mFar)
+                {
+                    bounds.slice0 = 1;
+                    bounds.slice1 = 0;
+                    continue;
+                }
+                bounds.slice0 = getSlice(std::max(nearest, mNear));
+                bounds.slice1 = getSlice(std::min(farthest, mFar));
+
+                // lights reaching through the near plane may cover any tile, the others by their projected box
+                glm::vec2 ndcMin(-1.0f);
+                glm::vec2 ndcMax(1.0f);
+                if (nearest > mNear)
+                {
+                    ndcMin = glm::vec2(std::numeric_limits<float>::max());
+                    ndcMax = glm::vec2(-std::numeric_limits<float>::max());
+                    for (uint32_t corner = 0; corner < 8; ++corner)
+                    {
+                        const glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+                        const glm::vec4 clip = mProjection * glm::vec4(viewCenter + offset, 1.0f);
+                        const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                        ndcMin = glm::min(ndcMin, ndc);
+                        ndcMax = glm::max(ndcMax, ndc);
+                    }
+                }
+                if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f)
+                {
+                    bounds.slice0 = 1;
+                    bounds.slice1 = 0;
+                    continue;
+                }
+
+                bounds.tileX0 = uint32_t(glm::clamp((ndcMin.x * 0.5f + 0.5f) * tilesX, 0.0f, tilesX - 1.0f));
+                bounds.tileY0 = uint32_t(glm::clamp((ndcMin.y * 0.5f + 0.5f) * tilesY, 0.0f, tilesY - 1.0f));
+                bounds.tileX1 = uint32_t(glm::clamp((ndcMax.x * 0.5f + 0.5f) * tilesX, 0.0f, tilesX - 1.0f));
+                bounds.tileY1 = uint32_t(glm::clamp((ndcMax.y * 0.5f + 0.5f) * tilesY, 0.0f, tilesY - 1.0f));
+            }
+        };
+
+        if (pool != nullptr)
+        {
+            pool->parallelFor(mLightCount, 512, bound);
+        }
+        else
+        {
+            bound(0, mLightCount);
+        }
+
+        for (std::vector<uint32_t>& sliceLights : mSliceLights)
+        {
+            sliceLights.clear();
+        }
+        for (uint32_t i = 0; i < mLightCount; ++i)
+        {
+            for (uint32_t slice = mLightBounds[i].slice0; slice <= mLightBounds[i].slice1 && slice < mSettings.slices; ++slice)
+            {
+                mSliceLights[slice].push_back(i);
+            }
+        }
+
+        // slices own disjoint clusters, so they are tested without synchronization
+        if (pool != nullptr)
+        {
+            pool->parallelFor(mSettings.slices, 1, [this](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t slice = begin; slice < end; ++slice)
+                {
+                    assignSlice(slice);
+                }
+            });
+        }
+        else
+        {
+            for (uint32_t slice = 0; slice < mSettings.slices; ++slice)
+            {
+                assignSlice(slice);
+            }
+        }
+
+        const Clock::time_point assigned = Clock::now();
+        mStats.assignTime = std::chrono::duration<double, std::milli>(assigned - start).count();
+
+        GpuLight* gpuLights = reinterpret_cast<GpuLight*>(region + mRangeOffsets[0]);
+        for (uint32_t i = 0; i < mLightCount; ++i)
+        {
+            const Light& light = lights[i];
+            GpuLight& gpuLight = gpuLights[i];
+            gpuLight.positionRange = glm::vec4(light.position, light.range);
+            gpuLight.colorIntensity = glm::vec4(light.color, light.intensity);
+            gpuLight.directionType = glm::vec4(glm::normalize(light.direction), float(light.type));
+            gpuLight.cone = glm::vec4(std::cos(light.innerAngle), std::cos(light.outerAngle), 0.0f, 0.0f);
+        }
+
+        GpuCluster* clusters = reinterpret_cast<GpuCluster*>(region + mRangeOffsets[1]);
+        uint32_t* indices = reinterpret_cast<uint32_t*>(region + mRangeOffsets[2]);
+        uint32_t offset = 0;
+        for (size_t cluster = 0; cluster < mClusterLights.size(); ++cluster)
+        {
+            const std::vector<uint32_t>& clusterLights = mClusterLights[cluster];
+            const uint32_t clusterCount = std::min(uint32_t(clusterLights.size()), mSettings.maxLightIndices - offset);
+            std::memcpy(indices + offset, clusterLights.data(), clusterCount * sizeof(uint32_t));
+            clusters[cluster] = { offset, clusterCount };
+
+            offset += clusterCount;
+            mStats.droppedIndices += uint32_t(clusterLights.size()) - clusterCount;
+            mStats.maxLightsPerCluster = std::max(mStats.maxLightsPerCluster, clusterCount);
+        }
+
+        mStats.lights = mLightCount;
+        mStats.lightIndices = offset;
+        mStats.uploadTime = std::chrono::duration<double, std::milli>(Clock::now() - assigned).count();
+    }
+
+    void ClusteredLighting::bind(const OpenglProgram& program, uint32_t viewportWidth, uint32_t viewportHeight) const
+    {
+        if (!mBuffer.isMapped())
+        {
+            return;
+        }
+
+        const GLintptr region = mBuffer.getOffset();
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kLightBinding, mBuffer.getId(), region + mRangeOffsets[0], mRangeSizes[0]);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kClusterBinding, mBuffer.getId(), region + mRangeOffsets[1], mRangeSizes[1]);
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, kIndexBinding, mBuffer.getId(), region + mRangeOffsets[2], mRangeSizes[2]);
+
+        // slice = log(depth) * scale - bias
+        const float logRatio = std::log(mFar / mNear);
+        const float scale = float(mSettings.slices) / logRatio;
+        const float bias = float(mSettings.slices) * std::log(mNear) / logRatio;
+
+        const GLuint id = program.id;
+        glProgramUniform3ui(id, glGetUniformLocation(id, "u_clusterGrid"), mSettings.tilesX, mSettings.tilesY, mSettings.slices);
+        glProgramUniform2f(id, glGetUniformLocation(id, "u_clusterViewport"), float(viewportWidth), float(viewportHeight));
+        glProgramUniform2f(id, glGetUniformLocation(id, "u_clusterDepth"), scale, bias);
+        glProgramUniform2f(id, glGetUniformLocation(id, "u_clusterPlanes"), mNear, mFar);
+        glProgramUniform1ui(id, glGetUniformLocation(id, "u_lightCount"), mLightCount);
+    }
+
+    void ClusteredLighting::buildClusterBounds(const glm::mat4& projection)
+    {
+        mProjection = projection;
+        mNear = projection[3][2] / (projection[2][2] - 1.0f);
+        mFar = projection[3][2] / (projection[2][2] + 1.0f);
+
+        const glm::mat4 inverseProjection = glm::inverse(projection);
+        const float ratio = mFar / mNear;
+        for (uint32_t slice = 0; slice < mSettings.slices; ++slice)
+        {
+            const float sliceNear = mNear * std::pow(ratio, float(slice) / float(mSettings.slices));
+            const float sliceFar = mNear * std::pow(ratio, float(slice + 1) / float(mSettings.slices));
+
+            for (uint32_t y = 0; y < mSettings.tilesY; ++y)
+            {
+                for (uint32_t x = 0; x < mSettings.tilesX; ++x)
+                {
+                    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+                    glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+                    for (uint32_t corner = 0; corner < 4; ++corner)
+                    {
+                        // the tile corner on the near plane, scaled along its view ray to both slice depths
+                        const float ndcX = float(x + (corner & 1)) / float(mSettings.tilesX) * 2.0f - 1.0f;
+                        const float ndcY = float(y + (corner >> 1)) / float(mSettings.tilesY) * 2.0f - 1.0f;
+                        const glm::vec4 point = inverseProjection * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+                        const glm::vec3 ray = glm::vec3(point) / -point.z;
+
+                        boundsMin = glm::min(boundsMin, glm::min(ray * sliceNear, ray * sliceFar));
+                        boundsMax = glm::max(boundsMax, glm::max(ray * sliceNear, ray * sliceFar));
+                    }
+
+                    const size_t index = (size_t(slice) * mSettings.tilesY + y) * mRowStride + x;
+                    for (uint32_t axis = 0; axis < 3; ++axis)
+                    {
+                        mBounds[BOUNDS_MIN_X + axis][index] = boundsMin[axis];
+                        mBounds[BOUNDS_MAX_X + axis][index] = boundsMax[axis];
+                    }
+                }
+            }
+        }
+    }
+
+    void ClusteredLighting::assignSlice(uint32_t slice)
+    {
+        const uint32_t tilesX = mSettings.tilesX;
+        const uint32_t tilesY = mSettings.tilesY;
+        for (uint32_t cluster = slice * tilesX * tilesY; cluster < (slice + 1) * tilesX * tilesY; ++cluster)
+        {
+            mClusterLights[cluster].clear();
+        }
+
+        const bool avx2 = mSimdLevel == SimdLevel::SIMD_AVX2;
+        for (uint32_t light : mSliceLights[slice])
+        {
+            const LightBounds& bounds = mLightBounds[light];
+            for (uint32_t y = bounds.tileY0; y <= bounds.tileY1; ++y)
+            {
+                const size_t row = (size_t(slice) * tilesY + y) * mRowStride;
+                for (uint32_t x = bounds.tileX0 & ~7u; x <= bounds.tileX1; x += 8)
+                {
+                    uint32_t mask;
+#if defined(CLUSTERS_X86)
+                    if (avx2)
+                    {
+                        mask = testSpheresAvx2(mBounds, row + x, bounds.sphere);
+                    }
+                    else
+#endif
+                    {
+                        mask = testSpheresScalar(mBounds, row + x, bounds.sphere);
+                    }
+
+                    // only the tiles of the light's rectangle, the padding at the end of a row never matches
+                    const uint32_t first = std::max(bounds.tileX0, x) - x;
+                    const uint32_t last = std::min(bounds.tileX1, x + 7) - x;
+                    mask &= (0xffu << first) & (0xffu >> (7 - last));
+
+                    for (uint32_t bit = first; mask != 0; ++bit)
+                    {
+                        if ((mask & (1u << bit)) != 0)
+                        {
+                            mClusterLights[(size_t(slice) * tilesY + y) * tilesX + x + bit].push_back(light);
+                            mask &= ~(1u << bit);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t ClusteredLighting::getSlice(float depth) const
+    {
+        const float slice = std::log(depth / mNear) * float(mSettings.slices) / std::log(mFar / mNear);
+        return uint32_t(glm::clamp(slice, 0.0f, float(mSettings.slices - 1)));
+    }
+}
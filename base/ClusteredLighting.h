@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Cpu.h"
+#include "OpenGLUtils.h"
+#include "StreamingBuffer.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    enum LightType : uint32_t
+    {
+        LIGHT_POINT,
+        LIGHT_SPOT,
+    };
+
+    struct Light
+    {
+        glm::vec3 position = glm::vec3(0.0f);
+        float range = 10.0f;
+        glm::vec3 color = glm::vec3(1.0f);
+        float intensity = 1.0f;
+
+        // spot lights only, the cone fades out between the inner and outer half angles in radians
+        glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+        float innerAngle = 0.3f;
+        float outerAngle = 0.5f;
+
+        LightType type = LIGHT_POINT;
+    };
+
+    struct ClusterGridSettings
+    {
+        // screen tiles and exponential depth slices between the near and far plane
+        uint32_t tilesX = 16;
+        uint32_t tilesY = 9;
+        uint32_t slices = 24;
+
+        uint32_t maxLights = 1u << 14;
+
+        // shared by all clusters, assignments beyond it are dropped and counted
+        uint32_t maxLightIndices = 1u << 20;
+    };
+
+    struct ClusteredLightingStats
+    {
+        uint32_t lights = 0;
+        uint32_t lightIndices = 0;
+        uint32_t droppedLights = 0;
+        uint32_t droppedIndices = 0;
+
+        // the busiest cluster, what a fragment there loops over
+        uint32_t maxLightsPerCluster = 0;
+
+        // milliseconds for binning and testing, and for writing the mapped buffers
+        double assignTime = 0.0;
+        double uploadTime = 0.0;
+    };
+
+    // Clustered forward lighting. The view frustum is split into tilesX x tilesY x slices froxels, every light's
+    // bounding sphere is tested against the view space bounds of the froxels it may touch, 8 froxels of a row at
+    // a time, with the depth slices spread over a thread pool. The result is uploaded into a StreamingBuffer,
+    // every region holds three ranges:
+    //   lights   - kLightBinding, the lights in world space
+    //   clusters - kClusterBinding, offset and count into the index list per froxel
+    //   indices  - kIndexBinding, light indices of all clusters back to back
+    // Fragment shaders #include "../common/clustered_lighting.glsl" and call shadeClusteredLights().
+    class ClusteredLighting
+    {
+    public:
+        static constexpr uint32_t kRegionCount = StreamingBuffer::kRegionCount;
+        static constexpr GLuint kLightBinding = 8;
+        static constexpr GLuint kClusterBinding = 9;
+        static constexpr GLuint kIndexBinding = 10;
+
+        ClusteredLighting() = default;
+        ~ClusteredLighting();
+
+        ClusteredLighting(const ClusteredLighting&) = delete;
+        ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+        bool init(const ClusterGridSettings& settings = ClusterGridSettings());
+        void destroy();
+
+        // defaults to the best level supported by the CPU, SSE4.1 falls back to the scalar test
+        void setSimdLevel(SimdLevel level);
+
+        // projection has to be a perspective projection, the froxel bounds are rebuilt when it changes.
+        // Waits for the GPU to release the region written kRegionCount updates ago
+        void update(const glm::mat4& view, const glm::mat4& projection, const Light* lights, uint32_t count, ThreadPool* pool = nullptr);
+
+        // binds this update's region to the three storage buffer bindings and sets the include's uniforms
+        void bind(const OpenglProgram& program, uint32_t viewportWidth, uint32_t viewportHeight) const;
+
+        const ClusteredLightingStats& getStats() const { return mStats; }
+        const ClusterGridSettings& getSettings() const { return mSettings; }
+
+    private:
+        // std430 layout of ClusterLight in clustered_lighting.glsl
+        struct GpuLight
+        {
+            glm::vec4 positionRange;
+            glm::vec4 colorIntensity;
+            glm::vec4 directionType;
+            glm::vec4 cone;
+        };
+
+        // view space bounding sphere and the froxel range it can touch
+        struct LightBounds
+        {
+            glm::vec4 sphere;
+            uint32_t tileX0;
+            uint32_t tileY0;
+            uint32_t tileX1;
+            uint32_t tileY1;
+            uint32_t slice0;
+            uint32_t slice1;
+        };
+
+        void buildClusterBounds(const glm::mat4& projection);
+        void assignSlice(uint32_t slice);
+        uint32_t getSlice(float depth) const;
+
+        ClusterGridSettings mSettings;
+        SimdLevel mSimdLevel = SimdLevel::SIMD_SCALAR;
+
+        glm::mat4 mProjection = glm::mat4(0.0f);
+        float mNear = 0.0f;
+        float mFar = 0.0f;
+
+        // froxel bounds in view space as structure of arrays, rows padded to a multiple of 8 froxels
+        uint32_t mRowStride = 0;
+        std::vector<float> mBounds[6];
+
+        std::vector<LightBounds> mLightBounds;
+        std::vector<std::vector<uint32_t>> mSliceLights;
+        std::vector<std::vector<uint32_t>> mClusterLights;
+
+        // lights, clusters and indices within a region, each aligned for glBindBufferRange
+        StreamingBuffer mBuffer;
+        GLintptr mRangeOffsets[3] = {};
+        GLsizeiptr mRangeSizes[3] = {};
+        uint32_t mLightCount = 0;
+
+        ClusteredLightingStats mStats;
+    };
+}
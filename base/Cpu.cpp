@@ -0,0 +1,83 @@
+#include "Cpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPU_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        SimdLevel detectSimdLevel()
+        {
+#if defined(CPU_X86)
+#if defined(__GNUC__) || defined(__clang__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2"))
+            {
+                return SimdLevel::SIMD_AVX2;
+            }
+            if (__builtin_cpu_supports("sse4.1"))
+            {
+                return SimdLevel::SIMD_SSE41;
+            }
+#elif defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 0);
+            const int maxLeaf = info[0];
+
+            __cpuid(info, 1);
+            const bool sse41 = (info[2] & (1 << 19)) != 0;
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+
+            bool avx2 = false;
+            if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+
+            if (avx2)
+            {
+                return SimdLevel::SIMD_AVX2;
+            }
+            if (sse41)
+            {
+                return SimdLevel::SIMD_SSE41;
+            }
+#endif
+#endif
+            return SimdLevel::SIMD_SCALAR;
+        }
+    }
+
+    SimdLevel getSupportedSimdLevel()
+    {
+        static const SimdLevel supported = detectSimdLevel();
+        return supported;
+    }
+
+    SimdLevel clampSimdLevel(SimdLevel level)
+    {
+        const SimdLevel supported = getSupportedSimdLevel();
+        return level < supported ? level : supported;
+    }
+
+    const char* getSimdLevelName(SimdLevel level)
+    {
+        switch (level)
+        {
+        case SimdLevel::SIMD_SSE41:
+            return "sse4.1";
+        case SimdLevel::SIMD_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace utils
+{
+    // instruction sets the SIMD kernels are built for, every level includes the ones below it
+    enum class SimdLevel : uint32_t
+    {
+        SIMD_SCALAR,
+        SIMD_SSE41,
+        SIMD_AVX2,
+    };
+
+    // best level the CPU and OS support, detected once. Modules keep their own active level and clamp
+    // requests to this one, so changing the level of one doesn't affect the others
+    SimdLevel getSupportedSimdLevel();
+
+    SimdLevel clampSimdLevel(SimdLevel level);
+
+    const char* getSimdLevelName(SimdLevel level);
+}
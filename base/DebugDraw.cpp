@@ -0,0 +1,357 @@
+#include "DebugDraw.h"
+
+#if UTILS_DEBUG_DRAW
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+namespace utils
+{
+    namespace
+    {
+        constexpr float kTwoPi = 6.28318530718f;
+
+        uint32_t packColor(const glm::vec4& color)
+        {
+            const glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+            return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+        }
+
+        // corner i of a box has x from bit 0, y from bit 1 and z from bit 2
+        const uint8_t kBoxEdges[12][2] =
+        {
+            { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+            { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+            { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+        };
+
+        const uint8_t kBoxFaces[6][4] =
+        {
+            { 0, 2, 4, 6 }, { 1, 5, 3, 7 },
+            { 0, 4, 1, 5 }, { 2, 3, 6, 7 },
+            { 0, 1, 2, 3 }, { 4, 6, 5, 7 },
+        };
+    }
+
+    DebugDraw::~DebugDraw()
+    {
+        destroy();
+    }
+
+    bool DebugDraw::init(std::shared_ptr<OpenglProgram> program, uint32_t maxLines, uint32_t maxTriangles)
+    {
+        destroy();
+
+        if (program == nullptr || maxLines == 0 || maxTriangles == 0)
+        {
+            std::cerr << "Debug draw needs a program and room for lines and triangles" << std::endl;
+            return false;
+        }
+
+        mProgram = program;
+        mMaxLines = maxLines;
+        mMaxTriangles = maxTriangles;
+
+        if (!mBuffer.init(GLsizeiptr(maxLines * 2 + maxTriangles * 3) * sizeof(Vertex)))
+        {
+            destroy();
+            return false;
+        }
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mBuffer.getId(), 0, sizeof(Vertex));
+        glVertexArrayAttribFormat(mVao, 0, 4, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexArrayAttribFormat(mVao, 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, color));
+        for (GLuint attribute = 0; attribute < 2; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, 0);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+        return true;
+    }
+
+    void DebugDraw::destroy()
+    {
+        if (mVao != 0)
+        {
+            glDeleteVertexArrays(1, &mVao);
+            mVao = 0;
+        }
+        mBuffer.destroy();
+
+        mProgram.reset();
+        mRegionAcquired = false;
+        mFrame = DebugDrawStats();
+        mMaxLines = 0;
+        mMaxTriangles = 0;
+    }
+
+    void DebugDraw::acquireRegion()
+    {
+        mLineVertices = static_cast<Vertex*>(mBuffer.acquire());
+        mTriangleVertices = mLineVertices + size_t(mMaxLines) * 2;
+        mRegionAcquired = true;
+    }
+
+    DebugDraw::Vertex* DebugDraw::allocateLines(uint32_t count)
+    {
+        if (!mBuffer.isMapped())
+        {
+            return nullptr;
+        }
+        if (!mRegionAcquired)
+        {
+            acquireRegion();
+        }
+        if (mFrame.lines + count > mMaxLines)
+        {
+            mFrame.droppedLines += count;
+            return nullptr;
+        }
+
+        Vertex* vertices = mLineVertices + size_t(mFrame.lines) * 2;
+        mFrame.lines += count;
+        return vertices;
+    }
+
+    DebugDraw::Vertex* DebugDraw::allocateTriangles(uint32_t count)
+    {
+        if (!mBuffer.isMapped())
+        {
+            return nullptr;
+        }
+        if (!mRegionAcquired)
+        {
+            acquireRegion();
+        }
+        if (mFrame.triangles + count > mMaxTriangles)
+        {
+            mFrame.droppedTriangles += count;
+            return nullptr;
+        }
+
+        Vertex* vertices = mTriangleVertices + size_t(mFrame.triangles) * 3;
+        mFrame.triangles += count;
+        return vertices;
+    }
+
+    void DebugDraw::line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, bool depthTest)
+    {
+        Vertex* vertices = allocateLines(1);
+        if (vertices != nullptr)
+        {
+            const float w = depthTest ? 1.0f : 0.0f;
+            const uint32_t packedColor = packColor(color);
+            vertices[0] = { glm::vec4(from, w), packedColor };
+            vertices[1] = { glm::vec4(to, w), packedColor };
+        }
+    }
+
+    void DebugDraw::triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color, bool depthTest)
+    {
+        Vertex* vertices = allocateTriangles(1);
+        if (vertices != nullptr)
+        {
+            const float w = depthTest ? 1.0f : 0.0f;
+            const uint32_t packedColor = packColor(color);
+            vertices[0] = { glm::vec4(a, w), packedColor };
+            vertices[1] = { glm::vec4(b, w), packedColor };
+            vertices[2] = { glm::vec4(c, w), packedColor };
+        }
+    }
+
+    void DebugDraw::aabb(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool depthTest)
+    {
+        const glm::vec3 size = max - min;
+        box(glm::mat4(glm::vec4(size.x * 0.5f, 0.0f, 0.0f, 0.0f), glm::vec4(0.0f, size.y * 0.5f, 0.0f, 0.0f),
+            glm::vec4(0.0f, 0.0f, size.z * 0.5f, 0.0f), glm::vec4((min + max) * 0.5f, 1.0f)), color, depthTest);
+    }
+
+    void DebugDraw::solidAabb(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool depthTest)
+    {
+        Vertex* vertices = allocateTriangles(12);
+        if (vertices == nullptr)
+        {
+            return;
+        }
+
+        const float w = depthTest ? 1.0f : 0.0f;
+        const uint32_t packedColor = packColor(color);
+        auto corner = [&](uint32_t i)
+        {
+            return Vertex{ glm::vec4((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y, (i & 4) ? max.z : min.z, w), packedColor };
+        };
+
+        for (const uint8_t* face : kBoxFaces)
+        {
+            vertices[0] = corner(face[0]);
+            vertices[1] = corner(face[1]);
+            vertices[2] = corner(face[2]);
+            vertices[3] = corner(face[2]);
+            vertices[4] = corner(face[1]);
+            vertices[5] = corner(face[3]);
+            vertices += 6;
+        }
+    }
+
+    void DebugDraw::box(const glm::mat4& transform, const glm::vec4& color, bool depthTest)
+    {
+        Vertex* vertices = allocateLines(12);
+        if (vertices == nullptr)
+        {
+            return;
+        }
+
+        glm::vec4 corners[8];
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            corners[i] = transform * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+            corners[i].w = depthTest ? 1.0f : 0.0f;
+        }
+
+        const uint32_t packedColor = packColor(color);
+        for (const uint8_t* edge : kBoxEdges)
+        {
+            vertices[0] = { corners[edge[0]], packedColor };
+            vertices[1] = { corners[edge[1]], packedColor };
+            vertices += 2;
+        }
+    }
+
+    void DebugDraw::sphere(const glm::vec3& center, float radius, const glm::vec4& color, bool depthTest, uint32_t segments)
+    {
+        segments = glm::max(segments, 3u);
+        Vertex* vertices = allocateLines(segments * 3);
+        if (vertices == nullptr)
+        {
+            return;
+        }
+
+        const float w = depthTest ? 1.0f : 0.0f;
+        const uint32_t packedColor = packColor(color);
+        glm::vec2 previous(radius, 0.0f);
+        for (uint32_t i = 1; i <= segments; ++i)
+        {
+            const float angle = kTwoPi * float(i) / float(segments);
+            const glm::vec2 current(std::cos(angle) * radius, std::sin(angle) * radius);
+
+            vertices[0] = { glm::vec4(center + glm::vec3(previous.x, previous.y, 0.0f), w), packedColor };
+            vertices[1] = { glm::vec4(center + glm::vec3(current.x, current.y, 0.0f), w), packedColor };
+            vertices[2] = { glm::vec4(center + glm::vec3(previous.x, 0.0f, previous.y), w), packedColor };
+            vertices[3] = { glm::vec4(center + glm::vec3(current.x, 0.0f, current.y), w), packedColor };
+            vertices[4] = { glm::vec4(center + glm::vec3(0.0f, previous.x, previous.y), w), packedColor };
+            vertices[5] = { glm::vec4(center + glm::vec3(0.0f, current.x, current.y), w), packedColor };
+            vertices += 6;
+
+            previous = current;
+        }
+    }
+
+    void DebugDraw::frustum(const glm::mat4& viewProjection, const glm::vec4& color, bool depthTest)
+    {
+        // the clip space cube mapped back into the world is the frustum
+        const glm::mat4 inverse = glm::inverse(viewProjection);
+        Vertex* vertices = allocateLines(12);
+        if (vertices == nullptr)
+        {
+            return;
+        }
+
+        glm::vec4 corners[8];
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const glm::vec4 corner = inverse * glm::vec4((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f, 1.0f);
+            corners[i] = glm::vec4(glm::vec3(corner) / corner.w, depthTest ? 1.0f : 0.0f);
+        }
+
+        const uint32_t packedColor = packColor(color);
+        for (const uint8_t* edge : kBoxEdges)
+        {
+            vertices[0] = { corners[edge[0]], packedColor };
+            vertices[1] = { corners[edge[1]], packedColor };
+            vertices += 2;
+        }
+    }
+
+    void DebugDraw::axis(const glm::mat4& transform, float size, bool depthTest)
+    {
+        const glm::vec3 origin = glm::vec3(transform[3]);
+        line(origin, origin + glm::vec3(transform[0]) * size, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f), depthTest);
+        line(origin, origin + glm::vec3(transform[1]) * size, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f), depthTest);
+        line(origin, origin + glm::vec3(transform[2]) * size, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), depthTest);
+    }
+
+    void DebugDraw::grid(const glm::mat4& transform, float extent, uint32_t cells, const glm::vec4& color, bool depthTest)
+    {
+        cells = glm::max(cells, 1u);
+        Vertex* vertices = allocateLines((cells + 1) * 2);
+        if (vertices == nullptr)
+        {
+            return;
+        }
+
+        const float w = depthTest ? 1.0f : 0.0f;
+        const uint32_t packedColor = packColor(color);
+        const float half = extent * 0.5f;
+        for (uint32_t i = 0; i <= cells; ++i)
+        {
+            const float offset = -half + extent * float(i) / float(cells);
+            const glm::vec4 a = transform * glm::vec4(offset, 0.0f, -half, 1.0f);
+            const glm::vec4 b = transform * glm::vec4(offset, 0.0f, half, 1.0f);
+            const glm::vec4 c = transform * glm::vec4(-half, 0.0f, offset, 1.0f);
+            const glm::vec4 d = transform * glm::vec4(half, 0.0f, offset, 1.0f);
+
+            vertices[0] = { glm::vec4(glm::vec3(a), w), packedColor };
+            vertices[1] = { glm::vec4(glm::vec3(b), w), packedColor };
+            vertices[2] = { glm::vec4(glm::vec3(c), w), packedColor };
+            vertices[3] = { glm::vec4(glm::vec3(d), w), packedColor };
+            vertices += 4;
+        }
+    }
+
+    void DebugDraw::render(const glm::mat4& viewProjection)
+    {
+        mStats = mFrame;
+        mFrame = DebugDrawStats();
+        if (!mRegionAcquired)
+        {
+            return;
+        }
+
+        const GLint first = GLint(mBuffer.getOffset() / GLintptr(sizeof(Vertex)));
+        if (mStats.lines > 0 || mStats.triangles > 0)
+        {
+            mProgram->use();
+            mProgram->setMat4("u_viewProjection", viewProjection);
+
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+            glBindVertexArray(mVao);
+            if (mStats.triangles > 0)
+            {
+                glDrawArrays(GL_TRIANGLES, first + GLint(mMaxLines) * 2, GLsizei(mStats.triangles) * 3);
+                ++mStats.drawCalls;
+            }
+            if (mStats.lines > 0)
+            {
+                glDrawArrays(GL_LINES, first, GLsizei(mStats.lines) * 2);
+                ++mStats.drawCalls;
+            }
+            glBindVertexArray(0);
+
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+            glDepthFunc(GL_LESS);
+        }
+
+        mBuffer.release();
+        mRegionAcquired = false;
+    }
+}
+
+#endif
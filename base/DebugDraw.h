@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+#include "StreamingBuffer.h"
+
+// set to 0 (ENABLE_DEBUG_DRAW=OFF in CMake) to compile every DebugDraw call into an empty inline function
+#ifndef UTILS_DEBUG_DRAW
+#define UTILS_DEBUG_DRAW 1
+#endif
+
+#if UTILS_DEBUG_DRAW
+#define UTILS_DEBUG_DRAW_BODY(...) ;
+#else
+#define UTILS_DEBUG_DRAW_BODY(...) { return __VA_ARGS__; }
+#endif
+
+namespace utils
+{
+    struct DebugDrawStats
+    {
+        uint32_t lines = 0;
+        uint32_t triangles = 0;
+        uint32_t drawCalls = 0;
+
+        // primitives that did not fit into the frame's region
+        uint32_t droppedLines = 0;
+        uint32_t droppedTriangles = 0;
+    };
+
+    // Immediate-mode lines and triangles for visualizing bounds, frusta and hierarchies. Shapes are written
+    // straight into a StreamingBuffer with one region per frame in flight, render() draws all lines
+    // and all triangles of the frame with one draw each. Shapes with depthTest = false are pushed onto the
+    // near plane in the vertex shader, so both kinds share a draw. Depth writes are off for everything.
+    class DebugDraw
+    {
+    public:
+        static constexpr uint32_t kRegionCount = StreamingBuffer::kRegionCount;
+
+        DebugDraw() = default;
+        ~DebugDraw() UTILS_DEBUG_DRAW_BODY()
+
+        DebugDraw(const DebugDraw&) = delete;
+        DebugDraw& operator=(const DebugDraw&) = delete;
+
+        bool init(std::shared_ptr<OpenglProgram> program, uint32_t maxLines = 1u << 18, uint32_t maxTriangles = 1u << 16) UTILS_DEBUG_DRAW_BODY(true)
+        void destroy() UTILS_DEBUG_DRAW_BODY()
+
+        void line(const glm::vec3& from, const glm::vec3& to, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+        void triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        void aabb(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+        void solidAabb(const glm::vec3& min, const glm::vec3& max, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        // the [-1, 1] cube transformed by transform
+        void box(const glm::mat4& transform, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        // three great circles
+        void sphere(const glm::vec3& center, float radius, const glm::vec4& color, bool depthTest = true, uint32_t segments = 24) UTILS_DEBUG_DRAW_BODY()
+
+        // edges of the volume a view projection matrix maps onto clip space
+        void frustum(const glm::mat4& viewProjection, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        // x, y and z axes of transform in red, green and blue
+        void axis(const glm::mat4& transform, float size = 1.0f, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        // cells x cells grid on the plane spanned by the x and z axes of transform, extent is its full width
+        void grid(const glm::mat4& transform, float extent, uint32_t cells, const glm::vec4& color, bool depthTest = true) UTILS_DEBUG_DRAW_BODY()
+
+        // draws and drops everything added since the last call
+        void render(const glm::mat4& viewProjection) UTILS_DEBUG_DRAW_BODY()
+
+        const DebugDrawStats& getStats() const { return mStats; }
+
+    private:
+        DebugDrawStats mStats;
+
+#if UTILS_DEBUG_DRAW
+        struct Vertex
+        {
+            // w is 1 for depth tested vertices, 0 for vertices drawn on top
+            glm::vec4 position;
+            uint32_t color;
+        };
+
+        void acquireRegion();
+
+        Vertex* allocateLines(uint32_t count);
+        Vertex* allocateTriangles(uint32_t count);
+
+        std::shared_ptr<OpenglProgram> mProgram;
+        uint32_t mMaxLines = 0;
+        uint32_t mMaxTriangles = 0;
+
+        GLuint mVao = 0;
+        StreamingBuffer mBuffer;
+        bool mRegionAcquired = false;
+
+        // the current region holds mMaxLines lines followed by mMaxTriangles triangles
+        Vertex* mLineVertices = nullptr;
+        Vertex* mTriangleVertices = nullptr;
+
+        // counts of the frame being recorded, moved into mStats by render
+        DebugDrawStats mFrame;
+#endif
+    };
+}
+
+#undef UTILS_DEBUG_DRAW_BODY
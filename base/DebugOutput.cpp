@@ -0,0 +1,261 @@
+#include "DebugOutput.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace utils
+{
+    namespace
+    {
+        // higher is more severe
+        uint32_t getSeverityRank(GLenum severity)
+        {
+            switch (severity)
+            {
+            case GL_DEBUG_SEVERITY_HIGH: return 3;
+            case GL_DEBUG_SEVERITY_MEDIUM: return 2;
+            case GL_DEBUG_SEVERITY_LOW: return 1;
+            default: return 0;
+            }
+        }
+
+        const char* getSourceName(GLenum source)
+        {
+            switch (source)
+            {
+            case GL_DEBUG_SOURCE_API: return "api";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+            }
+        }
+
+        const char* getTypeName(GLenum type)
+        {
+            switch (type)
+            {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            case GL_DEBUG_TYPE_MARKER: return "marker";
+            case GL_DEBUG_TYPE_PUSH_GROUP: return "push group";
+            case GL_DEBUG_TYPE_POP_GROUP: return "pop group";
+            default: return "other";
+            }
+        }
+
+        const char* getSeverityName(GLenum severity)
+        {
+            switch (severity)
+            {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "notification";
+            }
+        }
+    }
+
+    DebugOutput::~DebugOutput()
+    {
+        destroy();
+    }
+
+    bool DebugOutput::init(const DebugOutputSettings& settings)
+    {
+        destroy();
+
+        if (glDebugMessageCallback == nullptr)
+        {
+            std::cerr << "KHR_debug is not available, GL errors are not reported" << std::endl;
+            return false;
+        }
+
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if ((flags & GL_CONTEXT_FLAG_DEBUG_BIT) == 0)
+        {
+            std::cerr << "Not a debug context, the driver may not report GL errors" << std::endl;
+        }
+
+        mSettings = settings;
+        mQueue.reset(new LockFreeQueue<Message>(settings.queueCapacity));
+
+        // filter in the driver, rejected messages never reach the callback
+        const GLenum severities[] = { GL_DEBUG_SEVERITY_HIGH, GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_LOW, GL_DEBUG_SEVERITY_NOTIFICATION };
+        for (GLenum severity : severities)
+        {
+            const GLboolean enabled = getSeverityRank(severity) >= getSeverityRank(settings.minSeverity) ? GL_TRUE : GL_FALSE;
+            glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, severity, 0, nullptr, enabled);
+        }
+
+        // asynchronous output, GL_DEBUG_OUTPUT_SYNCHRONOUS would serialize the driver just like glGetError
+        glDebugMessageCallback(callback, this);
+        glEnable(GL_DEBUG_OUTPUT);
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+
+        mEnabled = true;
+        return true;
+    }
+
+    void DebugOutput::destroy()
+    {
+        if (!mEnabled)
+        {
+            return;
+        }
+
+        glDisable(GL_DEBUG_OUTPUT);
+        glDebugMessageCallback(nullptr, nullptr);
+        drain();
+
+        mQueue.reset();
+        mEntries.clear();
+        mEnabled = false;
+    }
+
+    void GLAPIENTRY DebugOutput::callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+        const GLchar* message, const void* userParam)
+    {
+        DebugOutput* output = static_cast<DebugOutput*>(const_cast<void*>(userParam));
+
+        Message entry;
+        entry.source = source;
+        entry.type = type;
+        entry.id = id;
+        entry.severity = severity;
+
+        const size_t size = std::min(length >= 0 ? size_t(length) : std::strlen(message), sizeof(entry.text) - 1);
+        std::memcpy(entry.text, message, size);
+        entry.text[size] = '\0';
+
+        if (!output->mQueue->tryPush(entry))
+        {
+            output->mDropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void DebugOutput::drain()
+    {
+        if (mQueue == nullptr)
+        {
+            return;
+        }
+
+        ++mDrainIndex;
+
+        uint32_t printed = 0;
+        Message message;
+        while (mQueue->tryPop(message))
+        {
+            ++mStats.received;
+            if (message.type == GL_DEBUG_TYPE_ERROR)
+            {
+                ++mStats.errors;
+            }
+
+            // FNV-1a over the message and its identifiers
+            uint64_t hash = 14695981039346656037ull;
+            auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * 1099511628211ull; };
+            mix(message.source);
+            mix(message.type);
+            mix(message.id);
+            mix(message.severity);
+            for (const char* c = message.text; *c != '\0'; ++c)
+            {
+                mix(uint8_t(*c));
+            }
+
+            auto it = mEntries.find(hash);
+            if (it == mEntries.end() && mEntries.size() >= mSettings.maxEntries && mAgedIndex != mDrainIndex)
+            {
+                ageEntries();
+            }
+
+            // a full table keeps the messages it already tracks, new ones are rate limited per drain only
+            Entry untracked;
+            Entry* tracked = &untracked;
+            if (it != mEntries.end())
+            {
+                // back after the repeat window, the sweep just hasn't removed it yet
+                if (it->second.lastSeen + mSettings.repeatWindow <= mDrainIndex)
+                {
+                    it->second = Entry();
+                }
+                tracked = &it->second;
+            }
+            else if (mEntries.size() < mSettings.maxEntries)
+            {
+                tracked = &mEntries[hash];
+            }
+
+            Entry& entry = *tracked;
+            ++entry.count;
+            entry.lastSeen = mDrainIndex;
+            if (entry.printed < mSettings.maxRepeats && printed < mSettings.maxMessagesPerFrame)
+            {
+                ++entry.printed;
+                ++printed;
+                ++mStats.printed;
+                print(message, entry.printed == mSettings.maxRepeats ? entry.count : 0);
+            }
+            else
+            {
+                ++mStats.suppressed;
+            }
+        }
+
+        if (mDrainIndex - mAgedIndex >= mSettings.repeatWindow)
+        {
+            ageEntries();
+        }
+
+        mStats.dropped = mDropped.load(std::memory_order_relaxed);
+        if (mStats.dropped != mReportedDropped)
+        {
+            std::cerr << "GL debug output: " << mStats.dropped - mReportedDropped << " messages dropped, the queue was full" << std::endl;
+            mReportedDropped = mStats.dropped;
+        }
+    }
+
+    void DebugOutput::ageEntries()
+    {
+        for (auto it = mEntries.begin(); it != mEntries.end();)
+        {
+            if (it->second.lastSeen + mSettings.repeatWindow <= mDrainIndex)
+            {
+                it = mEntries.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        mAgedIndex = mDrainIndex;
+    }
+
+    void DebugOutput::print(const Message& message, uint64_t repeats) const
+    {
+        std::cerr << "GL " << getTypeName(message.type) << " (" << getSourceName(message.source) << ", "
+            << getSeverityName(message.severity) << ", id " << message.id << "): " << message.text;
+        if (repeats > 0)
+        {
+            std::cerr << " [seen " << repeats << " times, further repeats are not printed]";
+        }
+        std::cerr << std::endl;
+    }
+
+    void DebugOutput::label(GLenum identifier, GLuint name, const std::string& label)
+    {
+        if (glObjectLabel != nullptr)
+        {
+            glObjectLabel(identifier, name, GLsizei(label.size()), label.c_str());
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "LockFreeQueue.h"
+
+namespace utils
+{
+    struct DebugOutputSettings
+    {
+        // messages the driver can report between two drains before new ones are dropped
+        uint32_t queueCapacity = 1024;
+
+        // printed messages per drain, the rest is only counted
+        uint32_t maxMessagesPerFrame = 16;
+
+        // identical messages are printed this many times, later repeats are counted
+        uint32_t maxRepeats = 3;
+
+        // a message not seen for this many drains is forgotten and printed again once it comes back
+        uint32_t repeatWindow = 600;
+
+        // distinct messages remembered at once, new ones beyond that are printed without de-duplication
+        uint32_t maxEntries = 1024;
+
+        // GL_DEBUG_SEVERITY_NOTIFICATION keeps everything, the default drops notifications
+        GLenum minSeverity = GL_DEBUG_SEVERITY_LOW;
+    };
+
+    struct DebugOutputStats
+    {
+        uint64_t received = 0;
+        uint64_t printed = 0;
+        uint64_t suppressed = 0;
+
+        // messages lost because the queue was full
+        uint64_t dropped = 0;
+        uint64_t errors = 0;
+    };
+
+    // Reports GL errors and warnings through KHR_debug instead of polling glGetError. The driver calls back
+    // asynchronously from any thread, the callback only copies the message into a lock-free queue and
+    // drain(), called once per frame, de-duplicates and rate limits what ends up on std::cerr.
+    class DebugOutput
+    {
+    public:
+        DebugOutput() = default;
+        ~DebugOutput();
+
+        DebugOutput(const DebugOutput&) = delete;
+        DebugOutput& operator=(const DebugOutput&) = delete;
+
+        // needs a current context, drivers only guarantee messages for contexts created with the debug flag
+        bool init(const DebugOutputSettings& settings = DebugOutputSettings());
+        void destroy();
+
+        void drain();
+
+        bool isEnabled() const { return mEnabled; }
+        const DebugOutputStats& getStats() const { return mStats; }
+
+        // names show up in messages and in frame debuggers, identifier is e.g. GL_BUFFER or GL_TEXTURE
+        static void label(GLenum identifier, GLuint name, const std::string& label);
+
+    private:
+        struct Message
+        {
+            GLenum source;
+            GLenum type;
+            GLuint id;
+            GLenum severity;
+            char text[240];
+        };
+
+        struct Entry
+        {
+            uint64_t count = 0;
+            uint64_t lastSeen = 0;
+            uint32_t printed = 0;
+        };
+
+        static void GLAPIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+            const GLchar* message, const void* userParam);
+
+        void print(const Message& message, uint64_t repeats) const;
+
+        // forgets messages not seen within the repeat window
+        void ageEntries();
+
+        DebugOutputSettings mSettings;
+        std::unique_ptr<LockFreeQueue<Message>> mQueue;
+        std::atomic<uint64_t> mDropped{ 0 };
+        uint64_t mReportedDropped = 0;
+
+        // message hash to how often it was seen
+        std::unordered_map<uint64_t, Entry> mEntries;
+        uint64_t mDrainIndex = 0;
+        uint64_t mAgedIndex = 0;
+
+        DebugOutputStats mStats;
+        bool mEnabled = false;
+    };
+}
@@ -0,0 +1,290 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace utils
+{
+    DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+    {
+        setSettings(settings);
+    }
+
+    void DynamicResolutionController::setSettings(const DynamicResolutionSettings& settings)
+    {
+        mSettings = settings;
+        mSettings.maxScale = std::clamp(mSettings.maxScale, 0.05f, 1.0f);
+        mSettings.minScale = std::clamp(mSettings.minScale, 0.05f, mSettings.maxScale);
+        mSettings.smoothing = std::clamp(mSettings.smoothing, 0.01f, 1.0f);
+        reset();
+    }
+
+    void DynamicResolutionController::reset()
+    {
+        mScale = mSettings.maxScale;
+        mSmoothedCost = 0.0;
+        mIntegral = 0.0;
+        mLastError = 0.0;
+        mHasSample = false;
+    }
+
+    float DynamicResolutionController::update(double gpuTime, float renderScale)
+    {
+        if (gpuTime <= 0.0 || renderScale <= 0.0f || mSettings.targetGpuTime <= 0.0)
+        {
+            return mScale;
+        }
+
+        // full resolution cost of the frame, timings arrive a few frames late and may belong to an older scale
+        const double cost = gpuTime / (double(renderScale) * renderScale);
+        const double area = double(mScale) * mScale;
+        double newArea = area;
+
+        if (!mHasSample || cost * area > mSettings.targetGpuTime * mSettings.overloadRatio)
+        {
+            // a spike, jump straight to the area that fits the budget and forget the history
+            mSmoothedCost = cost;
+            mIntegral = 0.0;
+            mLastError = 0.0;
+            mHasSample = true;
+            newArea = mSettings.targetGpuTime / cost;
+        }
+        else
+        {
+            mSmoothedCost += (cost - mSmoothedCost) * mSettings.smoothing;
+
+            // positive when there is headroom, relative so the gains don't depend on the target
+            const double error = (mSettings.targetGpuTime - mSmoothedCost * area) / mSettings.targetGpuTime;
+
+            // bounded, a long stretch at either scale limit must not keep the scale pinned there afterwards
+            mIntegral = std::clamp(mIntegral + error, -1.0, 1.0);
+            const double derivative = error - mLastError;
+            mLastError = error;
+
+            const double correction = mSettings.proportionalGain * error + mSettings.integralGain * mIntegral + mSettings.derivativeGain * derivative;
+            newArea = area * std::max(1.0 + correction, 0.25);
+        }
+
+        const float scale = std::clamp(float(std::sqrt(newArea)), mSettings.minScale, mSettings.maxScale);
+        const bool atLimit = scale == mSettings.minScale || scale == mSettings.maxScale;
+        if (std::abs(scale - mScale) >= mSettings.deadband || (atLimit && scale != mScale))
+        {
+            mScale = scale;
+        }
+        return mScale;
+    }
+
+    DynamicResolution::~DynamicResolution()
+    {
+        destroy();
+    }
+
+    bool DynamicResolution::init(std::shared_ptr<OpenglProgram> program, const DynamicResolutionSettings& settings)
+    {
+        destroy();
+
+        if (program == nullptr || program->id == 0)
+        {
+            std::cerr << "Dynamic resolution needs an upscale program" << std::endl;
+            return false;
+        }
+
+        mProgram = program;
+        mController.setSettings(settings);
+
+        glCreateQueries(GL_TIMESTAMP, GLsizei(kQueryLatency * 2), mQueries);
+        glCreateVertexArrays(1, &mEmptyVao);
+
+        glCreateSamplers(1, &mSampler);
+        glSamplerParameteri(mSampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glSamplerParameteri(mSampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glSamplerParameteri(mSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glSamplerParameteri(mSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        mStats = DynamicResolutionStats();
+        mStats.scale = mController.getScale();
+        return true;
+    }
+
+    void DynamicResolution::destroy()
+    {
+        if (mProgram == nullptr)
+        {
+            return;
+        }
+
+        destroyTarget();
+        glDeleteQueries(GLsizei(kQueryLatency * 2), mQueries);
+        glDeleteVertexArrays(1, &mEmptyVao);
+        glDeleteSamplers(1, &mSampler);
+
+        std::fill(std::begin(mQueries), std::end(mQueries), 0u);
+        std::fill(std::begin(mPending), std::end(mPending), false);
+        mEmptyVao = 0;
+        mSampler = 0;
+        mQueryIndex = 0;
+        mInFrame = false;
+        mProgram.reset();
+    }
+
+    void DynamicResolution::setSettings(const DynamicResolutionSettings& settings)
+    {
+        mController.setSettings(settings);
+
+        // the target is sized for the largest scale
+        destroyTarget();
+    }
+
+    void DynamicResolution::resizeTarget(uint32_t displayWidth, uint32_t displayHeight)
+    {
+        destroyTarget();
+
+        const float maxScale = mController.getSettings().maxScale;
+        mTargetWidth = std::max(uint32_t(std::ceil(displayWidth * maxScale)), 1u);
+        mTargetHeight = std::max(uint32_t(std::ceil(displayHeight * maxScale)), 1u);
+        mDisplayWidth = displayWidth;
+        mDisplayHeight = displayHeight;
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &mColor);
+        glTextureStorage2D(mColor, 1, GL_RGBA8, GLsizei(mTargetWidth), GLsizei(mTargetHeight));
+        glCreateTextures(GL_TEXTURE_2D, 1, &mDepth);
+        glTextureStorage2D(mDepth, 1, GL_DEPTH24_STENCIL8, GLsizei(mTargetWidth), GLsizei(mTargetHeight));
+
+        glCreateFramebuffers(1, &mFramebuffer);
+        glNamedFramebufferTexture(mFramebuffer, GL_COLOR_ATTACHMENT0, mColor, 0);
+        glNamedFramebufferTexture(mFramebuffer, GL_DEPTH_STENCIL_ATTACHMENT, mDepth, 0);
+        if (glCheckNamedFramebufferStatus(mFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Dynamic resolution framebuffer is incomplete" << std::endl;
+        }
+
+        ++mStats.reallocations;
+    }
+
+    void DynamicResolution::destroyTarget()
+    {
+        if (mFramebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &mFramebuffer);
+            glDeleteTextures(1, &mColor);
+            glDeleteTextures(1, &mDepth);
+        }
+        mFramebuffer = 0;
+        mColor = 0;
+        mDepth = 0;
+        mTargetWidth = 0;
+        mTargetHeight = 0;
+        mDisplayWidth = 0;
+        mDisplayHeight = 0;
+    }
+
+    void DynamicResolution::collectTiming()
+    {
+        // never waits, a frame still running on the GPU kQueryLatency frames later is simply not measured
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(mQueries[mQueryIndex * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            ++mStats.droppedTimings;
+            return;
+        }
+
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(mQueries[mQueryIndex * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(mQueries[mQueryIndex * 2 + 1], GL_QUERY_RESULT, &end);
+        if (end <= begin)
+        {
+            return;
+        }
+
+        mStats.gpuTime = double(end - begin) * 1e-6;
+        const float previous = mController.getScale();
+        if (mController.update(mStats.gpuTime, mScales[mQueryIndex]) != previous)
+        {
+            ++mStats.scaleChanges;
+        }
+        mStats.smoothedGpuTime = mController.getSmoothedGpuTime();
+    }
+
+    void DynamicResolution::beginFrame(uint32_t displayWidth, uint32_t displayHeight)
+    {
+        if (!isEnabled() || displayWidth == 0 || displayHeight == 0)
+        {
+            return;
+        }
+
+        mQueryIndex = (mQueryIndex + 1) % kQueryLatency;
+        if (mPending[mQueryIndex])
+        {
+            collectTiming();
+            mPending[mQueryIndex] = false;
+        }
+
+        if (displayWidth != mDisplayWidth || displayHeight != mDisplayHeight)
+        {
+            resizeTarget(displayWidth, displayHeight);
+        }
+
+        const float scale = mController.getScale();
+        mRenderWidth = std::clamp(uint32_t(std::lround(displayWidth * scale)), 1u, mTargetWidth);
+        mRenderHeight = std::clamp(uint32_t(std::lround(displayHeight * scale)), 1u, mTargetHeight);
+        mScales[mQueryIndex] = scale;
+        mStats.scale = scale;
+        mStats.renderWidth = mRenderWidth;
+        mStats.renderHeight = mRenderHeight;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glViewport(0, 0, GLsizei(mRenderWidth), GLsizei(mRenderHeight));
+        glQueryCounter(mQueries[mQueryIndex * 2], GL_TIMESTAMP);
+        mInFrame = true;
+    }
+
+    void DynamicResolution::endFrame(GLuint framebuffer)
+    {
+        if (!mInFrame)
+        {
+            return;
+        }
+        mInFrame = false;
+
+        // only the scene is timed, the upscale runs at display resolution whatever the scale
+        glQueryCounter(mQueries[mQueryIndex * 2 + 1], GL_TIMESTAMP);
+        mPending[mQueryIndex] = true;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, GLsizei(mDisplayWidth), GLsizei(mDisplayHeight));
+
+        const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        const GLboolean blend = glIsEnabled(GL_BLEND);
+        const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+        const GLboolean scissorTest = glIsEnabled(GL_SCISSOR_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_SCISSOR_TEST);
+
+        // the scene covers the lower left corner of the target, clamp to the centers of its border texels
+        const glm::vec2 targetSize = glm::vec2(float(mTargetWidth), float(mTargetHeight));
+        const glm::vec2 renderSize = glm::vec2(float(mRenderWidth), float(mRenderHeight));
+        mProgram->use();
+        mProgram->setInt("u_source", 0);
+        mProgram->setVec2("u_uvScale", renderSize / targetSize);
+        mProgram->setVec2("u_uvMax", (renderSize - 0.5f) / targetSize);
+        mProgram->setVec2("u_texelSize", 1.0f / targetSize);
+        mProgram->setFloat("u_sharpness", std::clamp(mController.getSettings().sharpness, 0.0f, 1.0f));
+
+        glBindTextureUnit(0, mColor);
+        glBindSampler(0, mSampler);
+        glBindVertexArray(mEmptyVao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        glBindSampler(0, 0);
+
+        if (depthTest) glEnable(GL_DEPTH_TEST);
+        if (blend) glEnable(GL_BLEND);
+        if (cullFace) glEnable(GL_CULL_FACE);
+        if (scissorTest) glEnable(GL_SCISSOR_TEST);
+    }
+}
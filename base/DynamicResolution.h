@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <glad/glad.h>
+
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    struct DynamicResolutionSettings
+    {
+        // GPU milliseconds per frame to aim for, leave headroom below the frame budget for the rest of the frame
+        double targetGpuTime = 14.0;
+
+        // fraction of the display resolution per axis
+        float minScale = 0.5f;
+        float maxScale = 1.0f;
+
+        // PID gains on the relative error of the smoothed GPU time, applied to the rendered pixel count
+        float proportionalGain = 0.25f;
+        float integralGain = 0.05f;
+        float derivativeGain = 0.1f;
+
+        // weight of the newest GPU time in the moving average
+        float smoothing = 0.3f;
+
+        // a frame this far over the target drops the resolution right away instead of waiting for the PID
+        float overloadRatio = 1.25f;
+
+        // smaller scale changes are ignored, so a steady load doesn't make the image shimmer
+        float deadband = 0.02f;
+
+        // 0 is plain bilinear upscaling, 1 the strongest sharpening
+        float sharpness = 0.5f;
+    };
+
+    // Picks the render scale from measured GPU frame times. The GPU time is assumed to grow with the pixel
+    // count: every timing is divided by the area it was rendered at, and the PID works on the area the
+    // current scale would cost. Timings arrive a few frames late, normalizing them keeps a stale timing of
+    // a larger scale from lowering the scale a second time.
+    class DynamicResolutionController
+    {
+    public:
+        explicit DynamicResolutionController(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+        void setSettings(const DynamicResolutionSettings& settings);
+        const DynamicResolutionSettings& getSettings() const { return mSettings; }
+
+        // feeds the GPU time in milliseconds of a frame rendered at renderScale and returns the new scale
+        float update(double gpuTime, float renderScale);
+        void reset();
+
+        float getScale() const { return mScale; }
+
+        // what the current scale is expected to cost
+        double getSmoothedGpuTime() const { return mSmoothedCost * mScale * mScale; }
+
+    private:
+        DynamicResolutionSettings mSettings;
+        float mScale = 1.0f;
+        // moving average of the GPU time at full resolution
+        double mSmoothedCost = 0.0;
+        double mIntegral = 0.0;
+        double mLastError = 0.0;
+        bool mHasSample = false;
+    };
+
+    struct DynamicResolutionStats
+    {
+        float scale = 1.0f;
+        uint32_t renderWidth = 0;
+        uint32_t renderHeight = 0;
+
+        // milliseconds, the newest measured frame and what the current scale is expected to cost
+        double gpuTime = 0.0;
+        double smoothedGpuTime = 0.0;
+
+        // scale changes and render target reallocations since init
+        uint32_t scaleChanges = 0;
+        uint32_t reallocations = 0;
+
+        // timings whose queries weren't done when their slot was reused
+        uint32_t droppedTimings = 0;
+    };
+
+    // Renders the scene into an internal target at a scale chosen by DynamicResolutionController and upscales
+    // it to the framebuffer with a contrast adaptive sharpening filter. The target is allocated at the largest
+    // scale and the scene is drawn into its lower left corner, so scale changes never reallocate; only a new
+    // display size does. GPU time is measured with timestamp queries between beginFrame and endFrame.
+    class DynamicResolution
+    {
+    public:
+        static constexpr uint32_t kQueryLatency = 4;
+
+        DynamicResolution() = default;
+        ~DynamicResolution();
+
+        DynamicResolution(const DynamicResolution&) = delete;
+        DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+        // program is the upscale shader pair, upscale/upscale.vert and upscale/upscale.frag
+        bool init(std::shared_ptr<OpenglProgram> program, const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+        void destroy();
+        bool isEnabled() const { return mProgram != nullptr; }
+
+        void setSettings(const DynamicResolutionSettings& settings);
+        const DynamicResolutionSettings& getSettings() const { return mController.getSettings(); }
+
+        // binds the scene framebuffer with the viewport set to the render size
+        void beginFrame(uint32_t displayWidth, uint32_t displayHeight);
+
+        // upscales into framebuffer, the window by default, and leaves it bound with the viewport set to the display size
+        void endFrame(GLuint framebuffer = 0);
+
+        uint32_t getRenderWidth() const { return mRenderWidth; }
+        uint32_t getRenderHeight() const { return mRenderHeight; }
+        GLuint getFramebuffer() const { return mFramebuffer; }
+
+        const DynamicResolutionStats& getStats() const { return mStats; }
+
+    private:
+        void resizeTarget(uint32_t displayWidth, uint32_t displayHeight);
+        void destroyTarget();
+        void collectTiming();
+
+        std::shared_ptr<OpenglProgram> mProgram;
+        DynamicResolutionController mController;
+
+        GLuint mFramebuffer = 0;
+        GLuint mColor = 0;
+        GLuint mDepth = 0;
+        GLuint mSampler = 0;
+        GLuint mEmptyVao = 0;
+
+        uint32_t mTargetWidth = 0;
+        uint32_t mTargetHeight = 0;
+        uint32_t mDisplayWidth = 0;
+        uint32_t mDisplayHeight = 0;
+        uint32_t mRenderWidth = 0;
+        uint32_t mRenderHeight = 0;
+
+        // a begin and an end timestamp per frame in flight
+        GLuint mQueries[kQueryLatency * 2] = {};
+        float mScales[kQueryLatency] = {};
+        bool mPending[kQueryLatency] = {};
+        uint32_t mQueryIndex = 0;
+        bool mInFrame = false;
+
+        DynamicResolutionStats mStats;
+    };
+}
@@ -0,0 +1,397 @@
+#include "EntityWorld.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+namespace utils
+{
+    namespace detail
+    {
+        namespace
+        {
+            // fixed storage, registered entries never move and can be read without the lock
+            std::mutex gComponentMutex;
+            ComponentInfo gComponents[kMaxComponentTypes];
+            uint32_t gComponentCount = 0;
+        }
+
+        uint32_t registerComponent(uint32_t size, uint32_t alignment)
+        {
+            std::lock_guard<std::mutex> lock(gComponentMutex);
+            if (gComponentCount >= kMaxComponentTypes)
+            {
+                std::cerr << "Too many component types, at most " << kMaxComponentTypes << " are supported." << std::endl;
+                std::abort();
+            }
+
+            gComponents[gComponentCount] = { size, alignment };
+            return gComponentCount++;
+        }
+
+        const ComponentInfo& getComponentInfo(uint32_t id)
+        {
+            return gComponents[id];
+        }
+    }
+
+    namespace
+    {
+        constexpr std::align_val_t kChunkAlignment{ 64 };
+
+        inline uint32_t alignOffset(uint32_t offset, uint32_t alignment)
+        {
+            return (offset + alignment - 1) & ~(alignment - 1);
+        }
+
+        uint32_t computeLayout(Archetype& archetype, uint32_t capacity)
+        {
+            uint32_t offset = sizeof(Entity) * capacity;
+            for (uint32_t id : archetype.components)
+            {
+                const detail::ComponentInfo& info = detail::getComponentInfo(id);
+                offset = alignOffset(offset, info.alignment);
+                archetype.offsets[id] = offset;
+                offset += info.size * capacity;
+            }
+            return offset;
+        }
+    }
+
+    EntityWorld::~EntityWorld()
+    {
+        for (auto& archetype : mArchetypes)
+        {
+            for (EntityChunk& chunk : archetype->chunks)
+            {
+                ::operator delete(chunk.data, kChunkAlignment);
+            }
+            if (archetype->spareChunk != nullptr)
+            {
+                ::operator delete(archetype->spareChunk, kChunkAlignment);
+            }
+        }
+    }
+
+    void EntityWorld::destroy(Entity entity)
+    {
+        if (!checkStructuralChange() || !isAlive(entity))
+        {
+            return;
+        }
+
+        EntityRecord& record = mRecords[entity.index];
+        freeRow(record.archetype, record.row);
+
+        record.archetype = nullptr;
+        ++record.generation;
+        mFreeIndices.push_back(entity.index);
+        --mEntityCount;
+    }
+
+    bool EntityWorld::isAlive(Entity entity) const
+    {
+        return entity.index < mRecords.size() && mRecords[entity.index].generation == entity.generation &&
+            mRecords[entity.index].archetype != nullptr;
+    }
+
+    void EntityWorld::playback(EntityCommandBuffer& commands)
+    {
+        const auto& list = commands.mCommands;
+        for (size_t i = 0; i < list.size(); ++i)
+        {
+            const EntityCommandBuffer::Command& command = list[i];
+            const uint8_t* data = commands.mData.data() + command.dataOffset;
+
+            switch (command.type)
+            {
+            case EntityCommandBuffer::COMMAND_CREATE:
+            {
+                ComponentMask mask = 0;
+                for (uint32_t c = 1; c <= command.componentId; ++c)
+                {
+                    mask |= ComponentMask(1) << list[i + c].componentId;
+                }
+
+                const Entity entity = createRaw(mask);
+                for (uint32_t c = 1; c <= command.componentId; ++c)
+                {
+                    const EntityCommandBuffer::Command& component = list[i + c];
+                    std::memcpy(getRaw(entity, component.componentId), commands.mData.data() + component.dataOffset, component.dataSize);
+                }
+                i += command.componentId;
+                break;
+            }
+            case EntityCommandBuffer::COMMAND_DESTROY:
+                destroy(command.entity);
+                break;
+            case EntityCommandBuffer::COMMAND_ADD:
+                addRaw(command.entity, command.componentId, data);
+                break;
+            case EntityCommandBuffer::COMMAND_REMOVE:
+                removeRaw(command.entity, command.componentId);
+                break;
+            default:
+                break;
+            }
+        }
+
+        commands.clear();
+    }
+
+    EntityWorldStats EntityWorld::getStats() const
+    {
+        EntityWorldStats stats;
+        stats.entityCount = mEntityCount;
+        stats.archetypeCount = uint32_t(mArchetypes.size());
+        for (const auto& archetype : mArchetypes)
+        {
+            stats.chunkCount += uint32_t(archetype->chunks.size());
+        }
+        stats.entityMoves = mEntityMoves;
+        return stats;
+    }
+
+    Entity EntityWorld::createRaw(ComponentMask mask)
+    {
+        if (!checkStructuralChange())
+        {
+            return Entity();
+        }
+
+        Entity entity;
+        if (!mFreeIndices.empty())
+        {
+            entity.index = mFreeIndices.back();
+            mFreeIndices.pop_back();
+        }
+        else
+        {
+            entity.index = uint32_t(mRecords.size());
+            mRecords.emplace_back();
+        }
+        entity.generation = mRecords[entity.index].generation;
+
+        Archetype* archetype = getArchetype(mask);
+        mRecords[entity.index].archetype = archetype;
+        mRecords[entity.index].row = allocateRow(archetype, entity);
+        ++mEntityCount;
+        return entity;
+    }
+
+    void EntityWorld::addRaw(Entity entity, uint32_t componentId, const void* data)
+    {
+        if (!isAlive(entity))
+        {
+            return;
+        }
+
+        const ComponentMask bit = ComponentMask(1) << componentId;
+        if ((mRecords[entity.index].archetype->mask & bit) == 0)
+        {
+            if (!checkStructuralChange())
+            {
+                return;
+            }
+            moveEntity(entity, mRecords[entity.index].archetype->mask | bit);
+        }
+
+        std::memcpy(getRaw(entity, componentId), data, detail::getComponentInfo(componentId).size);
+    }
+
+    void EntityWorld::removeRaw(Entity entity, uint32_t componentId)
+    {
+        if (!isAlive(entity))
+        {
+            return;
+        }
+
+        const ComponentMask bit = ComponentMask(1) << componentId;
+        if ((mRecords[entity.index].archetype->mask & bit) != 0 && checkStructuralChange())
+        {
+            moveEntity(entity, mRecords[entity.index].archetype->mask & ~bit);
+        }
+    }
+
+    void* EntityWorld::getRaw(Entity entity, uint32_t componentId)
+    {
+        if (!isAlive(entity))
+        {
+            return nullptr;
+        }
+
+        const EntityRecord& record = mRecords[entity.index];
+        const Archetype* archetype = record.archetype;
+        if ((archetype->mask & (ComponentMask(1) << componentId)) == 0)
+        {
+            return nullptr;
+        }
+
+        const EntityChunk& chunk = archetype->chunks[record.row / archetype->capacity];
+        const uint32_t slot = record.row % archetype->capacity;
+        return chunk.data + archetype->offsets[componentId] + size_t(slot) * archetype->sizes[componentId];
+    }
+
+    bool EntityWorld::checkStructuralChange() const
+    {
+        if (mIterating > 0)
+        {
+            std::cerr << "Structural changes are not allowed during iteration, use an EntityCommandBuffer." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    Archetype* EntityWorld::getArchetype(ComponentMask mask)
+    {
+        auto it = mArchetypeMap.find(mask);
+        if (it != mArchetypeMap.end())
+        {
+            return it->second;
+        }
+
+        auto archetype = std::make_unique<Archetype>();
+        archetype->mask = mask;
+        std::fill(std::begin(archetype->offsets), std::end(archetype->offsets), 0u);
+        std::fill(std::begin(archetype->sizes), std::end(archetype->sizes), 0u);
+        for (uint32_t id = 0; id < kMaxComponentTypes; ++id)
+        {
+            if ((mask & (ComponentMask(1) << id)) != 0)
+            {
+                archetype->components.push_back(id);
+                archetype->sizes[id] = detail::getComponentInfo(id).size;
+            }
+        }
+
+        // as many rows as fit into a chunk, rows larger than a chunk get chunks of their own size
+        uint32_t rowSize = sizeof(Entity);
+        for (uint32_t id : archetype->components)
+        {
+            rowSize += archetype->sizes[id];
+        }
+
+        uint32_t capacity = std::max(kChunkSize / rowSize, 1u);
+        while (capacity > 1 && computeLayout(*archetype, capacity) > kChunkSize)
+        {
+            --capacity;
+        }
+        archetype->capacity = capacity;
+        archetype->chunkSize = std::max(computeLayout(*archetype, capacity), kChunkSize);
+
+        Archetype* result = archetype.get();
+        mArchetypes.push_back(std::move(archetype));
+        mArchetypeMap.emplace(mask, result);
+        return result;
+    }
+
+    const std::vector<Archetype*>& EntityWorld::matchArchetypes(ComponentMask mask)
+    {
+        // queries only look at archetypes created since they last ran
+        Query& query = mQueries[mask];
+        for (; query.checkedCount < mArchetypes.size(); ++query.checkedCount)
+        {
+            Archetype* archetype = mArchetypes[query.checkedCount].get();
+            if ((archetype->mask & mask) == mask)
+            {
+                query.archetypes.push_back(archetype);
+            }
+        }
+        return query.archetypes;
+    }
+
+    uint32_t EntityWorld::allocateRow(Archetype* archetype, Entity entity)
+    {
+        const uint32_t row = archetype->entityCount++;
+        const uint32_t chunkIndex = row / archetype->capacity;
+        if (chunkIndex == archetype->chunks.size())
+        {
+            EntityChunk chunk;
+            if (archetype->spareChunk != nullptr)
+            {
+                chunk.data = archetype->spareChunk;
+                archetype->spareChunk = nullptr;
+            }
+            else
+            {
+                chunk.data = static_cast<uint8_t*>(::operator new(archetype->chunkSize, kChunkAlignment));
+            }
+            archetype->chunks.push_back(chunk);
+        }
+
+        EntityChunk& chunk = archetype->chunks[chunkIndex];
+        archetype->getEntities(chunk)[chunk.count++] = entity;
+        return row;
+    }
+
+    void EntityWorld::freeRow(Archetype* archetype, uint32_t row)
+    {
+        // the last row fills the hole so chunks stay tightly packed
+        const uint32_t last = archetype->entityCount - 1;
+        EntityChunk& lastChunk = archetype->chunks[last / archetype->capacity];
+        const uint32_t lastSlot = last % archetype->capacity;
+
+        if (row != last)
+        {
+            EntityChunk& chunk = archetype->chunks[row / archetype->capacity];
+            const uint32_t slot = row % archetype->capacity;
+
+            const Entity moved = archetype->getEntities(lastChunk)[lastSlot];
+            archetype->getEntities(chunk)[slot] = moved;
+            for (uint32_t id : archetype->components)
+            {
+                const uint32_t size = archetype->sizes[id];
+                std::memcpy(chunk.data + archetype->offsets[id] + size_t(slot) * size,
+                    lastChunk.data + archetype->offsets[id] + size_t(lastSlot) * size, size);
+            }
+            mRecords[moved.index].row = row;
+        }
+
+        --lastChunk.count;
+        --archetype->entityCount;
+
+        if (lastChunk.count == 0)
+        {
+            if (archetype->spareChunk == nullptr)
+            {
+                archetype->spareChunk = lastChunk.data;
+            }
+            else
+            {
+                ::operator delete(lastChunk.data, kChunkAlignment);
+            }
+            archetype->chunks.pop_back();
+        }
+    }
+
+    void EntityWorld::moveEntity(Entity entity, ComponentMask mask)
+    {
+        EntityRecord& record = mRecords[entity.index];
+        Archetype* source = record.archetype;
+        Archetype* target = getArchetype(mask);
+
+        const uint32_t sourceRow = record.row;
+        const uint32_t targetRow = allocateRow(target, entity);
+
+        const EntityChunk& sourceChunk = source->chunks[sourceRow / source->capacity];
+        const EntityChunk& targetChunk = target->chunks[targetRow / target->capacity];
+        const uint32_t sourceSlot = sourceRow % source->capacity;
+        const uint32_t targetSlot = targetRow % target->capacity;
+
+        // components only present in the target are left for the caller to fill in
+        for (uint32_t id : target->components)
+        {
+            if ((source->mask & (ComponentMask(1) << id)) != 0)
+            {
+                const uint32_t size = target->sizes[id];
+                std::memcpy(targetChunk.data + target->offsets[id] + size_t(targetSlot) * size,
+                    sourceChunk.data + source->offsets[id] + size_t(sourceSlot) * size, size);
+            }
+        }
+
+        freeRow(source, sourceRow);
+        record.archetype = target;
+        record.row = targetRow;
+        ++mEntityMoves;
+    }
+}
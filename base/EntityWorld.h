@@ -0,0 +1,389 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Memory.h"
+#include "ThreadPool.h"
+
+namespace utils
+{
+    struct Entity
+    {
+        static constexpr uint32_t kInvalidIndex = ~0u;
+
+        uint32_t index = kInvalidIndex;
+        uint32_t generation = 0;
+
+        explicit operator bool() const { return index != kInvalidIndex; }
+        bool operator==(const Entity& rhs) const { return index == rhs.index && generation == rhs.generation; }
+        bool operator!=(const Entity& rhs) const { return !(*this == rhs); }
+    };
+
+    using ComponentMask = uint64_t;
+    constexpr uint32_t kMaxComponentTypes = 64;
+
+    namespace detail
+    {
+        struct ComponentInfo
+        {
+            uint32_t size;
+            uint32_t alignment;
+        };
+
+        uint32_t registerComponent(uint32_t size, uint32_t alignment);
+        const ComponentInfo& getComponentInfo(uint32_t id);
+    }
+
+    // ids are handed out on first use, at most kMaxComponentTypes per program
+    template<typename T>
+    uint32_t getComponentId()
+    {
+        static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+            "components are moved with memcpy and never destroyed");
+        static const uint32_t id = detail::registerComponent(uint32_t(sizeof(T)), uint32_t(alignof(T)));
+        return id;
+    }
+
+    template<typename... Ts>
+    ComponentMask makeComponentMask()
+    {
+        ComponentMask mask = 0;
+        using Expand = int[];
+        (void)Expand{ 0, (mask |= ComponentMask(1) << getComponentId<Ts>(), 0)... };
+        return mask;
+    }
+
+    struct EntityChunk
+    {
+        uint8_t* data = nullptr;
+        uint32_t count = 0;
+    };
+
+    // all entities with exactly the same component set, each chunk stores one tightly packed array per component
+    struct Archetype
+    {
+        ComponentMask mask = 0;
+        std::vector<uint32_t> components;
+        uint32_t offsets[kMaxComponentTypes];
+        uint32_t sizes[kMaxComponentTypes];
+
+        uint32_t capacity = 0;
+        uint32_t chunkSize = 0;
+        uint32_t entityCount = 0;
+        std::vector<EntityChunk> chunks;
+
+        // an emptied chunk is kept around so entities moving back and forth don't hit the allocator
+        uint8_t* spareChunk = nullptr;
+
+        Entity* getEntities(const EntityChunk& chunk) const { return reinterpret_cast<Entity*>(chunk.data); }
+
+        template<typename T>
+        T* getColumn(const EntityChunk& chunk) const { return reinterpret_cast<T*>(chunk.data + offsets[getComponentId<T>()]); }
+    };
+
+    class EntityWorld;
+
+    // records structural changes while the world is being iterated, applied in order by EntityWorld::playback.
+    // Recording is thread-safe so parallel queries can share one buffer.
+    class EntityCommandBuffer
+    {
+    public:
+        template<typename... Ts>
+        void create(const Ts&... components)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCommands.push_back({ COMMAND_CREATE, Entity(), uint32_t(sizeof...(Ts)), 0, 0 });
+            using Expand = int[];
+            (void)Expand{ 0, (record(COMMAND_CREATE_COMPONENT, Entity(), getComponentId<Ts>(), &components, sizeof(Ts)), 0)... };
+        }
+
+        void destroy(Entity entity)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCommands.push_back({ COMMAND_DESTROY, entity, 0, 0, 0 });
+        }
+
+        // adds the component or overwrites it if the entity already has one
+        template<typename T>
+        void add(Entity entity, const T& component = T())
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            record(COMMAND_ADD, entity, getComponentId<T>(), &component, sizeof(T));
+        }
+
+        template<typename T>
+        void remove(Entity entity)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCommands.push_back({ COMMAND_REMOVE, entity, getComponentId<T>(), 0, 0 });
+        }
+
+        bool empty() const { return mCommands.empty(); }
+
+        // keeps the storage for the next frame
+        void clear()
+        {
+            mCommands.clear();
+            mData.clear();
+        }
+
+    private:
+        friend class EntityWorld;
+
+        enum CommandType : uint32_t
+        {
+            COMMAND_CREATE,             // followed by componentId commands of type COMMAND_CREATE_COMPONENT
+            COMMAND_CREATE_COMPONENT,
+            COMMAND_DESTROY,
+            COMMAND_ADD,
+            COMMAND_REMOVE,
+        };
+
+        struct Command
+        {
+            CommandType type;
+            Entity entity;
+            uint32_t componentId;
+            uint32_t dataOffset;
+            uint32_t dataSize;
+        };
+
+        void record(CommandType type, Entity entity, uint32_t componentId, const void* data, size_t size)
+        {
+            // payloads stay 16 byte aligned so they can be read in place
+            const size_t offset = (mData.size() + 15) & ~size_t(15);
+            mData.resize(offset + size);
+            std::memcpy(mData.data() + offset, data, size);
+            mCommands.push_back({ type, entity, componentId, uint32_t(offset), uint32_t(size) });
+        }
+
+        std::vector<Command> mCommands;
+        std::vector<uint8_t> mData;
+        std::mutex mMutex;
+    };
+
+    struct EntityWorldStats
+    {
+        uint32_t entityCount = 0;
+        uint32_t archetypeCount = 0;
+        uint32_t chunkCount = 0;
+
+        // rows copied between archetypes by add/remove since the last resetStats()
+        uint64_t entityMoves = 0;
+    };
+
+    // Archetype based entity/component storage. Structural changes (create, destroy, add, remove)
+    // are not allowed while a query is running, record them in an EntityCommandBuffer instead.
+    class EntityWorld
+    {
+    public:
+        static constexpr uint32_t kChunkSize = 16 << 10;
+
+        EntityWorld() = default;
+        ~EntityWorld();
+
+        EntityWorld(const EntityWorld&) = delete;
+        EntityWorld& operator=(const EntityWorld&) = delete;
+
+        template<typename... Ts>
+        Entity create(const Ts&... components)
+        {
+            const Entity entity = createRaw(makeComponentMask<Ts...>());
+            using Expand = int[];
+            (void)Expand{ 0, (set<Ts>(entity, components), 0)... };
+            return entity;
+        }
+
+        void destroy(Entity entity);
+        bool isAlive(Entity entity) const;
+
+        // adds the component or overwrites it if the entity already has one
+        template<typename T>
+        void add(Entity entity, const T& component = T())
+        {
+            addRaw(entity, getComponentId<T>(), &component);
+        }
+
+        template<typename T>
+        void remove(Entity entity)
+        {
+            removeRaw(entity, getComponentId<T>());
+        }
+
+        // nullptr if the entity doesn't have the component, pointers are invalidated by structural changes
+        template<typename T>
+        T* get(Entity entity)
+        {
+            return static_cast<T*>(getRaw(entity, getComponentId<T>()));
+        }
+
+        template<typename T>
+        bool has(Entity entity) const
+        {
+            return isAlive(entity) && (mRecords[entity.index].archetype->mask & makeComponentMask<T>()) != 0;
+        }
+
+        // f(uint32_t count, const Entity* entities, Ts*... columns) once per chunk holding all of Ts
+        template<typename... Ts, typename F>
+        void forEachChunk(F&& function)
+        {
+            IterationScope scope(*this);
+            for (Archetype* archetype : matchArchetypes(makeComponentMask<Ts...>()))
+            {
+                for (const EntityChunk& chunk : archetype->chunks)
+                {
+                    function(chunk.count, archetype->getEntities(chunk), archetype->getColumn<Ts>(chunk)...);
+                }
+            }
+        }
+
+        // f(Entity entity, Ts&... components)
+        template<typename... Ts, typename F>
+        void forEach(F&& function)
+        {
+            forEachChunk<Ts...>([&function](uint32_t count, const Entity* entities, Ts*... columns)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    function(entities[i], columns[i]...);
+                }
+            });
+        }
+
+        // chunks are distributed over the pool, the calling thread takes part
+        template<typename... Ts, typename F>
+        void parallelForEachChunk(ThreadPool& pool, F&& function)
+        {
+            IterationScope scope(*this);
+
+            ScratchScope scratch;
+            const std::vector<Archetype*>& archetypes = matchArchetypes(makeComponentMask<Ts...>());
+
+            uint32_t chunkCount = 0;
+            for (Archetype* archetype : archetypes)
+            {
+                chunkCount += uint32_t(archetype->chunks.size());
+            }
+
+            ChunkRef* chunks = static_cast<ChunkRef*>(scratch.allocate(sizeof(ChunkRef) * chunkCount, alignof(ChunkRef)));
+
+            uint32_t index = 0;
+            for (Archetype* archetype : archetypes)
+            {
+                for (const EntityChunk& chunk : archetype->chunks)
+                {
+                    chunks[index++] = { archetype, &chunk };
+                }
+            }
+
+            pool.parallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    const ChunkRef& ref = chunks[i];
+                    function(ref.chunk->count, ref.archetype->getEntities(*ref.chunk), ref.archetype->getColumn<Ts>(*ref.chunk)...);
+                }
+            });
+        }
+
+        template<typename... Ts, typename F>
+        void parallelForEach(ThreadPool& pool, F&& function)
+        {
+            parallelForEachChunk<Ts...>(pool, [&function](uint32_t count, const Entity* entities, Ts*... columns)
+            {
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    function(entities[i], columns[i]...);
+                }
+            });
+        }
+
+        // number of entities holding all of Ts
+        template<typename... Ts>
+        uint32_t count()
+        {
+            uint32_t total = 0;
+            for (Archetype* archetype : matchArchetypes(makeComponentMask<Ts...>()))
+            {
+                total += archetype->entityCount;
+            }
+            return total;
+        }
+
+        // applies and clears the recorded commands, entities destroyed in the meantime are skipped
+        void playback(EntityCommandBuffer& commands);
+
+        EntityWorldStats getStats() const;
+        void resetStats() { mEntityMoves = 0; }
+
+    private:
+        struct ChunkRef
+        {
+            Archetype* archetype;
+            const EntityChunk* chunk;
+        };
+
+        struct EntityRecord
+        {
+            Archetype* archetype = nullptr;
+            uint32_t row = 0;
+            uint32_t generation = 0;
+        };
+
+        struct Query
+        {
+            std::vector<Archetype*> archetypes;
+            size_t checkedCount = 0;
+        };
+
+        class IterationScope
+        {
+        public:
+            explicit IterationScope(EntityWorld& world) : mWorld(world) { ++mWorld.mIterating; }
+            ~IterationScope() { --mWorld.mIterating; }
+
+        private:
+            EntityWorld& mWorld;
+        };
+
+        template<typename T>
+        void set(Entity entity, const T& component)
+        {
+            if (void* data = getRaw(entity, getComponentId<T>()))
+            {
+                std::memcpy(data, &component, sizeof(T));
+            }
+        }
+
+        Entity createRaw(ComponentMask mask);
+        void addRaw(Entity entity, uint32_t componentId, const void* data);
+        void removeRaw(Entity entity, uint32_t componentId);
+        void* getRaw(Entity entity, uint32_t componentId);
+
+        bool checkStructuralChange() const;
+
+        Archetype* getArchetype(ComponentMask mask);
+        const std::vector<Archetype*>& matchArchetypes(ComponentMask mask);
+
+        uint32_t allocateRow(Archetype* archetype, Entity entity);
+        void freeRow(Archetype* archetype, uint32_t row);
+        void moveEntity(Entity entity, ComponentMask mask);
+
+        std::vector<EntityRecord> mRecords;
+        std::vector<uint32_t> mFreeIndices;
+        uint32_t mEntityCount = 0;
+
+        std::vector<std::unique_ptr<Archetype>> mArchetypes;
+        std::unordered_map<ComponentMask, Archetype*> mArchetypeMap;
+        std::unordered_map<ComponentMask, Query> mQueries;
+
+        uint32_t mIterating = 0;
+        uint64_t mEntityMoves = 0;
+    };
+}
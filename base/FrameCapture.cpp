@@ -0,0 +1,335 @@
+#include "FrameCapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace utils
+{
+    namespace
+    {
+        inline uint8_t clampByte(int value)
+        {
+            return uint8_t(std::min(std::max(value, 0), 255));
+        }
+
+        // full range BT.601 to match the C420jpeg tag, rows are flipped from GL's bottom-up order
+        void convertToYuv420(const uint8_t* rgba, uint32_t width, uint32_t height, std::vector<uint8_t>& yuv)
+        {
+            const uint32_t chromaWidth = (width + 1) / 2;
+            const uint32_t chromaHeight = (height + 1) / 2;
+            yuv.resize(size_t(width) * height + 2 * size_t(chromaWidth) * chromaHeight);
+
+            uint8_t* yPlane = yuv.data();
+            uint8_t* uPlane = yPlane + size_t(width) * height;
+            uint8_t* vPlane = uPlane + size_t(chromaWidth) * chromaHeight;
+
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* row = rgba + size_t(height - 1 - y) * width * 4;
+                uint8_t* dst = yPlane + size_t(y) * width;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const int r = row[x * 4 + 0];
+                    const int g = row[x * 4 + 1];
+                    const int b = row[x * 4 + 2];
+                    dst[x] = uint8_t((19595 * r + 38470 * g + 7471 * b + 32768) >> 16);
+                }
+            }
+
+            for (uint32_t cy = 0; cy < chromaHeight; ++cy)
+            {
+                const uint32_t y0 = std::min(cy * 2, height - 1);
+                const uint32_t y1 = std::min(cy * 2 + 1, height - 1);
+                const uint8_t* row0 = rgba + size_t(height - 1 - y0) * width * 4;
+                const uint8_t* row1 = rgba + size_t(height - 1 - y1) * width * 4;
+
+                for (uint32_t cx = 0; cx < chromaWidth; ++cx)
+                {
+                    const uint32_t x0 = std::min(cx * 2, width - 1) * 4;
+                    const uint32_t x1 = std::min(cx * 2 + 1, width - 1) * 4;
+
+                    const int r = row0[x0 + 0] + row0[x1 + 0] + row1[x0 + 0] + row1[x1 + 0];
+                    const int g = row0[x0 + 1] + row0[x1 + 1] + row1[x0 + 1] + row1[x1 + 1];
+                    const int b = row0[x0 + 2] + row0[x1 + 2] + row1[x0 + 2] + row1[x1 + 2];
+
+                    // sums of four samples, hence the extra >> 2
+                    uPlane[size_t(cy) * chromaWidth + cx] = clampByte(((-11059 * r - 21709 * g + 32768 * b + 131072) >> 18) + 128);
+                    vPlane[size_t(cy) * chromaWidth + cx] = clampByte(((32768 * r - 27439 * g - 5329 * b + 131072) >> 18) + 128);
+                }
+            }
+        }
+    }
+
+    FrameCapture::~FrameCapture()
+    {
+        stop();
+    }
+
+    bool FrameCapture::start(uint32_t width, uint32_t height, const FrameCaptureSettings& settings)
+    {
+        stop();
+
+        mSettings = settings;
+        mWidth = width;
+        mHeight = height;
+        mFrameIndex = 0;
+        mNextSlot = 0;
+        mFramesIssued = 0;
+        mFramesDropped = 0;
+        mFramesWritten = 0;
+        mTotalCaptureTime = 0.0;
+        mLastCaptureTime = 0.0;
+        mMaxCaptureTime = 0.0;
+
+        mSettings.ringSize = std::max(mSettings.ringSize, 2u);
+        mSettings.workerCount = std::max(mSettings.workerCount, 1u);
+
+        if (mSettings.format == CaptureFormat::CAPTURE_Y4M)
+        {
+            // frames must reach the file in order
+            mSettings.workerCount = 1;
+
+            mVideo.open(mSettings.outputPath, std::ios::binary);
+            if (!mVideo.is_open())
+            {
+                std::cerr << "Cannot open capture output: " << mSettings.outputPath << std::endl;
+                return false;
+            }
+            mVideo << "YUV4MPEG2 W" << width << " H" << height << " F" << mSettings.frameRate << ":1 Ip A1:1 C420jpeg\n";
+        }
+        else if (mSettings.format == CaptureFormat::CAPTURE_PNG_SEQUENCE)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(mSettings.outputPath, error);
+        }
+
+        // persistently mapped, so picking up a finished frame costs no map/unmap on the render thread
+        const GLsizeiptr size = GLsizeiptr(width) * height * 4;
+        for (uint32_t i = 0; i < mSettings.ringSize; ++i)
+        {
+            auto slot = std::make_unique<Slot>();
+            glCreateBuffers(1, &slot->mBuffer);
+            glNamedBufferStorage(slot->mBuffer, size, nullptr, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT | GL_CLIENT_STORAGE_BIT);
+            slot->mMapped = static_cast<const uint8_t*>(glMapNamedBufferRange(slot->mBuffer, 0, size, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
+            if (slot->mMapped == nullptr)
+            {
+                std::cerr << "Cannot map capture buffer." << std::endl;
+                glDeleteBuffers(1, &slot->mBuffer);
+                releaseResources();
+                return false;
+            }
+            mSlots.push_back(std::move(slot));
+        }
+
+        // one queue entry per slot, pushes never block the render thread
+        mQueue = std::make_unique<BoundedQueue<Slot*>>(mSettings.ringSize);
+        for (uint32_t i = 0; i < mSettings.workerCount; ++i)
+        {
+            mWorkers.emplace_back(&FrameCapture::workerLoop, this);
+        }
+
+        mCapturing = true;
+        return true;
+    }
+
+    void FrameCapture::stop()
+    {
+        if (!mCapturing)
+        {
+            return;
+        }
+
+        collect(true);
+
+        mQueue->close();
+        for (auto& worker : mWorkers)
+        {
+            worker.join();
+        }
+        mWorkers.clear();
+        mQueue.reset();
+
+        releaseResources();
+        mCapturing = false;
+    }
+
+    void FrameCapture::releaseResources()
+    {
+        for (auto& slot : mSlots)
+        {
+            glUnmapNamedBuffer(slot->mBuffer);
+            glDeleteBuffers(1, &slot->mBuffer);
+        }
+        mSlots.clear();
+
+        if (mVideo.is_open())
+        {
+            mVideo.close();
+        }
+    }
+
+    void FrameCapture::capture(GLuint framebuffer)
+    {
+        if (!mCapturing)
+        {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+
+        collect(false);
+
+        Slot* target = nullptr;
+        for (uint32_t i = 0; i < mSlots.size(); ++i)
+        {
+            Slot* slot = mSlots[(mNextSlot + i) % mSlots.size()].get();
+            if (slot->mState.load(std::memory_order_acquire) == SLOT_FREE)
+            {
+                target = slot;
+                mNextSlot = (mNextSlot + i + 1) % uint32_t(mSlots.size());
+                break;
+            }
+        }
+
+        if (target == nullptr)
+        {
+            // never stall the render thread on slow encoders
+            ++mFramesDropped;
+        }
+        else
+        {
+            GLint previousFramebuffer = 0;
+            glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, target->mBuffer);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(previousFramebuffer));
+
+            target->mFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            target->mFrameIndex = mFrameIndex;
+            target->mState.store(SLOT_PENDING, std::memory_order_release);
+            mPending.push_back(target);
+            ++mFramesIssued;
+        }
+
+        ++mFrameIndex;
+
+        const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        mLastCaptureTime = elapsed;
+        mTotalCaptureTime += elapsed;
+        mMaxCaptureTime = std::max(mMaxCaptureTime, elapsed);
+    }
+
+    FrameCaptureStats FrameCapture::getStats() const
+    {
+        FrameCaptureStats stats;
+        stats.framesIssued = mFramesIssued;
+        stats.framesWritten = mFramesWritten.load();
+        stats.framesDropped = mFramesDropped;
+        stats.lastCaptureTime = mLastCaptureTime;
+        stats.maxCaptureTime = mMaxCaptureTime;
+        stats.meanCaptureTime = mFrameIndex > 0 ? mTotalCaptureTime / mFrameIndex : 0.0;
+        return stats;
+    }
+
+    void FrameCapture::collect(bool wait)
+    {
+        while (!mPending.empty())
+        {
+            Slot* slot = mPending.front();
+
+            const GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+            const GLenum result = glClientWaitSync(slot->mFence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, timeout);
+            if (result == GL_TIMEOUT_EXPIRED)
+            {
+                // later frames can't be done before this one
+                break;
+            }
+
+            glDeleteSync(slot->mFence);
+            slot->mFence = nullptr;
+            mPending.pop_front();
+
+            if (result == GL_WAIT_FAILED)
+            {
+                std::cerr << "Waiting on capture fence failed." << std::endl;
+                slot->mState.store(SLOT_FREE, std::memory_order_release);
+                continue;
+            }
+
+            slot->mState.store(SLOT_ENCODING, std::memory_order_release);
+            mQueue->push(slot);
+        }
+    }
+
+    void FrameCapture::workerLoop()
+    {
+        Image image;
+        std::vector<uint8_t> yuv;
+        std::vector<unsigned char> png;
+
+        Slot* slot = nullptr;
+        while (mQueue->pop(slot))
+        {
+            encode(*slot, image, yuv, png);
+            ++mFramesWritten;
+        }
+    }
+
+    void FrameCapture::encode(Slot& slot, Image& image, std::vector<uint8_t>& yuv, std::vector<unsigned char>& png)
+    {
+        const uint64_t frameIndex = slot.mFrameIndex;
+
+        if (mSettings.format == CaptureFormat::CAPTURE_Y4M)
+        {
+            convertToYuv420(slot.mMapped, mWidth, mHeight, yuv);
+        }
+
+        if (mSettings.format == CaptureFormat::CAPTURE_PNG_SEQUENCE || mSettings.frameCallback)
+        {
+            image.create(int(mWidth), int(mHeight));
+            const size_t rowSize = size_t(mWidth) * 4;
+            for (uint32_t y = 0; y < mHeight; ++y)
+            {
+                std::memcpy(image.mData + y * rowSize, slot.mMapped + (mHeight - 1 - y) * rowSize, rowSize);
+            }
+        }
+
+        // everything below works on private copies, the buffer can take the next readback
+        slot.mState.store(SLOT_FREE, std::memory_order_release);
+
+        if (mSettings.format == CaptureFormat::CAPTURE_Y4M)
+        {
+            mVideo << "FRAME\n";
+            mVideo.write(reinterpret_cast<const char*>(yuv.data()), yuv.size());
+        }
+        else if (mSettings.format == CaptureFormat::CAPTURE_PNG_SEQUENCE)
+        {
+            std::ostringstream name;
+            name << mSettings.outputPath << "/frame_" << std::setw(6) << std::setfill('0') << frameIndex << ".png";
+
+            if (image.encodePng(png))
+            {
+                std::ofstream os(name.str(), std::ios::binary);
+                os.write(reinterpret_cast<const char*>(png.data()), png.size());
+            }
+            else
+            {
+                std::cerr << "Cannot encode captured frame " << frameIndex << std::endl;
+            }
+        }
+
+        if (mSettings.frameCallback)
+        {
+            mSettings.frameCallback(image, frameIndex);
+        }
+    }
+}
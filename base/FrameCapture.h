@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "BoundedQueue.h"
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    enum class CaptureFormat : uint32_t
+    {
+        CAPTURE_NONE,           // only the frame callback is invoked
+        CAPTURE_PNG_SEQUENCE,   // <outputPath>/frame_000000.png ...
+        CAPTURE_Y4M,            // raw YUV 4:2:0 video in a single file
+    };
+
+    struct FrameCaptureSettings
+    {
+        CaptureFormat format = CaptureFormat::CAPTURE_Y4M;
+        std::string outputPath;
+        uint32_t frameRate = 60;
+
+        // pixel pack buffers in flight, results are picked up once their fence has signaled
+        uint32_t ringSize = 4;
+
+        // PNG encoding is slow, several workers keep up with higher frame rates
+        uint32_t workerCount = 1;
+
+        // called on a worker thread with the top-down RGBA8 frame, e.g. for regression comparisons
+        std::function<void(const Image& image, uint64_t frameIndex)> frameCallback;
+    };
+
+    struct FrameCaptureStats
+    {
+        uint64_t framesIssued = 0;
+        uint64_t framesWritten = 0;
+
+        // frames skipped because every buffer was still in use
+        uint64_t framesDropped = 0;
+
+        // render thread cost of capture() in milliseconds
+        double lastCaptureTime = 0.0;
+        double meanCaptureTime = 0.0;
+        double maxCaptureTime = 0.0;
+    };
+
+    class FrameCapture
+    {
+    public:
+        FrameCapture() = default;
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture&) = delete;
+        FrameCapture& operator=(const FrameCapture&) = delete;
+
+        bool start(uint32_t width, uint32_t height, const FrameCaptureSettings& settings);
+
+        // waits for outstanding readbacks and the workers, then closes the output
+        void stop();
+
+        // queues a readback of the framebuffer's color buffer, call before swapping buffers
+        void capture(GLuint framebuffer = 0);
+
+        bool isCapturing() const { return mCapturing; }
+
+        FrameCaptureStats getStats() const;
+
+    private:
+        enum SlotState : uint32_t
+        {
+            SLOT_FREE,
+            SLOT_PENDING,   // readback issued, fence not signaled yet
+            SLOT_ENCODING,  // owned by a worker
+        };
+
+        struct Slot
+        {
+            GLuint mBuffer = 0;
+            GLsync mFence = nullptr;
+            const uint8_t* mMapped = nullptr;
+            uint64_t mFrameIndex = 0;
+            std::atomic<uint32_t> mState{ SLOT_FREE };
+        };
+
+        // hands every slot whose fence has signaled to the workers, without blocking unless asked to
+        void collect(bool wait);
+
+        // unmaps and deletes the slots and closes the video file, the workers must be stopped
+        void releaseResources();
+
+        void workerLoop();
+        void encode(Slot& slot, Image& image, std::vector<uint8_t>& yuv, std::vector<unsigned char>& png);
+
+        FrameCaptureSettings mSettings;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        bool mCapturing = false;
+
+        std::vector<std::unique_ptr<Slot>> mSlots;
+        std::deque<Slot*> mPending;
+        uint32_t mNextSlot = 0;
+        uint64_t mFrameIndex = 0;
+
+        std::unique_ptr<BoundedQueue<Slot*>> mQueue;
+        std::vector<std::thread> mWorkers;
+        std::ofstream mVideo;
+
+        std::atomic<uint64_t> mFramesWritten{ 0 };
+        uint64_t mFramesIssued = 0;
+        uint64_t mFramesDropped = 0;
+        double mTotalCaptureTime = 0.0;
+        double mLastCaptureTime = 0.0;
+        double mMaxCaptureTime = 0.0;
+    };
+}
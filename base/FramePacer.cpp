@@ -0,0 +1,264 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <thread>
+
+namespace utils
+{
+    void FramePacer::init(GLFWwindow* window, const FramePacerSettings& settings)
+    {
+        mWindow = window;
+        mSettings = settings;
+        mSettings.maxFramesInFlight = std::clamp(mSettings.maxFramesInFlight, 1u, kMaxFramesInFlight);
+        mSettings.maxSimulationSteps = std::max(mSettings.maxSimulationSteps, 1u);
+
+        if (mSettings.fixedTimestep <= 0.0)
+        {
+            mSettings.fixedTimestep = 1.0 / 60.0;
+        }
+
+        mFenceIndex = 0;
+        mFirstFrame = true;
+        mAccumulator = 0.0;
+        mSampleCount = 0;
+        mSampleIndex = 0;
+        mStats = FrameStats();
+
+        applySwapMode();
+    }
+
+    void FramePacer::destroy()
+    {
+        for (auto& fence : mFences)
+        {
+            if (fence != nullptr)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+        mWindow = nullptr;
+    }
+
+    void FramePacer::setSwapMode(SwapMode mode)
+    {
+        mSettings.swapMode = mode;
+        applySwapMode();
+    }
+
+    void FramePacer::setTargetFrameRate(double frameRate)
+    {
+        mSettings.targetFrameRate = std::max(frameRate, 0.0);
+        mDeadline = Clock::now();
+    }
+
+    void FramePacer::setMaxFramesInFlight(uint32_t count)
+    {
+        // drain everything in flight so the ring can be resized safely
+        for (auto& fence : mFences)
+        {
+            if (fence != nullptr)
+            {
+                glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        mSettings.maxFramesInFlight = std::clamp(count, 1u, kMaxFramesInFlight);
+        mFenceIndex = 0;
+    }
+
+    void FramePacer::setFixedTimestep(double timestep)
+    {
+        if (timestep > 0.0)
+        {
+            mSettings.fixedTimestep = timestep;
+            mAccumulator = std::min(mAccumulator, timestep);
+        }
+    }
+
+    uint32_t FramePacer::beginFrame()
+    {
+        waitForFrameSlot();
+
+        const auto now = Clock::now();
+        if (mFirstFrame)
+        {
+            mFirstFrame = false;
+            mLastFrameStart = now;
+            mDeadline = now;
+            mDeltaTime = 0.0;
+            return 0;
+        }
+
+        mDeltaTime = std::chrono::duration<double>(now - mLastFrameStart).count();
+        mLastFrameStart = now;
+
+        const double step = mSettings.fixedTimestep;
+        mAccumulator += std::min(mDeltaTime, step * mSettings.maxSimulationSteps);
+
+        uint32_t steps = 0;
+        while (mAccumulator >= step && steps < mSettings.maxSimulationSteps)
+        {
+            mAccumulator -= step;
+            ++steps;
+        }
+
+        // drop whatever the step budget could not absorb
+        mAccumulator = std::min(mAccumulator, step);
+
+        return steps;
+    }
+
+    void FramePacer::endFrame()
+    {
+        if (mFences[mFenceIndex] != nullptr)
+        {
+            glDeleteSync(mFences[mFenceIndex]);
+        }
+        mFences[mFenceIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        mFenceIndex = (mFenceIndex + 1) % mSettings.maxFramesInFlight;
+
+        limitFrameRate();
+
+        const auto now = Clock::now();
+        if (mStats.frameCount > 0)
+        {
+            recordFrameTime(std::chrono::duration<double, std::milli>(now - mLastFrameEnd).count());
+        }
+        mLastFrameEnd = now;
+        ++mStats.frameCount;
+    }
+
+    void FramePacer::applySwapMode()
+    {
+        int interval = 0;
+        switch (mSettings.swapMode)
+        {
+        case SwapMode::SWAP_IMMEDIATE:
+            interval = 0;
+            break;
+        case SwapMode::SWAP_VSYNC:
+            interval = 1;
+            break;
+        case SwapMode::SWAP_ADAPTIVE_VSYNC:
+            if (glfwExtensionSupported("WGL_EXT_swap_control_tear") || glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+            {
+                interval = -1;
+            }
+            else
+            {
+                std::cerr << "Adaptive vsync is not supported, falling back to vsync." << std::endl;
+                interval = 1;
+            }
+            break;
+        }
+
+        glfwSwapInterval(interval);
+    }
+
+    void FramePacer::waitForFrameSlot()
+    {
+        GLsync fence = mFences[mFenceIndex];
+        if (fence == nullptr)
+        {
+            mStats.gpuWaitTime = 0.0;
+            return;
+        }
+
+        const auto start = Clock::now();
+
+        // the fence belongs to the frame issued maxFramesInFlight frames ago
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, 0, 1000000);
+        }
+
+        if (result == GL_WAIT_FAILED)
+        {
+            std::cerr << "Waiting on frame fence failed." << std::endl;
+        }
+
+        glDeleteSync(fence);
+        mFences[mFenceIndex] = nullptr;
+
+        mStats.gpuWaitTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void FramePacer::limitFrameRate()
+    {
+        if (mSettings.targetFrameRate <= 0.0)
+        {
+            mStats.limiterWaitTime = 0.0;
+            return;
+        }
+
+        const auto start = Clock::now();
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / mSettings.targetFrameRate));
+        const auto spin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(mSettings.spinThreshold));
+
+        mDeadline += period;
+
+        if (start >= mDeadline)
+        {
+            // missed the deadline, resync instead of rushing the following frames
+            if (start - mDeadline > period)
+            {
+                mDeadline = start;
+            }
+            mStats.limiterWaitTime = 0.0;
+            return;
+        }
+
+        auto now = start;
+        while (mDeadline - now > spin)
+        {
+            std::this_thread::sleep_for(mDeadline - now - spin);
+            now = Clock::now();
+        }
+
+        // sleep granularity is too coarse for the last sub-millisecond
+        while (Clock::now() < mDeadline)
+        {
+            std::this_thread::yield();
+        }
+
+        mStats.limiterWaitTime = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void FramePacer::recordFrameTime(double milliseconds)
+    {
+        mSamples[mSampleIndex] = milliseconds;
+        mSampleIndex = (mSampleIndex + 1) % kStatsWindow;
+        mSampleCount = std::min(mSampleCount + 1, kStatsWindow);
+
+        double sum = 0.0;
+        double minTime = mSamples[0];
+        double maxTime = mSamples[0];
+        for (uint32_t i = 0; i < mSampleCount; ++i)
+        {
+            sum += mSamples[i];
+            minTime = std::min(minTime, mSamples[i]);
+            maxTime = std::max(maxTime, mSamples[i]);
+        }
+
+        const double mean = sum / mSampleCount;
+        double squares = 0.0;
+        for (uint32_t i = 0; i < mSampleCount; ++i)
+        {
+            const double d = mSamples[i] - mean;
+            squares += d * d;
+        }
+
+        mStats.lastFrameTime = milliseconds;
+        mStats.meanFrameTime = mean;
+        mStats.minFrameTime = minTime;
+        mStats.maxFrameTime = maxTime;
+        mStats.variance = squares / mSampleCount;
+        mStats.standardDeviation = std::sqrt(mStats.variance);
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+namespace utils
+{
+    enum class SwapMode : uint32_t
+    {
+        SWAP_IMMEDIATE,
+        SWAP_VSYNC,
+        SWAP_ADAPTIVE_VSYNC,    // tears instead of stalling when a frame misses vblank
+    };
+
+    struct FramePacerSettings
+    {
+        SwapMode swapMode = SwapMode::SWAP_VSYNC;
+
+        // 0 disables the frame limiter
+        double targetFrameRate = 0.0;
+
+        // how many frames the CPU may queue ahead of the GPU, clamped to [1, 3]
+        uint32_t maxFramesInFlight = 2;
+
+        // step used for update(), independent of the render rate
+        double fixedTimestep = 1.0 / 60.0;
+
+        // upper bound of update() calls per frame, avoids the spiral of death after a hitch
+        uint32_t maxSimulationSteps = 8;
+
+        // the limiter sleeps until this much time is left and spins for the rest
+        double spinThreshold = 0.002;
+    };
+
+    struct FrameStats
+    {
+        uint64_t frameCount = 0;
+
+        // all values in milliseconds over the last sample window
+        double lastFrameTime = 0.0;
+        double meanFrameTime = 0.0;
+        double minFrameTime = 0.0;
+        double maxFrameTime = 0.0;
+        double variance = 0.0;
+        double standardDeviation = 0.0;
+
+        // time spent blocked on frame fences and in the limiter during the last frame
+        double gpuWaitTime = 0.0;
+        double limiterWaitTime = 0.0;
+    };
+
+    class FramePacer
+    {
+    public:
+        static constexpr uint32_t kMaxFramesInFlight = 3;
+        static constexpr uint32_t kStatsWindow = 120;
+
+        FramePacer() = default;
+        ~FramePacer() = default;
+
+        // must be called with the window's context current and GL loaded
+        void init(GLFWwindow* window, const FramePacerSettings& settings);
+        void destroy();
+
+        void setSwapMode(SwapMode mode);
+        void setTargetFrameRate(double frameRate);
+        void setMaxFramesInFlight(uint32_t count);
+        void setFixedTimestep(double timestep);
+
+        // blocks until a frame slot is free and returns how many fixed steps to simulate
+        uint32_t beginFrame();
+
+        // call right after swapping buffers
+        void endFrame();
+
+        double getFixedTimestep() const { return mSettings.fixedTimestep; }
+
+        // fraction of a fixed step not yet simulated, for interpolating render state
+        double getInterpolationAlpha() const { return mAccumulator / mSettings.fixedTimestep; }
+
+        // wall time between the last two frames in seconds
+        double getDeltaTime() const { return mDeltaTime; }
+
+        const FramePacerSettings& getSettings() const { return mSettings; }
+        const FrameStats& getStats() const { return mStats; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        void applySwapMode();
+        void waitForFrameSlot();
+        void limitFrameRate();
+        void recordFrameTime(double milliseconds);
+
+        GLFWwindow* mWindow = nullptr;
+        FramePacerSettings mSettings;
+
+        std::array<GLsync, kMaxFramesInFlight> mFences = {};
+        uint32_t mFenceIndex = 0;
+
+        Clock::time_point mLastFrameStart;
+        Clock::time_point mLastFrameEnd;
+        Clock::time_point mDeadline;
+        bool mFirstFrame = true;
+
+        double mAccumulator = 0.0;
+        double mDeltaTime = 0.0;
+
+        std::array<double, kStatsWindow> mSamples = {};
+        uint32_t mSampleCount = 0;
+        uint32_t mSampleIndex = 0;
+
+        FrameStats mStats;
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace utils
+{
+    // view frustum planes pointing inwards, extracted from a GL clip space matrix
+    struct Frustum
+    {
+        enum Plane : uint32_t
+        {
+            PLANE_LEFT,
+            PLANE_RIGHT,
+            PLANE_BOTTOM,
+            PLANE_TOP,
+            PLANE_NEAR,
+            PLANE_FAR,
+            PLANE_COUNT,
+        };
+
+        glm::vec4 planes[PLANE_COUNT];
+
+        static Frustum fromMatrix(const glm::mat4& viewProjection)
+        {
+            const glm::mat4 m = glm::transpose(viewProjection);
+
+            Frustum frustum;
+            frustum.planes[PLANE_LEFT] = m[3] + m[0];
+            frustum.planes[PLANE_RIGHT] = m[3] - m[0];
+            frustum.planes[PLANE_BOTTOM] = m[3] + m[1];
+            frustum.planes[PLANE_TOP] = m[3] - m[1];
+            frustum.planes[PLANE_NEAR] = m[3] + m[2];
+            frustum.planes[PLANE_FAR] = m[3] - m[2];
+
+            for (glm::vec4& plane : frustum.planes)
+            {
+                plane /= glm::length(glm::vec3(plane));
+            }
+            return frustum;
+        }
+
+        bool intersectsSphere(const glm::vec3& center, float radius) const
+        {
+            for (const glm::vec4& plane : planes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const
+        {
+            for (const glm::vec4& plane : planes)
+            {
+                // the corner furthest along the plane normal
+                const glm::vec3 positive(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+                if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+}
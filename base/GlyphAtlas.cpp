@@ -0,0 +1,903 @@
+#include "GlyphAtlas.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "AssetArchive.h"
+#include "ThreadPool.h"
+
+#define STBTT_STATIC
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "imstb_truetype.h"
+
+namespace utils
+{
+    namespace
+    {
+        constexpr double kPi = 3.14159265358979323846;
+
+        enum EdgeColor : uint8_t
+        {
+            EDGE_RED = 1,
+            EDGE_GREEN = 2,
+            EDGE_BLUE = 4,
+            EDGE_YELLOW = EDGE_RED | EDGE_GREEN,
+            EDGE_MAGENTA = EDGE_RED | EDGE_BLUE,
+            EDGE_CYAN = EDGE_GREEN | EDGE_BLUE,
+            EDGE_WHITE = EDGE_RED | EDGE_GREEN | EDGE_BLUE,
+        };
+
+        // a line has its end point in p[1] and p[2]
+        struct Edge
+        {
+            glm::dvec2 p[3];
+            bool quadratic;
+            uint8_t color;
+
+            glm::dvec2 point(double t) const
+            {
+                return quadratic ? glm::mix(glm::mix(p[0], p[1], t), glm::mix(p[1], p[2], t), t) : glm::mix(p[0], p[2], t);
+            }
+
+            glm::dvec2 direction(double t) const
+            {
+                if (!quadratic)
+                {
+                    return p[2] - p[0];
+                }
+
+                const glm::dvec2 tangent = glm::mix(p[1] - p[0], p[2] - p[1], t);
+                return tangent == glm::dvec2(0.0) ? p[2] - p[0] : tangent;
+            }
+        };
+
+        // distance with the orthogonality of the closest point as a tie breaker between edges sharing it
+        struct SignedDistance
+        {
+            double distance = -1e240;
+            double dot = 1.0;
+
+            bool closerThan(const SignedDistance& other) const
+            {
+                return std::abs(distance) < std::abs(other.distance) || (std::abs(distance) == std::abs(other.distance) && dot < other.dot);
+            }
+        };
+
+        double cross(const glm::dvec2& a, const glm::dvec2& b)
+        {
+            return a.x * b.y - a.y * b.x;
+        }
+
+        double nonZeroSign(double value)
+        {
+            return value > 0.0 ? 1.0 : -1.0;
+        }
+
+        glm::dvec2 normalizeSafe(const glm::dvec2& v)
+        {
+            const double length = glm::length(v);
+            return length > 0.0 ? v / length : glm::dvec2(0.0, 1.0);
+        }
+
+        int solveQuadratic(double x[2], double a, double b, double c)
+        {
+            if (a == 0.0 || std::abs(b) > 1e12 * std::abs(a))
+            {
+                if (b == 0.0)
+                {
+                    return 0;
+                }
+                x[0] = -c / b;
+                return 1;
+            }
+
+            const double discriminant = b * b - 4.0 * a * c;
+            if (discriminant > 0.0)
+            {
+                const double root = std::sqrt(discriminant);
+                x[0] = (-b + root) / (2.0 * a);
+                x[1] = (-b - root) / (2.0 * a);
+                return 2;
+            }
+            if (discriminant == 0.0)
+            {
+                x[0] = -b / (2.0 * a);
+                return 1;
+            }
+            return 0;
+        }
+
+        int solveCubicNormed(double x[3], double a, double b, double c)
+        {
+            const double a2 = a * a;
+            double q = (a2 - 3.0 * b) / 9.0;
+            const double r = (a * (2.0 * a2 - 9.0 * b) + 27.0 * c) / 54.0;
+            const double r2 = r * r;
+            const double q3 = q * q * q;
+
+            if (r2 < q3)
+            {
+                const double t = std::acos(std::min(std::max(r / std::sqrt(q3), -1.0), 1.0));
+                a /= 3.0;
+                q = -2.0 * std::sqrt(q);
+                x[0] = q * std::cos(t / 3.0) - a;
+                x[1] = q * std::cos((t + 2.0 * kPi) / 3.0) - a;
+                x[2] = q * std::cos((t - 2.0 * kPi) / 3.0) - a;
+                return 3;
+            }
+
+            double u = -std::pow(std::abs(r) + std::sqrt(r2 - q3), 1.0 / 3.0);
+            if (r < 0.0)
+            {
+                u = -u;
+            }
+            const double v = u == 0.0 ? 0.0 : q / u;
+            a /= 3.0;
+            x[0] = (u + v) - a;
+            x[1] = -0.5 * (u + v) - a;
+            x[2] = 0.5 * std::sqrt(3.0) * (u - v);
+            return std::abs(x[2]) < 1e-14 ? 2 : 1;
+        }
+
+        int solveCubic(double x[3], double a, double b, double c, double d)
+        {
+            if (a != 0.0)
+            {
+                const double bn = b / a;
+                if (std::abs(bn) < 1e6)
+                {
+                    return solveCubicNormed(x, bn, c / a, d / a);
+                }
+            }
+            return solveQuadratic(x, b, c, d);
+        }
+
+        SignedDistance signedDistance(const Edge& edge, const glm::dvec2& origin, double& param)
+        {
+            SignedDistance result;
+            if (!edge.quadratic)
+            {
+                const glm::dvec2 aq = origin - edge.p[0];
+                const glm::dvec2 ab = edge.p[2] - edge.p[0];
+                param = glm::dot(aq, ab) / glm::dot(ab, ab);
+
+                const glm::dvec2 eq = (param > 0.5 ? edge.p[2] : edge.p[0]) - origin;
+                const double endpointDistance = glm::length(eq);
+                if (param > 0.0 && param < 1.0)
+                {
+                    const double orthoDistance = cross(aq, ab) / glm::length(ab);
+                    if (std::abs(orthoDistance) < endpointDistance)
+                    {
+                        result.distance = orthoDistance;
+                        result.dot = 0.0;
+                        return result;
+                    }
+                }
+
+                result.distance = nonZeroSign(cross(aq, ab)) * endpointDistance;
+                result.dot = std::abs(glm::dot(normalizeSafe(ab), normalizeSafe(eq)));
+                return result;
+            }
+
+            // the closest point is a root of the derivative of the squared distance, a cubic in t
+            const glm::dvec2 qa = edge.p[0] - origin;
+            const glm::dvec2 ab = edge.p[1] - edge.p[0];
+            const glm::dvec2 br = edge.p[2] - edge.p[1] - ab;
+            const double a = glm::dot(br, br);
+            const double b = 3.0 * glm::dot(ab, br);
+            const double c = 2.0 * glm::dot(ab, ab) + glm::dot(qa, br);
+            const double d = glm::dot(qa, ab);
+
+            double roots[3];
+            const int count = solveCubic(roots, a, b, c, d);
+
+            glm::dvec2 direction = edge.direction(0.0);
+            double minDistance = nonZeroSign(cross(direction, qa)) * glm::length(qa);
+            param = -glm::dot(qa, direction) / glm::dot(direction, direction);
+
+            direction = edge.direction(1.0);
+            const double endDistance = glm::length(edge.p[2] - origin);
+            if (endDistance < std::abs(minDistance))
+            {
+                minDistance = nonZeroSign(cross(direction, edge.p[2] - origin)) * endDistance;
+                param = glm::dot(origin - edge.p[1], direction) / glm::dot(direction, direction);
+            }
+
+            for (int i = 0; i < count; ++i)
+            {
+                const double t = roots[i];
+                if (t > 0.0 && t < 1.0)
+                {
+                    const glm::dvec2 qe = qa + 2.0 * t * ab + t * t * br;
+                    const double distance = glm::length(qe);
+                    if (distance <= std::abs(minDistance))
+                    {
+                        minDistance = nonZeroSign(cross(ab + t * br, qe)) * distance;
+                        param = t;
+                    }
+                }
+            }
+
+            result.distance = minDistance;
+            if (param >= 0.0 && param <= 1.0)
+            {
+                result.dot = 0.0;
+            }
+            else if (param < 0.5)
+            {
+                result.dot = std::abs(glm::dot(normalizeSafe(edge.direction(0.0)), normalizeSafe(qa)));
+            }
+            else
+            {
+                result.dot = std::abs(glm::dot(normalizeSafe(edge.direction(1.0)), normalizeSafe(edge.p[2] - origin)));
+            }
+            return result;
+        }
+
+        // distance to the edge extended along its end tangents, keeps corners sharp once channels are combined
+        double pseudoDistance(const Edge& edge, const glm::dvec2& origin, double param, double distance)
+        {
+            if (param < 0.0)
+            {
+                const glm::dvec2 direction = normalizeSafe(edge.direction(0.0));
+                const glm::dvec2 aq = origin - edge.p[0];
+                if (glm::dot(aq, direction) < 0.0)
+                {
+                    const double pseudo = cross(aq, direction);
+                    if (std::abs(pseudo) <= std::abs(distance))
+                    {
+                        return pseudo;
+                    }
+                }
+            }
+            else if (param > 1.0)
+            {
+                const glm::dvec2 direction = normalizeSafe(edge.direction(1.0));
+                const glm::dvec2 bq = origin - edge.p[2];
+                if (glm::dot(bq, direction) > 0.0)
+                {
+                    const double pseudo = cross(bq, direction);
+                    if (std::abs(pseudo) <= std::abs(distance))
+                    {
+                        return pseudo;
+                    }
+                }
+            }
+            return distance;
+        }
+
+        // nonzero winding of a horizontal ray towards +x, crossings are counted on [start, end) of every edge
+        int winding(const std::vector<Edge>& edges, const glm::dvec2& point)
+        {
+            int result = 0;
+            for (const Edge& edge : edges)
+            {
+                if (!edge.quadratic)
+                {
+                    const glm::dvec2& a = edge.p[0];
+                    const glm::dvec2& b = edge.p[2];
+                    if ((a.y <= point.y) != (b.y <= point.y))
+                    {
+                        const double x = a.x + (point.y - a.y) / (b.y - a.y) * (b.x - a.x);
+                        if (x > point.x)
+                        {
+                            result += b.y > a.y ? 1 : -1;
+                        }
+                    }
+                    continue;
+                }
+
+                const double a = edge.p[0].y - 2.0 * edge.p[1].y + edge.p[2].y;
+                const double b = 2.0 * (edge.p[1].y - edge.p[0].y);
+                const double c = edge.p[0].y - point.y;
+
+                double roots[2];
+                const int count = solveQuadratic(roots, a, b, c);
+                for (int i = 0; i < count; ++i)
+                {
+                    const double t = roots[i];
+                    const double slope = 2.0 * a * t + b;
+                    if (t >= 0.0 && t < 1.0 && slope != 0.0 && edge.point(t).x > point.x)
+                    {
+                        result += slope > 0.0 ? 1 : -1;
+                    }
+                }
+            }
+            return result;
+        }
+
+        bool isCorner(const glm::dvec2& a, const glm::dvec2& b)
+        {
+            // about 3 radians between the tangents, or pointing back
+            const glm::dvec2 na = normalizeSafe(a);
+            const glm::dvec2 nb = normalizeSafe(b);
+            return glm::dot(na, nb) <= 0.0 || std::abs(cross(na, nb)) > 0.14112;
+        }
+
+        // edges between two corners share a color, neighbouring colors always share exactly one channel
+        void colorEdges(std::vector<Edge>& edges, const std::vector<size_t>& contourStarts)
+        {
+            for (size_t contour = 0; contour < contourStarts.size(); ++contour)
+            {
+                const size_t begin = contourStarts[contour];
+                const size_t end = contour + 1 < contourStarts.size() ? contourStarts[contour + 1] : edges.size();
+                const size_t count = end - begin;
+
+                std::vector<size_t> corners;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const Edge& previous = edges[begin + (i + count - 1) % count];
+                    if (isCorner(previous.direction(1.0), edges[begin + i].direction(0.0)))
+                    {
+                        corners.push_back(i);
+                    }
+                }
+
+                if (corners.empty())
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        edges[i].color = EDGE_WHITE;
+                    }
+                    continue;
+                }
+
+                const uint8_t cycle[3] = { EDGE_CYAN, EDGE_MAGENTA, EDGE_YELLOW };
+                const size_t splines = corners.size();
+                for (size_t spline = 0; spline < splines; ++spline)
+                {
+                    uint8_t color = cycle[spline % 3];
+                    if (splines > 1 && spline + 1 == splines && spline % 3 == 0)
+                    {
+                        // the last spline would match the first one it touches
+                        color = EDGE_MAGENTA;
+                    }
+
+                    const size_t first = corners[spline];
+                    const size_t last = spline + 1 < splines ? corners[spline + 1] : corners[0] + count;
+                    for (size_t i = first; i < last; ++i)
+                    {
+                        edges[begin + i % count].color = color;
+                    }
+                }
+
+                // a single corner gives one spline, split it in three so both sides of the corner differ
+                if (splines == 1 && count >= 3)
+                {
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        edges[begin + (corners[0] + i) % count].color = cycle[std::min<size_t>(i * 3 / count, 2)];
+                    }
+                }
+            }
+        }
+    }
+
+    struct GlyphAtlas::FontData
+    {
+        std::vector<unsigned char> bytes;
+        stbtt_fontinfo info;
+
+        // font units to units of font size, the size being the distance from descent to ascent
+        float unitScale = 0.0f;
+        float ascent = 0.0f;
+        float lineHeight = 0.0f;
+    };
+
+    struct GlyphAtlas::RasterizedGlyph
+    {
+        uint64_t key = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint32_t> pixels;
+    };
+
+    GlyphAtlas::~GlyphAtlas()
+    {
+        destroy();
+    }
+
+    bool GlyphAtlas::init(const GlyphAtlasSettings& settings)
+    {
+        destroy();
+
+        uint32_t buckets = 0;
+        while (buckets < kMaxBuckets && (settings.minBucket << buckets) <= settings.maxBucket)
+        {
+            ++buckets;
+        }
+
+        if (settings.minBucket == 0 || buckets == 0 || settings.width < getCellSize(0) || settings.initialHeight == 0)
+        {
+            std::cerr << "Invalid glyph atlas settings" << std::endl;
+            return false;
+        }
+
+        mSettings = settings;
+        mSettings.maxBucket = settings.minBucket << (buckets - 1);
+        mSettings.maxHeight = std::max(settings.maxHeight, settings.initialHeight);
+        mHeight = settings.initialHeight;
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &mId);
+        glTextureStorage2D(mId, 1, GL_RGBA8, GLsizei(mSettings.width), GLsizei(mHeight));
+        glTextureParameteri(mId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(mId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(mId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(mId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        mQueue = std::make_shared<RasterQueue>();
+        mStats.atlasHeight = mHeight;
+        return true;
+    }
+
+    void GlyphAtlas::destroy()
+    {
+        if (mId != 0)
+        {
+            glDeleteTextures(1, &mId);
+            mId = 0;
+        }
+
+        mFonts.clear();
+        mGlyphs.clear();
+        mKerning.clear();
+        mAscii.clear();
+        mShelves.clear();
+        mCells.clear();
+        for (std::vector<uint32_t>& cells : mFreeCells)
+        {
+            cells.clear();
+        }
+
+        mQueue.reset();
+        mPending = 0;
+        mShelfEnd = 0;
+        mHeight = 0;
+        mStats = GlyphAtlasStats();
+    }
+
+    uint32_t GlyphAtlas::loadFont(const std::string& filename)
+    {
+        AssetData bytes;
+        if (!AssetFileSystem::global().read(filename, bytes))
+        {
+            std::cerr << "Cannot open the font: " << filename << std::endl;
+            return ~0u;
+        }
+
+        // stb_truetype keeps pointing into the bytes, so the font owns a copy even of archive views
+        auto font = std::make_shared<FontData>();
+        font->bytes.assign(bytes.data, bytes.data + bytes.size);
+        if (font->bytes.empty() || !stbtt_InitFont(&font->info, font->bytes.data(), stbtt_GetFontOffsetForIndex(font->bytes.data(), 0)))
+        {
+            std::cerr << "Cannot parse the font: " << filename << std::endl;
+            return ~0u;
+        }
+
+        int ascent;
+        int descent;
+        int lineGap;
+        stbtt_GetFontVMetrics(&font->info, &ascent, &descent, &lineGap);
+        font->unitScale = 1.0f / float(std::max(ascent - descent, 1));
+        font->ascent = float(ascent) * font->unitScale;
+        font->lineHeight = float(ascent - descent + lineGap) * font->unitScale;
+
+        mFonts.push_back(font);
+        mAscii.resize(mFonts.size() * kMaxBuckets * kAsciiCount, nullptr);
+        return uint32_t(mFonts.size() - 1);
+    }
+
+    uint32_t GlyphAtlas::getBucket(float size) const
+    {
+        // distance fields stay sharp up to about twice their rasterized size
+        uint32_t bucket = 0;
+        while ((mSettings.minBucket << bucket) * 2 < size && (mSettings.minBucket << bucket) < mSettings.maxBucket)
+        {
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    uint32_t GlyphAtlas::getCellSize(uint32_t bucket) const
+    {
+        return (mSettings.minBucket << bucket) + 2 * uint32_t(std::ceil(mSettings.distanceRange));
+    }
+
+    const Glyph* GlyphAtlas::getGlyph(uint32_t font, uint32_t codepoint, float size)
+    {
+        if (font >= mFonts.size())
+        {
+            return nullptr;
+        }
+
+        const uint32_t bucket = getBucket(size);
+        Glyph* glyph = nullptr;
+        Glyph** ascii = codepoint < kAsciiCount ? &mAscii[(size_t(font) * kMaxBuckets + bucket) * kAsciiCount + codepoint] : nullptr;
+
+        if (ascii != nullptr && *ascii != nullptr)
+        {
+            glyph = *ascii;
+        }
+        else
+        {
+            const uint64_t key = (uint64_t(font) << 40) | (uint64_t(bucket) << 32) | codepoint;
+            auto it = mGlyphs.find(key);
+            glyph = it != mGlyphs.end() ? &it->second : createGlyph(font, codepoint, bucket, key);
+            if (glyph == nullptr)
+            {
+                return nullptr;
+            }
+            if (ascii != nullptr)
+            {
+                *ascii = glyph;
+            }
+        }
+
+        glyph->lastUsedFrame = mFrame;
+        if (!glyph->resident && !glyph->pending && !glyph->empty)
+        {
+            requestGlyph(font, *glyph, codepoint);
+        }
+        return glyph;
+    }
+
+    Glyph* GlyphAtlas::createGlyph(uint32_t font, uint32_t codepoint, uint32_t bucket, uint64_t key)
+    {
+        const FontData& data = *mFonts[font];
+        const int index = stbtt_FindGlyphIndex(&data.info, int(codepoint));
+        if (index == 0 && codepoint != 0)
+        {
+            return nullptr;
+        }
+
+        Glyph& glyph = mGlyphs[key];
+        glyph.key = key;
+        glyph.bucket = bucket;
+
+        int advance;
+        int bearing;
+        stbtt_GetGlyphHMetrics(&data.info, index, &advance, &bearing);
+        glyph.advance = float(advance) * data.unitScale;
+
+        int x0, y0, x1, y1;
+        if (stbtt_IsGlyphEmpty(&data.info, index) || !stbtt_GetGlyphBox(&data.info, index, &x0, &y0, &x1, &y1) || x1 <= x0 || y1 <= y0)
+        {
+            glyph.empty = true;
+            return &glyph;
+        }
+
+        // texels per font unit, glyphs larger than a cell are scaled down to fit
+        const float padding = std::ceil(mSettings.distanceRange);
+        const float inner = float(getCellSize(bucket)) - 2.0f * padding;
+        const float scale = std::min({ float(mSettings.minBucket << bucket) * data.unitScale, inner / float(x1 - x0), inner / float(y1 - y0) });
+
+        const float width = std::ceil(float(x1 - x0) * scale) + 2.0f * padding;
+        const float height = std::ceil(float(y1 - y0) * scale) + 2.0f * padding;
+
+        glyph.texelScale = scale / data.unitScale;
+        glyph.plane.x = (float(x0) - padding / scale) * data.unitScale;
+        glyph.plane.y = -(float(y1) + padding / scale) * data.unitScale;
+        glyph.plane.z = glyph.plane.x + width / glyph.texelScale;
+        glyph.plane.w = glyph.plane.y + height / glyph.texelScale;
+        glyph.texels = glm::vec4(0.0f, 0.0f, width, height);
+        return &glyph;
+    }
+
+    void GlyphAtlas::requestGlyph(uint32_t font, Glyph& glyph, uint32_t codepoint)
+    {
+        if (mPending >= mSettings.maxPendingGlyphs)
+        {
+            return;
+        }
+        glyph.pending = true;
+        ++mPending;
+
+        std::shared_ptr<FontData> data = mFonts[font];
+        std::shared_ptr<RasterQueue> queue = mQueue;
+        const uint64_t key = glyph.key;
+        const uint32_t width = uint32_t(glyph.texels.z);
+        const uint32_t height = uint32_t(glyph.texels.w);
+        const double scale = double(glyph.texelScale) * data->unitScale;
+        const double padding = std::ceil(mSettings.distanceRange);
+        const double range = mSettings.distanceRange;
+
+        ThreadPool::global().enqueue([data, queue, key, codepoint, width, height, scale, padding, range]()
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            auto result = std::make_unique<RasterizedGlyph>();
+            result->key = key;
+            result->width = width;
+            result->height = height;
+            result->pixels.assign(size_t(width) * height, 0u);
+
+            const int index = stbtt_FindGlyphIndex(&data->info, int(codepoint));
+            int x0, y0, x1, y1;
+            stbtt_GetGlyphBox(&data->info, index, &x0, &y0, &x1, &y1);
+
+            stbtt_vertex* vertices = nullptr;
+            const int vertexCount = stbtt_GetGlyphShape(&data->info, index, &vertices);
+
+            std::vector<Edge> edges;
+            std::vector<size_t> contourStarts;
+            glm::dvec2 cursor(0.0);
+            double area = 0.0;
+            for (int i = 0; i < vertexCount; ++i)
+            {
+                const stbtt_vertex& vertex = vertices[i];
+                const glm::dvec2 to(vertex.x, vertex.y);
+                if (vertex.type == STBTT_vmove)
+                {
+                    contourStarts.push_back(edges.size());
+                }
+                else if (vertex.type == STBTT_vline && to != cursor)
+                {
+                    edges.push_back({ { cursor, to, to }, false, EDGE_WHITE });
+                }
+                else if (vertex.type == STBTT_vcurve)
+                {
+                    edges.push_back({ { cursor, glm::dvec2(vertex.cx, vertex.cy), to }, true, EDGE_WHITE });
+                }
+                else if (vertex.type == STBTT_vcubic)
+                {
+                    // two quadratics approximating the halves of the cubic
+                    const glm::dvec2 c1(vertex.cx, vertex.cy);
+                    const glm::dvec2 c2(vertex.cx1, vertex.cy1);
+                    const glm::dvec2 m01 = (cursor + c1) * 0.5, m12 = (c1 + c2) * 0.5, m23 = (c2 + to) * 0.5;
+                    const glm::dvec2 a = (m01 + m12) * 0.5, b = (m12 + m23) * 0.5, middle = (a + b) * 0.5;
+                    edges.push_back({ { cursor, (3.0 * (m01 + a) - cursor - middle) * 0.25, middle }, true, EDGE_WHITE });
+                    edges.push_back({ { middle, (3.0 * (b + m23) - middle - to) * 0.25, to }, true, EDGE_WHITE });
+                }
+
+                if (vertex.type != STBTT_vmove)
+                {
+                    area += cross(cursor, to);
+                }
+                cursor = to;
+            }
+            stbtt_FreeShape(&data->info, vertices);
+
+            // drop contours that ended up without edges
+            contourStarts.erase(std::unique(contourStarts.begin(), contourStarts.end()), contourStarts.end());
+            while (!contourStarts.empty() && contourStarts.back() == edges.size())
+            {
+                contourStarts.pop_back();
+            }
+            colorEdges(edges, contourStarts);
+
+            // TrueType outlines run clockwise, the interior is on the right and gets a positive distance
+            const double orientation = area <= 0.0 ? 1.0 : -1.0;
+
+            for (uint32_t y = 0; y < height && !edges.empty(); ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const glm::dvec2 point(x0 + (x + 0.5 - padding) / scale, y1 - (y + 0.5 - padding) / scale);
+
+                    SignedDistance closest[3];
+                    SignedDistance closestAll;
+                    const Edge* closestEdge[3] = { nullptr, nullptr, nullptr };
+                    double closestParam[3] = { 0.0, 0.0, 0.0 };
+
+                    for (const Edge& edge : edges)
+                    {
+                        double param;
+                        const SignedDistance distance = signedDistance(edge, point, param);
+                        if (distance.closerThan(closestAll))
+                        {
+                            closestAll = distance;
+                        }
+                        for (int channel = 0; channel < 3; ++channel)
+                        {
+                            if ((edge.color & (1 << channel)) && distance.closerThan(closest[channel]))
+                            {
+                                closest[channel] = distance;
+                                closestEdge[channel] = &edge;
+                                closestParam[channel] = param;
+                            }
+                        }
+                    }
+
+                    double channels[3];
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        channels[channel] = closestEdge[channel] != nullptr
+                            ? pseudoDistance(*closestEdge[channel], point, closestParam[channel], closest[channel].distance) * orientation
+                            : -1e240;
+                    }
+
+                    // where the channels disagree with the actual outline fall back to a plain distance field
+                    const double median = std::max(std::min(channels[0], channels[1]), std::min(std::max(channels[0], channels[1]), channels[2]));
+                    const double inside = winding(edges, point) != 0 ? 1.0 : -1.0;
+                    if ((median > 0.0) != (inside > 0.0))
+                    {
+                        channels[0] = channels[1] = channels[2] = std::abs(closestAll.distance) * inside;
+                    }
+
+                    uint32_t pixel = 0xff000000u;
+                    for (int channel = 0; channel < 3; ++channel)
+                    {
+                        const double value = std::min(std::max(channels[channel] * scale / range + 0.5, 0.0), 1.0);
+                        pixel |= uint32_t(std::lround(value * 255.0)) << (channel * 8);
+                    }
+                    result->pixels[size_t(y) * width + x] = pixel;
+                }
+            }
+
+            const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->finished.push_back(std::move(result));
+            queue->rasterTime += milliseconds;
+        });
+    }
+
+    float GlyphAtlas::getKerning(uint32_t font, uint32_t left, uint32_t right)
+    {
+        if (font >= mFonts.size())
+        {
+            return 0.0f;
+        }
+
+        const uint64_t key = (uint64_t(font) << 48) ^ (uint64_t(left) << 24) ^ right;
+        auto it = mKerning.find(key);
+        if (it != mKerning.end())
+        {
+            return it->second;
+        }
+
+        const FontData& data = *mFonts[font];
+        const float kerning = float(stbtt_GetCodepointKernAdvance(&data.info, int(left), int(right))) * data.unitScale;
+        mKerning.emplace(key, kerning);
+        return kerning;
+    }
+
+    float GlyphAtlas::getLineHeight(uint32_t font) const
+    {
+        return font < mFonts.size() ? mFonts[font]->lineHeight : 0.0f;
+    }
+
+    void GlyphAtlas::update()
+    {
+        if (mId == 0)
+        {
+            return;
+        }
+
+        ++mFrame;
+
+        std::vector<std::unique_ptr<RasterizedGlyph>> finished;
+        {
+            std::lock_guard<std::mutex> lock(mQueue->mutex);
+            finished.swap(mQueue->finished);
+            mStats.rasterTime += mQueue->rasterTime;
+            mQueue->rasterTime = 0.0;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        for (size_t i = 0; i < finished.size(); ++i)
+        {
+            RasterizedGlyph& raster = *finished[i];
+            auto it = mGlyphs.find(raster.key);
+            Glyph& glyph = it->second;
+
+            const uint32_t cell = allocateCell(glyph.bucket);
+            if (cell == ~0u)
+            {
+                // every cell of this size was used in the previous frame, try again next frame
+                std::lock_guard<std::mutex> lock(mQueue->mutex);
+                for (size_t j = i; j < finished.size(); ++j)
+                {
+                    mQueue->finished.push_back(std::move(finished[j]));
+                }
+                break;
+            }
+
+            Cell& slot = mCells[cell];
+            slot.glyph = &glyph;
+            glTextureSubImage2D(mId, 0, GLint(slot.x), GLint(slot.y), GLsizei(raster.width), GLsizei(raster.height), GL_RGBA, GL_UNSIGNED_BYTE, raster.pixels.data());
+
+            glyph.texels = glm::vec4(float(slot.x), float(slot.y), float(slot.x + raster.width), float(slot.y + raster.height));
+            glyph.cell = cell;
+            glyph.resident = true;
+            glyph.pending = false;
+            --mPending;
+
+            ++mStats.residentGlyphs;
+            ++mStats.rasterizedGlyphs;
+        }
+
+        mStats.pendingGlyphs = mPending;
+        mStats.atlasHeight = mHeight;
+    }
+
+    uint32_t GlyphAtlas::allocateCell(uint32_t bucket)
+    {
+        std::vector<uint32_t>& freeCells = mFreeCells[bucket];
+        if (!freeCells.empty())
+        {
+            const uint32_t cell = freeCells.back();
+            freeCells.pop_back();
+            return cell;
+        }
+
+        const uint32_t size = getCellSize(bucket);
+        for (;;)
+        {
+            for (Shelf& shelf : mShelves)
+            {
+                if (shelf.bucket == bucket && shelf.nextX + size <= mSettings.width)
+                {
+                    mCells.push_back({ shelf.nextX, shelf.y, bucket, nullptr });
+                    shelf.nextX += size;
+                    return uint32_t(mCells.size() - 1);
+                }
+            }
+
+            if (mShelfEnd + size <= mHeight)
+            {
+                mShelves.push_back({ mShelfEnd, bucket, 0 });
+                mShelfEnd += size;
+                continue;
+            }
+
+            if (!grow())
+            {
+                break;
+            }
+        }
+
+        // the atlas is full, reuse the least recently used cell of the bucket that wasn't drawn in the last frame
+        uint32_t oldest = ~0u;
+        for (uint32_t i = 0; i < uint32_t(mCells.size()); ++i)
+        {
+            const Cell& cell = mCells[i];
+            if (cell.bucket == bucket && cell.glyph != nullptr && cell.glyph->lastUsedFrame + 1 < mFrame &&
+                (oldest == ~0u || cell.glyph->lastUsedFrame < mCells[oldest].glyph->lastUsedFrame))
+            {
+                oldest = i;
+            }
+        }
+
+        if (oldest != ~0u)
+        {
+            Glyph& evicted = *mCells[oldest].glyph;
+            evicted.resident = false;
+            evicted.cell = ~0u;
+            evicted.texels = glm::vec4(0.0f, 0.0f, evicted.texels.z - evicted.texels.x, evicted.texels.w - evicted.texels.y);
+            mCells[oldest].glyph = nullptr;
+
+            --mStats.residentGlyphs;
+            ++mStats.evictedGlyphs;
+        }
+        return oldest;
+    }
+
+    bool GlyphAtlas::grow()
+    {
+        if (mHeight >= mSettings.maxHeight)
+        {
+            return false;
+        }
+
+        const uint32_t height = std::min(mHeight * 2, mSettings.maxHeight);
+
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, 1, GL_RGBA8, GLsizei(mSettings.width), GLsizei(height));
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // texel coordinates don't change, the renderer normalizes with the current size
+        glCopyImageSubData(mId, GL_TEXTURE_2D, 0, 0, 0, 0, texture, GL_TEXTURE_2D, 0, 0, 0, 0, GLsizei(mSettings.width), GLsizei(mHeight), 1);
+        glDeleteTextures(1, &mId);
+
+        mId = texture;
+        mHeight = height;
+        return true;
+    }
+}
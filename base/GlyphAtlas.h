@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace utils
+{
+    struct GlyphAtlasSettings
+    {
+        // the atlas grows in height by doubling, glyphs are evicted least recently used first once it is full
+        uint32_t width = 1024;
+        uint32_t initialHeight = 256;
+        uint32_t maxHeight = 4096;
+
+        // width of the encoded distance band in texels
+        float distanceRange = 4.0f;
+
+        // glyphs are rasterized once per power of two size bucket between these pixel heights
+        uint32_t minBucket = 16;
+        uint32_t maxBucket = 64;
+
+        uint32_t maxPendingGlyphs = 256;
+    };
+
+    struct GlyphAtlasStats
+    {
+        uint32_t residentGlyphs = 0;
+        uint32_t pendingGlyphs = 0;
+        uint32_t atlasHeight = 0;
+
+        uint64_t rasterizedGlyphs = 0;
+        uint64_t evictedGlyphs = 0;
+
+        // worker milliseconds spent generating distance fields, summed over all threads
+        double rasterTime = 0.0;
+    };
+
+    // metrics are in units of the font size, with y pointing down from the baseline
+    struct Glyph
+    {
+        float advance = 0.0f;
+
+        // left, top, right, bottom of the quad around the pen position
+        glm::vec4 plane = glm::vec4(0.0f);
+
+        // texel rectangle in the atlas, valid while resident
+        glm::vec4 texels = glm::vec4(0.0f);
+
+        // atlas texels per unit of font size, converts the distance range into screen pixels
+        float texelScale = 0.0f;
+
+        bool empty = false;
+        bool resident = false;
+        bool pending = false;
+
+        uint32_t bucket = 0;
+        uint32_t cell = ~0u;
+        uint64_t key = 0;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    // Multi-channel signed distance field glyphs of TrueType fonts, generated on worker threads. Glyphs are cached
+    // per (font, codepoint, size bucket), rasterized into fixed cells of a single RGBA8 texture and evicted in LRU
+    // order when the atlas can't grow anymore. Missing glyphs are requested on first use and show up once a later
+    // update uploaded them, their metrics are available right away so layout doesn't change.
+    class GlyphAtlas
+    {
+    public:
+        GlyphAtlas() = default;
+        ~GlyphAtlas();
+
+        GlyphAtlas(const GlyphAtlas&) = delete;
+        GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+        bool init(const GlyphAtlasSettings& settings = GlyphAtlasSettings());
+        void destroy();
+
+        // returns the font index, or ~0u if the file can't be loaded
+        uint32_t loadFont(const std::string& filename);
+
+        // nullptr if the font doesn't map the codepoint, otherwise the glyph of the bucket matching size
+        const Glyph* getGlyph(uint32_t font, uint32_t codepoint, float size);
+
+        // kerning between two codepoints and the line advance, in units of the font size
+        float getKerning(uint32_t font, uint32_t left, uint32_t right);
+        float getLineHeight(uint32_t font) const;
+
+        // uploads finished glyphs and starts a new frame for the LRU, call once per frame before laying out text
+        void update();
+
+        void bind(uint32_t slot) const { glBindTextureUnit(slot, mId); }
+
+        GLuint getId() const { return mId; }
+        float getDistanceRange() const { return mSettings.distanceRange; }
+        const GlyphAtlasStats& getStats() const { return mStats; }
+
+    private:
+        struct FontData;
+        struct RasterizedGlyph;
+
+        // shared with the raster jobs, so they can finish after the atlas was destroyed
+        struct RasterQueue
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<RasterizedGlyph>> finished;
+            double rasterTime = 0.0;
+        };
+
+        struct Shelf
+        {
+            uint32_t y;
+            uint32_t bucket;
+            uint32_t nextX;
+        };
+
+        struct Cell
+        {
+            uint32_t x;
+            uint32_t y;
+            uint32_t bucket;
+            Glyph* glyph;
+        };
+
+        static constexpr uint32_t kMaxBuckets = 8;
+        static constexpr uint32_t kAsciiCount = 128;
+
+        uint32_t getBucket(float size) const;
+        uint32_t getCellSize(uint32_t bucket) const;
+
+        Glyph* createGlyph(uint32_t font, uint32_t codepoint, uint32_t bucket, uint64_t key);
+        void requestGlyph(uint32_t font, Glyph& glyph, uint32_t codepoint);
+
+        uint32_t allocateCell(uint32_t bucket);
+        bool grow();
+
+        GlyphAtlasSettings mSettings;
+        GLuint mId = 0;
+        uint32_t mHeight = 0;
+        uint32_t mShelfEnd = 0;
+
+        std::vector<std::shared_ptr<FontData>> mFonts;
+        std::unordered_map<uint64_t, Glyph> mGlyphs;
+        std::unordered_map<uint64_t, float> mKerning;
+
+        // ASCII lookups skip the hash map, indexed by font, bucket and codepoint
+        std::vector<Glyph*> mAscii;
+
+        std::vector<Shelf> mShelves;
+        std::vector<Cell> mCells;
+        std::vector<uint32_t> mFreeCells[kMaxBuckets];
+
+        std::shared_ptr<RasterQueue> mQueue;
+        uint32_t mPending = 0;
+        uint64_t mFrame = 0;
+
+        GlyphAtlasStats mStats;
+    };
+}
@@ -0,0 +1,243 @@
+#include "GpuResidency.h"
+
+#include <algorithm>
+
+#include "Profiler.h"
+
+namespace utils
+{
+    GpuResidency& GpuResidency::global()
+    {
+        static GpuResidency residency;
+        return residency;
+    }
+
+    GpuResidency::ResourceId GpuResidency::add(GpuMemoryCategory category, uint64_t bytes, const GpuResidencyCallbacks& callbacks, uint32_t mipLevels)
+    {
+        ResourceId id;
+        if (mFreeIds.empty())
+        {
+            id = ResourceId(mResources.size());
+            mResources.emplace_back();
+        }
+        else
+        {
+            id = mFreeIds.back();
+            mFreeIds.pop_back();
+        }
+
+        Resource& resource = mResources[id];
+        resource = Resource();
+        resource.callbacks = callbacks;
+        resource.category = category;
+        resource.mipLevels = std::max(mipLevels, 1u);
+        resource.lastUsedFrame = mFrame;
+        resource.alive = true;
+        setBytes(resource, bytes);
+        ++mStats.resources;
+        return id;
+    }
+
+    void GpuResidency::remove(ResourceId id)
+    {
+        if (id >= mResources.size() || !mResources[id].alive)
+        {
+            return;
+        }
+
+        Resource& resource = mResources[id];
+        setBytes(resource, 0);
+        resource.callbacks = GpuResidencyCallbacks();
+        resource.alive = false;
+        mFreeIds.push_back(id);
+        --mStats.resources;
+    }
+
+    void GpuResidency::resize(ResourceId id, uint64_t bytes)
+    {
+        if (id < mResources.size() && mResources[id].alive && mResources[id].resident)
+        {
+            setBytes(mResources[id], bytes);
+        }
+    }
+
+    void GpuResidency::touch(ResourceId id)
+    {
+        if (id >= mResources.size() || !mResources[id].alive)
+        {
+            return;
+        }
+
+        Resource& resource = mResources[id];
+        const bool firstTouch = resource.lastUsedFrame != mFrame;
+        resource.lastUsedFrame = mFrame;
+        if (!resource.callbacks.restream)
+        {
+            return;
+        }
+
+        if (!resource.resident)
+        {
+            restream(resource, resource.droppedMips);
+            resource.resident = true;
+        }
+        else if (firstTouch && resource.droppedMips > 0 && hasRoom(resource.category, resource.bytes * 3))
+        {
+            // the next level up is four times the current top, so the chain grows to about four times its size.
+            // Without room it would only be trimmed again at the end of the frame
+            restream(resource, resource.droppedMips - 1);
+        }
+    }
+
+    bool GpuResidency::isResident(ResourceId id) const
+    {
+        return id < mResources.size() && mResources[id].alive && mResources[id].resident;
+    }
+
+    uint32_t GpuResidency::getDroppedMips(ResourceId id) const
+    {
+        return id < mResources.size() ? mResources[id].droppedMips : 0;
+    }
+
+    void GpuResidency::setBudget(GpuMemoryCategory category, uint64_t bytes)
+    {
+        mStats.budgets[category] = bytes;
+    }
+
+    void GpuResidency::setTotalBudget(uint64_t bytes)
+    {
+        mStats.totalBudget = bytes;
+    }
+
+    void GpuResidency::beginFrame()
+    {
+        ++mFrame;
+        mStats.evictions = 0;
+        mStats.mipDrops = 0;
+        mStats.restreams = 0;
+        mStats.evictedBytes = 0;
+        mStats.restreamedBytes = 0;
+    }
+
+    void GpuResidency::endFrame()
+    {
+        bool overBudget = false;
+        for (uint32_t category = 0; category < GPU_MEMORY_CATEGORY_COUNT; ++category)
+        {
+            overBudget = overBudget || isOverBudget(GpuMemoryCategory(category));
+        }
+
+        if (overBudget)
+        {
+            // oldest first, ties in id order so eviction is deterministic
+            mCandidates.clear();
+            for (ResourceId id = 0; id < mResources.size(); ++id)
+            {
+                if (isEvictable(mResources[id]))
+                {
+                    mCandidates.push_back(id);
+                }
+            }
+            std::sort(mCandidates.begin(), mCandidates.end(), [this](ResourceId a, ResourceId b)
+            {
+                return mResources[a].lastUsedFrame != mResources[b].lastUsedFrame ? mResources[a].lastUsedFrame < mResources[b].lastUsedFrame : a < b;
+            });
+
+            // dropping top mips keeps a blurry texture around and frees 3/4 of it per level, so that goes first
+            for (ResourceId id : mCandidates)
+            {
+                Resource& resource = mResources[id];
+                while (isOverBudget(resource.category) && resource.droppedMips < mMaxDroppedMips && resource.droppedMips + 1 < resource.mipLevels)
+                {
+                    trim(resource);
+                }
+            }
+
+            for (ResourceId id : mCandidates)
+            {
+                Resource& resource = mResources[id];
+                if (isOverBudget(resource.category))
+                {
+                    evict(resource);
+                }
+            }
+        }
+
+        mStats.evictedResources = 0;
+        mStats.trimmedResources = 0;
+        for (const Resource& resource : mResources)
+        {
+            mStats.evictedResources += resource.alive && !resource.resident ? 1 : 0;
+            mStats.trimmedResources += resource.alive && resource.resident && resource.droppedMips > 0 ? 1 : 0;
+        }
+
+        mStats.overBudget = false;
+        for (uint32_t category = 0; category < GPU_MEMORY_CATEGORY_COUNT; ++category)
+        {
+            mStats.overBudget = mStats.overBudget || isOverBudget(GpuMemoryCategory(category));
+        }
+    }
+
+    void GpuResidency::report(Profiler& profiler) const
+    {
+        profiler.setCounter("gpu memory: vertex buffers", double(mStats.bytes[GPU_MEMORY_VERTEX_BUFFER]));
+        profiler.setCounter("gpu memory: index buffers", double(mStats.bytes[GPU_MEMORY_INDEX_BUFFER]));
+        profiler.setCounter("gpu memory: textures", double(mStats.bytes[GPU_MEMORY_TEXTURE]));
+        profiler.setCounter("gpu memory: total", double(mStats.totalBytes));
+        profiler.setCounter("gpu memory: peak", double(mStats.peakBytes));
+        profiler.setCounter("gpu memory: evicted resources", double(mStats.evictedResources));
+        profiler.setCounter("gpu memory: restreams", double(mStats.restreams));
+    }
+
+    bool GpuResidency::isOverBudget(GpuMemoryCategory category) const
+    {
+        return (mStats.budgets[category] != 0 && mStats.bytes[category] > mStats.budgets[category])
+            || (mStats.totalBudget != 0 && mStats.totalBytes > mStats.totalBudget);
+    }
+
+    bool GpuResidency::hasRoom(GpuMemoryCategory category, uint64_t bytes) const
+    {
+        return (mStats.budgets[category] == 0 || mStats.bytes[category] + bytes <= mStats.budgets[category])
+            && (mStats.totalBudget == 0 || mStats.totalBytes + bytes <= mStats.totalBudget);
+    }
+
+    bool GpuResidency::isEvictable(const Resource& resource) const
+    {
+        return resource.alive && resource.resident && resource.lastUsedFrame < mFrame && resource.callbacks.evict && resource.callbacks.restream;
+    }
+
+    void GpuResidency::setBytes(Resource& resource, uint64_t bytes)
+    {
+        mStats.bytes[resource.category] = mStats.bytes[resource.category] - resource.bytes + bytes;
+        mStats.totalBytes = mStats.totalBytes - resource.bytes + bytes;
+        mStats.peakBytes = std::max(mStats.peakBytes, mStats.totalBytes);
+        resource.bytes = bytes;
+    }
+
+    void GpuResidency::trim(Resource& resource)
+    {
+        const uint64_t before = resource.bytes;
+        setBytes(resource, resource.callbacks.restream(resource.droppedMips + 1));
+        ++resource.droppedMips;
+        ++mStats.mipDrops;
+        mStats.evictedBytes += before > resource.bytes ? before - resource.bytes : 0;
+    }
+
+    void GpuResidency::restream(Resource& resource, uint32_t droppedMips)
+    {
+        const uint64_t before = resource.bytes;
+        setBytes(resource, resource.callbacks.restream(droppedMips));
+        resource.droppedMips = droppedMips;
+        ++mStats.restreams;
+        mStats.restreamedBytes += resource.bytes > before ? resource.bytes - before : 0;
+    }
+
+    void GpuResidency::evict(Resource& resource)
+    {
+        mStats.evictedBytes += resource.bytes;
+        ++mStats.evictions;
+        resource.callbacks.evict();
+        setBytes(resource, 0);
+        resource.resident = false;
+    }
+}
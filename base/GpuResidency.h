@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace utils
+{
+    class Profiler;
+
+    enum GpuMemoryCategory : uint32_t
+    {
+        GPU_MEMORY_VERTEX_BUFFER,
+        GPU_MEMORY_INDEX_BUFFER,
+        GPU_MEMORY_TEXTURE,
+        GPU_MEMORY_CATEGORY_COUNT,
+    };
+
+    struct GpuResidencyStats
+    {
+        // resident bytes and budgets per category, a budget of 0 is unlimited
+        uint64_t bytes[GPU_MEMORY_CATEGORY_COUNT] = {};
+        uint64_t budgets[GPU_MEMORY_CATEGORY_COUNT] = {};
+        uint64_t totalBytes = 0;
+        uint64_t totalBudget = 0;
+        uint64_t peakBytes = 0;
+
+        uint32_t resources = 0;
+        uint32_t evictedResources = 0;
+        uint32_t trimmedResources = 0;
+
+        // since the last beginFrame
+        uint32_t evictions = 0;
+        uint32_t mipDrops = 0;
+        uint32_t restreams = 0;
+        uint64_t evictedBytes = 0;
+        uint64_t restreamedBytes = 0;
+
+        // budgets that could not be met because everything left was used this frame
+        bool overBudget = false;
+    };
+
+    // how a resource gives memory back and gets it again, both run on the GL thread
+    struct GpuResidencyCallbacks
+    {
+        // frees the storage but keeps the GL name, so VAOs and anything holding the name stay valid
+        std::function<void()> evict;
+
+        // (re)creates the storage with the top droppedMips levels missing and returns its size in bytes. Called
+        // with one level more or less than what is resident for mip drops and restores, only after an eviction
+        // with nothing resident
+        std::function<uint64_t(uint32_t droppedMips)> restream;
+    };
+
+    // Accounts GPU memory per resource and category and keeps it under budget. Resources report their use
+    // with touch() when they are bound or drawn. endFrame() evicts the least recently used resources of the
+    // categories over budget, textures lose their top mips one at a time first. touch() streams an evicted
+    // resource back in with the mips it had and gives a trimmed one a level back per frame while its budget
+    // has room for it. Not thread safe, everything runs on the GL thread.
+    class GpuResidency
+    {
+    public:
+        using ResourceId = uint32_t;
+        static constexpr ResourceId kInvalidResource = ~0u;
+
+        // VertexBuffer, IndexBuffer and Texture2D register here
+        static GpuResidency& global();
+
+        GpuResidency() = default;
+
+        GpuResidency(const GpuResidency&) = delete;
+        GpuResidency& operator=(const GpuResidency&) = delete;
+
+        // resources without callbacks are accounted but never evicted. mipLevels > 1 allows dropping top mips
+        // down to maxDroppedMips before the whole resource goes
+        ResourceId add(GpuMemoryCategory category, uint64_t bytes, const GpuResidencyCallbacks& callbacks = GpuResidencyCallbacks(), uint32_t mipLevels = 1);
+        void remove(ResourceId id);
+
+        // storage was reallocated outside the manager, e.g. a buffer grown by the owner
+        void resize(ResourceId id, uint64_t bytes);
+
+        // marks the resource as used this frame, restreams it when it was evicted and restores a mip when it was trimmed
+        void touch(ResourceId id);
+
+        bool isResident(ResourceId id) const;
+        uint32_t getDroppedMips(ResourceId id) const;
+
+        void setBudget(GpuMemoryCategory category, uint64_t bytes);
+        void setTotalBudget(uint64_t bytes);
+        void setMaxDroppedMips(uint32_t count) { mMaxDroppedMips = count; }
+
+        // resets the per frame counters
+        void beginFrame();
+
+        // evicts until all budgets are met, resources touched this frame are never evicted
+        void endFrame();
+
+        const GpuResidencyStats& getStats() const { return mStats; }
+
+        // resident bytes per category and totals as profiler counters
+        void report(Profiler& profiler) const;
+
+    private:
+        struct Resource
+        {
+            GpuResidencyCallbacks callbacks;
+            uint64_t bytes = 0;
+            uint64_t lastUsedFrame = 0;
+            GpuMemoryCategory category = GPU_MEMORY_VERTEX_BUFFER;
+            uint32_t mipLevels = 1;
+            uint32_t droppedMips = 0;
+            bool resident = true;
+            bool alive = false;
+        };
+
+        bool isOverBudget(GpuMemoryCategory category) const;
+        bool hasRoom(GpuMemoryCategory category, uint64_t bytes) const;
+        bool isEvictable(const Resource& resource) const;
+        void setBytes(Resource& resource, uint64_t bytes);
+        void trim(Resource& resource);
+        void restream(Resource& resource, uint32_t droppedMips);
+        void evict(Resource& resource);
+
+        std::vector<Resource> mResources;
+        std::vector<ResourceId> mFreeIds;
+        std::vector<ResourceId> mCandidates;
+        uint64_t mFrame = 1;
+        uint32_t mMaxDroppedMips = 2;
+
+        GpuResidencyStats mStats;
+    };
+}
@@ -3,6 +3,7 @@
 #include <cstdint>
 
 #include <limits>
+#include <type_traits>
 
 class HandleBase {
 public:
@@ -30,10 +31,7 @@ public:
     HandleId getId() const noexcept { return object; }
 
     // initialize a handle, for internal use only.
-    //explicit HandleBase(HandleId id) noexcept : object(id) 
-    //{
-    //   assert_invariant(object != nullid); // usually means an uninitialized handle is used
-    //}
+    explicit HandleBase(HandleId id) noexcept : object(id) {}
 
 protected:
     HandleBase(HandleBase const& rhs) noexcept = default;
@@ -49,7 +47,7 @@ class Handle : public HandleBase
 public:
     Handle() noexcept = default;
     Handle(const Handle& rhs) noexcept = default;
-    Hanlde& operator=(const Handle& rhs) noexcept = default;
+    Handle& operator=(const Handle& rhs) noexcept = default;
     explicit Handle(HandleId id) noexcept : HandleBase(id) {}
 
     template<typename B, typename = std::enable_if_t<std::is_base_of<T, B>::value> >
@@ -0,0 +1,733 @@
+#include "ImageFilters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define FILTERS_X86 1
+#include <immintrin.h>
+#endif
+
+// kernels are compiled for their instruction set individually and selected at runtime
+#if defined(FILTERS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace utils
+{
+namespace filters
+{
+    namespace
+    {
+        constexpr uint32_t kTileRows = 32;
+
+        // GLSL: color.r*0.299 + color.g*0.587 + color.b*0.114
+        constexpr float kLumaR = 0.299f;
+        constexpr float kLumaG = 0.587f;
+        constexpr float kLumaB = 0.114f;
+
+        // texture fetches normalize unorm8 with a multiply by the reciprocal, dividing instead rounds exact
+        // .5 luminance ties the other way
+        constexpr float kUnormScale = 1.0f / 255.0f;
+
+        // every path rounds half to even like the float to unorm conversion on the GPU and saturates, so all
+        // levels produce identical bytes. The SIMD paths rely on the default MXCSR rounding mode
+        inline uint8_t toByte(float value)
+        {
+            const int i = int(std::lrint(value));
+            return uint8_t(std::min(std::max(i, 0), 255));
+        }
+
+        struct Kernels
+        {
+            void (*luminanceRow)(const uint8_t* src, uint8_t* dst, uint32_t width);
+            void (*colorMatrixRow)(const uint8_t* src, uint8_t* dst, uint32_t width, const float* matrix);
+            void (*horizontalRow)(const uint8_t* src, float* dst, uint32_t width, const float* weights, uint32_t radius);
+            void (*verticalRow)(const float* const* rows, uint8_t* dst, uint32_t count, const float* weights, uint32_t taps);
+            void (*combineRow)(const uint8_t* src, const uint8_t* blurred, uint8_t* dst, uint32_t width, float amount, float threshold);
+        };
+
+        // ------------------------------------------------------------------------
+        // scalar reference
+
+        inline void luminancePixel(const uint8_t* src, uint8_t* dst)
+        {
+            const float r = src[0] * kUnormScale;
+            const float g = src[1] * kUnormScale;
+            const float b = src[2] * kUnormScale;
+            const float grey = r * kLumaR + g * kLumaG + b * kLumaB;
+            const uint8_t value = toByte(grey * 255.0f);
+            dst[0] = value;
+            dst[1] = value;
+            dst[2] = value;
+            dst[3] = 255;
+        }
+
+        inline void colorMatrixPixel(const uint8_t* src, uint8_t* dst, const float* m)
+        {
+            const float r = src[0] * kUnormScale;
+            const float g = src[1] * kUnormScale;
+            const float b = src[2] * kUnormScale;
+            const float a = src[3] * kUnormScale;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                const float value = m[0 + i] * r + m[4 + i] * g + m[8 + i] * b + m[12 + i] * a;
+                dst[i] = toByte(value * 255.0f);
+            }
+        }
+
+        inline void horizontalPixel(const uint8_t* src, float* dst, int x, int width, const float* weights, int radius)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                float sum = 0.0f;
+                for (int k = -radius; k <= radius; ++k)
+                {
+                    const int sx = std::min(std::max(x + k, 0), width - 1);
+                    sum += weights[k + radius] * float(src[sx * 4 + c]);
+                }
+                dst[x * 4 + c] = sum;
+            }
+        }
+
+        inline void verticalValue(const float* const* rows, uint8_t* dst, uint32_t i, const float* weights, uint32_t taps)
+        {
+            float sum = 0.0f;
+            for (uint32_t k = 0; k < taps; ++k)
+            {
+                sum += weights[k] * rows[k][i];
+            }
+            dst[i] = toByte(sum);
+        }
+
+        inline void combinePixel(const uint8_t* src, const uint8_t* blurred, uint8_t* dst, float amount, float threshold)
+        {
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                const float s = float(src[c]);
+                const float d = s - float(blurred[c]);
+                dst[c] = std::fabs(d) < threshold ? src[c] : toByte(s + amount * d);
+            }
+            dst[3] = src[3];
+        }
+
+        void luminanceRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                luminancePixel(src + x * 4, dst + x * 4);
+            }
+        }
+
+        void colorMatrixRowScalar(const uint8_t* src, uint8_t* dst, uint32_t width, const float* matrix)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                colorMatrixPixel(src + x * 4, dst + x * 4, matrix);
+            }
+        }
+
+        void horizontalRowScalar(const uint8_t* src, float* dst, uint32_t width, const float* weights, uint32_t radius)
+        {
+            for (int x = 0; x < int(width); ++x)
+            {
+                horizontalPixel(src, dst, x, int(width), weights, int(radius));
+            }
+        }
+
+        void verticalRowScalar(const float* const* rows, uint8_t* dst, uint32_t count, const float* weights, uint32_t taps)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                verticalValue(rows, dst, i, weights, taps);
+            }
+        }
+
+        void combineRowScalar(const uint8_t* src, const uint8_t* blurred, uint8_t* dst, uint32_t width, float amount, float threshold)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                combinePixel(src + x * 4, blurred + x * 4, dst + x * 4, amount, threshold);
+            }
+        }
+
+        const Kernels kScalarKernels = { luminanceRowScalar, colorMatrixRowScalar, horizontalRowScalar, verticalRowScalar, combineRowScalar };
+
+#if defined(FILTERS_X86)
+        // ------------------------------------------------------------------------
+        // SSE4.1
+
+        TARGET_SSE41 inline __m128 loadPixelSse(const uint8_t* src)
+        {
+            int32_t packed;
+            std::memcpy(&packed, src, sizeof(packed));
+            return _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed)));
+        }
+
+        TARGET_SSE41 inline __m128i roundSse(__m128 value)
+        {
+            return _mm_cvtps_epi32(value);
+        }
+
+        TARGET_SSE41 void luminanceRowSse41(const uint8_t* src, uint8_t* dst, uint32_t width)
+        {
+            const __m128i mask = _mm_set1_epi32(0xff);
+            const __m128i alpha = _mm_set1_epi32(int32_t(0xff000000));
+            const __m128 scale = _mm_set1_ps(255.0f);
+            const __m128 unorm = _mm_set1_ps(kUnormScale);
+            const __m128 wr = _mm_set1_ps(kLumaR);
+            const __m128 wg = _mm_set1_ps(kLumaG);
+            const __m128 wb = _mm_set1_ps(kLumaB);
+
+            uint32_t x = 0;
+            for (; x + 4 <= width; x += 4)
+            {
+                const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+                const __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(px, mask)), unorm);
+                const __m128 g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask)), unorm);
+                const __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask)), unorm);
+                const __m128 grey = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, wr), _mm_mul_ps(g, wg)), _mm_mul_ps(b, wb));
+
+                __m128i v = roundSse(_mm_mul_ps(grey, scale));
+                v = _mm_min_epi32(_mm_max_epi32(v, _mm_setzero_si128()), mask);
+                v = _mm_or_si128(_mm_or_si128(v, _mm_slli_epi32(v, 8)), _mm_or_si128(_mm_slli_epi32(v, 16), alpha));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), v);
+            }
+
+            luminanceRowScalar(src + x * 4, dst + x * 4, width - x);
+        }
+
+        TARGET_SSE41 void colorMatrixRowSse41(const uint8_t* src, uint8_t* dst, uint32_t width, const float* matrix)
+        {
+            const __m128 c0 = _mm_loadu_ps(matrix + 0);
+            const __m128 c1 = _mm_loadu_ps(matrix + 4);
+            const __m128 c2 = _mm_loadu_ps(matrix + 8);
+            const __m128 c3 = _mm_loadu_ps(matrix + 12);
+            const __m128 scale = _mm_set1_ps(255.0f);
+            const __m128 unorm = _mm_set1_ps(kUnormScale);
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const __m128 color = _mm_mul_ps(loadPixelSse(src + x * 4), unorm);
+                __m128 value = _mm_mul_ps(c0, _mm_shuffle_ps(color, color, _MM_SHUFFLE(0, 0, 0, 0)));
+                value = _mm_add_ps(value, _mm_mul_ps(c1, _mm_shuffle_ps(color, color, _MM_SHUFFLE(1, 1, 1, 1))));
+                value = _mm_add_ps(value, _mm_mul_ps(c2, _mm_shuffle_ps(color, color, _MM_SHUFFLE(2, 2, 2, 2))));
+                value = _mm_add_ps(value, _mm_mul_ps(c3, _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3))));
+
+                const __m128i v = roundSse(_mm_mul_ps(value, scale));
+                const __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(v, v), _mm_setzero_si128());
+                const int32_t packed = _mm_cvtsi128_si32(bytes);
+                std::memcpy(dst + x * 4, &packed, sizeof(packed));
+            }
+        }
+
+        TARGET_SSE41 void horizontalRowSse41(const uint8_t* src, float* dst, uint32_t width, const float* weights, uint32_t radius)
+        {
+            const int w = int(width);
+            const int r = int(radius);
+            const int interiorEnd = w - r;
+
+            int x = 0;
+            for (; x < std::min(r, w); ++x)
+            {
+                horizontalPixel(src, dst, x, w, weights, r);
+            }
+
+            for (; x < interiorEnd; ++x)
+            {
+                const uint8_t* base = src + (x - r) * 4;
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k <= 2 * r; ++k)
+                {
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), loadPixelSse(base + k * 4)));
+                }
+                _mm_storeu_ps(dst + x * 4, sum);
+            }
+
+            for (; x < w; ++x)
+            {
+                horizontalPixel(src, dst, x, w, weights, r);
+            }
+        }
+
+        TARGET_SSE41 void verticalRowSse41(const float* const* rows, uint8_t* dst, uint32_t count, const float* weights, uint32_t taps)
+        {
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128 lo = _mm_setzero_ps();
+                __m128 hi = _mm_setzero_ps();
+                for (uint32_t k = 0; k < taps; ++k)
+                {
+                    const __m128 weight = _mm_set1_ps(weights[k]);
+                    lo = _mm_add_ps(lo, _mm_mul_ps(weight, _mm_loadu_ps(rows[k] + i)));
+                    hi = _mm_add_ps(hi, _mm_mul_ps(weight, _mm_loadu_ps(rows[k] + i + 4)));
+                }
+                const __m128i words = _mm_packus_epi32(roundSse(lo), roundSse(hi));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+            }
+
+            for (; i < count; ++i)
+            {
+                verticalValue(rows, dst, i, weights, taps);
+            }
+        }
+
+        TARGET_SSE41 void combineRowSse41(const uint8_t* src, const uint8_t* blurred, uint8_t* dst, uint32_t width, float amount, float threshold)
+        {
+            const __m128 amountV = _mm_set1_ps(amount);
+            const __m128 thresholdV = _mm_set1_ps(threshold);
+            const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+            const __m128i alphaMask = _mm_set1_epi32(int32_t(0xff000000));
+
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const __m128 s = loadPixelSse(src + x * 4);
+                const __m128 d = _mm_sub_ps(s, loadPixelSse(blurred + x * 4));
+                const __m128 sharpened = _mm_add_ps(s, _mm_mul_ps(amountV, d));
+                const __m128 keep = _mm_cmplt_ps(_mm_and_ps(d, absMask), thresholdV);
+                const __m128i v = roundSse(_mm_blendv_ps(sharpened, s, keep));
+
+                int32_t source;
+                std::memcpy(&source, src + x * 4, sizeof(source));
+
+                __m128i bytes = _mm_packus_epi16(_mm_packus_epi32(v, v), _mm_setzero_si128());
+                bytes = _mm_blendv_epi8(bytes, _mm_cvtsi32_si128(source), alphaMask);
+                const int32_t packed = _mm_cvtsi128_si32(bytes);
+                std::memcpy(dst + x * 4, &packed, sizeof(packed));
+            }
+        }
+
+        const Kernels kSse41Kernels = { luminanceRowSse41, colorMatrixRowSse41, horizontalRowSse41, verticalRowSse41, combineRowSse41 };
+
+        // ------------------------------------------------------------------------
+        // AVX2
+
+        TARGET_AVX2 inline __m256 loadPixelPairAvx2(const uint8_t* src)
+        {
+            return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src))));
+        }
+
+        TARGET_AVX2 inline __m256i roundAvx2(__m256 value)
+        {
+            return _mm256_cvtps_epi32(value);
+        }
+
+        // saturates eight 32 bit lanes to bytes
+        TARGET_AVX2 inline void storeBytesAvx2(uint8_t* dst, __m256i value)
+        {
+            const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(words, words));
+        }
+
+        TARGET_AVX2 void luminanceRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t width)
+        {
+            const __m256i mask = _mm256_set1_epi32(0xff);
+            const __m256i alpha = _mm256_set1_epi32(int32_t(0xff000000));
+            const __m256 scale = _mm256_set1_ps(255.0f);
+            const __m256 unorm = _mm256_set1_ps(kUnormScale);
+            const __m256 wr = _mm256_set1_ps(kLumaR);
+            const __m256 wg = _mm256_set1_ps(kLumaG);
+            const __m256 wb = _mm256_set1_ps(kLumaB);
+
+            uint32_t x = 0;
+            for (; x + 8 <= width; x += 8)
+            {
+                const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+                const __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, mask)), unorm);
+                const __m256 g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask)), unorm);
+                const __m256 b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask)), unorm);
+                const __m256 grey = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, wr), _mm256_mul_ps(g, wg)), _mm256_mul_ps(b, wb));
+
+                __m256i v = roundAvx2(_mm256_mul_ps(grey, scale));
+                v = _mm256_min_epi32(_mm256_max_epi32(v, _mm256_setzero_si256()), mask);
+                v = _mm256_or_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), _mm256_or_si256(_mm256_slli_epi32(v, 16), alpha));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), v);
+            }
+
+            luminanceRowSse41(src + x * 4, dst + x * 4, width - x);
+        }
+
+        TARGET_AVX2 void colorMatrixRowAvx2(const uint8_t* src, uint8_t* dst, uint32_t width, const float* matrix)
+        {
+            const __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(matrix + 0));
+            const __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(matrix + 4));
+            const __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(matrix + 8));
+            const __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(matrix + 12));
+            const __m256 scale = _mm256_set1_ps(255.0f);
+            const __m256 unorm = _mm256_set1_ps(kUnormScale);
+
+            uint32_t x = 0;
+            for (; x + 2 <= width; x += 2)
+            {
+                // one pixel per 128 bit lane
+                const __m256 color = _mm256_mul_ps(loadPixelPairAvx2(src + x * 4), unorm);
+                __m256 value = _mm256_mul_ps(c0, _mm256_shuffle_ps(color, color, _MM_SHUFFLE(0, 0, 0, 0)));
+                value = _mm256_add_ps(value, _mm256_mul_ps(c1, _mm256_shuffle_ps(color, color, _MM_SHUFFLE(1, 1, 1, 1))));
+                value = _mm256_add_ps(value, _mm256_mul_ps(c2, _mm256_shuffle_ps(color, color, _MM_SHUFFLE(2, 2, 2, 2))));
+                value = _mm256_add_ps(value, _mm256_mul_ps(c3, _mm256_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3))));
+
+                storeBytesAvx2(dst + x * 4, roundAvx2(_mm256_mul_ps(value, scale)));
+            }
+
+            colorMatrixRowSse41(src + x * 4, dst + x * 4, width - x, matrix);
+        }
+
+        TARGET_AVX2 void horizontalRowAvx2(const uint8_t* src, float* dst, uint32_t width, const float* weights, uint32_t radius)
+        {
+            const int w = int(width);
+            const int r = int(radius);
+            const int interiorEnd = w - r;
+
+            int x = 0;
+            for (; x < std::min(r, w); ++x)
+            {
+                horizontalPixel(src, dst, x, w, weights, r);
+            }
+
+            // two neighbouring pixels per iteration, both must stay inside the unclamped range
+            for (; x + 1 < interiorEnd; x += 2)
+            {
+                const uint8_t* base = src + (x - r) * 4;
+                __m256 sum = _mm256_setzero_ps();
+                for (int k = 0; k <= 2 * r; ++k)
+                {
+                    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), loadPixelPairAvx2(base + k * 4)));
+                }
+                _mm256_storeu_ps(dst + x * 4, sum);
+            }
+
+            for (; x < w; ++x)
+            {
+                horizontalPixel(src, dst, x, w, weights, r);
+            }
+        }
+
+        TARGET_AVX2 void verticalRowAvx2(const float* const* rows, uint8_t* dst, uint32_t count, const float* weights, uint32_t taps)
+        {
+            uint32_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m256 lo = _mm256_setzero_ps();
+                __m256 hi = _mm256_setzero_ps();
+                for (uint32_t k = 0; k < taps; ++k)
+                {
+                    const __m256 weight = _mm256_set1_ps(weights[k]);
+                    lo = _mm256_add_ps(lo, _mm256_mul_ps(weight, _mm256_loadu_ps(rows[k] + i)));
+                    hi = _mm256_add_ps(hi, _mm256_mul_ps(weight, _mm256_loadu_ps(rows[k] + i + 8)));
+                }
+                storeBytesAvx2(dst + i, roundAvx2(lo));
+                storeBytesAvx2(dst + i + 8, roundAvx2(hi));
+            }
+
+            for (; i < count; ++i)
+            {
+                verticalValue(rows, dst, i, weights, taps);
+            }
+        }
+
+        TARGET_AVX2 void combineRowAvx2(const uint8_t* src, const uint8_t* blurred, uint8_t* dst, uint32_t width, float amount, float threshold)
+        {
+            const __m256 amountV = _mm256_set1_ps(amount);
+            const __m256 thresholdV = _mm256_set1_ps(threshold);
+            const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+            const __m128i alphaMask = _mm_set1_epi32(int32_t(0xff000000));
+
+            uint32_t x = 0;
+            for (; x + 2 <= width; x += 2)
+            {
+                const __m256 s = loadPixelPairAvx2(src + x * 4);
+                const __m256 d = _mm256_sub_ps(s, loadPixelPairAvx2(blurred + x * 4));
+                const __m256 sharpened = _mm256_add_ps(s, _mm256_mul_ps(amountV, d));
+                const __m256 keep = _mm256_cmp_ps(_mm256_and_ps(d, absMask), thresholdV, _CMP_LT_OQ);
+                const __m256i v = roundAvx2(_mm256_blendv_ps(sharpened, s, keep));
+
+                const __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+                __m128i bytes = _mm_packus_epi16(words, words);
+                bytes = _mm_blendv_epi8(bytes, _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x * 4)), alphaMask);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x * 4), bytes);
+            }
+
+            combineRowSse41(src + x * 4, blurred + x * 4, dst + x * 4, width - x, amount, threshold);
+        }
+
+        const Kernels kAvx2Kernels = { luminanceRowAvx2, colorMatrixRowAvx2, horizontalRowAvx2, verticalRowAvx2, combineRowAvx2 };
+#endif
+
+        // ------------------------------------------------------------------------
+        // dispatch
+
+        SimdLevel gActiveLevel = getSupportedSimdLevel();
+
+        std::mutex gStatsMutex;
+        FilterStats gStats[KERNEL_COUNT];
+
+        const Kernels& getKernels()
+        {
+#if defined(FILTERS_X86)
+            switch (gActiveLevel)
+            {
+            case SimdLevel::SIMD_AVX2:
+                return kAvx2Kernels;
+            case SimdLevel::SIMD_SSE41:
+                return kSse41Kernels;
+            default:
+                break;
+            }
+#endif
+            return kScalarKernels;
+        }
+
+        class ScopedStats
+        {
+        public:
+            ScopedStats(FilterKernel kernel, const Image& image)
+                : mKernel(kernel), mPixels(uint64_t(image.mWidth) * image.mHeight), mStart(std::chrono::steady_clock::now())
+            {
+            }
+
+            ~ScopedStats()
+            {
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - mStart).count();
+                std::lock_guard<std::mutex> lock(gStatsMutex);
+                gStats[mKernel].invocations += 1;
+                gStats[mKernel].pixels += mPixels;
+                gStats[mKernel].seconds += seconds;
+            }
+
+        private:
+            FilterKernel mKernel;
+            uint64_t mPixels;
+            std::chrono::steady_clock::time_point mStart;
+        };
+
+        void prepareTarget(const Image& src, Image& dst)
+        {
+            if (dst.mData == nullptr || dst.mWidth != src.mWidth || dst.mHeight != src.mHeight)
+            {
+                dst.create(src.mWidth, src.mHeight);
+            }
+        }
+
+        // runs function(y0, y1) over horizontal bands of the image on the shared pool
+        template<typename Function>
+        void forEachTile(const Image& image, const Function& function)
+        {
+            const uint32_t height = uint32_t(image.mHeight);
+            const uint32_t tiles = (height + kTileRows - 1) / kTileRows;
+            ThreadPool::global().parallelFor(tiles, 1, [&](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t tile = begin; tile < end; ++tile)
+                {
+                    const uint32_t y0 = tile * kTileRows;
+                    function(y0, std::min(y0 + kTileRows, height));
+                }
+            });
+        }
+
+        void separableBlur(const Image& src, Image& dst, const std::vector<float>& weights)
+        {
+            prepareTarget(src, dst);
+
+            const Kernels& kernels = getKernels();
+            const uint32_t width = uint32_t(src.mWidth);
+            const int height = src.mHeight;
+            const uint32_t taps = uint32_t(weights.size());
+            const int radius = int(taps / 2);
+            const size_t rowFloats = size_t(width) * 4;
+
+            forEachTile(src, [&](uint32_t y0, uint32_t y1)
+            {
+                // horizontal pass over the band plus its vertical apron, kept per thread between tiles
+                thread_local std::vector<float> horizontal;
+                thread_local std::vector<const float*> rows;
+
+                const uint32_t bandRows = (y1 - y0) + 2 * radius;
+                horizontal.resize(bandRows * rowFloats);
+                rows.resize(taps);
+
+                for (uint32_t i = 0; i < bandRows; ++i)
+                {
+                    const int sy = std::min(std::max(int(y0) - radius + int(i), 0), height - 1);
+                    kernels.horizontalRow(src.mData + size_t(sy) * width * 4, horizontal.data() + i * rowFloats, width, weights.data(), radius);
+                }
+
+                for (uint32_t y = y0; y < y1; ++y)
+                {
+                    for (uint32_t k = 0; k < taps; ++k)
+                    {
+                        rows[k] = horizontal.data() + (y - y0 + k) * rowFloats;
+                    }
+                    kernels.verticalRow(rows.data(), dst.mData + size_t(y) * rowFloats, uint32_t(rowFloats), weights.data(), taps);
+                }
+            });
+        }
+
+        std::vector<float> makeGaussianWeights(float sigma)
+        {
+            sigma = std::max(sigma, 0.1f);
+            const int radius = std::max(1, int(std::ceil(sigma * 3.0f)));
+
+            std::vector<float> weights(2 * radius + 1);
+            float sum = 0.0f;
+            for (int i = -radius; i <= radius; ++i)
+            {
+                weights[i + radius] = std::exp(-float(i * i) / (2.0f * sigma * sigma));
+                sum += weights[i + radius];
+            }
+
+            for (auto& weight : weights)
+            {
+                weight /= sum;
+            }
+            return weights;
+        }
+
+        void combine(const Image& src, const Image& blurred, Image& dst, float amount, uint8_t threshold)
+        {
+            prepareTarget(src, dst);
+
+            const Kernels& kernels = getKernels();
+            const uint32_t width = uint32_t(src.mWidth);
+
+            forEachTile(src, [&](uint32_t y0, uint32_t y1)
+            {
+                for (uint32_t y = y0; y < y1; ++y)
+                {
+                    const size_t offset = size_t(y) * width * 4;
+                    kernels.combineRow(src.mData + offset, blurred.mData + offset, dst.mData + offset, width, amount, float(threshold));
+                }
+            });
+        }
+    }
+
+    SimdLevel getSimdLevel()
+    {
+        return gActiveLevel;
+    }
+
+    void setSimdLevel(SimdLevel level)
+    {
+        gActiveLevel = clampSimdLevel(level);
+    }
+
+    const char* getKernelName(FilterKernel kernel)
+    {
+        switch (kernel)
+        {
+        case KERNEL_LUMINANCE:
+            return "luminance";
+        case KERNEL_COLOR_MATRIX:
+            return "colorMatrix";
+        case KERNEL_BLUR:
+            return "blur";
+        case KERNEL_SHARPEN:
+            return "sharpen";
+        default:
+            return "unknown";
+        }
+    }
+
+    FilterStats getStats(FilterKernel kernel)
+    {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        return kernel < KERNEL_COUNT ? gStats[kernel] : FilterStats();
+    }
+
+    void resetStats()
+    {
+        std::lock_guard<std::mutex> lock(gStatsMutex);
+        for (auto& stats : gStats)
+        {
+            stats = FilterStats();
+        }
+    }
+
+    void luminance(const Image& src, Image& dst)
+    {
+        ScopedStats stats(KERNEL_LUMINANCE, src);
+        prepareTarget(src, dst);
+
+        const Kernels& kernels = getKernels();
+        const uint32_t width = uint32_t(src.mWidth);
+
+        forEachTile(src, [&](uint32_t y0, uint32_t y1)
+        {
+            const size_t offset = size_t(y0) * width * 4;
+            kernels.luminanceRow(src.mData + offset, dst.mData + offset, width * (y1 - y0));
+        });
+    }
+
+    void colorMatrix(const Image& src, Image& dst, const glm::mat4& matrix)
+    {
+        ScopedStats stats(KERNEL_COLOR_MATRIX, src);
+        prepareTarget(src, dst);
+
+        const Kernels& kernels = getKernels();
+        const uint32_t width = uint32_t(src.mWidth);
+        const float* m = &matrix[0][0];
+
+        forEachTile(src, [&](uint32_t y0, uint32_t y1)
+        {
+            const size_t offset = size_t(y0) * width * 4;
+            kernels.colorMatrixRow(src.mData + offset, dst.mData + offset, width * (y1 - y0), m);
+        });
+    }
+
+    void boxBlur(const Image& src, Image& dst, uint32_t radius)
+    {
+        ScopedStats stats(KERNEL_BLUR, src);
+        separableBlur(src, dst, std::vector<float>(2 * radius + 1, 1.0f / float(2 * radius + 1)));
+    }
+
+    void gaussianBlur(const Image& src, Image& dst, float sigma)
+    {
+        ScopedStats stats(KERNEL_BLUR, src);
+        separableBlur(src, dst, makeGaussianWeights(sigma));
+    }
+
+    void unsharpMask(const Image& src, Image& dst, float sigma, float amount, uint8_t threshold)
+    {
+        ScopedStats stats(KERNEL_SHARPEN, src);
+
+        Image blurred;
+        separableBlur(src, blurred, makeGaussianWeights(sigma));
+        combine(src, blurred, dst, amount, threshold);
+    }
+
+    void sharpen(const Image& src, Image& dst, float amount)
+    {
+        ScopedStats stats(KERNEL_SHARPEN, src);
+
+        Image blurred;
+        separableBlur(src, blurred, std::vector<float>(3, 1.0f / 3.0f));
+        combine(src, blurred, dst, amount, 0);
+    }
+
+    uint32_t maxDifference(const Image& a, const Image& b)
+    {
+        if (a.mWidth != b.mWidth || a.mHeight != b.mHeight || a.mData == nullptr || b.mData == nullptr)
+        {
+            return 255;
+        }
+
+        uint32_t result = 0;
+        const size_t count = size_t(a.mWidth) * a.mHeight * 4;
+        for (size_t i = 0; i < count; ++i)
+        {
+            result = std::max(result, uint32_t(std::abs(int(a.mData[i]) - int(b.mData[i]))));
+        }
+        return result;
+    }
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "Cpu.h"
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    // CPU versions of the image filters. All images are RGBA8 as produced by Image::loadFromFile.
+    // dst is (re)allocated to the size of src and must not alias it.
+    namespace filters
+    {
+        enum FilterKernel : uint32_t
+        {
+            KERNEL_LUMINANCE,
+            KERNEL_COLOR_MATRIX,
+            KERNEL_BLUR,
+            KERNEL_SHARPEN,
+            KERNEL_COUNT,
+        };
+
+        struct FilterStats
+        {
+            uint64_t invocations = 0;
+            uint64_t pixels = 0;
+            double seconds = 0.0;
+
+            double getMegapixelsPerSecond() const { return seconds > 0.0 ? pixels / seconds * 1e-6 : 0.0; }
+        };
+
+        // level used by the filters only, requests above getSupportedSimdLevel() are clamped
+        SimdLevel getSimdLevel();
+        void setSimdLevel(SimdLevel level);
+
+        const char* getKernelName(FilterKernel kernel);
+
+        // cumulative timings since startup or the last resetStats()
+        FilterStats getStats(FilterKernel kernel);
+        void resetStats();
+
+        // the grayfilter shader's weights and rounding: grey = r*0.299 + g*0.587 + b*0.114, alpha = 1
+        void luminance(const Image& src, Image& dst);
+
+        // dst = matrix * src on normalized colors, same convention as a GLSL mat4 * vec4
+        void colorMatrix(const Image& src, Image& dst, const glm::mat4& matrix);
+
+        // separable blurs with clamp-to-edge addressing
+        void boxBlur(const Image& src, Image& dst, uint32_t radius);
+        void gaussianBlur(const Image& src, Image& dst, float sigma);
+
+        // dst = src + amount * (src - gaussian(src)), channels differing by less than threshold are kept
+        void unsharpMask(const Image& src, Image& dst, float sigma, float amount, uint8_t threshold = 0);
+
+        // unsharp mask over a 3x3 box
+        void sharpen(const Image& src, Image& dst, float amount);
+
+        // largest per-channel difference, used to validate SIMD levels against each other and GPU output
+        uint32_t maxDifference(const Image& a, const Image& b);
+    }
+}
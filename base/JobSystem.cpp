@@ -0,0 +1,366 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace utils
+{
+    namespace
+    {
+        // set on worker threads, the main thread is recognized by its id
+        thread_local const JobSystem* tSystem = nullptr;
+        thread_local uint32_t tSlotIndex = 0;
+
+        // spins before a worker goes to sleep, long enough to bridge the gap between fork-join phases
+        constexpr uint32_t kIdleSpins = 256;
+    }
+
+    JobSystem::Slot::Slot()
+        : deques{ WorkStealingDeque<Job*>(kMaxJobsInFlight), WorkStealingDeque<Job*>(kMaxJobsInFlight) }
+        , jobs(new Job[kMaxJobsInFlight])
+    {
+    }
+
+    JobSystem::JobSystem(uint32_t workerCount)
+        : mMainThread(std::this_thread::get_id())
+    {
+        if (workerCount == 0)
+        {
+            const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        for (uint32_t i = 0; i <= workerCount; ++i)
+        {
+            mSlots.emplace_back(new Slot());
+        }
+        for (uint32_t i = 0; i < workerCount; ++i)
+        {
+            mThreads.emplace_back(&JobSystem::workerLoop, this, i + 1);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mStopping = true;
+        }
+        mWake.notify_all();
+
+        for (auto& thread : mThreads)
+        {
+            thread.join();
+        }
+    }
+
+    JobSystem& JobSystem::global()
+    {
+        static JobSystem system;
+        return system;
+    }
+
+    JobSystem::Slot* JobSystem::getSlot() const
+    {
+        if (tSystem == this)
+        {
+            return mSlots[tSlotIndex].get();
+        }
+        return isMainThread() ? mSlots[0].get() : nullptr;
+    }
+
+    uint32_t JobSystem::getSlotIndex(const Slot* slot) const
+    {
+        if (slot == nullptr)
+        {
+            return 0;
+        }
+        return tSystem == this ? tSlotIndex : 0;
+    }
+
+    JobSystem::Job* JobSystem::allocate(Slot& slot)
+    {
+        Job* job = &slot.jobs[slot.nextJob++ % kMaxJobsInFlight];
+
+        // the ring wrapped around onto a job that hasn't run yet, work until it did
+        while (!job->finished.load(std::memory_order_acquire))
+        {
+            Job* other = nullptr;
+            if (takeJob(&slot, false, other))
+            {
+                execute(other, &slot);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        job->finished.store(false, std::memory_order_relaxed);
+        return job;
+    }
+
+    void JobSystem::run(JobFunction function, JobCounter* counter, JobPriority priority)
+    {
+        if (counter != nullptr)
+        {
+            counter->mPending.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        Slot* slot = getSlot();
+        if (slot == nullptr)
+        {
+            Job* job = new Job();
+            job->function = std::move(function);
+            job->counter = counter;
+            job->finished.store(false, std::memory_order_relaxed);
+            job->owned = true;
+            mQueued.fetch_add(1, std::memory_order_seq_cst);
+            {
+                std::lock_guard<std::mutex> lock(mInjectedMutex);
+                mInjected[priority].push_back(job);
+                mInjectedCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            wake();
+            return;
+        }
+
+        Job* job = allocate(*slot);
+        job->function = std::move(function);
+        job->counter = counter;
+
+        // counted before it can be stolen, so the count never drops below the jobs actually queued
+        mQueued.fetch_add(1, std::memory_order_seq_cst);
+        if (!slot->deques[priority].push(job))
+        {
+            mQueued.fetch_sub(1, std::memory_order_relaxed);
+            slot->inlineJobs.fetch_add(1, std::memory_order_relaxed);
+            execute(job, slot);
+            return;
+        }
+        wake();
+    }
+
+    void JobSystem::wake()
+    {
+        // pairs with the sleeping count a worker publishes before checking mQueued one last time
+        if (mSleeping.load(std::memory_order_seq_cst) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mSleepMutex);
+            mWake.notify_one();
+        }
+    }
+
+    bool JobSystem::takeJob(Slot* slot, bool stealLowPriority, Job*& job)
+    {
+        const uint32_t slotCount = uint32_t(mSlots.size());
+        const uint32_t self = getSlotIndex(slot);
+
+        for (uint32_t priority = 0; priority < JOB_PRIORITY_COUNT; ++priority)
+        {
+            if (slot != nullptr && slot->deques[priority].pop(job))
+            {
+                mQueued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            if (priority == JOB_PRIORITY_LOW && !stealLowPriority)
+            {
+                break;
+            }
+
+            if (mInjectedCount.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mInjectedMutex);
+                if (!mInjected[priority].empty())
+                {
+                    job = mInjected[priority].front();
+                    mInjected[priority].pop_front();
+                    mInjectedCount.fetch_sub(1, std::memory_order_relaxed);
+                    mQueued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+
+            for (uint32_t i = 1; i < slotCount; ++i)
+            {
+                Slot& victim = *mSlots[(self + i) % slotCount];
+                if (victim.deques[priority].steal(job))
+                {
+                    mQueued.fetch_sub(1, std::memory_order_relaxed);
+                    if (slot != nullptr)
+                    {
+                        slot->stolenJobs.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void JobSystem::execute(Job* job, Slot* slot)
+    {
+        job->function();
+
+        // nothing of the job may be touched once the counter or the finished flag let others go on
+        job->function = nullptr;
+        JobCounter* counter = job->counter;
+        if (job->owned)
+        {
+            delete job;
+        }
+        else
+        {
+            job->finished.store(true, std::memory_order_release);
+        }
+
+        if (slot != nullptr)
+        {
+            slot->executedJobs.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (counter != nullptr)
+        {
+            counter->mPending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    void JobSystem::wait(JobCounter& counter)
+    {
+        Slot* slot = getSlot();
+        while (!counter.isDone())
+        {
+            Job* job = nullptr;
+            if (takeJob(slot, false, job))
+            {
+                execute(job, slot);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool JobSystem::wantsWork(Slot* slot, JobPriority priority) const
+    {
+        if (slot == nullptr)
+        {
+            return mInjectedCount.load(std::memory_order_relaxed) == 0;
+        }
+        return slot->deques[priority].size() == 0;
+    }
+
+    void JobSystem::runRange(const RangeFunction& function, uint32_t begin, uint32_t end, uint32_t minGrainSize, JobCounter& counter, JobPriority priority)
+    {
+        Slot* slot = getSlot();
+        while (end - begin >= 2 * minGrainSize && wantsWork(slot, priority))
+        {
+            const uint32_t middle = begin + (end - begin) / 2;
+            run([this, &function, middle, end, minGrainSize, &counter, priority]()
+            {
+                runRange(function, middle, end, minGrainSize, counter, priority);
+            }, &counter, priority);
+            end = middle;
+        }
+        function(begin, end);
+    }
+
+    void JobSystem::parallelFor(uint32_t count, uint32_t minGrainSize, const RangeFunction& function, JobPriority priority)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        minGrainSize = std::max(minGrainSize, 1u);
+        if (count < 2 * minGrainSize || mThreads.empty())
+        {
+            function(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        runRange(function, 0, count, minGrainSize, counter, priority);
+        wait(counter);
+    }
+
+    void JobSystem::runOnMainThread(JobFunction function)
+    {
+        std::lock_guard<std::mutex> lock(mMainMutex);
+        mMainJobs.push_back(std::move(function));
+    }
+
+    uint32_t JobSystem::executeMainThreadJobs()
+    {
+        if (!isMainThread())
+        {
+            std::cerr << "JobSystem::executeMainThreadJobs called from another thread than the main thread" << std::endl;
+            return 0;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMainMutex);
+            mMainJobsRunning.swap(mMainJobs);
+        }
+
+        // jobs queued while these run wait for the next frame
+        const uint32_t count = uint32_t(mMainJobsRunning.size());
+        for (JobFunction& function : mMainJobsRunning)
+        {
+            function();
+        }
+        mMainJobsRunning.clear();
+        mMainThreadJobs.fetch_add(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    JobSystemStats JobSystem::getStats() const
+    {
+        JobSystemStats stats;
+        for (const auto& slot : mSlots)
+        {
+            stats.executedJobs += slot->executedJobs.load(std::memory_order_relaxed);
+            stats.stolenJobs += slot->stolenJobs.load(std::memory_order_relaxed);
+            stats.inlineJobs += slot->inlineJobs.load(std::memory_order_relaxed);
+        }
+        stats.mainThreadJobs = mMainThreadJobs.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    void JobSystem::workerLoop(uint32_t index)
+    {
+        tSystem = this;
+        tSlotIndex = index;
+        Slot* slot = mSlots[index].get();
+
+        for (;;)
+        {
+            Job* job = nullptr;
+            if (takeJob(slot, true, job))
+            {
+                execute(job, slot);
+                continue;
+            }
+
+            uint32_t spins = 0;
+            while (mQueued.load(std::memory_order_relaxed) <= 0 && ++spins < kIdleSpins)
+            {
+                std::this_thread::yield();
+            }
+            if (mQueued.load(std::memory_order_relaxed) > 0)
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mSleepMutex);
+            mSleeping.fetch_add(1, std::memory_order_seq_cst);
+            mWake.wait(lock, [this]() { return mStopping || mQueued.load(std::memory_order_seq_cst) > 0; });
+            mSleeping.fetch_sub(1, std::memory_order_relaxed);
+            if (mStopping && mQueued.load(std::memory_order_relaxed) <= 0)
+            {
+                return;
+            }
+        }
+    }
+}
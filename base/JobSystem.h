@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+
+namespace utils
+{
+    enum JobPriority : uint32_t
+    {
+        // work the current frame waits for, always taken before anything else
+        JOB_PRIORITY_HIGH,
+        // streaming and other background work
+        JOB_PRIORITY_LOW,
+        JOB_PRIORITY_COUNT,
+    };
+
+    // Jobs started with a counter increment it and decrement it once they finished, JobSystem::wait helps
+    // until it reaches zero. A parent job that starts its children on its own counter before returning
+    // is only done once all of its children are.
+    class JobCounter
+    {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+        JobCounter& operator=(const JobCounter&) = delete;
+
+        bool isDone() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> mPending{ 0 };
+    };
+
+    struct JobSystemStats
+    {
+        uint64_t executedJobs = 0;
+        uint64_t stolenJobs = 0;
+
+        // started while the submitting thread's deque was full and run right away instead
+        uint64_t inlineJobs = 0;
+        uint64_t mainThreadJobs = 0;
+    };
+
+    // Work-stealing scheduler. Every worker and the main thread own one Chase-Lev deque per priority: they push
+    // and pop their own jobs newest first and steal the oldest jobs of others when they run dry, so fork-join
+    // work stays on warm caches and only idle threads touch shared state. Threads that don't belong to the
+    // system submit through a locked queue. Idle workers spin briefly and then sleep until jobs are queued.
+    // The thread that constructs the system is its main thread, runOnMainThread queues GL work for it.
+    class JobSystem
+    {
+    public:
+        using JobFunction = std::function<void()>;
+        using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+        // jobs a thread can have started and not yet finished before it has to help with others
+        static constexpr uint32_t kMaxJobsInFlight = 4096;
+
+        // 0 uses one worker per hardware thread minus the calling thread
+        explicit JobSystem(uint32_t workerCount = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // shared system used by the base library
+        static JobSystem& global();
+
+        void run(JobFunction function, JobCounter* counter = nullptr, JobPriority priority = JOB_PRIORITY_HIGH);
+
+        // runs jobs on the calling thread until counter is done: any high priority job, but low priority ones
+        // only from the thread's own deque, so a frame never waits on someone else's streaming work
+        void wait(JobCounter& counter);
+
+        // Splits [0, count) lazily: the running thread halves its range and offers the upper half for stealing
+        // only while its deque is empty, so ranges get cut finely when workers are idle and stay large when
+        // they are busy. Ranges are never split below minGrainSize. The calling thread takes part and returns
+        // once everything ran.
+        void parallelFor(uint32_t count, uint32_t minGrainSize, const RangeFunction& function, JobPriority priority = JOB_PRIORITY_HIGH);
+
+        // any thread, the function runs in the next executeMainThreadJobs
+        void runOnMainThread(JobFunction function);
+
+        // main thread only, call once per frame. Returns the number of jobs run
+        uint32_t executeMainThreadJobs();
+
+        bool isMainThread() const { return std::this_thread::get_id() == mMainThread; }
+        uint32_t getWorkerCount() const { return uint32_t(mThreads.size()); }
+
+        JobSystemStats getStats() const;
+
+    private:
+        struct Job
+        {
+            JobFunction function;
+            JobCounter* counter = nullptr;
+
+            // set once the job ran and its storage can be reused
+            std::atomic<bool> finished{ true };
+
+            // submitted from a foreign thread and deleted after running
+            bool owned = false;
+        };
+
+        struct alignas(64) Slot
+        {
+            Slot();
+
+            WorkStealingDeque<Job*> deques[JOB_PRIORITY_COUNT];
+
+            // ring of job storage, only the owning thread allocates from it
+            std::unique_ptr<Job[]> jobs;
+            uint32_t nextJob = 0;
+
+            std::atomic<uint64_t> executedJobs{ 0 };
+            std::atomic<uint64_t> stolenJobs{ 0 };
+            std::atomic<uint64_t> inlineJobs{ 0 };
+        };
+
+        // the calling thread's slot, nullptr for threads that don't belong to this system
+        Slot* getSlot() const;
+        uint32_t getSlotIndex(const Slot* slot) const;
+
+        Job* allocate(Slot& slot);
+
+        // high priority first, the own deque before the injected queue before other deques
+        bool takeJob(Slot* slot, bool stealLowPriority, Job*& job);
+        void execute(Job* job, Slot* slot);
+
+        // whether the running thread should split its range, true while nothing of its own waits to be stolen
+        bool wantsWork(Slot* slot, JobPriority priority) const;
+        void runRange(const RangeFunction& function, uint32_t begin, uint32_t end, uint32_t minGrainSize, JobCounter& counter, JobPriority priority);
+
+        void wake();
+        void workerLoop(uint32_t index);
+
+        // slot 0 belongs to the main thread, worker i uses slot i + 1
+        std::vector<std::unique_ptr<Slot>> mSlots;
+        std::vector<std::thread> mThreads;
+        std::thread::id mMainThread;
+
+        std::mutex mInjectedMutex;
+        std::deque<Job*> mInjected[JOB_PRIORITY_COUNT];
+        std::atomic<uint32_t> mInjectedCount{ 0 };
+
+        // jobs sitting in any queue, sleeping workers wait for it to become non-zero
+        std::atomic<int64_t> mQueued{ 0 };
+        std::atomic<uint32_t> mSleeping{ 0 };
+        std::mutex mSleepMutex;
+        std::condition_variable mWake;
+        bool mStopping = false;
+
+        std::mutex mMainMutex;
+        std::vector<JobFunction> mMainJobs;
+        std::vector<JobFunction> mMainJobsRunning;
+        std::atomic<uint64_t> mMainThreadJobs{ 0 };
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace utils
+{
+    // bounded multi-producer multi-consumer queue that never blocks, push and pop fail instead of waiting.
+    // Every cell carries a sequence number telling producers and consumers whose turn it is (Vyukov's design).
+    template<typename T>
+    class LockFreeQueue
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit LockFreeQueue(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            mCells.reset(new Cell[size]);
+            mMask = size - 1;
+            for (size_t i = 0; i < size; ++i)
+            {
+                mCells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        LockFreeQueue(const LockFreeQueue&) = delete;
+        LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+        // returns false if the queue is full
+        bool tryPush(const T& value)
+        {
+            size_t position = mEnqueuePosition.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = mCells[position & mMask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position);
+                if (difference == 0)
+                {
+                    if (mEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = mEnqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // returns false if the queue is empty
+        bool tryPop(T& value)
+        {
+            size_t position = mDequeuePosition.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = mCells[position & mMask];
+                const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const ptrdiff_t difference = ptrdiff_t(sequence) - ptrdiff_t(position + 1);
+                if (difference == 0)
+                {
+                    if (mDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        value = std::move(cell.value);
+                        cell.sequence.store(position + mMask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = mDequeuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        size_t capacity() const { return mMask + 1; }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> mCells;
+        size_t mMask = 0;
+
+        // producers and consumers spin on different cache lines
+        alignas(64) std::atomic<size_t> mEnqueuePosition{ 0 };
+        alignas(64) std::atomic<size_t> mDequeuePosition{ 0 };
+    };
+}
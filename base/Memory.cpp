@@ -0,0 +1,178 @@
+#include "Memory.h"
+
+#include <algorithm>
+
+namespace utils
+{
+    namespace detail
+    {
+        std::atomic<uint64_t> gHeapAllocations{ 0 };
+    }
+
+    namespace
+    {
+        constexpr size_t kMinimumBlockSize = 64 << 10;
+
+        std::atomic<size_t> gScratchCapacity{ 1 << 20 };
+    }
+
+    LinearAllocator::LinearAllocator(size_t capacity)
+    {
+        if (capacity > 0)
+        {
+            mBlock = new uint8_t[capacity];
+            mCapacity = capacity;
+            mStats.capacity = capacity;
+        }
+    }
+
+    LinearAllocator::~LinearAllocator()
+    {
+        for (auto& block : mOverflow)
+        {
+            delete[] block.first;
+        }
+        delete[] mBlock;
+        delete[] mSpare;
+    }
+
+    void* LinearAllocator::allocate(size_t size, size_t alignment)
+    {
+        uintptr_t address = reinterpret_cast<uintptr_t>(mBlock) + mOffset;
+        uintptr_t aligned = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+
+        if (mBlock == nullptr || aligned + size > reinterpret_cast<uintptr_t>(mBlock) + mCapacity)
+        {
+            grow(size + alignment);
+            address = reinterpret_cast<uintptr_t>(mBlock);
+            aligned = (address + alignment - 1) & ~uintptr_t(alignment - 1);
+        }
+
+        mOffset = size_t(aligned - reinterpret_cast<uintptr_t>(mBlock)) + size;
+
+        mStats.used = mOverflowBytes + mOffset;
+        mStats.peak = std::max(mStats.peak, mStats.used);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void LinearAllocator::reset()
+    {
+        if (!mOverflow.empty())
+        {
+            // one block big enough for everything the last cycle needed
+            const size_t capacity = std::max(mOverflowBytes + mCapacity, mStats.peak);
+
+            for (auto& block : mOverflow)
+            {
+                delete[] block.first;
+            }
+            mOverflow.clear();
+            mOverflowBytes = 0;
+
+            delete[] mSpare;
+            mSpare = nullptr;
+            mSpareCapacity = 0;
+
+            delete[] mBlock;
+            mBlock = new uint8_t[capacity];
+            mCapacity = capacity;
+            mStats.capacity = capacity;
+        }
+
+        mOffset = 0;
+        mStats.used = 0;
+    }
+
+    void LinearAllocator::rewind(size_t marker)
+    {
+        // drop the blocks added after the marker was taken, the largest is kept for the next overflow
+        while (!mOverflow.empty() && marker < mOverflowBytes)
+        {
+            if (mCapacity > mSpareCapacity)
+            {
+                delete[] mSpare;
+                mSpare = mBlock;
+                mSpareCapacity = mCapacity;
+            }
+            else
+            {
+                delete[] mBlock;
+            }
+
+            mBlock = mOverflow.back().first;
+            mCapacity = mOverflow.back().second;
+            mOverflowBytes -= mCapacity;
+            mOverflow.pop_back();
+        }
+
+        mOffset = std::min(marker - mOverflowBytes, mCapacity);
+        mStats.capacity = mOverflowBytes + mCapacity;
+        mStats.used = mOverflowBytes + mOffset;
+    }
+
+    void LinearAllocator::grow(size_t minimumSize)
+    {
+        if (mBlock != nullptr)
+        {
+            mOverflow.emplace_back(mBlock, mCapacity);
+            mOverflowBytes += mCapacity;
+            ++mStats.overflowCount;
+        }
+
+        if (mSpare != nullptr && mSpareCapacity >= minimumSize)
+        {
+            mBlock = mSpare;
+            mCapacity = mSpareCapacity;
+            mSpare = nullptr;
+            mSpareCapacity = 0;
+        }
+        else
+        {
+            const size_t capacity = std::max({ minimumSize, mCapacity * 2, kMinimumBlockSize });
+            mBlock = new uint8_t[capacity];
+            mCapacity = capacity;
+        }
+        mOffset = 0;
+        mStats.capacity = mOverflowBytes + mCapacity;
+    }
+
+    FrameAllocator::FrameAllocator(size_t capacityPerFrame, uint32_t bufferCount)
+    {
+        bufferCount = std::min(std::max(bufferCount, 1u), kMaxBuffers);
+        for (uint32_t i = 0; i < bufferCount; ++i)
+        {
+            mBuffers.push_back(std::make_unique<LinearAllocator>(capacityPerFrame));
+        }
+    }
+
+    void FrameAllocator::beginFrame()
+    {
+        mIndex = (mIndex + 1) % uint32_t(mBuffers.size());
+        mBuffers[mIndex]->reset();
+    }
+
+    MemoryStats FrameAllocator::getStats() const
+    {
+        MemoryStats stats;
+        for (const auto& buffer : mBuffers)
+        {
+            const MemoryStats& bufferStats = buffer->getStats();
+            stats.capacity += bufferStats.capacity;
+            stats.peak = std::max(stats.peak, bufferStats.peak);
+            stats.overflowCount += bufferStats.overflowCount;
+        }
+        stats.used = mBuffers[mIndex]->getStats().used;
+        return stats;
+    }
+
+    LinearAllocator& ScratchArena::get()
+    {
+        thread_local LinearAllocator arena(gScratchCapacity.load(std::memory_order_relaxed));
+        return arena;
+    }
+
+    void ScratchArena::setDefaultCapacity(size_t capacity)
+    {
+        gScratchCapacity.store(capacity, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace utils
+{
+    struct MemoryStats
+    {
+        size_t capacity = 0;
+        size_t used = 0;
+        size_t peak = 0;
+
+        // allocations that did not fit and had to grab another block from the heap
+        uint64_t overflowCount = 0;
+    };
+
+    // bump allocator, individual allocations are never freed, reset() releases everything at once.
+    // Overflow blocks are merged into one block on reset so a steady state stops touching the heap.
+    class LinearAllocator
+    {
+    public:
+        explicit LinearAllocator(size_t capacity = 0);
+        ~LinearAllocator();
+
+        LinearAllocator(const LinearAllocator&) = delete;
+        LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        template<typename T, typename... Args>
+        T* make(Args&&... args)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "destructors never run for linear allocations");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template<typename T>
+        T* makeArray(size_t count)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "destructors never run for linear allocations");
+            T* data = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+            for (size_t i = 0; i < count; ++i)
+            {
+                new (data + i) T();
+            }
+            return data;
+        }
+
+        void reset();
+
+        // rewind markers for scoped use, they count bytes over all blocks so scopes can nest across an overflow
+        size_t getMarker() const { return mOverflowBytes + mOffset; }
+        void rewind(size_t marker);
+
+        const MemoryStats& getStats() const { return mStats; }
+
+    private:
+        void grow(size_t minimumSize);
+
+        uint8_t* mBlock = nullptr;
+        size_t mCapacity = 0;
+        size_t mOffset = 0;
+
+        // full blocks kept alive until the next reset
+        std::vector<std::pair<uint8_t*, size_t>> mOverflow;
+        size_t mOverflowBytes = 0;
+
+        // the largest block a rewind dropped, reused by the next overflow so scopes that overflow every
+        // time don't hit the heap
+        uint8_t* mSpare = nullptr;
+        size_t mSpareCapacity = 0;
+
+        MemoryStats mStats;
+    };
+
+    // one linear allocator per frame in flight, data stays valid until its buffer comes around again
+    class FrameAllocator
+    {
+    public:
+        static constexpr uint32_t kMaxBuffers = 4;
+
+        explicit FrameAllocator(size_t capacityPerFrame = 4 << 20, uint32_t bufferCount = 2);
+
+        // switches to the next buffer and resets it, call once at the start of a frame
+        void beginFrame();
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) { return current().allocate(size, alignment); }
+
+        template<typename T, typename... Args>
+        T* make(Args&&... args) { return current().make<T>(std::forward<Args>(args)...); }
+
+        template<typename T>
+        T* makeArray(size_t count) { return current().makeArray<T>(count); }
+
+        LinearAllocator& current() { return *mBuffers[mIndex]; }
+
+        // peak over all buffers
+        MemoryStats getStats() const;
+
+    private:
+        std::vector<std::unique_ptr<LinearAllocator>> mBuffers;
+        uint32_t mIndex = 0;
+    };
+
+    // per-thread temporary memory, everything allocated inside a ScratchScope is released at its end
+    class ScratchArena
+    {
+    public:
+        static LinearAllocator& get();
+
+        // capacity used when a thread touches its arena for the first time
+        static void setDefaultCapacity(size_t capacity);
+    };
+
+    class ScratchScope
+    {
+    public:
+        ScratchScope() : mAllocator(ScratchArena::get()), mMarker(mAllocator.getMarker()) {}
+        ~ScratchScope() { mAllocator.rewind(mMarker); }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+        void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) { return mAllocator.allocate(size, alignment); }
+
+        template<typename T>
+        T* makeArray(size_t count) { return mAllocator.makeArray<T>(count); }
+
+        LinearAllocator& allocator() { return mAllocator; }
+
+    private:
+        LinearAllocator& mAllocator;
+        size_t mMarker;
+    };
+
+    // fixed-size object pool, grows in chunks and never returns memory before destruction
+    template<typename T>
+    class ObjectPool
+    {
+    public:
+        explicit ObjectPool(size_t objectsPerChunk = 256) : mObjectsPerChunk(objectsPerChunk > 0 ? objectsPerChunk : 1) {}
+
+        ~ObjectPool()
+        {
+            for (void* chunk : mChunks)
+            {
+                ::operator delete(chunk);
+            }
+        }
+
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        template<typename... Args>
+        T* create(Args&&... args)
+        {
+            return new (allocate()) T(std::forward<Args>(args)...);
+        }
+
+        void destroy(T* object)
+        {
+            if (object != nullptr)
+            {
+                object->~T();
+                deallocate(object);
+            }
+        }
+
+        void* allocate()
+        {
+            if (mFreeList == nullptr)
+            {
+                addChunk();
+            }
+
+            Node* node = mFreeList;
+            mFreeList = node->next;
+
+            ++mLive;
+            mStats.used = mLive * sizeof(Node);
+            mStats.peak = mStats.used > mStats.peak ? mStats.used : mStats.peak;
+            return node;
+        }
+
+        void deallocate(void* pointer)
+        {
+            Node* node = static_cast<Node*>(pointer);
+            node->next = mFreeList;
+            mFreeList = node;
+
+            --mLive;
+            mStats.used = mLive * sizeof(Node);
+        }
+
+        // makes sure count objects can be created without touching the heap
+        void reserve(size_t count)
+        {
+            while (mStats.capacity / sizeof(Node) < count)
+            {
+                addChunk();
+            }
+        }
+
+        size_t getLiveCount() const { return mLive; }
+        const MemoryStats& getStats() const { return mStats; }
+
+    private:
+        union Node
+        {
+            Node* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        void addChunk()
+        {
+            Node* chunk = static_cast<Node*>(::operator new(sizeof(Node) * mObjectsPerChunk));
+            mChunks.push_back(chunk);
+
+            for (size_t i = 0; i < mObjectsPerChunk; ++i)
+            {
+                chunk[i].next = (i + 1 < mObjectsPerChunk) ? &chunk[i + 1] : mFreeList;
+            }
+            mFreeList = chunk;
+
+            mStats.capacity += sizeof(Node) * mObjectsPerChunk;
+            if (mChunks.size() > 1)
+            {
+                ++mStats.overflowCount;
+            }
+        }
+
+        size_t mObjectsPerChunk;
+        std::vector<void*> mChunks;
+        Node* mFreeList = nullptr;
+        size_t mLive = 0;
+        MemoryStats mStats;
+    };
+
+    // STL adapter over any allocator exposing allocate(size, alignment), deallocation is a no-op
+    template<typename T, typename Arena = LinearAllocator>
+    class ArenaAllocator
+    {
+    public:
+        using value_type = T;
+
+        template<typename U>
+        struct rebind
+        {
+            using other = ArenaAllocator<U, Arena>;
+        };
+
+        explicit ArenaAllocator(Arena& arena) noexcept : mArena(&arena) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U, Arena>& other) noexcept : mArena(other.getArena()) {}
+
+        T* allocate(size_t count)
+        {
+            return static_cast<T*>(mArena->allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        void deallocate(T*, size_t) noexcept {}
+
+        Arena* getArena() const noexcept { return mArena; }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U, Arena>& rhs) const noexcept { return mArena == rhs.getArena(); }
+
+        template<typename U>
+        bool operator!=(const ArenaAllocator<U, Arena>& rhs) const noexcept { return mArena != rhs.getArena(); }
+
+    private:
+        Arena* mArena;
+    };
+
+    template<typename T>
+    using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+    namespace detail
+    {
+        extern std::atomic<uint64_t> gHeapAllocations;
+    }
+
+    // global operator new calls, only counted in executables that expand UTILS_COUNT_HEAP_ALLOCATIONS() once
+    inline uint64_t getHeapAllocationCount()
+    {
+        return detail::gHeapAllocations.load(std::memory_order_relaxed);
+    }
+}
+
+#define UTILS_COUNT_HEAP_ALLOCATIONS() \
+    void* operator new(size_t size) \
+    { \
+        utils::detail::gHeapAllocations.fetch_add(1, std::memory_order_relaxed); \
+        if (void* p = std::malloc(size ? size : 1)) return p; \
+        throw std::bad_alloc(); \
+    } \
+    void* operator new[](size_t size) { return operator new(size); } \
+    void operator delete(void* p) noexcept { std::free(p); } \
+    void operator delete[](void* p) noexcept { std::free(p); } \
+    void operator delete(void* p, size_t) noexcept { std::free(p); } \
+    void operator delete[](void* p, size_t) noexcept { std::free(p); }
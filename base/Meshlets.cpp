@@ -0,0 +1,544 @@
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "Frustum.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MESHLETS_X86 1
+#include <immintrin.h>
+#endif
+
+// the AVX2 test is compiled for its instruction set individually and selected at runtime
+#if defined(MESHLETS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        constexpr uint8_t kNoLocalIndex = 0xff;
+        constexpr uint32_t kNoTriangle = ~0u;
+
+        // frustumCulled, coneCulled, drawCount, visibleTriangles
+        constexpr uint32_t kStatsCounters = 4;
+
+        glm::vec3 getPosition(const float* positions, uint32_t stride, uint32_t vertex)
+        {
+            const float* position = positions + size_t(vertex) * stride;
+            return glm::vec3(position[0], position[1], position[2]);
+        }
+
+        void computeBounds(const float* positions, uint32_t stride, const MeshletMesh& mesh, Meshlet& meshlet)
+        {
+            glm::vec3 boundsMin(std::numeric_limits<float>::max());
+            glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                const glm::vec3 position = getPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + i]);
+                boundsMin = glm::min(boundsMin, position);
+                boundsMax = glm::max(boundsMax, position);
+            }
+
+            const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+            float radius = 0.0f;
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                radius = std::max(radius, glm::length(getPosition(positions, stride, mesh.vertices[meshlet.vertexOffset + i]) - center));
+            }
+            meshlet.sphere = glm::vec4(center, radius);
+
+            // the axis is the mean normal, the cutoff comes from the normal furthest away from it
+            glm::vec3 normals[256];
+            uint32_t normalCount = 0;
+            glm::vec3 axis(0.0f);
+            for (uint32_t triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+            {
+                const uint32_t* corners = &mesh.indices[meshlet.firstIndex + triangle * 3];
+                const glm::vec3 a = getPosition(positions, stride, corners[0]);
+                const glm::vec3 normal = glm::cross(getPosition(positions, stride, corners[1]) - a, getPosition(positions, stride, corners[2]) - a);
+                const float length = glm::length(normal);
+
+                // degenerate triangles are never visible, they don't widen the cone
+                if (length > 1e-12f)
+                {
+                    normals[normalCount] = normal / length;
+                    axis += normals[normalCount++];
+                }
+            }
+
+            const float axisLength = glm::length(axis);
+            meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            if (normalCount == 0 || axisLength < 1e-6f)
+            {
+                return;
+            }
+
+            axis /= axisLength;
+            float minimumDot = 1.0f;
+            for (uint32_t i = 0; i < normalCount; ++i)
+            {
+                minimumDot = std::min(minimumDot, glm::dot(axis, normals[i]));
+            }
+
+            // a cone of 90 degrees or more has a camera position facing some triangle from any direction
+            meshlet.cone = glm::vec4(axis, minimumDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot));
+        }
+
+        bool isCulled(const Meshlet& meshlet, const Frustum& frustum, const glm::vec3& camera, bool coneCulling, bool& frustumCulled)
+        {
+            const glm::vec3 center(meshlet.sphere);
+            frustumCulled = !frustum.intersectsSphere(center, meshlet.sphere.w);
+            if (frustumCulled)
+            {
+                return true;
+            }
+
+            const glm::vec3 view = center - camera;
+            return coneCulling && glm::dot(view, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(view) + meshlet.sphere.w;
+        }
+
+        void appendCommand(const Meshlet& meshlet, uint32_t index, DrawElementsIndirectCommand* commands, uint32_t& visible, MeshletCullStats& stats)
+        {
+            DrawElementsIndirectCommand& command = commands[visible++];
+            command.count = meshlet.triangleCount * 3;
+            command.instanceCount = 1;
+            command.firstIndex = meshlet.firstIndex;
+            command.baseVertex = 0;
+            command.baseInstance = index;
+            stats.visibleTriangles += meshlet.triangleCount;
+        }
+
+#if defined(MESHLETS_X86)
+        // 8 meshlets at once, bit i of the result is set for a visible meshlet, frustumMask gets the frustum culled ones
+        TARGET_AVX2 uint32_t testMeshletsAvx2(const Meshlet* meshlets, const Frustum& frustum, const glm::vec3& camera, bool coneCulling, uint32_t& frustumMask)
+        {
+            // the floats of a meshlet's sphere and cone are 12 apart
+            const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int(sizeof(Meshlet) / sizeof(float))));
+            const float* base = &meshlets[0].sphere.x;
+            const __m256 centerX = _mm256_i32gather_ps(base + 0, offsets, 4);
+            const __m256 centerY = _mm256_i32gather_ps(base + 1, offsets, 4);
+            const __m256 centerZ = _mm256_i32gather_ps(base + 2, offsets, 4);
+            const __m256 radius = _mm256_i32gather_ps(base + 3, offsets, 4);
+
+            __m256 outside = _mm256_setzero_ps();
+            const __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+            for (const glm::vec4& plane : frustum.planes)
+            {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(plane.x)), _mm256_set1_ps(plane.w));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(centerY, _mm256_set1_ps(plane.y)));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(centerZ, _mm256_set1_ps(plane.z)));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+            }
+            frustumMask = uint32_t(_mm256_movemask_ps(outside));
+
+            __m256 culled = outside;
+            if (coneCulling)
+            {
+                const float* cone = &meshlets[0].cone.x;
+                const __m256 viewX = _mm256_sub_ps(centerX, _mm256_set1_ps(camera.x));
+                const __m256 viewY = _mm256_sub_ps(centerY, _mm256_set1_ps(camera.y));
+                const __m256 viewZ = _mm256_sub_ps(centerZ, _mm256_set1_ps(camera.z));
+                __m256 along = _mm256_mul_ps(viewX, _mm256_i32gather_ps(cone + 0, offsets, 4));
+                along = _mm256_add_ps(along, _mm256_mul_ps(viewY, _mm256_i32gather_ps(cone + 1, offsets, 4)));
+                along = _mm256_add_ps(along, _mm256_mul_ps(viewZ, _mm256_i32gather_ps(cone + 2, offsets, 4)));
+                __m256 lengthSquared = _mm256_mul_ps(viewX, viewX);
+                lengthSquared = _mm256_add_ps(lengthSquared, _mm256_mul_ps(viewY, viewY));
+                lengthSquared = _mm256_add_ps(lengthSquared, _mm256_mul_ps(viewZ, viewZ));
+                const __m256 limit = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(cone + 3, offsets, 4), _mm256_sqrt_ps(lengthSquared)), radius);
+                culled = _mm256_or_ps(culled, _mm256_cmp_ps(along, limit, _CMP_GE_OQ));
+            }
+            return ~uint32_t(_mm256_movemask_ps(culled)) & 0xffu;
+        }
+#endif
+    }
+
+    bool buildMeshlets(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+        MeshletMesh& result, const MeshletSettings& settings)
+    {
+        result = MeshletMesh();
+
+        if (settings.maxVertices < 3 || settings.maxVertices > 255 || settings.maxTriangles == 0 || settings.maxTriangles > 256)
+        {
+            std::cerr << "Meshlets need 3 to 255 vertices and 1 to 256 triangles, got " << settings.maxVertices << " and " << settings.maxTriangles << std::endl;
+            return false;
+        }
+        if (indexCount % 3 != 0 || stride < 3)
+        {
+            std::cerr << "Meshlets need a triangle list with at least three floats per vertex" << std::endl;
+            return false;
+        }
+        for (uint32_t i = 0; i < indexCount; ++i)
+        {
+            if (indices[i] >= vertexCount)
+            {
+                std::cerr << "Mesh index " << indices[i] << " is out of range, the mesh has " << vertexCount << " vertices" << std::endl;
+                return false;
+            }
+        }
+
+        // the triangles of every vertex, the first liveTriangles of them are not in a meshlet yet
+        const uint32_t triangleCount = indexCount / 3;
+        std::vector<uint32_t> adjacencyOffsets(size_t(vertexCount) + 1, 0);
+        for (uint32_t i = 0; i < indexCount; ++i)
+        {
+            ++adjacencyOffsets[indices[i] + 1];
+        }
+        for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+        {
+            adjacencyOffsets[vertex + 1] += adjacencyOffsets[vertex];
+        }
+        std::vector<uint32_t> liveTriangles(vertexCount);
+        std::vector<uint32_t> adjacency(indexCount);
+        for (uint32_t i = 0; i < indexCount; ++i)
+        {
+            adjacency[adjacencyOffsets[indices[i]] + liveTriangles[indices[i]]++] = i / 3;
+        }
+
+        // candidates are scored by their centroid, computed once instead of on every visit
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+        {
+            const uint32_t* corners = indices + size_t(triangle) * 3;
+            centroids[triangle] = (getPosition(positions, stride, corners[0]) + getPosition(positions, stride, corners[1])
+                + getPosition(positions, stride, corners[2])) * (1.0f / 3.0f);
+        }
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint8_t> localIndex(vertexCount, kNoLocalIndex);
+        result.indices.reserve(indexCount);
+        result.localIndices.reserve(indexCount);
+        result.meshlets.reserve(triangleCount / settings.maxTriangles + 1);
+
+        Meshlet meshlet;
+        glm::vec3 positionSum(0.0f);
+        uint32_t seedCursor = 0;
+        uint32_t next = kNoTriangle;
+
+        auto countNewVertices = [&](uint32_t triangle)
+        {
+            const uint32_t* corners = indices + size_t(triangle) * 3;
+            return uint32_t(localIndex[corners[0]] == kNoLocalIndex) + uint32_t(localIndex[corners[1]] == kNoLocalIndex)
+                + uint32_t(localIndex[corners[2]] == kNoLocalIndex);
+        };
+
+        auto finishMeshlet = [&]()
+        {
+            if (meshlet.triangleCount > 0)
+            {
+                for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+                {
+                    localIndex[result.vertices[meshlet.vertexOffset + i]] = kNoLocalIndex;
+                }
+                computeBounds(positions, stride, result, meshlet);
+                result.meshlets.push_back(meshlet);
+            }
+
+            meshlet = Meshlet();
+            meshlet.firstIndex = uint32_t(result.indices.size());
+            meshlet.vertexOffset = uint32_t(result.vertices.size());
+            positionSum = glm::vec3(0.0f);
+        };
+
+        auto addTriangle = [&](uint32_t triangle)
+        {
+            emitted[triangle] = 1;
+            for (uint32_t corner = 0; corner < 3; ++corner)
+            {
+                const uint32_t vertex = indices[size_t(triangle) * 3 + corner];
+                if (localIndex[vertex] == kNoLocalIndex)
+                {
+                    localIndex[vertex] = uint8_t(meshlet.vertexCount++);
+                    result.vertices.push_back(vertex);
+                    positionSum += getPosition(positions, stride, vertex);
+                }
+
+                // swapped behind the live ones, candidates never visit it again
+                uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+                const uint32_t last = --liveTriangles[vertex];
+                for (uint32_t i = 0; i < last; ++i)
+                {
+                    if (live[i] == triangle)
+                    {
+                        std::swap(live[i], live[last]);
+                        break;
+                    }
+                }
+
+                result.indices.push_back(vertex);
+                result.localIndices.push_back(localIndex[vertex]);
+            }
+            ++meshlet.triangleCount;
+        };
+
+        finishMeshlet();
+        for (uint32_t added = 0; added < triangleCount; ++added)
+        {
+            // a new patch starts where the last one stopped growing, or at the first triangle left
+            if (next == kNoTriangle)
+            {
+                while (emitted[seedCursor])
+                {
+                    ++seedCursor;
+                }
+                next = seedCursor;
+            }
+
+            if (meshlet.vertexCount + countNewVertices(next) > settings.maxVertices || meshlet.triangleCount == settings.maxTriangles)
+            {
+                finishMeshlet();
+            }
+            addTriangle(next);
+
+            // the neighbour needing the fewest new vertices, then the one closest to the meshlet's center
+            const glm::vec3 center = positionSum / float(meshlet.vertexCount);
+            next = kNoTriangle;
+            uint32_t bestNewVertices = 4;
+            float bestDistance = 0.0f;
+            for (uint32_t i = 0; i < meshlet.vertexCount; ++i)
+            {
+                const uint32_t vertex = result.vertices[meshlet.vertexOffset + i];
+                const uint32_t* live = &adjacency[adjacencyOffsets[vertex]];
+                for (uint32_t j = 0; j < liveTriangles[vertex]; ++j)
+                {
+                    const uint32_t triangle = live[j];
+                    const uint32_t newVertices = countNewVertices(triangle);
+                    if (newVertices > bestNewVertices)
+                    {
+                        continue;
+                    }
+
+                    const glm::vec3 offset = centroids[triangle] - center;
+                    const float distance = glm::dot(offset, offset);
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        next = triangle;
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                    }
+                }
+            }
+        }
+        finishMeshlet();
+        return true;
+    }
+
+    bool buildMeshlets(const Mesh& mesh, MeshletMesh& result, const MeshletSettings& settings)
+    {
+        // the mesh factories store four floats per position
+        return buildMeshlets(mesh.mVertices.data(), uint32_t(mesh.mVertices.size() / 4), 4, mesh.mIndices.data(), uint32_t(mesh.mIndices.size()),
+            result, settings);
+    }
+
+    uint32_t cullMeshlets(const Meshlet* meshlets, uint32_t count, const glm::mat4& viewProjection, const glm::vec3& camera,
+        DrawElementsIndirectCommand* commands, MeshletCullStats& stats, bool coneCulling, SimdLevel level)
+    {
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        stats = MeshletCullStats();
+        stats.meshlets = count;
+
+        uint32_t visible = 0;
+        uint32_t first = 0;
+#if defined(MESHLETS_X86)
+        if (level == SimdLevel::SIMD_AVX2 && getSupportedSimdLevel() == SimdLevel::SIMD_AVX2)
+        {
+            for (; first + 8 <= count; first += 8)
+            {
+                uint32_t frustumMask = 0;
+                const uint32_t mask = testMeshletsAvx2(meshlets + first, frustum, camera, coneCulling, frustumMask);
+                for (uint32_t bit = 0; bit < 8; ++bit)
+                {
+                    const uint32_t index = first + bit;
+                    stats.triangles += meshlets[index].triangleCount;
+                    if ((mask & (1u << bit)) != 0)
+                    {
+                        appendCommand(meshlets[index], index, commands, visible, stats);
+                    }
+                    else if ((frustumMask & (1u << bit)) != 0)
+                    {
+                        ++stats.frustumCulled;
+                    }
+                    else
+                    {
+                        ++stats.coneCulled;
+                    }
+                }
+            }
+        }
+#endif
+
+        for (uint32_t index = first; index < count; ++index)
+        {
+            bool frustumCulled = false;
+            stats.triangles += meshlets[index].triangleCount;
+            if (!isCulled(meshlets[index], frustum, camera, coneCulling, frustumCulled))
+            {
+                appendCommand(meshlets[index], index, commands, visible, stats);
+            }
+            else if (frustumCulled)
+            {
+                ++stats.frustumCulled;
+            }
+            else
+            {
+                ++stats.coneCulled;
+            }
+        }
+
+        stats.visibleMeshlets = visible;
+        return visible;
+    }
+
+    MeshletCuller::~MeshletCuller()
+    {
+        destroy();
+    }
+
+    bool MeshletCuller::init(std::shared_ptr<OpenglProgram> cullProgram, uint32_t maxMeshlets)
+    {
+        destroy();
+
+        if (cullProgram == nullptr || maxMeshlets == 0)
+        {
+            std::cerr << "Meshlet culler needs the cull program and room for at least one meshlet" << std::endl;
+            return false;
+        }
+
+        mCullProgram = cullProgram;
+        mMaxMeshlets = maxMeshlets;
+
+        glCreateBuffers(1, &mMeshlets);
+        glNamedBufferStorage(mMeshlets, GLsizeiptr(maxMeshlets) * sizeof(Meshlet), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glCreateBuffers(1, &mCommands);
+        glNamedBufferStorage(mCommands, GLsizeiptr(maxMeshlets) * sizeof(DrawElementsIndirectCommand), nullptr, 0);
+        glCreateBuffers(kFrameLatency, mStatsBuffers);
+        for (GLuint stats : mStatsBuffers)
+        {
+            glNamedBufferStorage(stats, kStatsCounters * sizeof(uint32_t), nullptr, 0);
+        }
+        return true;
+    }
+
+    void MeshletCuller::destroy()
+    {
+        if (mMeshlets != 0)
+        {
+            glDeleteBuffers(1, &mMeshlets);
+            glDeleteBuffers(1, &mCommands);
+            glDeleteBuffers(kFrameLatency, mStatsBuffers);
+            mMeshlets = 0;
+            mCommands = 0;
+            for (uint32_t i = 0; i < kFrameLatency; ++i)
+            {
+                mStatsBuffers[i] = 0;
+                mStatsPending[i] = false;
+            }
+        }
+
+        mCullProgram.reset();
+        mMaxMeshlets = 0;
+        mMeshletCount = 0;
+        mTriangleCount = 0;
+        mStats = MeshletCullStats();
+    }
+
+    bool MeshletCuller::setMeshlets(const Meshlet* meshlets, uint32_t count)
+    {
+        if (count > mMaxMeshlets)
+        {
+            std::cerr << "Meshlet culler has room for " << mMaxMeshlets << " meshlets, " << count << " were given" << std::endl;
+            return false;
+        }
+
+        if (count > 0)
+        {
+            glNamedBufferSubData(mMeshlets, 0, GLsizeiptr(count) * sizeof(Meshlet), meshlets);
+        }
+
+        mMeshletCount = count;
+        mTriangleCount = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mTriangleCount += meshlets[i].triangleCount;
+        }
+        return true;
+    }
+
+    void MeshletCuller::cull(const glm::mat4& viewProjection, const glm::vec3& camera)
+    {
+        if (mMeshlets == 0)
+        {
+            return;
+        }
+
+        // the counters of this slot were written kFrameLatency frames ago
+        mFrame = (mFrame + 1) % kFrameLatency;
+        const GLuint stats = mStatsBuffers[mFrame];
+        if (mStatsPending[mFrame])
+        {
+            uint32_t counters[kStatsCounters];
+            glGetNamedBufferSubData(stats, 0, sizeof(counters), counters);
+            mStats.frustumCulled = counters[0];
+            mStats.coneCulled = counters[1];
+            mStats.visibleMeshlets = counters[2];
+            mStats.visibleTriangles = counters[3];
+        }
+        mStats.meshlets = mMeshletCount;
+        mStats.triangles = mTriangleCount;
+
+        const uint32_t zero = 0;
+        glClearNamedBufferData(stats, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        mStatsPending[mFrame] = true;
+
+        // without the draw count the whole buffer is drawn, commands past it must be empty
+        if (glMultiDrawElementsIndirectCount == nullptr && mMeshletCount > 0)
+        {
+            glClearNamedBufferSubData(mCommands, GL_R32UI, 0, GLsizeiptr(mMeshletCount) * sizeof(DrawElementsIndirectCommand),
+                GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        }
+
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        const GLuint program = mCullProgram->id;
+        mCullProgram->use();
+        glUniform4fv(glGetUniformLocation(program, "u_frustum"), Frustum::PLANE_COUNT, &frustum.planes[0][0]);
+        glUniform3f(glGetUniformLocation(program, "u_camera"), camera.x, camera.y, camera.z);
+        glUniform1ui(glGetUniformLocation(program, "u_meshletCount"), mMeshletCount);
+        glUniform1i(glGetUniformLocation(program, "u_coneCulling"), mConeCulling ? 1 : 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mMeshlets);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mCommands);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, stats);
+
+        glDispatchCompute((mMeshletCount + 63) / 64, 1, 1);
+
+        // the commands and the draw count are consumed by the indirect draw, the counters read back later
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    void MeshletCuller::draw(GLenum mode) const
+    {
+        if (mMeshletCount == 0)
+        {
+            return;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommands);
+        if (glMultiDrawElementsIndirectCount != nullptr)
+        {
+            glBindBuffer(GL_PARAMETER_BUFFER, mStatsBuffers[mFrame]);
+            glMultiDrawElementsIndirectCount(mode, GL_UNSIGNED_INT, nullptr, GLintptr(2 * sizeof(uint32_t)), GLsizei(mMeshletCount), 0);
+            glBindBuffer(GL_PARAMETER_BUFFER, 0);
+        }
+        else
+        {
+            glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, GLsizei(mMeshletCount), 0);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
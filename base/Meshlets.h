@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Cpu.h"
+#include "OcclusionCuller.h"
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    struct MeshletSettings
+    {
+        // 64 vertices and 124 triangles fit the output limits of mesh shaders on most hardware
+        uint32_t maxVertices = 64;
+        uint32_t maxTriangles = 124;
+    };
+
+    // a cluster of neighbouring triangles, laid out for std430 buffers as meshlet_cull.comp reads it
+    struct Meshlet
+    {
+        // object space bounding sphere, w is the radius
+        glm::vec4 sphere;
+
+        // normal cone, xyz is the axis and w the cutoff. Every triangle faces away from a camera at p when
+        // dot(sphere.xyz - p, axis) >= cutoff * length(sphere.xyz - p) + radius, a cutoff of 1 never culls
+        glm::vec4 cone;
+
+        // the triangles are [firstIndex, firstIndex + triangleCount * 3) of MeshletMesh::indices and localIndices
+        uint32_t firstIndex = 0;
+        uint32_t triangleCount = 0;
+
+        // the vertices are [vertexOffset, vertexOffset + vertexCount) of MeshletMesh::vertices
+        uint32_t vertexOffset = 0;
+        uint32_t vertexCount = 0;
+    };
+
+    struct MeshletMesh
+    {
+        std::vector<Meshlet> meshlets;
+
+        // the mesh's index buffer reordered meshlet by meshlet, bind it in place of the original
+        std::vector<uint32_t> indices;
+
+        // the same triangles indexing into the meshlet's vertices, for mesh shaders
+        std::vector<uint32_t> vertices;
+        std::vector<uint8_t> localIndices;
+    };
+
+    // Splits an indexed triangle list into meshlets. Each meshlet grows from a seed triangle by adding the
+    // neighbouring triangle that needs the fewest new vertices, ties go to the one nearest to the meshlet's
+    // center, so meshlets are compact patches with tight spheres and narrow cones. The next meshlet is seeded
+    // next to the last one, which keeps the reordered index buffer in surface order for the vertex cache.
+    // positions holds stride floats per vertex, the first three are the position.
+    bool buildMeshlets(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount,
+        MeshletMesh& result, const MeshletSettings& settings = MeshletSettings());
+    bool buildMeshlets(const Mesh& mesh, MeshletMesh& result, const MeshletSettings& settings = MeshletSettings());
+
+    struct MeshletCullStats
+    {
+        uint32_t meshlets = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t coneCulled = 0;
+        uint32_t visibleMeshlets = 0;
+        uint64_t triangles = 0;
+        uint64_t visibleTriangles = 0;
+    };
+
+    // Frustum and normal cone culling on the CPU, writes one command per visible meshlet and returns how
+    // many. viewProjection and camera are in the meshlets' object space; the cone test only holds for
+    // transforms with uniform scale. Disabling coneCulling keeps the back-facing meshlets.
+    uint32_t cullMeshlets(const Meshlet* meshlets, uint32_t count, const glm::mat4& viewProjection, const glm::vec3& camera,
+        DrawElementsIndirectCommand* commands, MeshletCullStats& stats, bool coneCulling = true,
+        SimdLevel level = getSupportedSimdLevel());
+
+    // The same culling in a compute shader. Visible meshlets are appended to a compacted indirect command
+    // buffer, drawn with glMultiDrawElementsIndirectCount where the driver has GL 4.6 and otherwise with the
+    // zeroed tail of the buffer drawing nothing. Stats lag kFrameLatency frames.
+    class MeshletCuller
+    {
+    public:
+        static constexpr uint32_t kFrameLatency = 3;
+
+        MeshletCuller() = default;
+        ~MeshletCuller();
+
+        MeshletCuller(const MeshletCuller&) = delete;
+        MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+        // cullProgram is the meshlet_cull.comp compute program
+        bool init(std::shared_ptr<OpenglProgram> cullProgram, uint32_t maxMeshlets);
+        void destroy();
+
+        bool setMeshlets(const Meshlet* meshlets, uint32_t count);
+
+        void setConeCullingEnabled(bool enabled) { mConeCulling = enabled; }
+        bool isConeCullingEnabled() const { return mConeCulling; }
+
+        // object space, like cullMeshlets
+        void cull(const glm::mat4& viewProjection, const glm::vec3& camera);
+
+        // bind the VAO with MeshletMesh::indices as its element buffer and the program first. baseInstance
+        // of every command is the meshlet's index, an instanced attribute of divisor 1 can read it
+        void draw(GLenum mode = GL_TRIANGLES) const;
+
+        GLuint getCommandBuffer() const { return mCommands; }
+        uint32_t getMeshletCount() const { return mMeshletCount; }
+
+        const MeshletCullStats& getStats() const { return mStats; }
+
+    private:
+        std::shared_ptr<OpenglProgram> mCullProgram;
+        uint32_t mMaxMeshlets = 0;
+        uint32_t mMeshletCount = 0;
+        uint64_t mTriangleCount = 0;
+
+        GLuint mMeshlets = 0;
+        GLuint mCommands = 0;
+
+        // frustumCulled, coneCulled, drawCount and visibleTriangles per frame in flight, drawCount is the
+        // parameter of the indirect count draw
+        GLuint mStatsBuffers[kFrameLatency] = {};
+        bool mStatsPending[kFrameLatency] = {};
+        uint32_t mFrame = 0;
+
+        bool mConeCulling = true;
+        MeshletCullStats mStats;
+    };
+}
@@ -0,0 +1,296 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "Frustum.h"
+
+namespace utils
+{
+    namespace
+    {
+        // frustumCulled, occluded, earlyDrawn, lateDrawn
+        constexpr uint32_t kStatsCounters = 4;
+
+        uint32_t floorPowerOfTwo(uint32_t value)
+        {
+            uint32_t result = 1;
+            while (result * 2 <= value)
+            {
+                result *= 2;
+            }
+            return result;
+        }
+
+        uint32_t getGroupCount(uint32_t count, uint32_t groupSize)
+        {
+            return (count + groupSize - 1) / groupSize;
+        }
+    }
+
+    OcclusionCuller::~OcclusionCuller()
+    {
+        destroy();
+    }
+
+    bool OcclusionCuller::init(std::shared_ptr<OpenglProgram> pyramidProgram, std::shared_ptr<OpenglProgram> cullProgram, uint32_t maxObjects)
+    {
+        destroy();
+
+        if (pyramidProgram == nullptr || cullProgram == nullptr || maxObjects == 0)
+        {
+            std::cerr << "Occlusion culler needs both compute programs and room for at least one object" << std::endl;
+            return false;
+        }
+
+        mPyramidProgram = pyramidProgram;
+        mCullProgram = cullProgram;
+        mMaxObjects = maxObjects;
+
+        glCreateBuffers(1, &mObjects);
+        glNamedBufferStorage(mObjects, GLsizeiptr(maxObjects) * sizeof(OcclusionObject), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glCreateBuffers(1, &mTemplates);
+        glNamedBufferStorage(mTemplates, GLsizeiptr(maxObjects) * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glCreateBuffers(PHASE_COUNT, mCommands);
+        for (GLuint commands : mCommands)
+        {
+            glNamedBufferStorage(commands, GLsizeiptr(maxObjects) * sizeof(DrawElementsIndirectCommand), nullptr, 0);
+        }
+        glCreateBuffers(1, &mVisibility);
+        glNamedBufferStorage(mVisibility, GLsizeiptr(maxObjects) * sizeof(uint32_t), nullptr, 0);
+        glCreateBuffers(kFrameLatency, mStatsBuffers);
+        for (GLuint stats : mStatsBuffers)
+        {
+            glNamedBufferStorage(stats, kStatsCounters * sizeof(uint32_t), nullptr, 0);
+        }
+        return true;
+    }
+
+    void OcclusionCuller::destroy()
+    {
+        if (mObjects != 0)
+        {
+            glDeleteBuffers(1, &mObjects);
+            glDeleteBuffers(1, &mTemplates);
+            glDeleteBuffers(PHASE_COUNT, mCommands);
+            glDeleteBuffers(1, &mVisibility);
+            glDeleteBuffers(kFrameLatency, mStatsBuffers);
+            mObjects = 0;
+            mTemplates = 0;
+            mVisibility = 0;
+            for (GLuint& commands : mCommands)
+            {
+                commands = 0;
+            }
+            for (uint32_t i = 0; i < kFrameLatency; ++i)
+            {
+                mStatsBuffers[i] = 0;
+                mStatsPending[i] = false;
+            }
+        }
+
+        if (mPyramid != 0)
+        {
+            glDeleteTextures(GLsizei(mPyramidViews.size()), mPyramidViews.data());
+            glDeleteTextures(1, &mPyramid);
+            mPyramidViews.clear();
+            mPyramid = 0;
+            mPyramidLevels = 0;
+        }
+
+        mPyramidProgram.reset();
+        mCullProgram.reset();
+        mMaxObjects = 0;
+        mObjectCount = 0;
+        mDepthWidth = 0;
+        mDepthHeight = 0;
+        mStats = OcclusionCullerStats();
+    }
+
+    bool OcclusionCuller::setObjects(const OcclusionObject* objects, const DrawElementsIndirectCommand* commands, uint32_t count)
+    {
+        if (count > mMaxObjects)
+        {
+            std::cerr << "Occlusion culler has room for " << mMaxObjects << " objects, " << count << " were given" << std::endl;
+            return false;
+        }
+
+        if (count > 0)
+        {
+            glNamedBufferSubData(mObjects, 0, GLsizeiptr(count) * sizeof(OcclusionObject), objects);
+            glNamedBufferSubData(mTemplates, 0, GLsizeiptr(count) * sizeof(DrawElementsIndirectCommand), commands);
+        }
+
+        // a different object set starts without visibility, the late pass of the next frame draws everything visible
+        if (count != mObjectCount)
+        {
+            const uint32_t zero = 0;
+            glClearNamedBufferData(mVisibility, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            mObjectCount = count;
+        }
+        return true;
+    }
+
+    void OcclusionCuller::updateObjects(const OcclusionObject* objects, uint32_t first, uint32_t count)
+    {
+        if (first + count <= mObjectCount && count > 0)
+        {
+            glNamedBufferSubData(mObjects, GLintptr(first) * sizeof(OcclusionObject), GLsizeiptr(count) * sizeof(OcclusionObject), objects);
+        }
+    }
+
+    void OcclusionCuller::resize(uint32_t width, uint32_t height)
+    {
+        if (width == mDepthWidth && height == mDepthHeight)
+        {
+            return;
+        }
+
+        if (mPyramid != 0)
+        {
+            glDeleteTextures(GLsizei(mPyramidViews.size()), mPyramidViews.data());
+            glDeleteTextures(1, &mPyramid);
+            mPyramidViews.clear();
+            mPyramid = 0;
+        }
+
+        mDepthWidth = width;
+        mDepthHeight = height;
+        if (width == 0 || height == 0)
+        {
+            mPyramidLevels = 0;
+            return;
+        }
+
+        // a power of two base keeps every level an exact 2x2 reduction of the one above
+        mPyramidWidth = floorPowerOfTwo(width);
+        mPyramidHeight = floorPowerOfTwo(height);
+        mPyramidLevels = 1;
+        while ((std::max(mPyramidWidth, mPyramidHeight) >> mPyramidLevels) > 0)
+        {
+            ++mPyramidLevels;
+        }
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &mPyramid);
+        glTextureStorage2D(mPyramid, GLsizei(mPyramidLevels), GL_R32F, GLsizei(mPyramidWidth), GLsizei(mPyramidHeight));
+
+        mPyramidViews.resize(mPyramidLevels);
+        glGenTextures(GLsizei(mPyramidLevels), mPyramidViews.data());
+        for (uint32_t level = 0; level < mPyramidLevels; ++level)
+        {
+            glTextureView(mPyramidViews[level], GL_TEXTURE_2D, mPyramid, GL_R32F, level, 1, 0, 1);
+        }
+    }
+
+    void OcclusionCuller::cullEarly(const glm::mat4& viewProjection)
+    {
+        if (mObjects == 0)
+        {
+            return;
+        }
+
+        // the counters of this slot were written kFrameLatency frames ago
+        mFrame = (mFrame + 1) % kFrameLatency;
+        const GLuint stats = mStatsBuffers[mFrame];
+        if (mStatsPending[mFrame])
+        {
+            uint32_t counters[kStatsCounters];
+            glGetNamedBufferSubData(stats, 0, sizeof(counters), counters);
+            mStats.frustumCulled = counters[0];
+            mStats.occluded = counters[1];
+            mStats.earlyDrawn = counters[2];
+            mStats.lateDrawn = counters[3];
+        }
+
+        const uint32_t zero = 0;
+        glClearNamedBufferData(stats, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        mStatsPending[mFrame] = true;
+        mStats.objects = mObjectCount;
+
+        cull(PHASE_EARLY, viewProjection);
+    }
+
+    void OcclusionCuller::buildPyramid(GLuint depthTexture)
+    {
+        if (mPyramid == 0 || !mOcclusionEnabled)
+        {
+            return;
+        }
+
+        mPyramidProgram->use();
+        glUniform1i(glGetUniformLocation(mPyramidProgram->id, "u_source"), 0);
+
+        uint32_t sourceWidth = mDepthWidth;
+        uint32_t sourceHeight = mDepthHeight;
+        for (uint32_t level = 0; level < mPyramidLevels; ++level)
+        {
+            const uint32_t width = std::max(mPyramidWidth >> level, 1u);
+            const uint32_t height = std::max(mPyramidHeight >> level, 1u);
+
+            glBindTextureUnit(0, level == 0 ? depthTexture : mPyramidViews[level - 1]);
+            glBindImageTexture(0, mPyramid, GLint(level), GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glUniform2i(glGetUniformLocation(mPyramidProgram->id, "u_sourceSize"), GLint(sourceWidth), GLint(sourceHeight));
+            glUniform2i(glGetUniformLocation(mPyramidProgram->id, "u_destinationSize"), GLint(width), GLint(height));
+            glDispatchCompute(getGroupCount(width, 8), getGroupCount(height, 8), 1);
+
+            // the next level samples what this one wrote
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+            sourceWidth = width;
+            sourceHeight = height;
+        }
+
+        glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindTextureUnit(0, 0);
+    }
+
+    void OcclusionCuller::cullLate(const glm::mat4& viewProjection)
+    {
+        if (mObjects != 0)
+        {
+            cull(PHASE_LATE, viewProjection);
+        }
+    }
+
+    void OcclusionCuller::cull(Phase phase, const glm::mat4& viewProjection)
+    {
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        const GLuint program = mCullProgram->id;
+
+        mCullProgram->use();
+        mCullProgram->setMat4("u_viewProjection", viewProjection);
+        glUniform4fv(glGetUniformLocation(program, "u_frustum"), Frustum::PLANE_COUNT, &frustum.planes[0][0]);
+        glUniform1ui(glGetUniformLocation(program, "u_objectCount"), mObjectCount);
+        glUniform1ui(glGetUniformLocation(program, "u_phase"), phase);
+        glUniform1i(glGetUniformLocation(program, "u_occlusion"), mOcclusionEnabled && mPyramid != 0 ? 1 : 0);
+        glUniform2i(glGetUniformLocation(program, "u_pyramidSize"), GLint(mPyramidWidth), GLint(mPyramidHeight));
+        glUniform1i(glGetUniformLocation(program, "u_pyramidLevels"), GLint(mPyramidLevels));
+        glUniform1i(glGetUniformLocation(program, "u_pyramid"), 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mObjects);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mTemplates);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mCommands[phase]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mVisibility);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, mCommands[PHASE_EARLY]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mStatsBuffers[mFrame]);
+        glBindTextureUnit(0, mPyramid);
+
+        glDispatchCompute(getGroupCount(mObjectCount, 64), 1, 1);
+
+        // the commands are consumed by indirect draws and, for the early ones, by the late pass
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        glBindTextureUnit(0, 0);
+    }
+
+    void OcclusionCuller::draw(Phase phase, GLenum mode) const
+    {
+        if (mObjectCount == 0)
+        {
+            return;
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommands[phase]);
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT, nullptr, GLsizei(mObjectCount), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    // layout of GL_DRAW_INDIRECT_BUFFER entries for glMultiDrawElementsIndirect
+    struct DrawElementsIndirectCommand
+    {
+        uint32_t count = 0;
+        uint32_t instanceCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t baseVertex = 0;
+        uint32_t baseInstance = 0;
+    };
+
+    // world space bounds of a culled object, w is unused
+    struct OcclusionObject
+    {
+        glm::vec4 boundsMin;
+        glm::vec4 boundsMax;
+    };
+
+    struct OcclusionCullerStats
+    {
+        uint32_t objects = 0;
+        uint32_t frustumCulled = 0;
+        uint32_t occluded = 0;
+
+        // drawn in the early pass because they were visible last frame, drawn after the re-test
+        uint32_t earlyDrawn = 0;
+        uint32_t lateDrawn = 0;
+    };
+
+    // Two-phase hierarchical-Z occlusion culling on the GPU, one indirect command per object:
+    //   cullEarly    - objects visible last frame that pass the frustum test get instanceCount 1
+    //   draw early   - their depth is what the last frame's visible set looks like from the current camera
+    //   buildPyramid - max-reduces that depth into a mip chain
+    //   cullLate     - every object in the frustum is tested against the pyramid, visible objects not drawn
+    //                  early are drawn now, so newly disoccluded objects show up without a frame of delay
+    // The late result is the visibility the next frame's early pass starts from. Stats lag kFrameLatency frames.
+    class OcclusionCuller
+    {
+    public:
+        enum Phase : uint32_t
+        {
+            PHASE_EARLY,
+            PHASE_LATE,
+            PHASE_COUNT,
+        };
+
+        static constexpr uint32_t kFrameLatency = 3;
+
+        OcclusionCuller() = default;
+        ~OcclusionCuller();
+
+        OcclusionCuller(const OcclusionCuller&) = delete;
+        OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+
+        // pyramidProgram and cullProgram are the depth_pyramid.comp and occlusion_cull.comp compute programs
+        bool init(std::shared_ptr<OpenglProgram> pyramidProgram, std::shared_ptr<OpenglProgram> cullProgram, uint32_t maxObjects);
+        void destroy();
+
+        // instanceCount of the commands is ignored, a changed count resets the visibility of the last frame
+        bool setObjects(const OcclusionObject* objects, const DrawElementsIndirectCommand* commands, uint32_t count);
+
+        // for moving objects, bounds only
+        void updateObjects(const OcclusionObject* objects, uint32_t first, uint32_t count);
+
+        // size of the depth buffer passed to buildPyramid
+        void resize(uint32_t width, uint32_t height);
+
+        // without occlusion the early pass draws everything in the frustum and the late pass nothing
+        void setOcclusionEnabled(bool enabled) { mOcclusionEnabled = enabled; }
+        bool isOcclusionEnabled() const { return mOcclusionEnabled; }
+
+        void cullEarly(const glm::mat4& viewProjection);
+        void buildPyramid(GLuint depthTexture);
+        void cullLate(const glm::mat4& viewProjection);
+
+        // one glMultiDrawElementsIndirect over all objects, culled ones have no instances. Bind the VAO and
+        // program first, gl_BaseInstance / gl_InstanceID + baseInstance identifies the object
+        void draw(Phase phase, GLenum mode = GL_TRIANGLES) const;
+
+        GLuint getCommandBuffer(Phase phase) const { return mCommands[phase]; }
+        GLuint getPyramid() const { return mPyramid; }
+        uint32_t getPyramidLevels() const { return mPyramidLevels; }
+        uint32_t getObjectCount() const { return mObjectCount; }
+
+        const OcclusionCullerStats& getStats() const { return mStats; }
+
+    private:
+        void cull(Phase phase, const glm::mat4& viewProjection);
+
+        std::shared_ptr<OpenglProgram> mPyramidProgram;
+        std::shared_ptr<OpenglProgram> mCullProgram;
+        uint32_t mMaxObjects = 0;
+        uint32_t mObjectCount = 0;
+
+        GLuint mObjects = 0;
+        GLuint mTemplates = 0;
+        GLuint mCommands[PHASE_COUNT] = {};
+
+        // 1 for objects visible at the end of the last frame
+        GLuint mVisibility = 0;
+
+        // one small counter buffer per frame in flight, read back kFrameLatency frames later
+        GLuint mStatsBuffers[kFrameLatency] = {};
+        bool mStatsPending[kFrameLatency] = {};
+        uint32_t mFrame = 0;
+
+        // R32F max depth, level 0 is the largest power of two not above the depth buffer size
+        GLuint mPyramid = 0;
+        uint32_t mPyramidWidth = 0;
+        uint32_t mPyramidHeight = 0;
+        uint32_t mPyramidLevels = 0;
+        uint32_t mDepthWidth = 0;
+        uint32_t mDepthHeight = 0;
+
+        // a single level view per mip, the reduction samples one level while writing the next
+        std::vector<GLuint> mPyramidViews;
+
+        bool mOcclusionEnabled = true;
+        OcclusionCullerStats mStats;
+    };
+}
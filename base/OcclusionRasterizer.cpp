@@ -0,0 +1,564 @@
+#include "OcclusionRasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define OCCLUSION_X86 1
+#include <immintrin.h>
+#endif
+
+// the AVX2 paths are compiled for their instruction set individually and selected at runtime
+#if defined(OCCLUSION_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        double getMilliseconds(Clock::time_point start)
+        {
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+
+        uint32_t roundUp(uint32_t value, uint32_t multiple)
+        {
+            return (value + multiple - 1) / multiple * multiple;
+        }
+
+        void transformScalar(const float* positions, uint32_t first, uint32_t count, uint32_t stride, const glm::mat4& matrix, float* const clip[4])
+        {
+            for (uint32_t i = first; i < count; ++i)
+            {
+                const float* position = positions + size_t(i) * stride;
+                const glm::vec4 result = matrix * glm::vec4(position[0], position[1], position[2], 1.0f);
+                for (uint32_t component = 0; component < 4; ++component)
+                {
+                    clip[component][i] = result[component];
+                }
+            }
+        }
+
+        void rasterizeScalar(const OcclusionRasterizer::Triangle& triangle, int32_t x0, int32_t y0, int32_t x1, int32_t y1, float* depth, uint32_t stride)
+        {
+            for (int32_t y = y0; y < y1; ++y)
+            {
+                float* line = depth + size_t(y) * stride;
+                for (int32_t x = x0; x < x1; ++x)
+                {
+                    const float fx = float(x);
+                    const float fy = float(y);
+                    const float e0 = triangle.edgeA[0] * fx + triangle.edgeB[0] * fy + triangle.edgeC[0];
+                    const float e1 = triangle.edgeA[1] * fx + triangle.edgeB[1] * fy + triangle.edgeC[1];
+                    const float e2 = triangle.edgeA[2] * fx + triangle.edgeB[2] * fy + triangle.edgeC[2];
+                    if (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f)
+                    {
+                        const float z = triangle.depthA * fx + triangle.depthB * fy + triangle.depthC;
+                        line[x] = std::min(line[x], z);
+                    }
+                }
+            }
+        }
+
+        float getBlockMaxScalar(const float* depth, uint32_t stride)
+        {
+            float result = 0.0f;
+            for (uint32_t y = 0; y < OcclusionRasterizer::kBlockSize; ++y)
+            {
+                for (uint32_t x = 0; x < OcclusionRasterizer::kBlockSize; ++x)
+                {
+                    result = std::max(result, depth[size_t(y) * stride + x]);
+                }
+            }
+            return result;
+        }
+
+#if defined(OCCLUSION_X86)
+        // 8 vertices per iteration, the positions are gathered out of the caller's interleaved layout
+        TARGET_AVX2 uint32_t transformAvx2(const float* positions, uint32_t count, uint32_t stride, const glm::mat4& matrix, float* const clip[4])
+        {
+            const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int32_t(stride)));
+
+            uint32_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                const float* base = positions + size_t(i) * stride;
+                const __m256 x = _mm256_i32gather_ps(base + 0, offsets, 4);
+                const __m256 y = _mm256_i32gather_ps(base + 1, offsets, 4);
+                const __m256 z = _mm256_i32gather_ps(base + 2, offsets, 4);
+
+                for (uint32_t component = 0; component < 4; ++component)
+                {
+                    __m256 result = _mm256_set1_ps(matrix[3][component]);
+                    result = _mm256_fmadd_ps(_mm256_set1_ps(matrix[0][component]), x, result);
+                    result = _mm256_fmadd_ps(_mm256_set1_ps(matrix[1][component]), y, result);
+                    result = _mm256_fmadd_ps(_mm256_set1_ps(matrix[2][component]), z, result);
+                    _mm256_storeu_ps(clip[component] + i, result);
+                }
+            }
+            return i;
+        }
+
+        // spans of 8 pixels start on 8 pixel boundaries, tiles are a multiple of 8 wide so spans never leave the tile
+        TARGET_AVX2 void rasterizeAvx2(const OcclusionRasterizer::Triangle& triangle, int32_t x0, int32_t y0, int32_t x1, int32_t y1, float* depth, uint32_t stride)
+        {
+            const __m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+            const __m256 edgeA0 = _mm256_set1_ps(triangle.edgeA[0]);
+            const __m256 edgeA1 = _mm256_set1_ps(triangle.edgeA[1]);
+            const __m256 edgeA2 = _mm256_set1_ps(triangle.edgeA[2]);
+            const __m256 depthA = _mm256_set1_ps(triangle.depthA);
+            const int32_t spanBegin = x0 & ~7;
+
+            for (int32_t y = y0; y < y1; ++y)
+            {
+                const float fy = float(y);
+                const __m256 row0 = _mm256_set1_ps(triangle.edgeB[0] * fy + triangle.edgeC[0]);
+                const __m256 row1 = _mm256_set1_ps(triangle.edgeB[1] * fy + triangle.edgeC[1]);
+                const __m256 row2 = _mm256_set1_ps(triangle.edgeB[2] * fy + triangle.edgeC[2]);
+                const __m256 rowDepth = _mm256_set1_ps(triangle.depthB * fy + triangle.depthC);
+                float* line = depth + size_t(y) * stride;
+
+                for (int32_t x = spanBegin; x < x1; x += 8)
+                {
+                    const __m256 px = _mm256_add_ps(_mm256_set1_ps(float(x)), lane);
+
+                    // the sign bit is set for pixels outside any of the edges
+                    const __m256 outside = _mm256_or_ps(_mm256_fmadd_ps(edgeA0, px, row0),
+                        _mm256_or_ps(_mm256_fmadd_ps(edgeA1, px, row1), _mm256_fmadd_ps(edgeA2, px, row2)));
+                    if (_mm256_movemask_ps(outside) == 0xff)
+                    {
+                        continue;
+                    }
+
+                    const __m256 z = _mm256_fmadd_ps(depthA, px, rowDepth);
+                    const __m256 current = _mm256_loadu_ps(line + x);
+                    _mm256_storeu_ps(line + x, _mm256_blendv_ps(_mm256_min_ps(current, z), current, outside));
+                }
+            }
+        }
+
+        TARGET_AVX2 float getBlockMaxAvx2(const float* depth, uint32_t stride)
+        {
+            __m256 result = _mm256_loadu_ps(depth);
+            for (uint32_t y = 1; y < OcclusionRasterizer::kBlockSize; ++y)
+            {
+                result = _mm256_max_ps(result, _mm256_loadu_ps(depth + size_t(y) * stride));
+            }
+
+            __m128 half = _mm_max_ps(_mm256_castps256_ps128(result), _mm256_extractf128_ps(result, 1));
+            half = _mm_max_ps(half, _mm_movehl_ps(half, half));
+            half = _mm_max_ss(half, _mm_shuffle_ps(half, half, 1));
+            return _mm_cvtss_f32(half);
+        }
+#endif
+    }
+
+    bool OcclusionRasterizer::init(uint32_t width, uint32_t height)
+    {
+        if (width == 0 || height == 0)
+        {
+            std::cerr << "Occlusion rasterizer needs a non-empty depth buffer" << std::endl;
+            return false;
+        }
+
+        mWidth = roundUp(width, kTileWidth);
+        mHeight = roundUp(height, kTileHeight);
+        mTilesX = mWidth / kTileWidth;
+        mTilesY = mHeight / kTileHeight;
+        mSimdLevel = getSupportedSimdLevel();
+
+        mDepth.assign(size_t(mWidth) * mHeight, 1.0f);
+        mBlockDepth.assign(size_t(mWidth / kBlockSize) * (mHeight / kBlockSize), 1.0f);
+        mTileDepth.assign(size_t(mTilesX) * mTilesY, 1.0f);
+        mBins.assign(size_t(mTilesX) * mTilesY, std::vector<uint32_t>());
+        mTriangles.clear();
+        return true;
+    }
+
+    void OcclusionRasterizer::setSimdLevel(SimdLevel level)
+    {
+        mSimdLevel = clampSimdLevel(level);
+    }
+
+    void OcclusionRasterizer::beginFrame(const glm::mat4& viewProjection)
+    {
+        mViewProjection = viewProjection;
+
+        std::fill(mDepth.begin(), mDepth.end(), 1.0f);
+        std::fill(mBlockDepth.begin(), mBlockDepth.end(), 1.0f);
+        std::fill(mTileDepth.begin(), mTileDepth.end(), 1.0f);
+        for (std::vector<uint32_t>& bin : mBins)
+        {
+            bin.clear();
+        }
+        mTriangles.clear();
+
+        mStats = OcclusionRasterizerStats();
+        mTested = 0;
+        mOccluded = 0;
+    }
+
+    void OcclusionRasterizer::addOccluder(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount, const glm::mat4& model, bool twoSided)
+    {
+        if (mBins.empty() || vertexCount == 0 || indexCount < 3)
+        {
+            return;
+        }
+
+        const Clock::time_point start = Clock::now();
+        const glm::mat4 matrix = mViewProjection * model;
+
+        float* clip[4];
+        for (uint32_t component = 0; component < 4; ++component)
+        {
+            if (mClip[component].size() < vertexCount)
+            {
+                mClip[component].resize(vertexCount);
+            }
+            clip[component] = mClip[component].data();
+        }
+
+        uint32_t transformed = 0;
+#if defined(OCCLUSION_X86)
+        if (mSimdLevel == SimdLevel::SIMD_AVX2)
+        {
+            transformed = transformAvx2(positions, vertexCount, stride, matrix, clip);
+        }
+#endif
+        transformScalar(positions, transformed, vertexCount, stride, matrix, clip);
+
+        for (uint32_t i = 0; i + 3 <= indexCount; i += 3)
+        {
+            const uint32_t i0 = indices[i + 0];
+            const uint32_t i1 = indices[i + 1];
+            const uint32_t i2 = indices[i + 2];
+            if (i0 >= vertexCount || i1 >= vertexCount || i2 >= vertexCount)
+            {
+                continue;
+            }
+
+            addTriangle(glm::vec4(clip[0][i0], clip[1][i0], clip[2][i0], clip[3][i0]),
+                glm::vec4(clip[0][i1], clip[1][i1], clip[2][i1], clip[3][i1]),
+                glm::vec4(clip[0][i2], clip[1][i2], clip[2][i2], clip[3][i2]), twoSided);
+        }
+
+        mStats.occluders += 1;
+        mStats.triangles += indexCount / 3;
+        mStats.transformTime += getMilliseconds(start);
+    }
+
+    void OcclusionRasterizer::addOccluder(const Mesh& mesh, const glm::mat4& model, bool twoSided)
+    {
+        // Mesh positions are x, y, z, w
+        addOccluder(mesh.mVertices.data(), uint32_t(mesh.mVertices.size() / 4), 4, mesh.mIndices.data(), uint32_t(mesh.mIndices.size()), model, twoSided);
+    }
+
+    void OcclusionRasterizer::addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, bool twoSided)
+    {
+        // trivially outside one of the frustum planes other than near
+        if ((a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+            (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w) ||
+            (a.z > a.w && b.z > b.w && c.z > c.w))
+        {
+            return;
+        }
+
+        // clip against the near plane z = -w, a triangle becomes at most a quad
+        const glm::vec4 input[3] = { a, b, c };
+        glm::vec4 polygon[4];
+        uint32_t count = 0;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            const glm::vec4& current = input[i];
+            const glm::vec4& next = input[(i + 1) % 3];
+            const float currentDistance = current.z + current.w;
+            const float nextDistance = next.z + next.w;
+
+            if (currentDistance >= 0.0f)
+            {
+                polygon[count++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            {
+                polygon[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+            }
+        }
+
+        if (count < 3)
+        {
+            return;
+        }
+
+        glm::vec3 screen[4];
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const glm::vec3 ndc = glm::vec3(polygon[i]) / polygon[i].w;
+            screen[i] = glm::vec3((ndc.x * 0.5f + 0.5f) * float(mWidth), (ndc.y * 0.5f + 0.5f) * float(mHeight), ndc.z * 0.5f + 0.5f);
+        }
+
+        for (uint32_t i = 1; i + 1 < count; ++i)
+        {
+            addScreenTriangle(screen[0], screen[i], screen[i + 1], twoSided);
+        }
+    }
+
+    void OcclusionRasterizer::addScreenTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, bool twoSided)
+    {
+        float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        if (area == 0.0f || (area < 0.0f && !twoSided))
+        {
+            return;
+        }
+
+        // clockwise triangles of two sided occluders are flipped so inside is always positive
+        const glm::vec3 v0 = a;
+        const glm::vec3 v1 = area < 0.0f ? c : b;
+        const glm::vec3 v2 = area < 0.0f ? b : c;
+        area = std::abs(area);
+
+        // pixels whose centers are inside the bounds, clamped before the conversion so far away vertices don't overflow
+        const float width = float(mWidth);
+        const float height = float(mHeight);
+        const float minX = std::clamp(std::min({ v0.x, v1.x, v2.x }) - 0.5f, -1.0f, width + 1.0f);
+        const float minY = std::clamp(std::min({ v0.y, v1.y, v2.y }) - 0.5f, -1.0f, height + 1.0f);
+        const float maxX = std::clamp(std::max({ v0.x, v1.x, v2.x }) - 0.5f, -1.0f, width + 1.0f);
+        const float maxY = std::clamp(std::max({ v0.y, v1.y, v2.y }) - 0.5f, -1.0f, height + 1.0f);
+
+        Triangle triangle;
+        triangle.minX = std::max(int32_t(std::ceil(minX)), 0);
+        triangle.minY = std::max(int32_t(std::ceil(minY)), 0);
+        triangle.maxX = std::min(int32_t(std::floor(maxX)) + 1, int32_t(mWidth));
+        triangle.maxY = std::min(int32_t(std::floor(maxY)) + 1, int32_t(mHeight));
+        if (triangle.minX >= triangle.maxX || triangle.minY >= triangle.maxY)
+        {
+            return;
+        }
+
+        // edge i runs from vertex i to i + 1, E(x, y) = A x + B y + C is positive inside
+        const glm::vec3 vertices[3] = { v0, v1, v2 };
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            const glm::vec3& from = vertices[i];
+            const glm::vec3& to = vertices[(i + 1) % 3];
+            const float edgeA = from.y - to.y;
+            const float edgeB = to.x - from.x;
+            const float edgeC = (to.y - from.y) * from.x - (to.x - from.x) * from.y;
+
+            triangle.edgeA[i] = edgeA;
+            triangle.edgeB[i] = edgeB;
+            triangle.edgeC[i] = edgeC + 0.5f * (edgeA + edgeB);
+        }
+
+        // each edge weights the vertex opposite to it
+        const float inverseArea = 1.0f / area;
+        const float weight0 = v2.z * inverseArea;
+        const float weight1 = v0.z * inverseArea;
+        const float weight2 = v1.z * inverseArea;
+        triangle.depthA = triangle.edgeA[0] * weight0 + triangle.edgeA[1] * weight1 + triangle.edgeA[2] * weight2;
+        triangle.depthB = triangle.edgeB[0] * weight0 + triangle.edgeB[1] * weight1 + triangle.edgeB[2] * weight2;
+        triangle.depthC = triangle.edgeC[0] * weight0 + triangle.edgeC[1] * weight1 + triangle.edgeC[2] * weight2;
+
+        const uint32_t index = uint32_t(mTriangles.size());
+        mTriangles.push_back(triangle);
+        mStats.trianglesRasterized += 1;
+
+        const uint32_t tileX0 = uint32_t(triangle.minX) / kTileWidth;
+        const uint32_t tileY0 = uint32_t(triangle.minY) / kTileHeight;
+        const uint32_t tileX1 = uint32_t(triangle.maxX - 1) / kTileWidth;
+        const uint32_t tileY1 = uint32_t(triangle.maxY - 1) / kTileHeight;
+        for (uint32_t y = tileY0; y <= tileY1; ++y)
+        {
+            for (uint32_t x = tileX0; x <= tileX1; ++x)
+            {
+                mBins[size_t(y) * mTilesX + x].push_back(index);
+            }
+        }
+        mStats.binnedTriangles += (tileX1 - tileX0 + 1) * (tileY1 - tileY0 + 1);
+    }
+
+    void OcclusionRasterizer::rasterize(ThreadPool* pool)
+    {
+        const Clock::time_point start = Clock::now();
+        const uint32_t tileCount = mTilesX * mTilesY;
+
+        if (pool != nullptr)
+        {
+            pool->parallelFor(tileCount, 1, [this](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t tile = begin; tile < end; ++tile)
+                {
+                    rasterizeTile(tile);
+                }
+            });
+        }
+        else
+        {
+            for (uint32_t tile = 0; tile < tileCount; ++tile)
+            {
+                rasterizeTile(tile);
+            }
+        }
+
+        mStats.rasterTime += getMilliseconds(start);
+    }
+
+    void OcclusionRasterizer::rasterizeTile(uint32_t tile)
+    {
+        const std::vector<uint32_t>& bin = mBins[tile];
+        if (bin.empty())
+        {
+            return;
+        }
+
+        const int32_t tileX0 = int32_t((tile % mTilesX) * kTileWidth);
+        const int32_t tileY0 = int32_t((tile / mTilesX) * kTileHeight);
+        const int32_t tileX1 = tileX0 + int32_t(kTileWidth);
+        const int32_t tileY1 = tileY0 + int32_t(kTileHeight);
+        const bool avx2 = mSimdLevel == SimdLevel::SIMD_AVX2;
+
+        for (uint32_t index : bin)
+        {
+            const Triangle& triangle = mTriangles[index];
+            const int32_t x0 = std::max(triangle.minX, tileX0);
+            const int32_t y0 = std::max(triangle.minY, tileY0);
+            const int32_t x1 = std::min(triangle.maxX, tileX1);
+            const int32_t y1 = std::min(triangle.maxY, tileY1);
+
+#if defined(OCCLUSION_X86)
+            if (avx2)
+            {
+                rasterizeAvx2(triangle, x0, y0, x1, y1, mDepth.data(), mWidth);
+                continue;
+            }
+#endif
+            rasterizeScalar(triangle, x0, y0, x1, y1, mDepth.data(), mWidth);
+        }
+
+        // the farthest depth of every block and of the whole tile
+        const uint32_t blocksPerRow = mWidth / kBlockSize;
+        float tileDepth = 0.0f;
+        for (int32_t y = tileY0; y < tileY1; y += kBlockSize)
+        {
+            for (int32_t x = tileX0; x < tileX1; x += kBlockSize)
+            {
+                const float* block = mDepth.data() + size_t(y) * mWidth + x;
+                float blockDepth;
+#if defined(OCCLUSION_X86)
+                if (avx2)
+                {
+                    blockDepth = getBlockMaxAvx2(block, mWidth);
+                }
+                else
+#endif
+                {
+                    blockDepth = getBlockMaxScalar(block, mWidth);
+                }
+
+                mBlockDepth[size_t(y / kBlockSize) * blocksPerRow + x / kBlockSize] = blockDepth;
+                tileDepth = std::max(tileDepth, blockDepth);
+            }
+        }
+        mTileDepth[tile] = tileDepth;
+    }
+
+    bool OcclusionRasterizer::isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+    {
+        if (mBins.empty())
+        {
+            return true;
+        }
+        mTested.fetch_add(1, std::memory_order_relaxed);
+
+        glm::vec2 screenMin(std::numeric_limits<float>::max());
+        glm::vec2 screenMax(-std::numeric_limits<float>::max());
+        float nearest = 1.0f;
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            const glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+            const glm::vec4 clip = mViewProjection * glm::vec4(corner, 1.0f);
+
+            // boxes reaching through the near plane cover an unbounded screen area
+            if (clip.z < -clip.w || clip.w <= 0.0f)
+            {
+                return true;
+            }
+
+            const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            const glm::vec2 screen((ndc.x * 0.5f + 0.5f) * float(mWidth), (ndc.y * 0.5f + 0.5f) * float(mHeight));
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+
+        // every pixel the rectangle touches
+        const int32_t x0 = int32_t(std::floor(std::clamp(screenMin.x, 0.0f, float(mWidth))));
+        const int32_t y0 = int32_t(std::floor(std::clamp(screenMin.y, 0.0f, float(mHeight))));
+        const int32_t x1 = int32_t(std::ceil(std::clamp(screenMax.x, 0.0f, float(mWidth))));
+        const int32_t y1 = int32_t(std::ceil(std::clamp(screenMax.y, 0.0f, float(mHeight))));
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return false;
+        }
+
+        const uint32_t blocksPerRow = mWidth / kBlockSize;
+        for (int32_t tileY = y0 / int32_t(kTileHeight); tileY <= (y1 - 1) / int32_t(kTileHeight); ++tileY)
+        {
+            for (int32_t tileX = x0 / int32_t(kTileWidth); tileX <= (x1 - 1) / int32_t(kTileWidth); ++tileX)
+            {
+                if (mTileDepth[size_t(tileY) * mTilesX + tileX] < nearest)
+                {
+                    continue;
+                }
+
+                const int32_t tileX0 = std::max(x0, tileX * int32_t(kTileWidth));
+                const int32_t tileY0 = std::max(y0, tileY * int32_t(kTileHeight));
+                const int32_t tileX1 = std::min(x1, (tileX + 1) * int32_t(kTileWidth));
+                const int32_t tileY1 = std::min(y1, (tileY + 1) * int32_t(kTileHeight));
+                for (int32_t blockY = tileY0 / int32_t(kBlockSize); blockY <= (tileY1 - 1) / int32_t(kBlockSize); ++blockY)
+                {
+                    for (int32_t blockX = tileX0 / int32_t(kBlockSize); blockX <= (tileX1 - 1) / int32_t(kBlockSize); ++blockX)
+                    {
+                        if (mBlockDepth[size_t(blockY) * blocksPerRow + blockX] < nearest)
+                        {
+                            continue;
+                        }
+
+                        const int32_t px1 = std::min(tileX1, (blockX + 1) * int32_t(kBlockSize));
+                        const int32_t py1 = std::min(tileY1, (blockY + 1) * int32_t(kBlockSize));
+                        for (int32_t y = std::max(tileY0, blockY * int32_t(kBlockSize)); y < py1; ++y)
+                        {
+                            for (int32_t x = std::max(tileX0, blockX * int32_t(kBlockSize)); x < px1; ++x)
+                            {
+                                if (mDepth[size_t(y) * mWidth + x] >= nearest)
+                                {
+                                    return true;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        mOccluded.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    OcclusionRasterizerStats OcclusionRasterizer::getStats() const
+    {
+        OcclusionRasterizerStats stats = mStats;
+        stats.occludeesTested = mTested.load(std::memory_order_relaxed);
+        stats.occludeesOccluded = mOccluded.load(std::memory_order_relaxed);
+        return stats;
+    }
+}
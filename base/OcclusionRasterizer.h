@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Cpu.h"
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    struct OcclusionRasterizerStats
+    {
+        uint32_t occluders = 0;
+        uint32_t triangles = 0;
+
+        // triangles left after backface, viewport and near plane clipping, binned ones count once per tile
+        uint32_t trianglesRasterized = 0;
+        uint32_t binnedTriangles = 0;
+
+        uint32_t occludeesTested = 0;
+        uint32_t occludeesOccluded = 0;
+
+        double transformTime = 0.0;
+        double rasterTime = 0.0;
+    };
+
+    // CPU occlusion culling against a small software depth buffer, for paths without GPU readback or compute:
+    //   beginFrame   - clears the depth buffer and stores the view projection
+    //   addOccluder  - transforms a low poly mesh 8 vertices at a time, clips and bins its triangles into tiles
+    //   rasterize    - tiles are rasterized in parallel, 8 pixel spans are tested against the edges at once and
+    //                  only covered pixels take the nearer depth. Each 8x8 block and tile keeps its farthest depth
+    //   isVisible    - an occludee's screen rectangle and nearest depth are tested against tiles, then blocks,
+    //                  then pixels, it is occluded when every pixel it touches is nearer
+    // Coverage is sampled at pixel centers like the GPU, so silhouettes are accurate to a pixel of the
+    // (coarse) buffer rather than strictly conservative.
+    class OcclusionRasterizer
+    {
+    public:
+        static constexpr uint32_t kTileWidth = 32;
+        static constexpr uint32_t kTileHeight = 16;
+        static constexpr uint32_t kBlockSize = 8;
+
+        // a set up screen space triangle, edge functions and depth plane are in pixel coordinates with the
+        // pixel center folded into the constant, the bounds are the covered pixel centers (max exclusive)
+        struct Triangle
+        {
+            float edgeA[3];
+            float edgeB[3];
+            float edgeC[3];
+            float depthA;
+            float depthB;
+            float depthC;
+            int32_t minX;
+            int32_t minY;
+            int32_t maxX;
+            int32_t maxY;
+        };
+
+        OcclusionRasterizer() = default;
+
+        OcclusionRasterizer(const OcclusionRasterizer&) = delete;
+        OcclusionRasterizer& operator=(const OcclusionRasterizer&) = delete;
+
+        // the size is rounded up to whole tiles, 256x128 is plenty for occlusion
+        bool init(uint32_t width, uint32_t height);
+
+        // defaults to the best level supported by the CPU, SSE4.1 falls back to the scalar rasterizer
+        void setSimdLevel(SimdLevel level);
+        SimdLevel getSimdLevel() const { return mSimdLevel; }
+
+        void beginFrame(const glm::mat4& viewProjection);
+
+        // positions are x, y, z triples with stride floats between vertices, indices form a triangle list.
+        // Counter clockwise triangles face the camera, twoSided occluders such as planes skip backface culling
+        void addOccluder(const float* positions, uint32_t vertexCount, uint32_t stride, const uint32_t* indices, uint32_t indexCount, const glm::mat4& model, bool twoSided = false);
+        void addOccluder(const Mesh& mesh, const glm::mat4& model, bool twoSided = false);
+
+        // without a pool the tiles are rasterized on the calling thread
+        void rasterize(ThreadPool* pool = nullptr);
+
+        // world space bounds, safe to call from several threads after rasterize(). Boxes crossing the near plane
+        // are visible, boxes outside the viewport are not
+        bool isVisible(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+
+        uint32_t getWidth() const { return mWidth; }
+        uint32_t getHeight() const { return mHeight; }
+
+        // row major, bottom row first like glReadPixels, 0 is the near plane and 1 the cleared far plane
+        const float* getDepth() const { return mDepth.data(); }
+
+        OcclusionRasterizerStats getStats() const;
+
+    private:
+        void addTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, bool twoSided);
+        void addScreenTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, bool twoSided);
+        void rasterizeTile(uint32_t tile);
+
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        uint32_t mTilesX = 0;
+        uint32_t mTilesY = 0;
+        SimdLevel mSimdLevel = SimdLevel::SIMD_SCALAR;
+
+        glm::mat4 mViewProjection = glm::mat4(1.0f);
+
+        std::vector<float> mDepth;
+        std::vector<float> mBlockDepth;
+        std::vector<float> mTileDepth;
+
+        std::vector<Triangle> mTriangles;
+        std::vector<std::vector<uint32_t>> mBins;
+
+        // clip space positions of the occluder being added, structure of arrays
+        std::vector<float> mClip[4];
+
+        OcclusionRasterizerStats mStats;
+        mutable std::atomic<uint32_t> mTested{ 0 };
+        mutable std::atomic<uint32_t> mOccluded{ 0 };
+    };
+}
@@ -1,12 +1,22 @@
 #include "OpenGLExampleBase.h"
-
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 
+#include "AssetArchive.h"
+#include "GpuResidency.h"
+#include "JobSystem.h"
+#include "VertexLayout.h"
+
 OpenGLExampleBase* OpenGLExampleBase::exampleBase = nullptr;
 
 OpenGLExampleBase::OpenGLExampleBase()
 {
     exampleBase = this;
+
+    // data.pack is built by the data_pack target, without it assets load from the data directory
+    utils::AssetFileSystem::global().mount(getAssetPackPath(), getAssetPath());
 }
 
 OpenGLExampleBase::~OpenGLExampleBase()
@@ -31,9 +41,21 @@ void OpenGLExampleBase::handleMouseButtonCallback(GLFWwindow* window, int key, i
 
 }
 
-void OpenGLExampleBase::handleWindowResize(GLFWwindow* window, int width, int height)
+void OpenGLExampleBase::handleCursorPosCallback(GLFWwindow* window, double x, double y)
 {
+    exampleBase->mMouseX = x;
+    exampleBase->mMouseY = y;
+    exampleBase->onMouseMove();
+}
 
+void OpenGLExampleBase::handleWindowResize(GLFWwindow* window, int width, int height)
+{
+    // minimized windows report a zero size, keep rendering at the last one
+    if (exampleBase != nullptr && width > 0 && height > 0)
+    {
+        exampleBase->mWidth = uint32_t(width);
+        exampleBase->mHeight = uint32_t(height);
+    }
 }
 
 void OpenGLExampleBase::setupWindow()
@@ -53,8 +75,6 @@ void OpenGLExampleBase::setupWindow()
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-    glfwSwapInterval(1);
-
 #ifdef _DEBUG
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
 	glfwSetErrorCallback([](int error, const char* description)
@@ -63,6 +83,14 @@ void OpenGLExampleBase::setupWindow()
     });
 #endif
 
+    if (mHeadless)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+        // a hidden window has no vblank to wait for
+        mFramePacerSettings.swapMode = utils::SwapMode::SWAP_IMMEDIATE;
+    }
+
 	mWindow = glfwCreateWindow(mWidth, mHeight, "OpenGLRenderLib", nullptr, nullptr);
 	if (!mWindow)
     {
@@ -74,6 +102,7 @@ void OpenGLExampleBase::setupWindow()
 	glfwSetFramebufferSizeCallback(mWindow, handleWindowResize);
 	glfwSetKeyCallback(mWindow, handleKeyCallback);
     glfwSetMouseButtonCallback(mWindow, handleMouseButtonCallback);
+    glfwSetCursorPosCallback(mWindow, handleCursorPosCallback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
@@ -82,6 +111,32 @@ void OpenGLExampleBase::setupWindow()
     }
 
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << ", " << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
+
+#ifdef _DEBUG
+    mDebugOutput.init();
+#endif
+
+    // swap interval and fences need a current context
+    mFramePacer.init(mWindow, mFramePacerSettings);
+    mProfiler.init();
+
+    // OPENGL_CAPTURE=<dir> records every frame to <dir>/capture.y4m
+    if (const char* captureDir = std::getenv("OPENGL_CAPTURE"))
+    {
+        std::error_code error;
+        std::filesystem::create_directories(captureDir, error);
+
+        int width = int(mWidth);
+        int height = int(mHeight);
+        glfwGetFramebufferSize(mWindow, &width, &height);
+
+        utils::FrameCaptureSettings captureSettings;
+        captureSettings.outputPath = std::string(captureDir) + "/capture.y4m";
+        if (mFrameCapture.start(uint32_t(width), uint32_t(height), captureSettings))
+        {
+            std::cout << "Capturing to " << captureSettings.outputPath << std::endl;
+        }
+    }
 }
 
 void OpenGLExampleBase::onKeyDown(int key)
@@ -99,6 +154,25 @@ void OpenGLExampleBase::onMouseMove()
     
 }
 
+utils::Ray OpenGLExampleBase::getMouseRay(const glm::mat4& viewProjection) const
+{
+    // the cursor is in screen coordinates, which differ from framebuffer pixels on high dpi displays
+    int width = int(mWidth);
+    int height = int(mHeight);
+    glfwGetWindowSize(mWindow, &width, &height);
+
+    const glm::vec2 ndc(2.0f * float(mMouseX) / float(std::max(width, 1)) - 1.0f, 1.0f - 2.0f * float(mMouseY) / float(std::max(height, 1)));
+    const glm::mat4 inverse = glm::inverse(viewProjection);
+    const glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+    const glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+
+    utils::Ray ray;
+    ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+    ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+    ray.tMax = 1.0f;
+    return ray;
+}
+
 const std::string OpenGLExampleBase::getShadersPath() const
 {
     return getAssetPath() + "shaders/";
@@ -109,6 +183,13 @@ const std::string OpenGLExampleBase::getTexturePath() const
     return getAssetPath() + "textures/";
 }
 
+bool OpenGLExampleBase::enableDynamicResolution(const utils::DynamicResolutionSettings& settings)
+{
+    auto vertexShader = utils::OpenglShader::create(getShadersPath() + "upscale/upscale.vert", GL_VERTEX_SHADER);
+    auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "upscale/upscale.frag", GL_FRAGMENT_SHADER);
+    return mDynamicResolution.init(utils::OpenglProgram::create(vertexShader, fragmentShader), settings);
+}
+
 void OpenGLExampleBase::prepare()
 {
     
@@ -116,12 +197,88 @@ void OpenGLExampleBase::prepare()
 
 void OpenGLExampleBase::renderLoop()
 {
-	while (!glfwWindowShouldClose(mWindow))
+	while (!glfwWindowShouldClose(mWindow) && (mFrameLimit == 0 || mFramePacer.getStats().frameCount < mFrameLimit))
 	{
-        render();
+        // wait for a free frame slot before sampling input to keep latency low
+        const uint32_t steps = mFramePacer.beginFrame();
+        mFrameAllocator.beginFrame();
+        utils::GpuResidency::global().beginFrame();
 
-        glfwSwapBuffers(mWindow);
 		glfwPollEvents();
+
+        // GL work jobs queued for the main thread, e.g. uploads of streamed data
+        utils::JobSystem::global().executeMainThreadJobs();
+
+        for (uint32_t i = 0; i < steps; ++i)
+        {
+            update(mFramePacer.getFixedTimestep());
+        }
+
+        mProfiler.beginFrame();
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "frame");
+            mDynamicResolution.beginFrame(mWidth, mHeight);
+            render();
+            if (mDynamicResolution.isEnabled())
+            {
+                UTILS_PROFILE_SCOPE(mProfiler, "upscale");
+                mDynamicResolution.endFrame();
+                mProfiler.setCounter("resolution scale", mDynamicResolution.getStats().scale);
+            }
+        }
+        mProfiler.endFrame();
+
+        // everything drawn this frame has been touched, evict what has not
+        utils::GpuResidency::global().endFrame();
+        utils::GpuResidency::global().report(mProfiler);
+
+        // the back buffer is undefined after the swap
+        mFrameCapture.capture();
+
+        glfwSwapBuffers(mWindow);
+        mFramePacer.endFrame();
+
+        mDebugOutput.drain();
+    }
+
+    const auto& stats = mFramePacer.getStats();
+    std::cout << "Frames: " << stats.frameCount << ", frame time: " << stats.meanFrameTime << " ms (min " << stats.minFrameTime
+              << ", max " << stats.maxFrameTime << ", stddev " << stats.standardDeviation << ", variance " << stats.variance << ")" << std::endl;
+
+    for (const utils::ProfileZone& zone : mProfiler.getZones())
+    {
+        std::cout << std::string(zone.depth * 2, ' ') << zone.name << ": cpu " << zone.cpuTime << " ms, gpu " << zone.gpuTime << " ms" << std::endl;
+    }
+
+    for (const utils::ProfileCounter& counter : mProfiler.getCounters())
+    {
+        std::cout << counter.name << ": " << counter.value << std::endl;
+    }
+
+    if (mDebugOutput.isEnabled())
+    {
+        const auto& debugStats = mDebugOutput.getStats();
+        std::cout << "GL debug messages: " << debugStats.received << " (" << debugStats.errors << " errors), "
+                  << debugStats.suppressed << " suppressed, " << debugStats.dropped << " dropped" << std::endl;
+    }
+
+    if (mDynamicResolution.isEnabled())
+    {
+        const auto& resolutionStats = mDynamicResolution.getStats();
+        std::cout << "Dynamic resolution: scale " << resolutionStats.scale << " (" << resolutionStats.renderWidth << "x" << resolutionStats.renderHeight
+                  << "), gpu " << resolutionStats.gpuTime << " ms (smoothed " << resolutionStats.smoothedGpuTime << "), " << resolutionStats.scaleChanges
+                  << " scale changes, " << resolutionStats.reallocations << " reallocations, " << resolutionStats.droppedTimings << " dropped timings" << std::endl;
+    }
+
+    const auto memoryStats = mFrameAllocator.getStats();
+    std::cout << "Frame memory: peak " << memoryStats.peak << " bytes, overflows " << memoryStats.overflowCount << std::endl;
+
+    if (mFrameCapture.isCapturing())
+    {
+        const auto captureStats = mFrameCapture.getStats();
+        mFrameCapture.stop();
+        std::cout << "Captured frames: " << captureStats.framesIssued << ", dropped " << captureStats.framesDropped
+                  << ", capture cost " << captureStats.meanCaptureTime << " ms (max " << captureStats.maxCaptureTime << ")" << std::endl;
     }
 
     destroyWindow();
@@ -132,6 +289,13 @@ void OpenGLExampleBase::destroyWindow()
 {
     if(mWindow)
     {
+        mDebugOutput.destroy();
+        mDynamicResolution.destroy();
+        mProfiler.destroy();
+        mFramePacer.destroy();
+
+        // the shared VAOs belong to this context
+        utils::VertexArrayCache::global().destroy();
         glfwDestroyWindow(mWindow);
         glfwTerminate();
     }
@@ -5,6 +5,14 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "DebugOutput.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "Memory.h"
+#include "Profiler.h"
+#include "Ray.h"
+
 
 class OpenGLExampleBase
 {
@@ -18,6 +26,9 @@ public:
 
     virtual void prepare();
 
+    /** @brief Fixed-step simulation, called zero or more times per frame before render */
+    virtual void update(double /*deltaTime*/) {}
+
     /** @brief Render function to be implemented by the sample application */
 	virtual void render() {}
 
@@ -27,12 +38,23 @@ public:
 
     virtual void onKeyUp(int key);
 
+    /** @brief Called when the cursor moves, the position is in mMouseX and mMouseY */
     virtual void onMouseMove();
 
 protected:
     const std::string getShadersPath() const;
     const std::string getTexturePath() const;
 
+    // render() then draws into a scaled target that is upscaled to the window, size the viewport and
+    // anything resolution dependent with getRenderWidth() and getRenderHeight()
+    bool enableDynamicResolution(const utils::DynamicResolutionSettings& settings = utils::DynamicResolutionSettings());
+
+    uint32_t getRenderWidth() const { return mDynamicResolution.isEnabled() ? mDynamicResolution.getRenderWidth() : mWidth; }
+    uint32_t getRenderHeight() const { return mDynamicResolution.isEnabled() ? mDynamicResolution.getRenderHeight() : mHeight; }
+
+    // the world space ray under the cursor for the view projection matrix the scene is drawn with, from the near to the far plane
+    utils::Ray getMouseRay(const glm::mat4& viewProjection) const;
+
     const std::string getAssetPath() const 
     {
     #if defined(ROOT_DATA_DIR)
@@ -42,11 +64,23 @@ protected:
     #endif
     }
 
+    // built from getAssetPath() by the data_pack target
+    const std::string getAssetPackPath() const
+    {
+    #if defined(ROOT_DATA_PACK)
+        return ROOT_DATA_PACK;
+    #else
+        return getAssetPath() + "data.pack";
+    #endif
+    }
+
 private:
     static void handleKeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
     
     static void handleMouseButtonCallback(GLFWwindow* window, int key, int action, int modes);
 
+    static void handleCursorPosCallback(GLFWwindow* window, double x, double y);
+
     static void handleWindowResize(GLFWwindow* window, int width, int height);
 
 protected:
@@ -56,6 +90,33 @@ protected:
 
     uint32_t mWidth = 1280;
 	uint32_t mHeight = 720;
+
+    // cursor position in window coordinates, the origin is the top left corner
+    double mMouseX = 0.0;
+    double mMouseY = 0.0;
+
+    // read by setupWindow, change before calling it or use mFramePacer afterwards
+    utils::FramePacerSettings mFramePacerSettings;
+    utils::FramePacer mFramePacer;
+
+    // headless runs use a hidden window and no vsync, mFrameLimit ends the loop after that many frames (0 = run until closed)
+    bool mHeadless = false;
+    uint64_t mFrameLimit = 0;
+
+    // reads back every rendered frame once started, setupWindow starts it when OPENGL_CAPTURE names a directory
+    utils::FrameCapture mFrameCapture;
+
+    // per-frame scratch memory, reset at the start of every frame once the pacer has a free frame slot
+    utils::FrameAllocator mFrameAllocator;
+
+    // GL errors and warnings of debug builds, drained once per frame
+    utils::DebugOutput mDebugOutput;
+
+    // render() runs in a "frame" zone, add nested zones with UTILS_PROFILE_SCOPE(mProfiler, "name")
+    utils::Profiler mProfiler;
+
+    // off unless enableDynamicResolution() is called, scales the resolution of render() to a GPU time target
+    utils::DynamicResolution mDynamicResolution;
 };
 
 
@@ -1,27 +1,59 @@
 #include "OpenGLUtils.h"
 
 #include <fstream>
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <vector>
 
+#include "AssetArchive.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
 namespace utils
 {
-    std::shared_ptr<VertexBuffer> VertexBuffer::create(uint32_t size, void *data, BufferFlag flag)
+    namespace
+    {
+        // only evictable buffers with initial data get callbacks, everything else is just accounted
+        GpuResidency::ResourceId addBuffer(GpuMemoryCategory category, GLuint id, uint32_t size, const void* data, bool evictable, std::vector<uint8_t>& shadow)
+        {
+            GpuResidencyCallbacks callbacks;
+            if (evictable && data != nullptr)
+            {
+                const uint8_t* bytes = static_cast<const uint8_t*>(data);
+                shadow.assign(bytes, bytes + size);
+                callbacks.evict = [id]()
+                {
+                    glNamedBufferData(id, 0, nullptr, GL_STATIC_DRAW);
+                };
+                callbacks.restream = [id, &shadow](uint32_t)
+                {
+                    glNamedBufferData(id, GLsizeiptr(shadow.size()), shadow.data(), GL_STATIC_DRAW);
+                    return uint64_t(shadow.size());
+                };
+            }
+            return GpuResidency::global().add(category, size, callbacks);
+        }
+    }
+
+    std::shared_ptr<VertexBuffer> VertexBuffer::create(uint32_t size, void *data, BufferFlag flag, bool evictable)
     {
         auto vb = std::make_shared<VertexBuffer>();
-        vb->init(size, data, flag);
+        vb->init(size, data, flag, evictable);
         return vb;
     }
 
-    void VertexBuffer::init(uint32_t size, void *data, BufferFlag flag)
+    void VertexBuffer::init(uint32_t size, void *data, BufferFlag flag, bool evictable)
     {
         mSize = size;
-        const bool drawIndirect = 0 != (flag & BufferFlag::BUFFER_DRAW_INDIRECT);
+        const bool drawIndirect = flag == BufferFlag::BUFFER_DRAW_INDIRECT;
 
         mTarget = drawIndirect ? GL_DRAW_INDIRECT_BUFFER : GL_ARRAY_BUFFER;
 
@@ -29,6 +61,8 @@ namespace utils
         GL_CHECK(glBindBuffer(mTarget, mId));
         GL_CHECK(glBufferData(mTarget, mSize, data, (nullptr == data) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW));
         GL_CHECK(glBindBuffer(mTarget, 0));
+
+        mResidency = addBuffer(GPU_MEMORY_VERTEX_BUFFER, mId, size, data, evictable, mShadow);
     }
 
     void VertexBuffer::update(uint32_t offset, uint32_t size, void *data)
@@ -39,25 +73,55 @@ namespace utils
             return;
         }
 
+        touch();
+        if (!mShadow.empty())
+        {
+            std::memcpy(mShadow.data() + offset, data, size);
+        }
+
         GL_CHECK(glBindBuffer(mTarget, mId));
         GL_CHECK(glBufferSubData(mTarget, offset, size, data));
         GL_CHECK(glBindBuffer(mTarget, 0));
     }
 
+    VertexBuffer::~VertexBuffer()
+    {
+        destroy();
+    }
+
     void VertexBuffer::destroy()
     {
-        GL_CHECK(glBindBuffer(mTarget, 0));
-        GL_CHECK(glDeleteBuffers(1, &mId));
+        GpuResidency::global().remove(mResidency);
+        mResidency = GpuResidency::kInvalidResource;
+        mShadow.clear();
+
+        if (mId != 0)
+        {
+            GL_CHECK(glBindBuffer(mTarget, 0));
+            GL_CHECK(glDeleteBuffers(1, &mId));
+            mId = 0;
+        }
     }
 
-    std::shared_ptr<IndexBuffer> IndexBuffer::create(uint32_t size, void *data, BufferFlag flag)
+    void VertexBuffer::bind()
+    {
+        touch();
+        GL_CHECK(glBindBuffer(mTarget, mId));
+    }
+
+    void VertexBuffer::touch()
+    {
+        GpuResidency::global().touch(mResidency);
+    }
+
+    std::shared_ptr<IndexBuffer> IndexBuffer::create(uint32_t size, void *data, BufferFlag flag, bool evictable)
     {
         auto ib = std::make_shared<IndexBuffer>();
-        ib->init(size, data, flag);
+        ib->init(size, data, flag, evictable);
         return ib;
     }
 
-    void IndexBuffer::init(uint32_t size, void *data, BufferFlag flag)
+    void IndexBuffer::init(uint32_t size, void *data, BufferFlag flag, bool evictable)
     {
         mSize = size;
         mFlag = flag;
@@ -66,6 +130,8 @@ namespace utils
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mId));
         GL_CHECK(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, data, (NULL == data) ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW));
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+        mResidency = addBuffer(GPU_MEMORY_INDEX_BUFFER, mId, size, data, evictable, mShadow);
     }
 
     void IndexBuffer::update(uint32_t offset, uint32_t size, void *data)
@@ -76,15 +142,45 @@ namespace utils
             return;
         }
 
+        touch();
+        if (!mShadow.empty())
+        {
+            std::memcpy(mShadow.data() + offset, data, size);
+        }
+
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mId));
         GL_CHECK(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset, size, data));
         GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
     }
 
+    IndexBuffer::~IndexBuffer()
+    {
+        destroy();
+    }
+
     void IndexBuffer::destroy()
     {
-        GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-        GL_CHECK(glDeleteBuffers(1, &mId));
+        GpuResidency::global().remove(mResidency);
+        mResidency = GpuResidency::kInvalidResource;
+        mShadow.clear();
+
+        if (mId != 0)
+        {
+            GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+            GL_CHECK(glDeleteBuffers(1, &mId));
+            mId = 0;
+        }
+    }
+
+    void IndexBuffer::bind()
+    {
+        touch();
+        GL_CHECK(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mId));
+    }
+
+    void IndexBuffer::touch()
+    {
+        GpuResidency::global().touch(mResidency);
     }
 
     std::shared_ptr<OpenglShader> OpenglShader::create(const std::string &filename, GLenum shaderType)
@@ -102,42 +198,102 @@ namespace utils
         destroy();
     }
 
-    bool OpenglShader::init(const std::string &filename, GLenum shaderType)
+    namespace
     {
-        std::ifstream is;
-        is.open(filename);
-        if (is.is_open())
-        {
-            std::string shaderString;
-            std::stringstream shaderStream;
-            shaderStream << is.rdbuf();
-            is.close();
-            shaderString = shaderStream.str();
-
-            const char *shaderSource = shaderString.c_str();
-            unsigned int shader = glCreateShader(shaderType);
-            glShaderSource(shader, 1, &shaderSource, nullptr);
-            glCompileShader(shader);
-            GLint compileStatus;
-            glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
-            if (compileStatus != GL_TRUE)
+        constexpr uint32_t kMaxIncludeDepth = 16;
+
+        // expands #include "file" lines relative to the including file. Every file gets its own source string
+        // number in #line directives, so compile errors name the file by its index in files
+        bool loadShaderSource(const std::string& filename, std::string& source, std::vector<std::string>& files, uint32_t depth)
+        {
+            std::string text;
+            if (!AssetFileSystem::global().readString(filename, text))
             {
-                GLint logLength;
-                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
-                std::vector<char> infoLog(logLength);
-                glGetShaderInfoLog(shader, logLength, nullptr, infoLog.data());
-                std::cerr << "Failed to compile shader. Compile log\n"
-                          << infoLog.data() << std::endl;
+                std::cerr << "Error: Could not open shader file: " << filename.c_str() << std::endl;
                 return false;
             }
-            id = shader;
-            type = shaderType;
+            std::istringstream is(text);
+
+            const uint32_t fileIndex = uint32_t(files.size());
+            files.push_back(filename);
+
+            const size_t slash = filename.find_last_of("/\\");
+            const std::string directory = slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+
+            std::string line;
+            uint32_t lineNumber = 0;
+            while (std::getline(is, line))
+            {
+                ++lineNumber;
+
+                const size_t directive = line.find_first_not_of(" \t");
+                if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+                {
+                    source += line;
+                    source += '\n';
+                    continue;
+                }
+
+                const size_t open = line.find('"', directive + 8);
+                const size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+                if (close == std::string::npos)
+                {
+                    std::cerr << filename << "(" << lineNumber << "): malformed #include" << std::endl;
+                    return false;
+                }
+                if (depth >= kMaxIncludeDepth)
+                {
+                    std::cerr << filename << "(" << lineNumber << "): #include nested deeper than " << kMaxIncludeDepth << " levels" << std::endl;
+                    return false;
+                }
+
+                source += "#line 1 " + std::to_string(files.size()) + "\n";
+                if (!loadShaderSource(directory + line.substr(open + 1, close - open - 1), source, files, depth + 1))
+                {
+                    return false;
+                }
+                source += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+            }
+            return true;
         }
-        else
+    }
+
+    bool OpenglShader::init(const std::string &filename, GLenum shaderType)
+    {
+        std::string shaderString;
+        std::vector<std::string> files;
+        if (!loadShaderSource(filename, shaderString, files, 0))
         {
-            std::cerr << "Error: Could not open shader file: " << filename.c_str() << std::endl;
             return false;
         }
+
+        const char *shaderSource = shaderString.c_str();
+        unsigned int shader = glCreateShader(shaderType);
+        glShaderSource(shader, 1, &shaderSource, nullptr);
+        glCompileShader(shader);
+        GLint compileStatus;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+        if (compileStatus != GL_TRUE)
+        {
+            GLint logLength;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+            std::vector<char> infoLog(logLength);
+            glGetShaderInfoLog(shader, logLength, nullptr, infoLog.data());
+            std::cerr << "Failed to compile shader. Compile log\n"
+                      << infoLog.data() << std::endl;
+            if (files.size() > 1)
+            {
+                for (size_t i = 0; i < files.size(); ++i)
+                {
+                    std::cerr << "  source " << i << ": " << files[i] << std::endl;
+                }
+            }
+            glDeleteShader(shader);
+            return false;
+        }
+        id = shader;
+        type = shaderType;
+        return true;
     }
 
     void OpenglShader::destroy()
@@ -163,6 +319,20 @@ namespace utils
         return nullptr;
     }
 
+    std::shared_ptr<OpenglProgram> OpenglProgram::create(std::shared_ptr<OpenglShader> &computeShader)
+    {
+        if (!computeShader)
+            return nullptr;
+
+        std::shared_ptr<OpenglProgram> program = std::make_shared<OpenglProgram>();
+        if (program->init(computeShader))
+        {
+            return program;
+        }
+
+        return nullptr;
+    }
+
     OpenglProgram::~OpenglProgram()
     {
         destroy();
@@ -203,6 +373,38 @@ namespace utils
         return true;
     }
 
+    bool OpenglProgram::init(std::shared_ptr<OpenglShader> &computeShader)
+    {
+        if (computeShader->type != GL_COMPUTE_SHADER)
+        {
+            std::cerr << "Compute programs need a compute shader" << std::endl;
+            return false;
+        }
+
+        id = glCreateProgram();
+        compute = computeShader->id;
+        glAttachShader(id, compute);
+        glLinkProgram(id);
+
+        GLint linkStatus;
+        glGetProgramiv(id, GL_LINK_STATUS, &linkStatus);
+        if (linkStatus != GL_TRUE)
+        {
+            GLint logLength;
+            glGetProgramiv(id, GL_INFO_LOG_LENGTH, &logLength);
+            std::vector<char> infoLog(logLength);
+            glGetProgramInfoLog(id, logLength, nullptr, infoLog.data());
+            std::cerr << "Failed to link compute program. Link log\n"
+                      << infoLog.data() << std::endl;
+            glDeleteProgram(id);
+            id = 0;
+
+            return false;
+        }
+
+        return true;
+    }
+
     void OpenglProgram::destroy()
     {
         if (id != 0)
@@ -212,14 +414,110 @@ namespace utils
         }
     }
 
-    void Image::loadFromFile(const std::string &filename)
+    bool Image::loadFromFile(const std::string &filename)
     {
-        mData = stbi_load(filename.c_str(), &mWidth, &mHeight, &mChannle, 4);
+        AssetData bytes;
+        if (!AssetFileSystem::global().read(filename, bytes))
+        {
+            std::cerr << "Cannot open the image: " << filename << std::endl;
+            return false;
+        }
+
+        if (!loadFromMemory(bytes.data, bytes.size))
+        {
+            std::cerr << "Cannot load the image: " << filename << " (" << getLastError() << ")" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Image::loadFromMemory(const unsigned char *data, size_t size)
+    {
+        // images keep the file's row order, the flag is per thread and textures decoded here set their own
+        stbi_set_flip_vertically_on_load_thread(false);
+
+        int width;
+        int height;
+        int channle;
+        unsigned char *pixels = stbi_load_from_memory(data, int(size), &width, &height, &channle, 4);
+        if (pixels == nullptr)
+        {
+            return false;
+        }
+
+        if (mData != nullptr)
+        {
+            free(mData);
+        }
+
+        mData = pixels;
+        mWidth = width;
+        mHeight = height;
+        mDepth = 1;
+        mChannle = channle;
+        return true;
+    }
+
+    void Image::create(int width, int height)
+    {
+        const size_t size = size_t(width) * height * 4;
+        if (mData == nullptr || size_t(mWidth) * mHeight * 4 < size)
+        {
+            if (mData != nullptr)
+            {
+                free(mData);
+            }
+            mData = static_cast<unsigned char*>(malloc(size));
+        }
+
+        // pixels are always stored as RGBA8, the same layout loadFromFile produces
+        mWidth = width;
+        mHeight = height;
+        mDepth = 1;
+        mChannle = 4;
+    }
+
+    bool Image::encodePng(std::vector<unsigned char> &output) const
+    {
+        output.clear();
         if (mData == nullptr)
         {
-            std::cerr << "Cannot load the image: " << filename << std::endl;
-            exit(1);
+            return false;
         }
+
+        auto append = [](void *context, void *data, int size)
+        {
+            auto *output = static_cast<std::vector<unsigned char> *>(context);
+            auto *bytes = static_cast<unsigned char *>(data);
+            output->insert(output->end(), bytes, bytes + size);
+        };
+
+        return stbi_write_png_to_func(append, &output, mWidth, mHeight, 4, mData, mWidth * 4) != 0;
+    }
+
+    bool Image::saveToFile(const std::string &filename) const
+    {
+        std::vector<unsigned char> bytes;
+        if (!encodePng(bytes))
+        {
+            std::cerr << "Cannot encode the image: " << filename << std::endl;
+            return false;
+        }
+
+        std::ofstream os(filename, std::ios::binary);
+        os.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+        if (!os)
+        {
+            std::cerr << "Cannot write the image: " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    const char *Image::getLastError()
+    {
+        const char *reason = stbi_failure_reason();
+        return reason != nullptr ? reason : "unknown error";
     }
 
     Image::~Image()
@@ -240,76 +538,238 @@ namespace utils
         return nullptr;
     }
 
-    bool Texture2D::loadFromFile(const std::string &filename, bool generateMipmap)
+    Texture2D::~Texture2D()
     {
-        GLuint textureID;
-        int width;
-        int height;
-        int channle;
-        glGenTextures(1, &textureID);
+        destroy();
+    }
 
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *data = stbi_load(filename.c_str(), &width, &height, &channle, 3);
+    namespace
+    {
+        // 2x2 box filter from src into dst, which may be src. Odd sizes repeat their last row or column
+        void halveImage(const unsigned char* src, unsigned char* dst, int& width, int& height, int components)
+        {
+            const int halfWidth = std::max(width / 2, 1);
+            const int halfHeight = std::max(height / 2, 1);
+            for (int y = 0; y < halfHeight; ++y)
+            {
+                const unsigned char* row0 = src + size_t(std::min(y * 2, height - 1)) * width * components;
+                const unsigned char* row1 = src + size_t(std::min(y * 2 + 1, height - 1)) * width * components;
+                for (int x = 0; x < halfWidth; ++x)
+                {
+                    const int x0 = std::min(x * 2, width - 1) * components;
+                    const int x1 = std::min(x * 2 + 1, width - 1) * components;
+                    for (int c = 0; c < components; ++c)
+                    {
+                        const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                        dst[(size_t(y) * halfWidth + x) * components + c] = (unsigned char)((sum + 2) >> 2);
+                    }
+                }
+            }
+            width = halfWidth;
+            height = halfHeight;
+        }
 
-        if (data)
+        uint32_t getMipLevels(int width, int height)
         {
-            glBindTexture(GL_TEXTURE_2D, textureID);
+            uint32_t levels = 1;
+            for (int size = std::max(width, height); size > 1; size /= 2)
+            {
+                ++levels;
+            }
+            return levels;
+        }
 
+        struct TextureFormat
+        {
             GLenum internalFormat;
             GLenum format;
-            if (channle == 1)
+            uint64_t texelSize;
+        };
+
+        // RGB8 is padded to four bytes by most drivers
+        TextureFormat getTextureFormat(uint32_t channels)
+        {
+            switch (channels)
             {
-                internalFormat = GL_RED;
-                format = GL_RED;
+            case 1:
+                return { GL_R8, GL_RED, 1 };
+            case 2:
+                return { GL_RG8, GL_RG, 2 };
+            case 4:
+                return { GL_RGBA8, GL_RGBA, 4 };
+            default:
+                return { GL_RGB8, GL_RGB, 4 };
             }
-            else if (channle == 3)
+        }
+    }
+
+    bool Texture2D::loadFromFile(const std::string &filename, bool generateMipmap)
+    {
+        mFilename = filename;
+        mHasMipmap = generateMipmap;
+
+        int width;
+        int height;
+        int channle;
+        unsigned char* data = decode(width, height, channle);
+        if (data == nullptr)
+        {
+            return false;
+        }
+
+        mWidth = width;
+        mHeight = height;
+        mChanngle = channle;
+        mLevels = mHasMipmap ? getMipLevels(width, height) : 1;
+
+        // the chain is filtered on the CPU instead of with glGenerateMipmap, so a restored level matches the one
+        // that was dropped
+        glGenTextures(1, &mId);
+        glBindTexture(GL_TEXTURE_2D, mId);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, GLint(mLevels - 1));
+        uploadLevels(data, 0, mLevels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        stbi_image_free(data);
+        mResidentMip = 0;
+
+        GpuResidencyCallbacks callbacks;
+        callbacks.evict = [this]()
+        {
+            release();
+        };
+        callbacks.restream = [this](uint32_t droppedMips)
+        {
+            return upload(droppedMips);
+        };
+        mResidency = GpuResidency::global().add(GPU_MEMORY_TEXTURE, upload(0), callbacks, mLevels);
+        return true;
+    }
+
+    unsigned char* Texture2D::decode(int& width, int& height, int& channels) const
+    {
+        AssetData file;
+        if (!AssetFileSystem::global().read(mFilename, file))
+        {
+            std::cerr << "Failed to load texture " << mFilename << ": cannot open the file" << std::endl;
+            return nullptr;
+        }
+
+        // GL expects the bottom row first. Set per thread, a global flip is ignored once a thread has set its own
+        stbi_set_flip_vertically_on_load_thread(true);
+        unsigned char* data = stbi_load_from_memory(file.data, int(file.size), &width, &height, &channels, 0);
+        if (data == nullptr)
+        {
+            std::cerr << "Failed to load texture " << mFilename << ": " << stbi_failure_reason() << std::endl;
+        }
+        return data;
+    }
+
+    void Texture2D::uploadLevels(unsigned char* data, uint32_t first, uint32_t end)
+    {
+        const TextureFormat format = getTextureFormat(mChanngle);
+        int levelWidth = int(mWidth);
+        int levelHeight = int(mHeight);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (uint32_t level = 0; level < end; ++level)
+        {
+            if (level > 0)
             {
-                internalFormat = GL_RGB;
-                format = GL_RGB;
+                halveImage(data, data, levelWidth, levelHeight, int(mChanngle));
             }
-            else if (channle == 4)
+            if (level >= first)
             {
-                internalFormat = GL_RGBA;
-                format = GL_RGBA;
+                glTexImage2D(GL_TEXTURE_2D, GLint(level), GLint(format.internalFormat), levelWidth, levelHeight, 0,
+                    format.format, GL_UNSIGNED_BYTE, data);
             }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
 
-            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    uint64_t Texture2D::upload(uint32_t droppedMips)
+    {
+        droppedMips = std::min(droppedMips, mLevels - 1);
 
-            if (generateMipmap)
+        // level i always holds level i of the file, dropping mips only moves the base level. The name stays valid
+        // for anything holding on to it, sampling with normalized coordinates is unaffected
+        glBindTexture(GL_TEXTURE_2D, mId);
+        if (droppedMips < mResidentMip)
+        {
+            int width;
+            int height;
+            int channels;
+            unsigned char* data = decode(width, height, channels);
+            if (data != nullptr && (uint32_t(width) != mWidth || uint32_t(height) != mHeight || uint32_t(channels) != mChanngle))
             {
-                glGenerateMipmap(GL_TEXTURE_2D);
+                std::cerr << "Failed to restream texture " << mFilename << ": the file changed since it was loaded" << std::endl;
+                stbi_image_free(data);
+                data = nullptr;
             }
 
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-            glBindTexture(GL_TEXTURE_2D, 0);
+            if (data != nullptr)
+            {
+                uploadLevels(data, droppedMips, mResidentMip);
+                stbi_image_free(data);
+                mResidentMip = droppedMips;
+            }
+        }
 
-            mId = textureID;
-            mWidth = width;
-            mHeight = height;
-            mChanngle = channle;
-            mHasMipmap = generateMipmap;
+        // zero sized levels free their storage
+        const GLint baseLevel = GLint(std::min(std::max(droppedMips, mResidentMip), mLevels - 1));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, baseLevel);
+        for (uint32_t level = mResidentMip; level < droppedMips; ++level)
+        {
+            glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        mResidentMip = std::max(droppedMips, mResidentMip);
+        glBindTexture(GL_TEXTURE_2D, 0);
 
-            return true;
+        // RGB8 is padded to four bytes by most drivers
+        const uint64_t texelSize = getTextureFormat(mChanngle).texelSize;
+        uint64_t bytes = 0;
+        for (uint32_t level = mResidentMip; level < mLevels; ++level)
+        {
+            bytes += uint64_t(std::max(mWidth >> level, 1u)) * uint64_t(std::max(mHeight >> level, 1u)) * texelSize;
         }
-        else
+        return bytes;
+    }
+
+    void Texture2D::release()
+    {
+        glBindTexture(GL_TEXTURE_2D, mId);
+        for (uint32_t level = mResidentMip; level < mLevels; ++level)
         {
-            stbi_image_free(data);
-            glBindTexture(GL_TEXTURE_2D, 0);
-            return false;
+            glTexImage2D(GL_TEXTURE_2D, GLint(level), GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
         }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        mResidentMip = mLevels;
+    }
+
+    void Texture2D::destroy()
+    {
+        GpuResidency::global().remove(mResidency);
+        mResidency = GpuResidency::kInvalidResource;
+
+        glDeleteTextures(1, &mId);
+        mId = 0;
     }
 
     void Texture2D::bind(uint32_t slot)
     {
+        touch();
         glActiveTexture(GL_TEXTURE0 + slot);
         glBindTexture(GL_TEXTURE_2D, mId);
     }
 
+    void Texture2D::touch()
+    {
+        GpuResidency::global().touch(mResidency);
+    }
+
     void Texture2D::unbind()
     {
         glBindTexture(GL_TEXTURE_2D, 0);
@@ -325,7 +785,7 @@ namespace utils
         mesh->mTextCoords = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
         mesh->mIndices = {0, 1, 2, 1, 3, 2};
 
-        for (int32_t i = 0; i < mesh->mVertices.size(); ++i)
+        for (size_t i = 0; i < mesh->mVertices.size() / 4; ++i)
         {
             mesh->mVertices[i * 4 + 0] *= halfExtend;
             mesh->mVertices[i * 4 + 1] *= halfExtend;
@@ -352,4 +812,127 @@ namespace utils
 
         return mesh;
     }
-}
\ No newline at end of file
+
+    std::shared_ptr<Mesh> Mesh::createGrid(uint32_t resolution)
+    {
+        auto mesh = std::make_shared<Mesh>();
+
+        // the quadrants need an even resolution, odd ones get one more row and column of quads
+        resolution = std::max(resolution + (resolution & 1), 2u);
+        const uint32_t side = resolution + 1;
+
+        for (uint32_t z = 0; z < side; ++z)
+        {
+            for (uint32_t x = 0; x < side; ++x)
+            {
+                const float u = float(x) / float(resolution);
+                const float v = float(z) / float(resolution);
+                mesh->mVertices.insert(mesh->mVertices.end(), { u, 0.0f, v, 1.0f });
+                mesh->mNormals.insert(mesh->mNormals.end(), { 0.0f, 1.0f, 0.0f });
+                mesh->mTangents.insert(mesh->mTangents.end(), { 1.0f, 0.0f, 0.0f });
+                mesh->mTextCoords.insert(mesh->mTextCoords.end(), { u, v });
+            }
+        }
+
+        const uint32_t half = resolution / 2;
+        for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            const uint32_t x0 = (quadrant & 1) * half;
+            const uint32_t z0 = (quadrant >> 1) * half;
+            for (uint32_t z = z0; z < z0 + half; ++z)
+            {
+                for (uint32_t x = x0; x < x0 + half; ++x)
+                {
+                    const uint32_t i = z * side + x;
+                    mesh->mIndices.insert(mesh->mIndices.end(), { i, i + side, i + 1, i + 1, i + side, i + side + 1 });
+                }
+            }
+        }
+
+        return mesh;
+    }
+
+    std::shared_ptr<Mesh> Mesh::createSphere(uint32_t resolution, float roughness)
+    {
+        auto mesh = std::make_shared<Mesh>();
+
+        resolution = std::max(resolution, 1u);
+        const uint32_t side = resolution + 1;
+        const glm::vec3 axes[3] = { glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f) };
+
+        for (uint32_t face = 0; face < 6; ++face)
+        {
+            // u x v points along the face normal, so the quads wind counter-clockwise seen from outside
+            const float sign = face < 3 ? 1.0f : -1.0f;
+            const glm::vec3 normal = axes[face % 3] * sign;
+            const glm::vec3 u = axes[(face + 1) % 3] * sign;
+            const glm::vec3 v = glm::cross(normal, u);
+
+            const uint32_t base = uint32_t(mesh->mVertices.size() / 4);
+            for (uint32_t y = 0; y < side; ++y)
+            {
+                for (uint32_t x = 0; x < side; ++x)
+                {
+                    const float s = float(x) / float(resolution);
+                    const float t = float(y) / float(resolution);
+                    glm::vec3 position = glm::normalize(normal + u * (s * 2.0f - 1.0f) + v * (t * 2.0f - 1.0f));
+                    const glm::vec3 tangent = glm::normalize(u - position * glm::dot(u, position));
+
+                    if (roughness > 0.0f)
+                    {
+                        float displacement = 0.0f;
+                        float frequency = 3.0f;
+                        float amplitude = 0.5f;
+                        for (uint32_t octave = 0; octave < 5; ++octave)
+                        {
+                            displacement += amplitude * std::sin(position.x * frequency + float(octave)) * std::sin(position.y * frequency * 1.3f + 1.7f)
+                                * std::sin(position.z * frequency * 0.9f + 2.3f * float(octave));
+                            frequency *= 2.7f;
+                            amplitude *= 0.55f;
+                        }
+                        position *= 1.0f + roughness * displacement;
+                    }
+
+                    mesh->mVertices.insert(mesh->mVertices.end(), { position.x, position.y, position.z, 1.0f });
+                    mesh->mNormals.insert(mesh->mNormals.end(), { position.x, position.y, position.z });
+                    mesh->mTangents.insert(mesh->mTangents.end(), { tangent.x, tangent.y, tangent.z });
+                    mesh->mTextCoords.insert(mesh->mTextCoords.end(), { s, t });
+                }
+            }
+
+            for (uint32_t y = 0; y < resolution; ++y)
+            {
+                for (uint32_t x = 0; x < resolution; ++x)
+                {
+                    const uint32_t i = base + y * side + x;
+                    mesh->mIndices.insert(mesh->mIndices.end(), { i, i + 1, i + side + 1, i, i + side + 1, i + side });
+                }
+            }
+        }
+
+        // a displaced surface needs the normals of its faces, area weighted
+        if (roughness > 0.0f)
+        {
+            std::vector<glm::vec3> normals(mesh->mVertices.size() / 4, glm::vec3(0.0f));
+            auto position = [&mesh](uint32_t vertex) { return glm::vec3(mesh->mVertices[vertex * 4], mesh->mVertices[vertex * 4 + 1], mesh->mVertices[vertex * 4 + 2]); };
+            for (size_t i = 0; i < mesh->mIndices.size(); i += 3)
+            {
+                const uint32_t* corners = &mesh->mIndices[i];
+                const glm::vec3 faceNormal = glm::cross(position(corners[1]) - position(corners[0]), position(corners[2]) - position(corners[0]));
+                for (uint32_t corner = 0; corner < 3; ++corner)
+                {
+                    normals[corners[corner]] += faceNormal;
+                }
+            }
+            for (size_t vertex = 0; vertex < normals.size(); ++vertex)
+            {
+                const glm::vec3 normal = glm::normalize(normals[vertex]);
+                mesh->mNormals[vertex * 3 + 0] = normal.x;
+                mesh->mNormals[vertex * 3 + 1] = normal.y;
+                mesh->mNormals[vertex * 3 + 2] = normal.z;
+            }
+        }
+
+        return mesh;
+    }
+}
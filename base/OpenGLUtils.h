@@ -1,4 +1,6 @@
 
+#pragma once
+
 #include <string>
 #include <memory>
 
@@ -8,19 +10,12 @@
 #include <cstdint>
 #include <vector>
 
+#include "GpuResidency.h"
+
 
-#ifdef __DEBUG
-#define GL_CHECK(_call) \
-    for(;;) { \
-        _call; \
-        GLenum gl_err = glGetError(); \
-        if(0 != gl_err) {std::cout <<  "GL error("<< gl_err << "): " << glEnumName(gl_err) << "at " << __FILE__ << " (" << __LINE__ << ")" << std::endl; }\
-        unused(gl_err); \
-        break; \
-    } 
-#else
-#	define GL_CHECK(_call)   _call
-#endif
+// GL errors are reported asynchronously by DebugOutput in debug builds, polling glGetError after every call
+// would stall the driver. The macro is kept to mark calls worth a second look in a frame debugger.
+#define GL_CHECK(_call) _call
 
 namespace utils
 {
@@ -34,29 +29,57 @@ namespace utils
 
     struct VertexBuffer
     {
-        static std::shared_ptr<VertexBuffer> create(uint32_t size, void* data, BufferFlag flag);
+        // an evictable buffer keeps a copy of its initial data in system memory, so GpuResidency can evict it and
+        // restream it later. bind() or touch() it every frame it is drawn, its VAOs stay valid across evictions
+        static std::shared_ptr<VertexBuffer> create(uint32_t size, void* data, BufferFlag flag, bool evictable = false);
+
+        VertexBuffer() = default;
+        ~VertexBuffer();
+
+        // GpuResidency's callbacks point at mShadow, so the buffer stays where it was created
+        VertexBuffer(const VertexBuffer&) = delete;
+        VertexBuffer& operator=(const VertexBuffer&) = delete;
 
-        void init(uint32_t size, void* data, BufferFlag flag);
+        void init(uint32_t size, void* data, BufferFlag flag, bool evictable = false);
         void update(uint32_t offset, uint32_t size, void* data);
         void destroy();
 
-        GLuint mId;
-        GLuint mSize;
-        GLenum mTarget;
+        // binds to mTarget, use touch() before using mId directly, e.g. with glVertexArrayVertexBuffer
+        void bind();
+        void touch();
 
+        GLuint mId = 0;
+        GLuint mSize = 0;
+        GLenum mTarget = GL_ARRAY_BUFFER;
+
+        GpuResidency::ResourceId mResidency = GpuResidency::kInvalidResource;
+        std::vector<uint8_t> mShadow;
     };
 
     struct IndexBuffer
     {
-        static std::shared_ptr<IndexBuffer> create(uint32_t size, void* data, BufferFlag flag);
+        static std::shared_ptr<IndexBuffer> create(uint32_t size, void* data, BufferFlag flag, bool evictable = false);
+
+        IndexBuffer() = default;
+        ~IndexBuffer();
+
+        IndexBuffer(const IndexBuffer&) = delete;
+        IndexBuffer& operator=(const IndexBuffer&) = delete;
 
-        void init(uint32_t size, void* data, BufferFlag flag);
+        void init(uint32_t size, void* data, BufferFlag flag, bool evictable = false);
         void update(uint32_t offset, uint32_t size, void* data);
         void destroy();
 
-        GLuint mId;
-        uint32_t mSize;
-        BufferFlag mFlag;
+        // binds to GL_ELEMENT_ARRAY_BUFFER, use touch() before using mId directly, e.g. with glVertexArrayElementBuffer
+        void bind();
+        void touch();
+
+        GLuint mId = 0;
+        uint32_t mSize = 0;
+        BufferFlag mFlag = BUFFER_NONE;
+
+        GpuResidency::ResourceId mResidency = GpuResidency::kInvalidResource;
+        std::vector<uint8_t> mShadow;
     };
 
     struct OpenglShader
@@ -72,6 +95,15 @@ namespace utils
         void destroy();
     };
 
+    // uniform names are passed through as plain pointers, string literals don't build a std::string per call
+    struct UniformName
+    {
+        UniformName(const char* name) : value(name) {}
+        UniformName(const std::string& name) : value(name.c_str()) {}
+
+        const char* value;
+    };
+
     struct OpenglProgram
     {
         GLuint id = 0;
@@ -89,9 +121,11 @@ namespace utils
         GLuint compute = 0;
 
         static std::shared_ptr<OpenglProgram> create(std::shared_ptr<OpenglShader>& vertexShader, std::shared_ptr<OpenglShader>& fragmentShader);
+        static std::shared_ptr<OpenglProgram> create(std::shared_ptr<OpenglShader>& computeShader);
 
         ~OpenglProgram();
         bool init(std::shared_ptr<OpenglShader>& vertexShader, std::shared_ptr<OpenglShader>& fragmentShader);
+        bool init(std::shared_ptr<OpenglShader>& computeShader);
         void destroy();
 
         void use() 
@@ -99,76 +133,91 @@ namespace utils
             glUseProgram(id); 
         }
 
-        void setBool(const std::string &name, bool value) const
+        void setBool(UniformName name, bool value) const
         {         
-            glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value); 
+            glUniform1i(glGetUniformLocation(id, name.value), (int)value); 
         }
         // ------------------------------------------------------------------------
-        void setInt(const std::string &name, int value) const
+        void setInt(UniformName name, int value) const
         { 
-            glUniform1i(glGetUniformLocation(id, name.c_str()), value); 
+            glUniform1i(glGetUniformLocation(id, name.value), value); 
         }
         // ------------------------------------------------------------------------
-        void setFloat(const std::string &name, float value) const
+        void setFloat(UniformName name, float value) const
         { 
-            glUniform1f(glGetUniformLocation(id, name.c_str()), value); 
+            glUniform1f(glGetUniformLocation(id, name.value), value); 
         }
         // ------------------------------------------------------------------------
-        void setVec2(const std::string &name, const glm::vec2 &value) const
+        void setVec2(UniformName name, const glm::vec2 &value) const
         { 
-            glUniform2fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]); 
+            glUniform2fv(glGetUniformLocation(id, name.value), 1, &value[0]); 
         }
-        void setVec2(const std::string &name, float x, float y) const
+        void setVec2(UniformName name, float x, float y) const
         { 
-            glUniform2f(glGetUniformLocation(id, name.c_str()), x, y); 
+            glUniform2f(glGetUniformLocation(id, name.value), x, y); 
         }
         // ------------------------------------------------------------------------
-        void setVec3(const std::string &name, const glm::vec3 &value) const
+        void setVec3(UniformName name, const glm::vec3 &value) const
         { 
-            glUniform3fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]); 
+            glUniform3fv(glGetUniformLocation(id, name.value), 1, &value[0]); 
         }
-        void setVec3(const std::string &name, float x, float y, float z) const
+        void setVec3(UniformName name, float x, float y, float z) const
         { 
-            glUniform3f(glGetUniformLocation(id, name.c_str()), x, y, z); 
+            glUniform3f(glGetUniformLocation(id, name.value), x, y, z); 
         }
         // ------------------------------------------------------------------------
-        void setVec4(const std::string &name, const glm::vec4 &value) const
+        void setVec4(UniformName name, const glm::vec4 &value) const
         { 
-            glUniform4fv(glGetUniformLocation(id, name.c_str()), 1, &value[0]); 
+            glUniform4fv(glGetUniformLocation(id, name.value), 1, &value[0]); 
         }
-        void setVec4(const std::string &name, float x, float y, float z, float w) 
+        void setVec4(UniformName name, float x, float y, float z, float w) 
         { 
-            glUniform4f(glGetUniformLocation(id, name.c_str()), x, y, z, w); 
+            glUniform4f(glGetUniformLocation(id, name.value), x, y, z, w); 
         }
         // ------------------------------------------------------------------------
-        void setMat2(const std::string &name, const glm::mat2 &mat) const
+        void setMat2(UniformName name, const glm::mat2 &mat) const
         {
-            glUniformMatrix2fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            glUniformMatrix2fv(glGetUniformLocation(id, name.value), 1, GL_FALSE, &mat[0][0]);
         }
         // ------------------------------------------------------------------------
-        void setMat3(const std::string &name, const glm::mat3 &mat) const
+        void setMat3(UniformName name, const glm::mat3 &mat) const
         {
-            glUniformMatrix3fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            glUniformMatrix3fv(glGetUniformLocation(id, name.value), 1, GL_FALSE, &mat[0][0]);
         }
         // ------------------------------------------------------------------------
-        void setMat4(const std::string &name, const glm::mat4 &mat) const
+        void setMat4(UniformName name, const glm::mat4 &mat) const
         {
-            glUniformMatrix4fv(glGetUniformLocation(id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+            glUniformMatrix4fv(glGetUniformLocation(id, name.value), 1, GL_FALSE, &mat[0][0]);
         }
     };
 
     struct Image
     {
     public:
-        void loadFromFile(const std::string& filename);
+        Image() = default;
+        Image(const Image&) = delete;
+        Image& operator=(const Image&) = delete;
+
+        // decodes to RGBA8, returns false and keeps the previous contents on failure
+        bool loadFromFile(const std::string& filename);
+        bool loadFromMemory(const unsigned char* data, size_t size);
+
+        // allocates an uninitialized RGBA8 image, reusing the current buffer when it is large enough
+        void create(int width, int height);
+
+        bool encodePng(std::vector<unsigned char>& output) const;
+        bool saveToFile(const std::string& filename) const;
+
+        // reason for the last failed load on the calling thread
+        static const char* getLastError();
 
         ~Image();
 
-        int mWidth;
-        int mHeight;
-        int mDepth;
-        int mChannle;
-        unsigned char* mData;
+        int mWidth = 0;
+        int mHeight = 0;
+        int mDepth = 0;
+        int mChannle = 0;
+        unsigned char* mData = nullptr;
 
         
     };
@@ -178,12 +227,21 @@ namespace utils
     public:
         static std::shared_ptr<Texture2D> create(const std::string& filename, bool generatedMipmap = true);
 
-        ~Texture2D() = default;
+        Texture2D() = default;
+        ~Texture2D();
+
+        Texture2D(const Texture2D&) = delete;
+        Texture2D& operator=(const Texture2D&) = delete;
 
+        // marks the texture as used this frame, an evicted texture is streamed back in first. mId stays the same
+        // across evictions and mip drops, code that samples it through the raw name has to touch() it every frame
         void bind(uint32_t slot);
+        void touch();
 
         void unbind();
 
+        void destroy();
+
         const uint32_t getWidth() const  { return mWidth; }
         const uint32_t getHeight() const { return mHeight; }
 
@@ -194,9 +252,29 @@ namespace utils
         uint32_t mChanngle = 0;
         bool mHasMipmap = false;
 
+        // mWidth and mHeight stay the size of the file when top mips are dropped, mLevels is the full chain
+        std::string mFilename;
+        uint32_t mLevels = 0;
+        GpuResidency::ResourceId mResidency = GpuResidency::kInvalidResource;
+
     private:
         bool loadFromFile(const std::string& filename, bool generateMipmap);
 
+        // reads and decodes mFilename through the asset file system, free the result with stbi_image_free
+        unsigned char* decode(int& width, int& height, int& channels) const;
+
+        // uploads levels [first, end) of the chain built from the decoded top level, data is filtered in place
+        void uploadLevels(unsigned char* data, uint32_t first, uint32_t end);
+
+        // respecifies the levels of mId so that the top droppedMips are missing. Dropped levels are freed, missing
+        // ones are decoded from the file again, the rest stays untouched. Returns the resident size in bytes
+        uint64_t upload(uint32_t droppedMips);
+
+        // frees every level but keeps the name
+        void release();
+
+        // first level with storage, mLevels when evicted
+        uint32_t mResidentMip = 0;
     };
 
     class Mesh
@@ -209,6 +287,14 @@ namespace utils
         
         static std::shared_ptr<Mesh> createPlane(float horizontalExtend, float verticalExtend);
 
+        // resolution x resolution quads on the xz plane spanning [0, 1]. Odd resolutions are rounded up to the next even one.
+        // Indices are grouped by quadrant (-x -z, +x -z, -x +z, +x +z) so each quarter can be drawn on its own.
+        static std::shared_ptr<Mesh> createGrid(uint32_t resolution);
+
+        // unit sphere made of six cube faces of resolution x resolution quads each. roughness > 0 displaces the
+        // surface along the normal by up to that fraction of the radius with layered noise, like a scanned object
+        static std::shared_ptr<Mesh> createSphere(uint32_t resolution, float roughness = 0.0f);
+
         std::vector<float> mVertices;
         std::vector<float> mNormals;
         std::vector<float> mTangents;
@@ -0,0 +1,151 @@
+#include "Profiler.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace utils
+{
+    namespace
+    {
+        constexpr uint32_t kNoZone = ~0u;
+    }
+
+    Profiler::~Profiler()
+    {
+        destroy();
+    }
+
+    bool Profiler::init(uint32_t maxZones)
+    {
+        destroy();
+
+        if (maxZones == 0)
+        {
+            std::cerr << "Profiler needs room for at least one zone" << std::endl;
+            return false;
+        }
+
+        // a begin and an end timestamp per zone and frame in flight
+        mMaxZones = maxZones;
+        mFrames.resize(kFrameLatency);
+        for (Frame& frame : mFrames)
+        {
+            frame.records.reserve(maxZones);
+            frame.queries.resize(size_t(maxZones) * 2);
+            glCreateQueries(GL_TIMESTAMP, GLsizei(frame.queries.size()), frame.queries.data());
+        }
+        return true;
+    }
+
+    void Profiler::destroy()
+    {
+        for (Frame& frame : mFrames)
+        {
+            glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+        }
+        mFrames.clear();
+        mZones.clear();
+        mCounters.clear();
+        mMaxZones = 0;
+        mInFrame = false;
+    }
+
+    void Profiler::beginFrame()
+    {
+        if (mFrames.empty())
+        {
+            return;
+        }
+
+        // the slot was last used kFrameLatency frames ago, its timestamps are normally available by now
+        mFrameIndex = (mFrameIndex + 1) % kFrameLatency;
+        Frame& frame = mFrames[mFrameIndex];
+        if (frame.pending)
+        {
+            collect(frame);
+        }
+
+        frame.records.clear();
+        mDepth = 0;
+        mInFrame = true;
+    }
+
+    void Profiler::endFrame()
+    {
+        if (mInFrame)
+        {
+            mFrames[mFrameIndex].pending = !mFrames[mFrameIndex].records.empty();
+            mInFrame = false;
+        }
+    }
+
+    uint32_t Profiler::beginZone(const char* name)
+    {
+        if (glPushDebugGroup != nullptr)
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, GLsizei(std::strlen(name)), name);
+        }
+
+        if (!mInFrame || mFrames[mFrameIndex].records.size() >= mMaxZones)
+        {
+            return kNoZone;
+        }
+
+        Frame& frame = mFrames[mFrameIndex];
+        const uint32_t zone = uint32_t(frame.records.size());
+        glQueryCounter(frame.queries[size_t(zone) * 2], GL_TIMESTAMP);
+        frame.records.push_back({ name, mDepth++, Clock::now(), Clock::time_point() });
+        return zone;
+    }
+
+    void Profiler::endZone(uint32_t zone)
+    {
+        if (zone != kNoZone && mInFrame)
+        {
+            Frame& frame = mFrames[mFrameIndex];
+            glQueryCounter(frame.queries[size_t(zone) * 2 + 1], GL_TIMESTAMP);
+            frame.records[zone].cpuEnd = Clock::now();
+            --mDepth;
+        }
+
+        if (glPopDebugGroup != nullptr)
+        {
+            glPopDebugGroup();
+        }
+    }
+
+    void Profiler::setCounter(const char* name, double value)
+    {
+        for (ProfileCounter& counter : mCounters)
+        {
+            if (counter.name == name || std::strcmp(counter.name, name) == 0)
+            {
+                counter.value = value;
+                return;
+            }
+        }
+        mCounters.push_back({ name, value });
+    }
+
+    void Profiler::collect(Frame& frame)
+    {
+        mZones.resize(frame.records.size());
+        for (size_t i = 0; i < frame.records.size(); ++i)
+        {
+            const Record& record = frame.records[i];
+
+            // waits only if the GPU is more than kFrameLatency frames behind
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+            ProfileZone& zone = mZones[i];
+            zone.name = record.name;
+            zone.depth = record.depth;
+            zone.cpuTime = std::chrono::duration<double, std::milli>(record.cpuEnd - record.cpuBegin).count();
+            zone.gpuTime = end > begin ? double(end - begin) * 1e-6 : 0.0;
+        }
+        frame.pending = false;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+namespace utils
+{
+    struct ProfileZone
+    {
+        // the string passed to beginZone, it has to outlive the profiler
+        const char* name = nullptr;
+        uint32_t depth = 0;
+
+        // milliseconds
+        double cpuTime = 0.0;
+        double gpuTime = 0.0;
+    };
+
+    struct ProfileCounter
+    {
+        // like zone names, it has to outlive the profiler
+        const char* name = nullptr;
+        double value = 0.0;
+    };
+
+    // CPU and GPU time of nested zones. Every zone is also a KHR_debug group, so frame debuggers and the
+    // driver's debug messages show the same structure. GPU timestamps are read kFrameLatency frames later,
+    // getZones() always describes the newest frame whose queries completed.
+    class Profiler
+    {
+    public:
+        static constexpr uint32_t kFrameLatency = 4;
+
+        Profiler() = default;
+        ~Profiler();
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        bool init(uint32_t maxZones = 128);
+        void destroy();
+
+        void beginFrame();
+        void endFrame();
+
+        // zones beyond maxZones per frame only push their debug group
+        uint32_t beginZone(const char* name);
+        void endZone(uint32_t zone);
+
+        const std::vector<ProfileZone>& getZones() const { return mZones; }
+
+        // latest value of a quantity that is not a time, e.g. memory in use. Counters keep the order they were first set in
+        void setCounter(const char* name, double value);
+        const std::vector<ProfileCounter>& getCounters() const { return mCounters; }
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Record
+        {
+            const char* name;
+            uint32_t depth;
+            Clock::time_point cpuBegin;
+            Clock::time_point cpuEnd;
+        };
+
+        struct Frame
+        {
+            std::vector<Record> records;
+            std::vector<GLuint> queries;
+            bool pending = false;
+        };
+
+        void collect(Frame& frame);
+
+        std::vector<Frame> mFrames;
+        uint32_t mFrameIndex = 0;
+        uint32_t mMaxZones = 0;
+        uint32_t mDepth = 0;
+        bool mInFrame = false;
+
+        std::vector<ProfileZone> mZones;
+        std::vector<ProfileCounter> mCounters;
+    };
+
+    // profiles the enclosing block, does nothing but the debug group outside of beginFrame/endFrame
+    class ProfileScope
+    {
+    public:
+        ProfileScope(Profiler& profiler, const char* name) : mProfiler(profiler), mZone(profiler.beginZone(name)) {}
+        ~ProfileScope() { mProfiler.endZone(mZone); }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        Profiler& mProfiler;
+        uint32_t mZone;
+    };
+}
+
+#define UTILS_PROFILE_CONCAT_IMPL(a, b) a##b
+#define UTILS_PROFILE_CONCAT(a, b) UTILS_PROFILE_CONCAT_IMPL(a, b)
+#define UTILS_PROFILE_SCOPE(profiler, name) utils::ProfileScope UTILS_PROFILE_CONCAT(profileScope, __LINE__)(profiler, name)
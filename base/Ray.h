@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cfloat>
+
+#include <glm/glm.hpp>
+
+namespace utils
+{
+    // the direction doesn't have to be normalized, hit distances are in multiples of it
+    struct Ray
+    {
+        glm::vec3 origin;
+        glm::vec3 direction;
+        float tMax = FLT_MAX;
+    };
+}
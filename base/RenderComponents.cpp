@@ -0,0 +1,136 @@
+#include "RenderComponents.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "Frustum.h"
+#include "Memory.h"
+#include "ThreadPool.h"
+
+namespace utils
+{
+    namespace
+    {
+        template<typename... Ts, typename F>
+        void runChunks(EntityWorld& world, ThreadPool* pool, F&& function)
+        {
+            if (pool != nullptr)
+            {
+                world.parallelForEachChunk<Ts...>(*pool, function);
+            }
+            else
+            {
+                world.forEachChunk<Ts...>(function);
+            }
+        }
+    }
+
+    void syncTransforms(EntityWorld& world, const TransformHierarchy& transforms, ThreadPool* pool)
+    {
+        runChunks<TransformComponent, WorldTransform>(world, pool,
+            [&transforms](uint32_t count, const Entity*, TransformComponent* handles, WorldTransform* matrices)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                matrices[i].matrix = transforms.getWorldMatrix(handles[i].handle);
+            }
+        });
+    }
+
+    void selectLods(EntityWorld& world, const glm::vec3& eye, ThreadPool* pool)
+    {
+        runChunks<WorldTransform, LodComponent, MeshComponent>(world, pool,
+            [&eye](uint32_t count, const Entity*, WorldTransform* matrices, LodComponent* lods, MeshComponent* meshes)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                LodComponent& lod = lods[i];
+                if (lod.levelCount == 0)
+                {
+                    continue;
+                }
+
+                const float distance = glm::length(glm::vec3(matrices[i].matrix[3]) - eye);
+                uint32_t level = 0;
+                while (level + 1 < lod.levelCount && distance > lod.distances[level])
+                {
+                    ++level;
+                }
+
+                lod.level = level;
+                meshes[i] = lod.levels[level];
+            }
+        });
+    }
+
+    RenderSubmitStats submitRenderables(EntityWorld& world, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue, ThreadPool* pool)
+    {
+        const glm::mat4 viewProjection = projection * view;
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+        std::atomic<uint32_t> visited{ 0 };
+        std::atomic<uint32_t> culled{ 0 };
+        std::atomic<uint32_t> submitted{ 0 };
+
+        runChunks<WorldTransform, MeshComponent, MaterialComponent, BoundsComponent>(world, pool,
+            [&](uint32_t count, const Entity*, WorldTransform* matrices, MeshComponent* meshes, MaterialComponent* materials, BoundsComponent* bounds)
+        {
+            ScratchScope scratch;
+            uint32_t* visible = static_cast<uint32_t*>(scratch.allocate(sizeof(uint32_t) * count, alignof(uint32_t)));
+            uint32_t visibleCount = 0;
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const glm::mat4& matrix = matrices[i].matrix;
+                const glm::vec3 center = glm::vec3(matrix * glm::vec4(bounds[i].center, 1.0f));
+                const float scale = std::max({ glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) });
+
+                if (frustum.intersectsSphere(center, bounds[i].radius * scale))
+                {
+                    visible[visibleCount++] = i;
+                }
+            }
+
+            visited += count;
+            culled += count - visibleCount;
+            if (visibleCount == 0)
+            {
+                return;
+            }
+
+            // one allocation per chunk keeps contention on the queue low
+            DrawCommand* commands = queue.allocate(visibleCount);
+            if (commands == nullptr)
+            {
+                return;
+            }
+
+            for (uint32_t k = 0; k < visibleCount; ++k)
+            {
+                const uint32_t i = visible[k];
+                const glm::mat4& matrix = matrices[i].matrix;
+                const float depth = -(view * matrix[3]).z;
+
+                DrawCommand& command = commands[k];
+                command.sortKey = RenderQueue::makeSortKey(materials[i].layer, materials[i].program, meshes[i].vao, meshes[i].vertexBuffer, depth);
+                command.program = materials[i].program;
+                command.mvpLocation = materials[i].mvpLocation;
+                command.vao = meshes[i].vao;
+                command.mode = meshes[i].mode;
+                command.count = meshes[i].count;
+                command.indexType = meshes[i].indexType;
+                command.vertexBuffer = meshes[i].vertexBuffer;
+                command.indexBuffer = meshes[i].indexBuffer;
+                command.vertexStride = meshes[i].vertexStride;
+                command.mvp = viewProjection * matrix;
+            }
+            submitted += visibleCount;
+        });
+
+        RenderSubmitStats stats;
+        stats.visited = visited.load();
+        stats.submitted = submitted.load();
+        stats.culled = culled.load();
+        return stats;
+    }
+}
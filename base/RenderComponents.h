@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "EntityWorld.h"
+#include "RenderQueue.h"
+#include "TransformHierarchy.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    struct WorldTransform
+    {
+        glm::mat4 matrix = glm::mat4(1.0f);
+    };
+
+    // entities placed by a TransformHierarchy, their WorldTransform is refreshed by syncTransforms
+    struct TransformComponent
+    {
+        TransformHandle handle;
+    };
+
+    struct MeshComponent
+    {
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLsizei count = 0;
+
+        // 0 draws with glDrawArrays
+        GLenum indexType = GL_UNSIGNED_INT;
+
+        // set for a vao from VertexArrayCache, 0 for a vao that has its own buffers attached
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLsizei vertexStride = 0;
+    };
+
+    struct MaterialComponent
+    {
+        GLuint program = 0;
+        GLint mvpLocation = -1;
+
+        // sorted before program and mesh, e.g. opaque before transparent
+        uint32_t layer = 0;
+    };
+
+    // bounding sphere in model space
+    struct BoundsComponent
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+    };
+
+    // selectLods copies the mesh of the chosen level into the entity's MeshComponent
+    struct LodComponent
+    {
+        static constexpr uint32_t kMaxLevels = 4;
+
+        MeshComponent levels[kMaxLevels];
+
+        // a level is used up to this distance from the eye, the last level has no limit
+        float distances[kMaxLevels] = {};
+
+        uint32_t levelCount = 0;
+        uint32_t level = 0;
+    };
+
+    struct RenderSubmitStats
+    {
+        uint32_t visited = 0;
+        uint32_t culled = 0;
+        uint32_t submitted = 0;
+    };
+
+    // pool may be nullptr to run on the calling thread
+    void syncTransforms(EntityWorld& world, const TransformHierarchy& transforms, ThreadPool* pool = nullptr);
+    void selectLods(EntityWorld& world, const glm::vec3& eye, ThreadPool* pool = nullptr);
+
+    // frustum culls every entity with WorldTransform, MeshComponent, MaterialComponent and BoundsComponent
+    // and adds the visible ones to the queue, which has to be reset beforehand
+    RenderSubmitStats submitRenderables(EntityWorld& world, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue,
+        ThreadPool* pool = nullptr);
+}
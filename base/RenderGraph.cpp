@@ -0,0 +1,724 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <unordered_set>
+
+namespace utils
+{
+    namespace
+    {
+        constexpr uint32_t kUnused = std::numeric_limits<uint32_t>::max();
+
+        uint32_t getBytesPerPixel(GLenum format)
+        {
+            switch (format)
+            {
+            case GL_R8:
+                return 1;
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGBA16F:
+            case GL_RGBA16:
+            case GL_RG32F:
+            case GL_DEPTH32F_STENCIL8:
+                return 8;
+            case GL_RGBA32F:
+                return 16;
+            default:
+                // RGBA8, SRGB8_ALPHA8, RGB10_A2, R11F_G11F_B10F, RG16F, R32F, 24/32 bit depth
+                return 4;
+            }
+        }
+
+        bool hasStencil(GLenum format)
+        {
+            return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+        }
+    }
+
+    bool RenderTextureDesc::isDepth() const
+    {
+        return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F
+            || format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8;
+    }
+
+    uint64_t RenderTextureDesc::getByteSize() const
+    {
+        uint64_t size = 0;
+        uint32_t w = width;
+        uint32_t h = height;
+        for (uint32_t level = 0; level < levels; ++level)
+        {
+            size += uint64_t(w) * h * getBytesPerPixel(format);
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+        }
+        return size;
+    }
+
+    RenderTargetPool::~RenderTargetPool()
+    {
+        destroy();
+    }
+
+    RenderTexture* RenderTargetPool::acquire(const RenderTextureDesc& desc)
+    {
+        for (auto& texture : mTextures)
+        {
+            if (!texture->mInUse && texture->mDesc == desc)
+            {
+                texture->mInUse = true;
+                texture->mLastUsedFrame = mFrameIndex;
+                return texture.get();
+            }
+        }
+
+        auto texture = std::make_unique<RenderTexture>();
+        texture->mDesc = desc;
+        texture->mByteSize = desc.getByteSize();
+        texture->mInUse = true;
+        texture->mLastUsedFrame = mFrameIndex;
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture->mId);
+        glTextureStorage2D(texture->mId, std::max(desc.levels, 1u), desc.format, desc.width, desc.height);
+        glTextureParameteri(texture->mId, GL_TEXTURE_MIN_FILTER, desc.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTextureParameteri(texture->mId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTextureParameteri(texture->mId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTextureParameteri(texture->mId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        mAllocatedBytes += texture->mByteSize;
+        mTextures.push_back(std::move(texture));
+        return mTextures.back().get();
+    }
+
+    void RenderTargetPool::release(RenderTexture* texture)
+    {
+        if (texture != nullptr)
+        {
+            texture->mInUse = false;
+        }
+    }
+
+    GLuint RenderTargetPool::getFramebuffer(const std::vector<GLuint>& colors, GLuint depth, bool depthHasStencil)
+    {
+        std::string key;
+        for (GLuint color : colors)
+        {
+            key += std::to_string(color) + ",";
+        }
+        key += "d" + std::to_string(depth);
+
+        auto it = mFramebuffers.find(key);
+        if (it != mFramebuffers.end())
+        {
+            it->second.mLastUsedFrame = mFrameIndex;
+            return it->second.mId;
+        }
+
+        GLuint fbo = 0;
+        glCreateFramebuffers(1, &fbo);
+
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < colors.size(); ++i)
+        {
+            glNamedFramebufferTexture(fbo, GLenum(GL_COLOR_ATTACHMENT0 + i), colors[i], 0);
+            drawBuffers.push_back(GLenum(GL_COLOR_ATTACHMENT0 + i));
+        }
+
+        if (depth != 0)
+        {
+            glNamedFramebufferTexture(fbo, depthHasStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, depth, 0);
+        }
+
+        if (drawBuffers.empty())
+        {
+            glNamedFramebufferDrawBuffer(fbo, GL_NONE);
+        }
+        else
+        {
+            glNamedFramebufferDrawBuffers(fbo, GLsizei(drawBuffers.size()), drawBuffers.data());
+        }
+
+        const GLenum status = glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cerr << "Render graph framebuffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        }
+
+        mFramebuffers[key] = { fbo, mFrameIndex };
+        return fbo;
+    }
+
+    void RenderTargetPool::beginFrame(uint32_t maxUnusedFrames)
+    {
+        ++mFrameIndex;
+
+        for (auto it = mFramebuffers.begin(); it != mFramebuffers.end();)
+        {
+            if (mFrameIndex - it->second.mLastUsedFrame > maxUnusedFrames)
+            {
+                glDeleteFramebuffers(1, &it->second.mId);
+                it = mFramebuffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        for (auto it = mTextures.begin(); it != mTextures.end();)
+        {
+            auto& texture = *it;
+            texture->mInUse = false;
+            if (mFrameIndex - texture->mLastUsedFrame > maxUnusedFrames)
+            {
+                // framebuffers referencing it were unused for as long and are already gone
+                mAllocatedBytes -= texture->mByteSize;
+                glDeleteTextures(1, &texture->mId);
+                it = mTextures.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void RenderTargetPool::destroy()
+    {
+        for (auto& entry : mFramebuffers)
+        {
+            glDeleteFramebuffers(1, &entry.second.mId);
+        }
+        mFramebuffers.clear();
+
+        for (auto& texture : mTextures)
+        {
+            glDeleteTextures(1, &texture->mId);
+        }
+        mTextures.clear();
+        mAllocatedBytes = 0;
+    }
+
+    RenderGraphTextureHandle RenderGraphBuilder::create(const std::string& name, const RenderTextureDesc& desc)
+    {
+        RenderGraph::ResourceNode node;
+        node.mName = name;
+        node.mDesc = desc;
+        mGraph.mResources.push_back(node);
+        return RenderGraphTextureHandle(uint32_t(mGraph.mResources.size() - 1));
+    }
+
+    RenderGraphTextureHandle RenderGraphBuilder::read(RenderGraphTextureHandle handle, RenderGraphAccess access)
+    {
+        if (handle)
+        {
+            mGraph.mPasses[mPassIndex].mReads.push_back({ handle.getId(), access });
+        }
+        return handle;
+    }
+
+    RenderGraphTextureHandle RenderGraphBuilder::write(RenderGraphTextureHandle handle, RenderGraphAccess access)
+    {
+        if (handle)
+        {
+            mGraph.mPasses[mPassIndex].mWrites.push_back({ handle.getId(), access });
+            mGraph.mResources[handle.getId()].mWriters.push_back(mPassIndex);
+        }
+        return handle;
+    }
+
+    void RenderGraphBuilder::sideEffect()
+    {
+        mGraph.mPasses[mPassIndex].mSideEffect = true;
+    }
+
+    GLuint RenderGraphResources::getTexture(RenderGraphTextureHandle handle) const
+    {
+        return mGraph.getTextureId(handle.getId());
+    }
+
+    const RenderTextureDesc& RenderGraphResources::getDesc(RenderGraphTextureHandle handle) const
+    {
+        return mGraph.mResources[handle.getId()].mDesc;
+    }
+
+    void RenderGraph::addPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute)
+    {
+        PassNode pass;
+        pass.mName = name;
+        pass.mExecute = execute;
+        mPasses.push_back(std::move(pass));
+
+        RenderGraphBuilder builder(*this, uint32_t(mPasses.size() - 1));
+        setup(builder);
+
+        mCompiled = false;
+    }
+
+    RenderGraphTextureHandle RenderGraph::importTexture(const std::string& name, const RenderTextureDesc& desc, GLuint id)
+    {
+        ResourceNode node;
+        node.mName = name;
+        node.mDesc = desc;
+        node.mImported = true;
+        node.mImportedId = id;
+        mResources.push_back(node);
+        return RenderGraphTextureHandle(uint32_t(mResources.size() - 1));
+    }
+
+    RenderGraphTextureHandle RenderGraph::importBackbuffer(const std::string& name, uint32_t width, uint32_t height)
+    {
+        RenderTextureDesc desc;
+        desc.width = width;
+        desc.height = height;
+        desc.format = GL_RGBA8;
+
+        auto handle = importTexture(name, desc, 0);
+        mResources[handle.getId()].mBackbuffer = true;
+        return handle;
+    }
+
+    void RenderGraph::compile()
+    {
+        mStats = RenderGraphStats();
+        mPool.beginFrame();
+
+        cullPasses();
+        sortPasses();
+        allocateResources();
+        computeBarriers();
+
+        mCompiled = true;
+    }
+
+    void RenderGraph::cullPasses()
+    {
+        for (auto& resource : mResources)
+        {
+            // imported resources are graph outputs
+            resource.mRefCount = resource.mImported ? 1 : 0;
+        }
+
+        for (auto& pass : mPasses)
+        {
+            pass.mCulled = false;
+            pass.mRefCount = uint32_t(pass.mWrites.size());
+            for (const auto& read : pass.mReads)
+            {
+                // a read-modify-write must not keep its own pass alive
+                const bool alsoWritten = std::any_of(pass.mWrites.begin(), pass.mWrites.end(), [&](const ResourceAccess& write) { return write.mResource == read.mResource; });
+                if (!alsoWritten)
+                {
+                    ++mResources[read.mResource].mRefCount;
+                }
+            }
+        }
+
+        // every resource enters the list once, when its count first is or drops to zero
+        std::vector<uint32_t> unreferenced;
+        for (uint32_t i = 0; i < mResources.size(); ++i)
+        {
+            if (mResources[i].mRefCount == 0)
+            {
+                unreferenced.push_back(i);
+            }
+        }
+
+        auto cullPass = [&](PassNode& pass)
+        {
+            pass.mCulled = true;
+            for (const auto& read : pass.mReads)
+            {
+                auto& resource = mResources[read.mResource];
+                if (resource.mRefCount > 0 && --resource.mRefCount == 0)
+                {
+                    unreferenced.push_back(read.mResource);
+                }
+            }
+        };
+
+        for (auto& pass : mPasses)
+        {
+            if (pass.mRefCount == 0 && !pass.mSideEffect)
+            {
+                cullPass(pass);
+            }
+        }
+
+        while (!unreferenced.empty())
+        {
+            const uint32_t index = unreferenced.back();
+            unreferenced.pop_back();
+
+            for (uint32_t writer : mResources[index].mWriters)
+            {
+                auto& pass = mPasses[writer];
+                if (pass.mCulled || pass.mSideEffect)
+                {
+                    continue;
+                }
+
+                if (--pass.mRefCount == 0)
+                {
+                    cullPass(pass);
+                }
+            }
+        }
+
+        for (const auto& pass : mPasses)
+        {
+            if (pass.mCulled)
+            {
+                ++mStats.culledPassCount;
+            }
+        }
+    }
+
+    void RenderGraph::sortPasses()
+    {
+        struct ResourceState
+        {
+            uint32_t mLastWriter = kUnused;
+            std::vector<uint32_t> mReaders;
+        };
+
+        std::vector<ResourceState> states(mResources.size());
+
+        for (uint32_t i = 0; i < mPasses.size(); ++i)
+        {
+            auto& pass = mPasses[i];
+            pass.mDependencies.clear();
+            if (pass.mCulled)
+            {
+                continue;
+            }
+
+            // read after write
+            for (const auto& read : pass.mReads)
+            {
+                auto& state = states[read.mResource];
+                if (state.mLastWriter != kUnused && state.mLastWriter != i)
+                {
+                    pass.mDependencies.push_back(state.mLastWriter);
+                }
+                state.mReaders.push_back(i);
+            }
+
+            // write after write and write after read
+            for (const auto& write : pass.mWrites)
+            {
+                auto& state = states[write.mResource];
+                if (state.mLastWriter != kUnused && state.mLastWriter != i)
+                {
+                    pass.mDependencies.push_back(state.mLastWriter);
+                }
+                for (uint32_t reader : state.mReaders)
+                {
+                    if (reader != i)
+                    {
+                        pass.mDependencies.push_back(reader);
+                    }
+                }
+                state.mLastWriter = i;
+                state.mReaders.clear();
+            }
+        }
+
+        std::vector<uint32_t> inDegree(mPasses.size(), 0);
+        std::vector<std::vector<uint32_t>> dependents(mPasses.size());
+        for (uint32_t i = 0; i < mPasses.size(); ++i)
+        {
+            auto& deps = mPasses[i].mDependencies;
+            std::sort(deps.begin(), deps.end());
+            deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+            for (uint32_t dep : deps)
+            {
+                dependents[dep].push_back(i);
+                ++inDegree[i];
+            }
+        }
+
+        // Kahn's algorithm, ties broken by declaration order to keep the result stable
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+        for (uint32_t i = 0; i < mPasses.size(); ++i)
+        {
+            if (!mPasses[i].mCulled && inDegree[i] == 0)
+            {
+                ready.push(i);
+            }
+        }
+
+        mOrder.clear();
+        while (!ready.empty())
+        {
+            const uint32_t index = ready.top();
+            ready.pop();
+            mOrder.push_back(index);
+
+            for (uint32_t dependent : dependents[index])
+            {
+                if (--inDegree[dependent] == 0)
+                {
+                    ready.push(dependent);
+                }
+            }
+        }
+
+        mStats.passCount = uint32_t(mOrder.size());
+    }
+
+    void RenderGraph::allocateResources()
+    {
+        for (auto& resource : mResources)
+        {
+            resource.mFirstUse = kUnused;
+            resource.mLastUse = 0;
+            resource.mPhysical = nullptr;
+        }
+
+        for (uint32_t order = 0; order < mOrder.size(); ++order)
+        {
+            const auto& pass = mPasses[mOrder[order]];
+            auto touch = [&](const ResourceAccess& access)
+            {
+                auto& resource = mResources[access.mResource];
+                resource.mFirstUse = std::min(resource.mFirstUse, order);
+                resource.mLastUse = std::max(resource.mLastUse, order);
+            };
+            std::for_each(pass.mReads.begin(), pass.mReads.end(), touch);
+            std::for_each(pass.mWrites.begin(), pass.mWrites.end(), touch);
+        }
+
+        std::vector<std::vector<uint32_t>> acquires(mOrder.size());
+        std::vector<std::vector<uint32_t>> releases(mOrder.size());
+        for (uint32_t i = 0; i < mResources.size(); ++i)
+        {
+            const auto& resource = mResources[i];
+            if (resource.mImported || resource.mFirstUse == kUnused)
+            {
+                continue;
+            }
+
+            acquires[resource.mFirstUse].push_back(i);
+            releases[resource.mLastUse].push_back(i);
+
+            ++mStats.textureCount;
+            mStats.peakMemoryWithoutAliasing += resource.mDesc.getByteSize();
+        }
+
+        // walk the timeline, a texture released after its last use is handed to later resources
+        std::unordered_set<RenderTexture*> physical;
+        for (uint32_t order = 0; order < mOrder.size(); ++order)
+        {
+            for (uint32_t index : acquires[order])
+            {
+                auto& resource = mResources[index];
+                resource.mPhysical = mPool.acquire(resource.mDesc);
+                physical.insert(resource.mPhysical);
+            }
+
+            for (uint32_t index : releases[order])
+            {
+                mPool.release(mResources[index].mPhysical);
+            }
+        }
+
+        mStats.physicalTextureCount = uint32_t(physical.size());
+        for (const auto* texture : physical)
+        {
+            mStats.peakMemory += texture->mByteSize;
+        }
+    }
+
+    void RenderGraph::computeBarriers()
+    {
+        // image stores are incoherent, every later consumer needs a barrier for its access type
+        std::vector<bool> storageWritten(mResources.size(), false);
+        std::vector<GLbitfield> issued(mResources.size(), 0);
+
+        auto barrierFor = [](RenderGraphAccess access) -> GLbitfield
+        {
+            switch (access)
+            {
+            case RenderGraphAccess::ACCESS_SAMPLED:
+                return GL_TEXTURE_FETCH_BARRIER_BIT;
+            case RenderGraphAccess::ACCESS_STORAGE:
+                return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+            case RenderGraphAccess::ACCESS_ATTACHMENT:
+                return GL_FRAMEBUFFER_BARRIER_BIT;
+            }
+            return 0;
+        };
+
+        for (uint32_t index : mOrder)
+        {
+            auto& pass = mPasses[index];
+            pass.mBarriers = 0;
+
+            auto require = [&](const ResourceAccess& access)
+            {
+                const GLbitfield bit = barrierFor(access.mAccess);
+                if (storageWritten[access.mResource] && (issued[access.mResource] & bit) == 0)
+                {
+                    pass.mBarriers |= bit;
+                    issued[access.mResource] |= bit;
+                }
+            };
+            std::for_each(pass.mReads.begin(), pass.mReads.end(), require);
+            std::for_each(pass.mWrites.begin(), pass.mWrites.end(), require);
+
+            for (const auto& write : pass.mWrites)
+            {
+                storageWritten[write.mResource] = write.mAccess == RenderGraphAccess::ACCESS_STORAGE;
+                issued[write.mResource] = 0;
+            }
+
+            if (pass.mBarriers != 0)
+            {
+                ++mStats.barrierCount;
+            }
+        }
+    }
+
+    GLuint RenderGraph::getTextureId(uint32_t resource) const
+    {
+        const auto& node = mResources[resource];
+        if (node.mImported)
+        {
+            return node.mImportedId;
+        }
+        return node.mPhysical != nullptr ? node.mPhysical->mId : 0;
+    }
+
+    GLuint RenderGraph::prepareFramebuffer(const PassNode& pass, std::vector<GLenum>& discardOnLoad, std::vector<GLenum>& discardOnStore, uint32_t order)
+    {
+        std::vector<GLuint> colors;
+        GLuint depth = 0;
+        bool depthHasStencil = false;
+
+        for (const auto& write : pass.mWrites)
+        {
+            if (write.mAccess != RenderGraphAccess::ACCESS_ATTACHMENT)
+            {
+                continue;
+            }
+
+            const auto& resource = mResources[write.mResource];
+            if (resource.mBackbuffer)
+            {
+                // the default framebuffer can't be combined with other attachments
+                return 0;
+            }
+
+            GLenum attachment;
+            if (resource.mDesc.isDepth())
+            {
+                depth = getTextureId(write.mResource);
+                depthHasStencil = hasStencil(resource.mDesc.format);
+                attachment = depthHasStencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            }
+            else
+            {
+                attachment = GLenum(GL_COLOR_ATTACHMENT0 + colors.size());
+                colors.push_back(getTextureId(write.mResource));
+            }
+
+            if (resource.mImported)
+            {
+                continue;
+            }
+
+            const bool readHere = std::any_of(pass.mReads.begin(), pass.mReads.end(), [&](const ResourceAccess& read) { return read.mResource == write.mResource; });
+            if (resource.mFirstUse == order && !readHere)
+            {
+                discardOnLoad.push_back(attachment);
+            }
+            if (resource.mLastUse == order)
+            {
+                discardOnStore.push_back(attachment);
+            }
+        }
+
+        return mPool.getFramebuffer(colors, depth, depthHasStencil);
+    }
+
+    void RenderGraph::execute()
+    {
+        if (!mCompiled)
+        {
+            compile();
+        }
+
+        std::vector<GLenum> discardOnLoad;
+        std::vector<GLenum> discardOnStore;
+
+        for (uint32_t order = 0; order < mOrder.size(); ++order)
+        {
+            auto& pass = mPasses[mOrder[order]];
+
+            if (pass.mBarriers != 0)
+            {
+                glMemoryBarrier(pass.mBarriers);
+            }
+
+            const RenderGraphAccess attachment = RenderGraphAccess::ACCESS_ATTACHMENT;
+            auto firstAttachment = std::find_if(pass.mWrites.begin(), pass.mWrites.end(), [&](const ResourceAccess& write) { return write.mAccess == attachment; });
+
+            GLuint fbo = 0;
+            discardOnLoad.clear();
+            discardOnStore.clear();
+
+            if (firstAttachment != pass.mWrites.end())
+            {
+                fbo = prepareFramebuffer(pass, discardOnLoad, discardOnStore, order);
+
+                const auto& desc = mResources[firstAttachment->mResource].mDesc;
+                glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+                glViewport(0, 0, desc.width, desc.height);
+
+                // transient contents are undefined on first write, no need to load them
+                if (fbo != 0 && !discardOnLoad.empty())
+                {
+                    glInvalidateNamedFramebufferData(fbo, GLsizei(discardOnLoad.size()), discardOnLoad.data());
+                    ++mStats.invalidateCount;
+                }
+            }
+
+            pass.mExecute(RenderGraphResources(*this, fbo));
+
+            // nobody reads these attachments afterwards, skip storing them
+            if (fbo != 0 && !discardOnStore.empty())
+            {
+                glInvalidateNamedFramebufferData(fbo, GLsizei(discardOnStore.size()), discardOnStore.data());
+                ++mStats.invalidateCount;
+            }
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void RenderGraph::reset()
+    {
+        mPasses.clear();
+        mResources.clear();
+        mOrder.clear();
+        mCompiled = false;
+    }
+
+    std::vector<std::string> RenderGraph::getExecutionOrder() const
+    {
+        std::vector<std::string> names;
+        for (uint32_t index : mOrder)
+        {
+            names.push_back(mPasses[index].mName);
+        }
+        return names;
+    }
+}
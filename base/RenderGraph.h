@@ -0,0 +1,223 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Handle.h"
+
+namespace utils
+{
+    struct RenderTextureDesc
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        GLenum format = GL_RGBA8;
+        uint32_t levels = 1;
+
+        bool operator==(const RenderTextureDesc& rhs) const
+        {
+            return width == rhs.width && height == rhs.height && format == rhs.format && levels == rhs.levels;
+        }
+
+        bool isDepth() const;
+        uint64_t getByteSize() const;
+    };
+
+    // a physical texture owned by the pool
+    struct RenderTexture
+    {
+        GLuint mId = 0;
+        RenderTextureDesc mDesc;
+        uint64_t mByteSize = 0;
+        uint64_t mLastUsedFrame = 0;
+        bool mInUse = false;
+    };
+
+    class RenderTargetPool
+    {
+    public:
+        RenderTargetPool() = default;
+        ~RenderTargetPool();
+
+        RenderTargetPool(const RenderTargetPool&) = delete;
+        RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+        // returns a free texture matching desc, creating one if needed
+        RenderTexture* acquire(const RenderTextureDesc& desc);
+        void release(RenderTexture* texture);
+
+        // framebuffer for the given attachment set, cached across frames
+        GLuint getFramebuffer(const std::vector<GLuint>& colors, GLuint depth, bool depthHasStencil);
+
+        // advances the frame counter and releases textures and framebuffers unused for more than maxUnusedFrames
+        void beginFrame(uint32_t maxUnusedFrames = 4);
+
+        void destroy();
+
+        uint64_t getAllocatedBytes() const { return mAllocatedBytes; }
+
+    private:
+        struct FramebufferEntry
+        {
+            GLuint mId = 0;
+            uint64_t mLastUsedFrame = 0;
+        };
+
+        std::vector<std::unique_ptr<RenderTexture>> mTextures;
+        std::unordered_map<std::string, FramebufferEntry> mFramebuffers;
+        uint64_t mFrameIndex = 0;
+        uint64_t mAllocatedBytes = 0;
+    };
+
+    struct RenderGraphTexture;
+    using RenderGraphTextureHandle = Handle<RenderGraphTexture>;
+
+    enum class RenderGraphAccess : uint32_t
+    {
+        ACCESS_SAMPLED,
+        ACCESS_STORAGE,
+        ACCESS_ATTACHMENT,
+    };
+
+    struct RenderGraphStats
+    {
+        uint32_t passCount = 0;
+        uint32_t culledPassCount = 0;
+        uint32_t textureCount = 0;
+        uint32_t physicalTextureCount = 0;
+        uint32_t barrierCount = 0;
+        uint32_t invalidateCount = 0;
+
+        // render target memory used by transient resources this frame
+        uint64_t peakMemory = 0;
+        uint64_t peakMemoryWithoutAliasing = 0;
+    };
+
+    class RenderGraph;
+
+    class RenderGraphBuilder
+    {
+    public:
+        RenderGraphTextureHandle create(const std::string& name, const RenderTextureDesc& desc);
+        RenderGraphTextureHandle read(RenderGraphTextureHandle handle, RenderGraphAccess access = RenderGraphAccess::ACCESS_SAMPLED);
+        RenderGraphTextureHandle write(RenderGraphTextureHandle handle, RenderGraphAccess access = RenderGraphAccess::ACCESS_ATTACHMENT);
+
+        // keeps the pass alive even if nothing reads its outputs
+        void sideEffect();
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphBuilder(RenderGraph& graph, uint32_t passIndex) : mGraph(graph), mPassIndex(passIndex) {}
+
+        RenderGraph& mGraph;
+        uint32_t mPassIndex;
+    };
+
+    class RenderGraphResources
+    {
+    public:
+        GLuint getTexture(RenderGraphTextureHandle handle) const;
+        const RenderTextureDesc& getDesc(RenderGraphTextureHandle handle) const;
+
+        // framebuffer holding the pass's attachments, already bound for drawing
+        GLuint getFramebuffer() const { return mFramebuffer; }
+
+    private:
+        friend class RenderGraph;
+
+        RenderGraphResources(const RenderGraph& graph, GLuint framebuffer) : mGraph(graph), mFramebuffer(framebuffer) {}
+
+        const RenderGraph& mGraph;
+        GLuint mFramebuffer;
+    };
+
+    class RenderGraph
+    {
+    public:
+        using SetupFunction = std::function<void(RenderGraphBuilder&)>;
+        using ExecuteFunction = std::function<void(const RenderGraphResources&)>;
+
+        explicit RenderGraph(RenderTargetPool& pool) : mPool(pool) {}
+
+        void addPass(const std::string& name, const SetupFunction& setup, const ExecuteFunction& execute);
+
+        // external textures are never aliased or invalidated, writing them keeps the writer alive
+        RenderGraphTextureHandle importTexture(const std::string& name, const RenderTextureDesc& desc, GLuint id);
+        RenderGraphTextureHandle importBackbuffer(const std::string& name, uint32_t width, uint32_t height);
+
+        // culls, orders and assigns physical resources
+        void compile();
+        void execute();
+
+        // drops all passes and resources, physical textures stay in the pool
+        void reset();
+
+        const RenderGraphStats& getStats() const { return mStats; }
+
+        // pass names in execution order after compile()
+        std::vector<std::string> getExecutionOrder() const;
+
+    private:
+        friend class RenderGraphBuilder;
+        friend class RenderGraphResources;
+
+        struct ResourceNode
+        {
+            std::string mName;
+            RenderTextureDesc mDesc;
+            GLuint mImportedId = 0;
+            bool mImported = false;
+            bool mBackbuffer = false;
+
+            std::vector<uint32_t> mWriters;
+            uint32_t mRefCount = 0;
+            uint32_t mFirstUse = 0;
+            uint32_t mLastUse = 0;
+            RenderTexture* mPhysical = nullptr;
+        };
+
+        struct ResourceAccess
+        {
+            uint32_t mResource;
+            RenderGraphAccess mAccess;
+        };
+
+        struct PassNode
+        {
+            std::string mName;
+            ExecuteFunction mExecute;
+            std::vector<ResourceAccess> mReads;
+            std::vector<ResourceAccess> mWrites;
+            std::vector<uint32_t> mDependencies;
+            uint32_t mRefCount = 0;
+            bool mSideEffect = false;
+            bool mCulled = false;
+
+            // filled by compile()
+            GLbitfield mBarriers = 0;
+        };
+
+        void cullPasses();
+        void sortPasses();
+        void allocateResources();
+        void computeBarriers();
+
+        GLuint getTextureId(uint32_t resource) const;
+        GLuint prepareFramebuffer(const PassNode& pass, std::vector<GLenum>& discardOnLoad, std::vector<GLenum>& discardOnStore, uint32_t order);
+
+        RenderTargetPool& mPool;
+        std::vector<PassNode> mPasses;
+        std::vector<ResourceNode> mResources;
+        std::vector<uint32_t> mOrder;
+        bool mCompiled = false;
+
+        RenderGraphStats mStats;
+    };
+}
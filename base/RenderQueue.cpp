@@ -0,0 +1,127 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace utils
+{
+    uint64_t RenderQueue::makeSortKey(uint32_t layer, GLuint program, GLuint vao, GLuint vertexBuffer, float viewDepth)
+    {
+        // positive floats order like their bit patterns
+        uint32_t depthBits = 0;
+        const float depth = std::max(viewDepth, 0.0f);
+        std::memcpy(&depthBits, &depth, sizeof(depthBits));
+
+        return (uint64_t(layer & 0xf) << 60) | (uint64_t(program & 0xfff) << 48) | (uint64_t(vao & 0xff) << 40)
+            | (uint64_t(vertexBuffer & 0xff) << 32) | depthBits;
+    }
+
+    void RenderQueue::reset(uint32_t capacity)
+    {
+        if (mCommands.size() < capacity)
+        {
+            mCommands.resize(capacity);
+        }
+        mOrder.clear();
+        mCount = 0;
+        mDropped = 0;
+        mStats = RenderQueueStats();
+    }
+
+    DrawCommand* RenderQueue::allocate(uint32_t count)
+    {
+        // the counter never passes the capacity, so every slot below it belongs to a caller
+        uint32_t first = mCount.load(std::memory_order_relaxed);
+        do
+        {
+            if (first + count > mCommands.size())
+            {
+                mDropped += count;
+                return nullptr;
+            }
+        } while (!mCount.compare_exchange_weak(first, first + count, std::memory_order_relaxed));
+
+        return mCommands.data() + first;
+    }
+
+    uint32_t RenderQueue::size() const
+    {
+        return mCount.load(std::memory_order_relaxed);
+    }
+
+    void RenderQueue::sort()
+    {
+        const uint32_t count = size();
+
+        mOrder.resize(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            mOrder[i] = { mCommands[i].sortKey, i };
+        }
+        std::sort(mOrder.begin(), mOrder.end());
+    }
+
+    void RenderQueue::execute()
+    {
+        if (mOrder.size() != size())
+        {
+            sort();
+        }
+
+        GLuint program = 0;
+        GLuint vao = 0;
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        for (const auto& entry : mOrder)
+        {
+            const DrawCommand& command = mCommands[entry.second];
+            if (command.count == 0)
+            {
+                continue;
+            }
+
+            if (command.program != program)
+            {
+                program = command.program;
+                glUseProgram(program);
+                ++mStats.programChanges;
+            }
+            if (command.vao != vao)
+            {
+                vao = command.vao;
+                glBindVertexArray(vao);
+                ++mStats.vertexArrayChanges;
+
+                // a shared vao still holds whatever buffers were attached when it was last used
+                vertexBuffer = 0;
+                indexBuffer = 0;
+            }
+            if (command.vertexBuffer != 0 && command.vertexBuffer != vertexBuffer)
+            {
+                vertexBuffer = command.vertexBuffer;
+                glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, command.vertexStride);
+                ++mStats.vertexBufferChanges;
+            }
+            if (command.indexBuffer != 0 && command.indexBuffer != indexBuffer)
+            {
+                indexBuffer = command.indexBuffer;
+                glVertexArrayElementBuffer(vao, indexBuffer);
+            }
+
+            glUniformMatrix4fv(command.mvpLocation, 1, GL_FALSE, &command.mvp[0][0]);
+            if (command.indexType != 0)
+            {
+                glDrawElements(command.mode, command.count, command.indexType, nullptr);
+            }
+            else
+            {
+                glDrawArrays(command.mode, 0, command.count);
+            }
+        }
+
+        glBindVertexArray(0);
+
+        mStats.commandCount = uint32_t(mOrder.size());
+        mStats.droppedCount = mDropped.load();
+    }
+}
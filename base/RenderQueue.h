@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace utils
+{
+    struct DrawCommand
+    {
+        uint64_t sortKey = 0;
+
+        GLuint program = 0;
+        GLint mvpLocation = -1;
+        GLuint vao = 0;
+        GLenum mode = GL_TRIANGLES;
+        GLsizei count = 0;
+
+        // 0 draws with glDrawArrays
+        GLenum indexType = GL_UNSIGNED_INT;
+
+        // bound to binding 0 and as element buffer of a shared vao before drawing, 0 keeps the vao's own
+        GLuint vertexBuffer = 0;
+        GLuint indexBuffer = 0;
+        GLsizei vertexStride = 0;
+
+        glm::mat4 mvp;
+    };
+
+    struct RenderQueueStats
+    {
+        uint32_t commandCount = 0;
+        uint32_t programChanges = 0;
+        uint32_t vertexArrayChanges = 0;
+        uint32_t vertexBufferChanges = 0;
+
+        // commands that did not fit into the capacity given to reset()
+        uint32_t droppedCount = 0;
+    };
+
+    // collects draws from any thread, sorts them by key and submits them with redundant binds skipped
+    class RenderQueue
+    {
+    public:
+        // layer first, then state, then front to back. Meshes sharing a vao are grouped by vertex buffer
+        static uint64_t makeSortKey(uint32_t layer, GLuint program, GLuint vao, GLuint vertexBuffer, float viewDepth);
+
+        // starts a new frame, capacity is the most commands that can be added before the next reset
+        void reset(uint32_t capacity);
+
+        // thread-safe, returns nullptr once the queue is full
+        DrawCommand* allocate(uint32_t count);
+
+        void sort();
+        void execute();
+
+        uint32_t size() const;
+        const DrawCommand& operator[](uint32_t index) const { return mCommands[mOrder[index].second]; }
+
+        const RenderQueueStats& getStats() const { return mStats; }
+
+    private:
+        std::vector<DrawCommand> mCommands;
+        std::vector<std::pair<uint64_t, uint32_t>> mOrder;
+        std::atomic<uint32_t> mCount{ 0 };
+        std::atomic<uint32_t> mDropped{ 0 };
+
+        RenderQueueStats mStats;
+    };
+}
@@ -0,0 +1,359 @@
+#include "SpriteBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+#include "ThreadPool.h"
+
+namespace utils
+{
+    namespace
+    {
+        constexpr uint16_t kNoTexture = 0xffff;
+
+        uint16_t toUnorm16(float value)
+        {
+            return uint16_t(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f));
+        }
+
+        uint32_t packColor(const glm::vec4& color)
+        {
+            const glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+            return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+        }
+
+        void applyBlend(SpriteBlend blend)
+        {
+            switch (blend)
+            {
+            case SPRITE_BLEND_ALPHA:
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                break;
+            case SPRITE_BLEND_PREMULTIPLIED:
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+                break;
+            case SPRITE_BLEND_ADDITIVE:
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+                break;
+            default:
+                glDisable(GL_BLEND);
+                break;
+            }
+        }
+    }
+
+    SpriteBatch::~SpriteBatch()
+    {
+        destroy();
+    }
+
+    bool SpriteBatch::init(std::shared_ptr<OpenglProgram> program, uint32_t maxSprites)
+    {
+        destroy();
+
+        if (program == nullptr || maxSprites == 0)
+        {
+            std::cerr << "Sprite batch needs a program and room for at least one sprite" << std::endl;
+            return false;
+        }
+
+        mProgram = program;
+        mMaxSprites = maxSprites;
+
+        // one region per frame in flight, written while the GPU still reads the others
+        if (!mVertexBuffer.init(GLsizeiptr(maxSprites) * 4 * sizeof(Vertex)))
+        {
+            destroy();
+            return false;
+        }
+
+        std::vector<uint32_t> indices(size_t(maxSprites) * 6);
+        for (uint32_t quad = 0; quad < maxSprites; ++quad)
+        {
+            const uint32_t vertex = quad * 4;
+            uint32_t* index = &indices[size_t(quad) * 6];
+            index[0] = vertex + 0;
+            index[1] = vertex + 1;
+            index[2] = vertex + 2;
+            index[3] = vertex + 2;
+            index[4] = vertex + 1;
+            index[5] = vertex + 3;
+        }
+        glCreateBuffers(1, &mIndexBuffer);
+        glNamedBufferStorage(mIndexBuffer, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mVertexBuffer.getId(), 0, sizeof(Vertex));
+        glVertexArrayElementBuffer(mVao, mIndexBuffer);
+        glVertexArrayAttribFormat(mVao, 0, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexArrayAttribFormat(mVao, 1, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(Vertex, uv));
+        glVertexArrayAttribFormat(mVao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Vertex, color));
+        glVertexArrayAttribIFormat(mVao, 3, 2, GL_UNSIGNED_SHORT, offsetof(Vertex, texture));
+        for (GLuint attribute = 0; attribute < 4; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, 0);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+
+        // 2D textures use units [0, kTextureSlots), arrays the units after them
+        mProgram->use();
+        for (uint32_t slot = 0; slot < kTextureSlots; ++slot)
+        {
+            mProgram->setInt("u_textures[" + std::to_string(slot) + "]", int(slot));
+            mProgram->setInt("u_arrays[" + std::to_string(slot) + "]", int(kTextureSlots + slot));
+        }
+        glUseProgram(0);
+
+        mQuads.reserve(std::min(maxSprites, 1u << 16));
+        return true;
+    }
+
+    void SpriteBatch::destroy()
+    {
+        if (mVao != 0)
+        {
+            glDeleteVertexArrays(1, &mVao);
+            mVao = 0;
+        }
+        mVertexBuffer.destroy();
+        if (mIndexBuffer != 0)
+        {
+            glDeleteBuffers(1, &mIndexBuffer);
+            mIndexBuffer = 0;
+        }
+
+        mProgram.reset();
+        mQuads.clear();
+        mMaxSprites = 0;
+    }
+
+    void SpriteBatch::begin(const glm::mat4& projection)
+    {
+        mProjection = projection;
+        mQuads.clear();
+        mStats = SpriteBatchStats();
+
+        if (mVertexBuffer.isMapped())
+        {
+            mVertexBuffer.acquire();
+        }
+    }
+
+    void SpriteBatch::draw(const Sprite& sprite)
+    {
+        if (mQuads.size() >= mMaxSprites)
+        {
+            ++mStats.droppedSprites;
+            return;
+        }
+
+        Quad quad;
+        quad.position = sprite.position;
+        quad.halfSize = sprite.size * 0.5f;
+        quad.rotation = sprite.rotation == 0.0f ? glm::vec2(1.0f, 0.0f) : glm::vec2(std::cos(sprite.rotation), std::sin(sprite.rotation));
+        quad.uv[0] = toUnorm16(sprite.uvRect.x);
+        quad.uv[1] = toUnorm16(sprite.uvRect.y);
+        quad.uv[2] = toUnorm16(sprite.uvRect.z);
+        quad.uv[3] = toUnorm16(sprite.uvRect.w);
+        quad.color = packColor(sprite.color);
+        quad.texture = sprite.texture;
+        quad.layer = uint16_t(sprite.layer);
+        quad.isArray = sprite.target == GL_TEXTURE_2D_ARRAY ? 1 : 0;
+        quad.blend = uint8_t(sprite.blend);
+        quad.order = sprite.order;
+        mQuads.push_back(quad);
+    }
+
+    void SpriteBatch::sortQuads()
+    {
+        const uint32_t count = uint32_t(mQuads.size());
+        mKeys.resize(count);
+        mSortScratch.resize(count);
+
+        // order, blend, texture kind and name in the upper half, the submission index in the lower half
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Quad& quad = mQuads[i];
+            const uint64_t group = (uint64_t(quad.order) << 24) | (uint64_t(quad.blend) << 22) | (uint64_t(quad.isArray) << 21)
+                | (quad.texture & 0x1fffff);
+            mKeys[i] = (group << 32) | i;
+        }
+
+        // stable LSD radix sort on the group bytes, a pass is skipped when all keys share its digit
+        uint32_t histogram[4][256] = {};
+        for (uint64_t key : mKeys)
+        {
+            for (uint32_t pass = 0; pass < 4; ++pass)
+            {
+                ++histogram[pass][(key >> (32 + pass * 8)) & 0xff];
+            }
+        }
+
+        for (uint32_t pass = 0; pass < 4; ++pass)
+        {
+            const uint32_t shift = 32 + pass * 8;
+            if (histogram[pass][(mKeys[0] >> shift) & 0xff] == count)
+            {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for (uint32_t& bucket : histogram[pass])
+            {
+                const uint32_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+
+            for (uint64_t key : mKeys)
+            {
+                mSortScratch[histogram[pass][(key >> shift) & 0xff]++] = key;
+            }
+            mKeys.swap(mSortScratch);
+        }
+    }
+
+    void SpriteBatch::end(ThreadPool* pool)
+    {
+        if (mQuads.empty() || !mVertexBuffer.isMapped())
+        {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        sortQuads();
+
+        // walk the sorted quads and give every texture of a draw its own slot
+        struct Draw
+        {
+            uint32_t first;
+            uint32_t count;
+            SpriteBlend blend;
+            GLuint textures[kTextureSlots];
+            GLuint arrays[kTextureSlots];
+        };
+
+        std::vector<Draw> draws;
+        mSlots.resize(mQuads.size());
+
+        Draw current = {};
+        uint32_t used[2] = {};
+        for (uint32_t i = 0; i < uint32_t(mKeys.size()); ++i)
+        {
+            const Quad& quad = mQuads[uint32_t(mKeys[i])];
+            const SpriteBlend blend = SpriteBlend(quad.blend);
+
+            bool fits = true;
+            if (quad.texture != 0)
+            {
+                const GLuint* names = quad.isArray ? current.arrays : current.textures;
+                const uint32_t count = used[quad.isArray];
+                fits = count < kTextureSlots || std::find(names, names + count, quad.texture) != names + count;
+            }
+
+            if (current.count > 0 && (blend != current.blend || !fits))
+            {
+                mStats.slotSplits += fits ? 0 : 1;
+                draws.push_back(current);
+                current = {};
+                used[0] = 0;
+                used[1] = 0;
+            }
+
+            if (current.count == 0)
+            {
+                current.first = i;
+                current.blend = blend;
+            }
+
+            uint16_t slot = kNoTexture;
+            if (quad.texture != 0)
+            {
+                GLuint* names = quad.isArray ? current.arrays : current.textures;
+                uint32_t& count = used[quad.isArray];
+                slot = uint16_t(std::find(names, names + count, quad.texture) - names);
+                if (slot == count)
+                {
+                    names[count++] = quad.texture;
+                }
+                slot += quad.isArray ? uint16_t(kTextureSlots) : uint16_t(0);
+            }
+
+            mSlots[i] = slot;
+            ++current.count;
+        }
+        draws.push_back(current);
+
+        writeVertices(static_cast<Vertex*>(mVertexBuffer.getMapped()), pool);
+
+        mStats.buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        mStats.sprites = uint32_t(mQuads.size());
+
+        mProgram->use();
+        mProgram->setMat4("u_projection", mProjection);
+        glBindVertexArray(mVao);
+        for (const Draw& draw : draws)
+        {
+            flush(draw.first, draw.count, draw.blend, draw.textures, draw.arrays);
+        }
+        glBindVertexArray(0);
+        glDisable(GL_BLEND);
+
+        mVertexBuffer.release();
+    }
+
+    void SpriteBatch::writeVertices(Vertex* vertices, ThreadPool* pool)
+    {
+        auto write = [this, vertices](uint32_t begin, uint32_t end)
+        {
+            static const glm::vec2 corners[4] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f } };
+
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const Quad& quad = mQuads[uint32_t(mKeys[i])];
+                Vertex* vertex = vertices + size_t(i) * 4;
+                for (uint32_t corner = 0; corner < 4; ++corner)
+                {
+                    const glm::vec2 local = corners[corner] * quad.halfSize;
+                    vertex[corner].position = quad.position + glm::vec2(local.x * quad.rotation.x - local.y * quad.rotation.y,
+                        local.x * quad.rotation.y + local.y * quad.rotation.x);
+                    vertex[corner].uv[0] = quad.uv[(corner & 1) ? 2 : 0];
+                    vertex[corner].uv[1] = quad.uv[(corner & 2) ? 3 : 1];
+                    vertex[corner].color = quad.color;
+                    vertex[corner].texture = mSlots[i];
+                    vertex[corner].layer = quad.layer;
+                }
+            }
+        };
+
+        const uint32_t count = uint32_t(mQuads.size());
+        if (pool != nullptr && count > 8192)
+        {
+            pool->parallelFor(count, 4096, write);
+        }
+        else
+        {
+            write(0, count);
+        }
+    }
+
+    void SpriteBatch::flush(uint32_t first, uint32_t count, SpriteBlend blend, const GLuint* textures, const GLuint* arrays)
+    {
+        applyBlend(blend);
+
+        // unused slots are bound to 0, the shader never samples them
+        glBindTextures(0, kTextureSlots, textures);
+        glBindTextures(kTextureSlots, kTextureSlots, arrays);
+
+        const GLint baseVertex = GLint(mVertexBuffer.getOffset() / GLintptr(sizeof(Vertex)) + GLintptr(first) * 4);
+        glDrawElementsBaseVertex(GL_TRIANGLES, GLsizei(count) * 6, GL_UNSIGNED_INT, nullptr, baseVertex);
+        ++mStats.drawCalls;
+    }
+}
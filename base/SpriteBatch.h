@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+#include "StreamingBuffer.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    enum SpriteBlend : uint32_t
+    {
+        SPRITE_BLEND_ALPHA,
+        SPRITE_BLEND_PREMULTIPLIED,
+        SPRITE_BLEND_ADDITIVE,
+        SPRITE_BLEND_OPAQUE,
+        SPRITE_BLEND_COUNT,
+    };
+
+    struct Sprite
+    {
+        // center and full extent in the space of the batch's projection
+        glm::vec2 position = glm::vec2(0.0f);
+        glm::vec2 size = glm::vec2(1.0f);
+        float rotation = 0.0f;
+
+        // u0, v0, u1, v1
+        glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+        glm::vec4 color = glm::vec4(1.0f);
+
+        // 0 draws the color only, GL_TEXTURE_2D_ARRAY textures sample the given layer
+        GLuint texture = 0;
+        GLenum target = GL_TEXTURE_2D;
+        uint32_t layer = 0;
+
+        SpriteBlend blend = SPRITE_BLEND_ALPHA;
+
+        // lower orders are drawn first, within one order sprites are grouped by blend mode and texture
+        uint8_t order = 0;
+    };
+
+    struct SpriteBatchStats
+    {
+        uint32_t sprites = 0;
+        uint32_t drawCalls = 0;
+        uint32_t droppedSprites = 0;
+
+        // draws that had to end because all texture slots were taken
+        uint32_t slotSplits = 0;
+
+        // milliseconds spent sorting and writing vertices in end()
+        double buildTime = 0.0;
+    };
+
+    // Collects quads between begin and end and draws them with as few draws as possible. Sprites are sorted by
+    // order, blend mode and texture, vertices are written into a StreamingBuffer with one region per frame in
+    // flight and drawn with a shared static index buffer. A draw binds up to kTextureSlots 2D textures
+    // and as many texture arrays, a new draw only starts when the blend mode changes or the slots run out.
+    class SpriteBatch
+    {
+    public:
+        static constexpr uint32_t kTextureSlots = 8;
+        static constexpr uint32_t kRegionCount = StreamingBuffer::kRegionCount;
+
+        SpriteBatch() = default;
+        ~SpriteBatch();
+
+        SpriteBatch(const SpriteBatch&) = delete;
+        SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+        bool init(std::shared_ptr<OpenglProgram> program, uint32_t maxSprites = 1u << 17);
+        void destroy();
+
+        void begin(const glm::mat4& projection);
+        void draw(const Sprite& sprite);
+        void end(ThreadPool* pool = nullptr);
+
+        const SpriteBatchStats& getStats() const { return mStats; }
+
+    private:
+        struct Vertex
+        {
+            glm::vec2 position;
+            uint16_t uv[2];
+            uint32_t color;
+            uint16_t texture;
+            uint16_t layer;
+        };
+
+        struct Quad
+        {
+            glm::vec2 position;
+            glm::vec2 halfSize;
+            glm::vec2 rotation;     // cos, sin
+            uint16_t uv[4];
+            uint32_t color;
+            GLuint texture;
+            uint16_t layer;
+            uint8_t isArray;
+            uint8_t blend;
+            uint8_t order;
+        };
+
+        void sortQuads();
+        void writeVertices(Vertex* vertices, ThreadPool* pool);
+        void flush(uint32_t first, uint32_t count, SpriteBlend blend, const GLuint* textures, const GLuint* arrays);
+
+        std::shared_ptr<OpenglProgram> mProgram;
+        uint32_t mMaxSprites = 0;
+
+        GLuint mVao = 0;
+        StreamingBuffer mVertexBuffer;
+        GLuint mIndexBuffer = 0;
+
+        glm::mat4 mProjection = glm::mat4(1.0f);
+        std::vector<Quad> mQuads;
+        std::vector<uint64_t> mKeys;
+        std::vector<uint64_t> mSortScratch;
+
+        // texture slot per quad after sorting, 0xffff for untextured quads
+        std::vector<uint16_t> mSlots;
+
+        SpriteBatchStats mStats;
+    };
+}
@@ -0,0 +1,86 @@
+#include "StreamingBuffer.h"
+
+#include <iostream>
+
+namespace utils
+{
+    StreamingBuffer::~StreamingBuffer()
+    {
+        destroy();
+    }
+
+    bool StreamingBuffer::init(GLsizeiptr regionSize, GLsizeiptr alignment)
+    {
+        destroy();
+
+        if (regionSize <= 0 || alignment <= 0)
+        {
+            std::cerr << "Streaming buffer needs a region size and alignment" << std::endl;
+            return false;
+        }
+
+        mRegionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glCreateBuffers(1, &mId);
+        glNamedBufferStorage(mId, mRegionSize * kRegionCount, nullptr, flags);
+        mMapped = static_cast<uint8_t*>(glMapNamedBufferRange(mId, 0, mRegionSize * kRegionCount, flags));
+        if (mMapped == nullptr)
+        {
+            std::cerr << "Cannot map a streaming buffer of " << mRegionSize * kRegionCount << " bytes" << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void StreamingBuffer::destroy()
+    {
+        for (GLsync& fence : mFences)
+        {
+            if (fence != nullptr)
+            {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+
+        if (mId != 0)
+        {
+            if (mMapped != nullptr)
+            {
+                glUnmapNamedBuffer(mId);
+                mMapped = nullptr;
+            }
+            glDeleteBuffers(1, &mId);
+            mId = 0;
+        }
+
+        mRegionSize = 0;
+        mRegion = 0;
+    }
+
+    void* StreamingBuffer::acquire()
+    {
+        mRegion = (mRegion + 1) % kRegionCount;
+        GLsync& fence = mFences[mRegion];
+        if (fence != nullptr)
+        {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+        return getMapped();
+    }
+
+    void StreamingBuffer::release()
+    {
+        // a region released twice keeps the newer fence, it covers the older one
+        GLsync& fence = mFences[mRegion];
+        if (fence != nullptr)
+        {
+            glDeleteSync(fence);
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+namespace utils
+{
+    // A persistently mapped, coherent buffer split into kRegionCount regions, one per frame in flight. acquire()
+    // moves to the next region and waits for the fence of the last frame that used it, release() fences the
+    // commands submitted since, so the CPU writes one region while the GPU still reads the others.
+    class StreamingBuffer
+    {
+    public:
+        static constexpr uint32_t kRegionCount = 3;
+
+        StreamingBuffer() = default;
+        ~StreamingBuffer();
+
+        StreamingBuffer(const StreamingBuffer&) = delete;
+        StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+        // regionSize is rounded up to a multiple of alignment, so every region starts aligned for glBindBufferRange
+        bool init(GLsizeiptr regionSize, GLsizeiptr alignment = 1);
+        void destroy();
+
+        // makes the next region current once the GPU is done with it and returns its mapping
+        void* acquire();
+
+        // fences everything submitted so far, the current region is reused kRegionCount acquires later
+        void release();
+
+        bool isMapped() const { return mMapped != nullptr; }
+        GLuint getId() const { return mId; }
+
+        // the current region
+        void* getMapped() const { return mMapped + mRegionSize * mRegion; }
+        GLintptr getOffset() const { return GLintptr(mRegionSize) * mRegion; }
+        GLsizeiptr getRegionSize() const { return mRegionSize; }
+
+    private:
+        GLuint mId = 0;
+        uint8_t* mMapped = nullptr;
+        GLsizeiptr mRegionSize = 0;
+        GLsync mFences[kRegionCount] = {};
+        uint32_t mRegion = 0;
+    };
+}
@@ -0,0 +1,607 @@
+#include "Terrain.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "Frustum.h"
+#include "ThreadPool.h"
+
+namespace utils
+{
+    namespace
+    {
+        const char* kMetaFile = "terrain.txt";
+
+        bool isPowerOfTwo(uint32_t value)
+        {
+            return value != 0 && (value & (value - 1)) == 0;
+        }
+
+        uint16_t readHeight(const Image& image, int x, int y)
+        {
+            x = std::min(std::max(x, 0), image.mWidth - 1);
+            y = std::min(std::max(y, 0), image.mHeight - 1);
+            const unsigned char* pixel = image.mData + (size_t(y) * image.mWidth + x) * 4;
+            return uint16_t((pixel[0] << 8) | pixel[1]);
+        }
+
+        bool intersectsSphere(const glm::vec3& min, const glm::vec3& max, const glm::vec3& center, float radius)
+        {
+            const glm::vec3 closest = glm::clamp(center, min, max);
+            const glm::vec3 delta = closest - center;
+            return glm::dot(delta, delta) <= radius * radius;
+        }
+    }
+
+    bool Terrain::bakeTiles(const Image& heightmap, const std::string& directory, uint32_t tileSize)
+    {
+        if (heightmap.mData == nullptr || !isPowerOfTwo(tileSize))
+        {
+            std::cerr << "Cannot bake terrain tiles, the heightmap is empty or the tile size isn't a power of two" << std::endl;
+            return false;
+        }
+
+        // the finest level has one sample per heightmap texel, every level above halves the resolution
+        const uint32_t extent = uint32_t(std::max(heightmap.mWidth, heightmap.mHeight) - 1);
+        uint32_t depth = 1;
+        while ((uint64_t(tileSize) << (depth - 1)) < extent && depth < kMaxLevels)
+        {
+            ++depth;
+        }
+
+        struct TileId
+        {
+            uint32_t depth;
+            uint32_t x;
+            uint32_t y;
+        };
+
+        std::vector<TileId> tiles;
+        for (uint32_t d = 0; d < depth; ++d)
+        {
+            for (uint32_t y = 0; y < (1u << d); ++y)
+            {
+                for (uint32_t x = 0; x < (1u << d); ++x)
+                {
+                    tiles.push_back({ d, x, y });
+                }
+            }
+        }
+
+        std::atomic<bool> succeeded{ true };
+        const uint32_t samples = tileSize + 1;
+
+        ThreadPool::global().parallelFor(uint32_t(tiles.size()), 16, [&](uint32_t begin, uint32_t end)
+        {
+            Image tile;
+            tile.create(int(samples), int(samples));
+
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const TileId& id = tiles[i];
+                const uint32_t step = 1u << (depth - 1 - id.depth);
+                const uint64_t originX = uint64_t(id.x) * tileSize * step;
+                const uint64_t originY = uint64_t(id.y) * tileSize * step;
+
+                for (uint32_t y = 0; y < samples; ++y)
+                {
+                    for (uint32_t x = 0; x < samples; ++x)
+                    {
+                        const uint16_t height = readHeight(heightmap, int(std::min<uint64_t>(originX + x * step, INT32_MAX)),
+                            int(std::min<uint64_t>(originY + y * step, INT32_MAX)));
+
+                        unsigned char* pixel = tile.mData + (size_t(y) * samples + x) * 4;
+                        pixel[0] = uint8_t(height >> 8);
+                        pixel[1] = uint8_t(height & 0xff);
+                        pixel[2] = 0;
+                        pixel[3] = 255;
+                    }
+                }
+
+                const std::string path = directory + "/" + std::to_string(id.depth) + "_" + std::to_string(id.x) + "_" + std::to_string(id.y) + ".png";
+                if (!tile.saveToFile(path))
+                {
+                    succeeded = false;
+                }
+            }
+        });
+
+        std::ofstream meta(directory + "/" + kMetaFile);
+        meta << tileSize << " " << depth << " " << heightmap.mWidth << " " << heightmap.mHeight << std::endl;
+        if (!meta)
+        {
+            std::cerr << "Cannot write the terrain description: " << directory << "/" << kMetaFile << std::endl;
+            return false;
+        }
+        return succeeded;
+    }
+
+    Terrain::~Terrain()
+    {
+        destroy();
+    }
+
+    bool Terrain::init(const TerrainSettings& settings, std::shared_ptr<OpenglProgram> program)
+    {
+        destroy();
+
+        std::ifstream meta(settings.tileDirectory + "/" + kMetaFile);
+        uint32_t width = 0;
+        uint32_t height = 0;
+        if (!(meta >> mTileSize >> mDepth >> width >> height))
+        {
+            std::cerr << "Cannot read the terrain description in " << settings.tileDirectory << std::endl;
+            return false;
+        }
+
+        if (!isPowerOfTwo(mTileSize) || mDepth == 0 || mDepth > kMaxLevels || settings.gridResolution < 2 ||
+            mTileSize % settings.gridResolution != 0 || settings.cacheSize < 2)
+        {
+            std::cerr << "Invalid terrain settings, the grid resolution has to divide the tile size " << mTileSize << std::endl;
+            return false;
+        }
+
+        mSettings = settings;
+        mProgram = program;
+        mRootSize = float(mTileSize << (mDepth - 1)) * mSettings.sampleSpacing;
+
+        // ranges are indexed by level, level 0 being the finest
+        float range = mSettings.lodDistance * float(mTileSize) * mSettings.sampleSpacing;
+        for (uint32_t level = 0; level < mDepth; ++level)
+        {
+            mRanges[level] = range;
+            range *= 2.0f;
+        }
+
+        auto grid = Mesh::createGrid(mSettings.gridResolution);
+        const GLsizei quadrantCount = GLsizei(grid->mIndices.size() / 4);
+        mRangeCounts[DRAW_WHOLE] = GLsizei(grid->mIndices.size());
+        mRangeOffsets[DRAW_WHOLE] = 0;
+        for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            mRangeCounts[DRAW_QUADRANT_0 + quadrant] = quadrantCount;
+            mRangeOffsets[DRAW_QUADRANT_0 + quadrant] = GLsizeiptr(quadrant) * quadrantCount * sizeof(uint32_t);
+        }
+
+        glCreateBuffers(1, &mGridBuffer);
+        glNamedBufferStorage(mGridBuffer, grid->mVertices.size() * sizeof(float), grid->mVertices.data(), 0);
+        glCreateBuffers(1, &mIndexBuffer);
+        glNamedBufferStorage(mIndexBuffer, grid->mIndices.size() * sizeof(uint32_t), grid->mIndices.data(), 0);
+        glCreateBuffers(1, &mInstanceBuffer);
+        glNamedBufferData(mInstanceBuffer, mSettings.maxNodes * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mGridBuffer, 0, 4 * sizeof(float));
+        glVertexArrayAttribFormat(mVao, 0, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(mVao, 0, 0);
+        glEnableVertexArrayAttrib(mVao, 0);
+
+        glVertexArrayVertexBuffer(mVao, 1, mInstanceBuffer, 0, sizeof(Instance));
+        glVertexArrayBindingDivisor(mVao, 1, 1);
+        glVertexArrayAttribFormat(mVao, 1, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, node));
+        glVertexArrayAttribBinding(mVao, 1, 1);
+        glEnableVertexArrayAttrib(mVao, 1);
+        glVertexArrayAttribFormat(mVao, 2, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, params));
+        glVertexArrayAttribBinding(mVao, 2, 1);
+        glEnableVertexArrayAttrib(mVao, 2);
+
+        glVertexArrayElementBuffer(mVao, mIndexBuffer);
+
+        const GLsizei samples = GLsizei(mTileSize + 1);
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &mHeightTexture);
+        glTextureStorage3D(mHeightTexture, 1, GL_R16, samples, samples, GLsizei(mSettings.cacheSize));
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &mNormalTexture);
+        glTextureStorage3D(mNormalTexture, 1, GL_RG8_SNORM, samples, samples, GLsizei(mSettings.cacheSize));
+        for (GLuint texture : { mHeightTexture, mNormalTexture })
+        {
+            glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+
+        mSlots.assign(mSettings.cacheSize, Slot());
+        mLoadQueue = std::make_shared<LoadQueue>();
+        mInitialized = true;
+
+        // the root tile is loaded up front and never evicted, it covers everything that isn't streamed in yet
+        requestTile(0, 0, 0);
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mLoadQueue->mutex);
+                if (!mLoadQueue->finished.empty())
+                {
+                    break;
+                }
+            }
+            std::this_thread::yield();
+        }
+        uploadTiles();
+
+        if (mResident.count(makeKey(0, 0, 0)) == 0)
+        {
+            std::cerr << "Cannot load the root terrain tile " << getTilePath(0, 0, 0) << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+
+    void Terrain::destroy()
+    {
+        if (!mInitialized)
+        {
+            return;
+        }
+
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(1, &mGridBuffer);
+        glDeleteBuffers(1, &mIndexBuffer);
+        glDeleteBuffers(1, &mInstanceBuffer);
+        glDeleteTextures(1, &mHeightTexture);
+        glDeleteTextures(1, &mNormalTexture);
+        mVao = mGridBuffer = mIndexBuffer = mInstanceBuffer = mHeightTexture = mNormalTexture = 0;
+
+        // jobs still in flight only hold on to the queue
+        mLoadQueue.reset();
+        mSlots.clear();
+        mResident.clear();
+        mBounds.clear();
+        mPending.clear();
+        mFailed.clear();
+        for (std::vector<Instance>& instances : mInstances)
+        {
+            instances.clear();
+        }
+        mProgram.reset();
+        mStats = TerrainStats();
+        mInitialized = false;
+    }
+
+    void Terrain::update(const glm::vec3& eye, const glm::mat4& viewProjection)
+    {
+        if (!mInitialized)
+        {
+            return;
+        }
+
+        ++mFrame;
+
+        const auto uploadStart = std::chrono::steady_clock::now();
+        uploadTiles();
+        mStats.uploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+
+        for (std::vector<Instance>& instances : mInstances)
+        {
+            instances.clear();
+        }
+        mStats.selectedNodes = 0;
+        mStats.droppedNodes = 0;
+
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        if (!selectNode(0, 0, 0, eye, frustum))
+        {
+            // the eye is beyond the coarsest range, the root still covers the whole terrain
+            addInstance(0, 0, 0, DRAW_WHOLE, requestTile(0, 0, 0));
+        }
+
+        mStats.drawnVertices = 0;
+        mUpload.clear();
+        for (uint32_t range = 0; range < DRAW_RANGE_COUNT; ++range)
+        {
+            mUpload.insert(mUpload.end(), mInstances[range].begin(), mInstances[range].end());
+            mStats.drawnVertices += uint64_t(mInstances[range].size()) * mRangeCounts[range];
+        }
+
+        if (!mUpload.empty())
+        {
+            glInvalidateBufferData(mInstanceBuffer);
+            glNamedBufferSubData(mInstanceBuffer, 0, mUpload.size() * sizeof(Instance), mUpload.data());
+        }
+
+        mStats.residentTiles = uint32_t(mResident.size());
+        mStats.pendingTiles = uint32_t(mPending.size());
+    }
+
+    void Terrain::render(const glm::mat4& viewProjection, const glm::vec3& eye)
+    {
+        if (!mInitialized || mUpload.empty())
+        {
+            return;
+        }
+
+        mProgram->use();
+        mProgram->setMat4("u_viewProjection", viewProjection);
+        mProgram->setVec3("u_eye", eye);
+        mProgram->setFloat("u_gridResolution", float(mSettings.gridResolution));
+        mProgram->setFloat("u_heightScale", mSettings.heightScale);
+        mProgram->setFloat("u_tileSamples", float(mTileSize + 1));
+        mProgram->setInt("u_heights", 0);
+        mProgram->setInt("u_normals", 1);
+
+        glBindTextureUnit(0, mHeightTexture);
+        glBindTextureUnit(1, mNormalTexture);
+        glBindVertexArray(mVao);
+
+        GLuint baseInstance = 0;
+        for (uint32_t range = 0; range < DRAW_RANGE_COUNT; ++range)
+        {
+            const GLsizei count = GLsizei(mInstances[range].size());
+            if (count != 0)
+            {
+                glDrawElementsInstancedBaseInstance(GL_TRIANGLES, mRangeCounts[range], GL_UNSIGNED_INT,
+                    reinterpret_cast<const void*>(mRangeOffsets[range]), count, baseInstance);
+            }
+            baseInstance += GLuint(count);
+        }
+
+        glBindVertexArray(0);
+    }
+
+    bool Terrain::selectNode(uint32_t depth, uint32_t x, uint32_t y, const glm::vec3& eye, const Frustum& frustum)
+    {
+        const uint32_t level = mDepth - 1 - depth;
+        const float size = mRootSize / float(1u << depth);
+        const TileBounds bounds = getBounds(depth, x, y);
+        const glm::vec3 min(float(x) * size, bounds.minHeight, float(y) * size);
+        const glm::vec3 max(min.x + size, bounds.maxHeight, min.z + size);
+
+        // nodes outside of their level's range are drawn by the parent
+        if (!intersectsSphere(min, max, eye, mRanges[level]))
+        {
+            return false;
+        }
+
+        // culled nodes count as handled, neither they nor their parent draw anything
+        if (!frustum.intersectsBox(min, max))
+        {
+            return true;
+        }
+
+        const uint32_t layer = requestTile(depth, x, y);
+        if (layer == kInvalidLayer)
+        {
+            return false;
+        }
+
+        if (level == 0 || !intersectsSphere(min, max, eye, mRanges[level - 1]))
+        {
+            addInstance(depth, x, y, DRAW_WHOLE, layer);
+            return true;
+        }
+
+        // refining replaces one instance by up to four
+        if (mStats.selectedNodes + 4 > mSettings.maxNodes)
+        {
+            ++mStats.droppedNodes;
+            addInstance(depth, x, y, DRAW_WHOLE, layer);
+            return true;
+        }
+
+        for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+        {
+            const uint32_t childX = x * 2 + (quadrant & 1);
+            const uint32_t childY = y * 2 + (quadrant >> 1);
+            if (!selectNode(depth + 1, childX, childY, eye, frustum))
+            {
+                addInstance(depth, x, y, DrawRange(DRAW_QUADRANT_0 + quadrant), layer);
+            }
+        }
+        return true;
+    }
+
+    void Terrain::addInstance(uint32_t depth, uint32_t x, uint32_t y, DrawRange range, uint32_t layer)
+    {
+        if (mStats.selectedNodes >= mSettings.maxNodes)
+        {
+            ++mStats.droppedNodes;
+            return;
+        }
+
+        const uint32_t level = mDepth - 1 - depth;
+        const float size = mRootSize / float(1u << depth);
+        const float morphEnd = mRanges[level];
+        const float previous = level > 0 ? mRanges[level - 1] : 0.0f;
+        const float morphStart = morphEnd - (morphEnd - previous) * mSettings.morphRatio;
+
+        Instance instance;
+        instance.node = glm::vec4(float(x) * size, float(y) * size, size, 0.0f);
+        instance.params = glm::vec4(float(layer), morphStart, morphEnd, 0.0f);
+        mInstances[range].push_back(instance);
+        ++mStats.selectedNodes;
+    }
+
+    Terrain::TileBounds Terrain::getBounds(uint32_t depth, uint32_t x, uint32_t y) const
+    {
+        // tiles that were never loaded are bounded by their closest loaded ancestor, the root is always known
+        for (;;)
+        {
+            auto it = mBounds.find(makeKey(depth, x, y));
+            if (it != mBounds.end() || depth == 0)
+            {
+                return it != mBounds.end() ? it->second : TileBounds{ 0.0f, mSettings.heightScale };
+            }
+            --depth;
+            x /= 2;
+            y /= 2;
+        }
+    }
+
+    uint32_t Terrain::requestTile(uint32_t depth, uint32_t x, uint32_t y)
+    {
+        const uint64_t key = makeKey(depth, x, y);
+
+        auto it = mResident.find(key);
+        if (it != mResident.end())
+        {
+            mSlots[it->second].lastUsedFrame = mFrame;
+            return it->second;
+        }
+
+        if (mPending.count(key) != 0 || mFailed.count(key) != 0 || mPending.size() >= mSettings.maxPendingLoads)
+        {
+            return kInvalidLayer;
+        }
+        mPending.insert(key);
+
+        std::shared_ptr<LoadQueue> queue = mLoadQueue;
+        const std::string path = getTilePath(depth, x, y);
+        const uint32_t samples = mTileSize + 1;
+        const float heightScale = mSettings.heightScale;
+        const float spacing = getSampleSpacing(depth);
+
+        ThreadPool::global().enqueue([queue, path, key, samples, heightScale, spacing]()
+        {
+            auto tile = std::make_unique<LoadedTile>();
+            tile->key = key;
+
+            Image image;
+            if (image.loadFromFile(path) && uint32_t(image.mWidth) == samples && uint32_t(image.mHeight) == samples)
+            {
+                const size_t count = size_t(samples) * samples;
+                tile->heights.resize(count);
+                tile->normals.resize(count * 2);
+
+                uint16_t minHeight = 0xffff;
+                uint16_t maxHeight = 0;
+                for (size_t i = 0; i < count; ++i)
+                {
+                    const uint16_t height = uint16_t((image.mData[i * 4] << 8) | image.mData[i * 4 + 1]);
+                    tile->heights[i] = height;
+                    minHeight = std::min(minHeight, height);
+                    maxHeight = std::max(maxHeight, height);
+                }
+
+                // central differences, one sided on the tile border
+                const float scale = heightScale / 65535.0f;
+                for (uint32_t y = 0; y < samples; ++y)
+                {
+                    for (uint32_t x = 0; x < samples; ++x)
+                    {
+                        const uint32_t x0 = x > 0 ? x - 1 : x;
+                        const uint32_t x1 = x + 1 < samples ? x + 1 : x;
+                        const uint32_t y0 = y > 0 ? y - 1 : y;
+                        const uint32_t y1 = y + 1 < samples ? y + 1 : y;
+
+                        const float dx = (float(tile->heights[y * samples + x1]) - float(tile->heights[y * samples + x0])) * scale / (float(x1 - x0) * spacing);
+                        const float dz = (float(tile->heights[y1 * samples + x]) - float(tile->heights[y0 * samples + x]) ) * scale / (float(y1 - y0) * spacing);
+                        const glm::vec3 normal = glm::normalize(glm::vec3(-dx, 1.0f, -dz));
+
+                        tile->normals[(y * samples + x) * 2 + 0] = int8_t(std::lround(normal.x * 127.0f));
+                        tile->normals[(y * samples + x) * 2 + 1] = int8_t(std::lround(normal.z * 127.0f));
+                    }
+                }
+
+                tile->bounds = { float(minHeight) * scale, float(maxHeight) * scale };
+                tile->valid = true;
+            }
+
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->finished.push_back(std::move(tile));
+        });
+
+        return kInvalidLayer;
+    }
+
+    std::string Terrain::getTilePath(uint32_t depth, uint32_t x, uint32_t y) const
+    {
+        return mSettings.tileDirectory + "/" + std::to_string(depth) + "_" + std::to_string(x) + "_" + std::to_string(y) + ".png";
+    }
+
+    float Terrain::getSampleSpacing(uint32_t depth) const
+    {
+        return mSettings.sampleSpacing * float(1u << (mDepth - 1 - depth));
+    }
+
+    void Terrain::uploadTiles()
+    {
+        for (uint32_t uploads = 0; uploads < mSettings.maxUploadsPerFrame; ++uploads)
+        {
+            std::unique_ptr<LoadedTile> tile;
+            {
+                std::lock_guard<std::mutex> lock(mLoadQueue->mutex);
+                if (mLoadQueue->finished.empty())
+                {
+                    return;
+                }
+                tile = std::move(mLoadQueue->finished.back());
+                mLoadQueue->finished.pop_back();
+            }
+
+            if (!tile->valid)
+            {
+                mPending.erase(tile->key);
+                mFailed.insert(tile->key);
+                ++mStats.failedTiles;
+                continue;
+            }
+
+            const uint32_t layer = findSlot();
+            if (layer == kInvalidLayer)
+            {
+                // every layer is still in use, the tile waits for the next frame
+                std::lock_guard<std::mutex> lock(mLoadQueue->mutex);
+                mLoadQueue->finished.push_back(std::move(tile));
+                return;
+            }
+
+            uploadTile(*tile, layer);
+        }
+    }
+
+    uint32_t Terrain::findSlot()
+    {
+        const uint64_t root = makeKey(0, 0, 0);
+        uint32_t best = kInvalidLayer;
+        for (uint32_t i = 0; i < uint32_t(mSlots.size()); ++i)
+        {
+            const Slot& slot = mSlots[i];
+            if (slot.key == kFreeSlot)
+            {
+                return i;
+            }
+
+            // tiles drawn in the previous frame stay, replacing them would pop
+            if (slot.key == root || slot.lastUsedFrame + 1 >= mFrame)
+            {
+                continue;
+            }
+
+            if (best == kInvalidLayer || slot.lastUsedFrame < mSlots[best].lastUsedFrame)
+            {
+                best = i;
+            }
+        }
+        return best;
+    }
+
+    void Terrain::uploadTile(LoadedTile& tile, uint32_t layer)
+    {
+        Slot& slot = mSlots[layer];
+        if (slot.key != kFreeSlot)
+        {
+            mResident.erase(slot.key);
+            ++mStats.evictedTiles;
+        }
+
+        const GLsizei samples = GLsizei(mTileSize + 1);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTextureSubImage3D(mHeightTexture, 0, 0, 0, GLint(layer), samples, samples, 1, GL_RED, GL_UNSIGNED_SHORT, tile.heights.data());
+        glTextureSubImage3D(mNormalTexture, 0, 0, 0, GLint(layer), samples, samples, 1, GL_RG, GL_BYTE, tile.normals.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        slot.key = tile.key;
+        slot.lastUsedFrame = mFrame;
+        mResident[tile.key] = layer;
+        mBounds[tile.key] = tile.bounds;
+        mPending.erase(tile.key);
+        ++mStats.loadedTiles;
+    }
+}
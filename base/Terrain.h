@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    struct Frustum;
+
+    struct TerrainSettings
+    {
+        // directory written by Terrain::bakeTiles
+        std::string tileDirectory;
+
+        // world units between two samples of the full resolution heightmap, and the height of the largest sample
+        float sampleSpacing = 1.0f;
+        float heightScale = 256.0f;
+
+        // quads per side of the shared grid mesh, must divide the baked tile size
+        uint32_t gridResolution = 32;
+
+        // the finest level is used up to lodDistance times its node size from the eye, every coarser level doubles it
+        float lodDistance = 2.0f;
+
+        // fraction of a level's range over which its vertices morph into the next coarser level
+        float morphRatio = 0.3f;
+
+        // resident tiles on the GPU, least recently used ones are replaced
+        uint32_t cacheSize = 128;
+        uint32_t maxPendingLoads = 16;
+        uint32_t maxUploadsPerFrame = 4;
+
+        // upper bound for drawn nodes, caps the vertex count independently of the terrain size
+        uint32_t maxNodes = 512;
+    };
+
+    struct TerrainStats
+    {
+        uint32_t selectedNodes = 0;
+        uint32_t droppedNodes = 0;
+        uint64_t drawnVertices = 0;
+
+        uint32_t residentTiles = 0;
+        uint32_t pendingTiles = 0;
+        uint64_t loadedTiles = 0;
+        uint64_t evictedTiles = 0;
+        uint64_t failedTiles = 0;
+
+        // milliseconds spent uploading streamed tiles in the last update
+        double uploadTime = 0.0;
+    };
+
+    // Heightmap terrain rendered with continuous distance-based LOD (CDLOD). Every quadtree node maps to one
+    // baked tile of the heightmap pyramid and is drawn as an instance of a single grid mesh, vertices morph
+    // into the coarser level in the vertex shader. Tiles are decoded on worker threads and kept in an LRU cache
+    // of texture array layers, nodes whose tile isn't resident yet are drawn by their parent.
+    class Terrain
+    {
+    public:
+        // heights are 16 bit with the high byte in red and the low byte in green, 8 bit grayscale images work as-is
+        static bool bakeTiles(const Image& heightmap, const std::string& directory, uint32_t tileSize = 256);
+
+        Terrain() = default;
+        ~Terrain();
+
+        Terrain(const Terrain&) = delete;
+        Terrain& operator=(const Terrain&) = delete;
+
+        bool init(const TerrainSettings& settings, std::shared_ptr<OpenglProgram> program);
+        void destroy();
+
+        // selects the nodes to draw, requests missing tiles and uploads finished ones
+        void update(const glm::vec3& eye, const glm::mat4& viewProjection);
+        void render(const glm::mat4& viewProjection, const glm::vec3& eye);
+
+        // extent of the terrain in world units, it starts at the origin and extends along +x and +z
+        float getSize() const { return mRootSize; }
+        float getHeightScale() const { return mSettings.heightScale; }
+
+        const TerrainStats& getStats() const { return mStats; }
+
+    private:
+        static constexpr uint32_t kMaxLevels = 16;
+        static constexpr uint32_t kInvalidLayer = ~0u;
+        static constexpr uint64_t kFreeSlot = ~0ull;
+
+        // the shared grid's indices are stored quadrant by quadrant, a whole node draws all of them
+        enum DrawRange : uint32_t
+        {
+            DRAW_WHOLE,
+            DRAW_QUADRANT_0,
+            DRAW_RANGE_COUNT = DRAW_QUADRANT_0 + 4,
+        };
+
+        struct Instance
+        {
+            glm::vec4 node;     // x, z, size
+            glm::vec4 params;   // texture layer, morph start, morph end
+        };
+
+        struct TileBounds
+        {
+            float minHeight;
+            float maxHeight;
+        };
+
+        struct LoadedTile
+        {
+            uint64_t key = 0;
+            bool valid = false;
+            TileBounds bounds = { 0.0f, 0.0f };
+            std::vector<uint16_t> heights;
+            std::vector<int8_t> normals;
+        };
+
+        // shared with the loader jobs, so they can finish after the terrain was destroyed
+        struct LoadQueue
+        {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<LoadedTile>> finished;
+        };
+
+        struct Slot
+        {
+            uint64_t key = kFreeSlot;
+            uint64_t lastUsedFrame = 0;
+        };
+
+        static uint64_t makeKey(uint32_t depth, uint32_t x, uint32_t y) { return (uint64_t(depth) << 48) | (uint64_t(x) << 24) | y; }
+
+        bool selectNode(uint32_t depth, uint32_t x, uint32_t y, const glm::vec3& eye, const Frustum& frustum);
+        void addInstance(uint32_t depth, uint32_t x, uint32_t y, DrawRange range, uint32_t layer);
+
+        TileBounds getBounds(uint32_t depth, uint32_t x, uint32_t y) const;
+
+        // layer of a resident tile, otherwise the tile is queued for loading and kInvalidLayer returned
+        uint32_t requestTile(uint32_t depth, uint32_t x, uint32_t y);
+        std::string getTilePath(uint32_t depth, uint32_t x, uint32_t y) const;
+        float getSampleSpacing(uint32_t depth) const;
+        void uploadTiles();
+        uint32_t findSlot();
+        void uploadTile(LoadedTile& tile, uint32_t layer);
+
+        TerrainSettings mSettings;
+        std::shared_ptr<OpenglProgram> mProgram;
+        bool mInitialized = false;
+
+        // baked layout
+        uint32_t mTileSize = 0;
+        uint32_t mDepth = 0;
+        float mRootSize = 0.0f;
+        float mRanges[kMaxLevels] = {};
+
+        GLuint mVao = 0;
+        GLuint mGridBuffer = 0;
+        GLuint mIndexBuffer = 0;
+        GLuint mInstanceBuffer = 0;
+        GLsizei mRangeCounts[DRAW_RANGE_COUNT] = {};
+        GLsizeiptr mRangeOffsets[DRAW_RANGE_COUNT] = {};
+        GLuint mHeightTexture = 0;
+        GLuint mNormalTexture = 0;
+
+        std::vector<Slot> mSlots;
+        std::unordered_map<uint64_t, uint32_t> mResident;
+        std::unordered_map<uint64_t, TileBounds> mBounds;
+        std::unordered_set<uint64_t> mPending;
+        std::unordered_set<uint64_t> mFailed;
+        std::shared_ptr<LoadQueue> mLoadQueue;
+
+        std::vector<Instance> mInstances[DRAW_RANGE_COUNT];
+        std::vector<Instance> mUpload;
+        uint64_t mFrame = 0;
+
+        TerrainStats mStats;
+    };
+}
@@ -0,0 +1,199 @@
+#include "TextRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+namespace utils
+{
+    namespace
+    {
+        // returns the next codepoint and advances text, malformed sequences decode to U+FFFD
+        uint32_t decodeUtf8(const char*& text)
+        {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+            const unsigned char lead = bytes[0];
+
+            uint32_t length = 1;
+            uint32_t codepoint = lead;
+            if (lead >= 0xf0)
+            {
+                length = 4;
+                codepoint = lead & 0x07;
+            }
+            else if (lead >= 0xe0)
+            {
+                length = 3;
+                codepoint = lead & 0x0f;
+            }
+            else if (lead >= 0xc0)
+            {
+                length = 2;
+                codepoint = lead & 0x1f;
+            }
+            else if (lead >= 0x80)
+            {
+                ++text;
+                return 0xfffd;
+            }
+
+            for (uint32_t i = 1; i < length; ++i)
+            {
+                if ((bytes[i] & 0xc0) != 0x80)
+                {
+                    text += i;
+                    return 0xfffd;
+                }
+                codepoint = (codepoint << 6) | (bytes[i] & 0x3f);
+            }
+
+            text += length;
+            return codepoint;
+        }
+
+        uint32_t packColor(const glm::vec4& color)
+        {
+            const glm::uvec4 bytes = glm::uvec4(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+            return bytes.x | (bytes.y << 8) | (bytes.z << 16) | (bytes.w << 24);
+        }
+    }
+
+    TextRenderer::~TextRenderer()
+    {
+        destroy();
+    }
+
+    bool TextRenderer::init(std::shared_ptr<OpenglProgram> program, uint32_t maxGlyphs)
+    {
+        destroy();
+
+        if (program == nullptr || maxGlyphs == 0)
+        {
+            std::cerr << "Text renderer needs a program and room for at least one glyph" << std::endl;
+            return false;
+        }
+
+        mProgram = program;
+        mCapacity = maxGlyphs;
+        mInstances.reserve(std::min(maxGlyphs, 4096u));
+
+        glCreateBuffers(1, &mBuffer);
+        glNamedBufferData(mBuffer, GLsizeiptr(mCapacity) * sizeof(Instance), nullptr, GL_STREAM_DRAW);
+
+        // quad corners come from gl_VertexID, every attribute is per instance
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mBuffer, 0, sizeof(Instance));
+        glVertexArrayBindingDivisor(mVao, 0, 1);
+
+        glVertexArrayAttribFormat(mVao, 0, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, rect));
+        glVertexArrayAttribFormat(mVao, 1, 4, GL_FLOAT, GL_FALSE, offsetof(Instance, texels));
+        glVertexArrayAttribFormat(mVao, 2, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(Instance, color));
+        glVertexArrayAttribFormat(mVao, 3, 1, GL_FLOAT, GL_FALSE, offsetof(Instance, pixelRange));
+        for (GLuint attribute = 0; attribute < 4; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, 0);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+        return true;
+    }
+
+    void TextRenderer::destroy()
+    {
+        if (mVao != 0)
+        {
+            glDeleteVertexArrays(1, &mVao);
+            glDeleteBuffers(1, &mBuffer);
+            mVao = 0;
+            mBuffer = 0;
+        }
+        mProgram.reset();
+        mInstances.clear();
+        mCapacity = 0;
+    }
+
+    void TextRenderer::begin()
+    {
+        mInstances.clear();
+        mStats = TextStats();
+    }
+
+    glm::vec2 TextRenderer::addText(GlyphAtlas& atlas, uint32_t font, const char* text, const glm::vec2& position, float size, const glm::vec4& color)
+    {
+        const uint32_t packedColor = packColor(color);
+        const float pixelRange = atlas.getDistanceRange() * size;
+
+        glm::vec2 pen = position;
+        uint32_t previous = 0;
+        while (*text != '\0')
+        {
+            const uint32_t codepoint = decodeUtf8(text);
+            if (codepoint == '\n')
+            {
+                pen.x = position.x;
+                pen.y += atlas.getLineHeight(font) * size;
+                previous = 0;
+                continue;
+            }
+
+            const Glyph* glyph = atlas.getGlyph(font, codepoint, size);
+            if (glyph == nullptr)
+            {
+                glyph = atlas.getGlyph(font, '?', size);
+                if (glyph == nullptr)
+                {
+                    continue;
+                }
+            }
+
+            if (previous != 0)
+            {
+                pen.x += atlas.getKerning(font, previous, codepoint) * size;
+            }
+            previous = codepoint;
+
+            if (glyph->resident && mInstances.size() < mCapacity)
+            {
+                Instance instance;
+                instance.rect = glm::vec4(pen.x, pen.y, pen.x, pen.y) + glyph->plane * size;
+                instance.texels = glyph->texels;
+                instance.color = packedColor;
+                instance.pixelRange = pixelRange / glyph->texelScale;
+                mInstances.push_back(instance);
+            }
+            else if (!glyph->empty)
+            {
+                ++mStats.missingGlyphs;
+            }
+
+            pen.x += glyph->advance * size;
+        }
+        return pen;
+    }
+
+    void TextRenderer::render(const GlyphAtlas& atlas, const glm::mat4& projection)
+    {
+        mStats.glyphs = uint32_t(mInstances.size());
+        if (mInstances.empty() || mVao == 0)
+        {
+            return;
+        }
+
+        glInvalidateBufferData(mBuffer);
+        glNamedBufferSubData(mBuffer, 0, GLsizeiptr(mInstances.size() * sizeof(Instance)), mInstances.data());
+
+        mProgram->use();
+        mProgram->setMat4("u_projection", projection);
+        mProgram->setInt("u_atlas", 0);
+        atlas.bind(0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glBindVertexArray(mVao);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, GLsizei(mInstances.size()));
+        glBindVertexArray(0);
+
+        glDisable(GL_BLEND);
+        ++mStats.drawCalls;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GlyphAtlas.h"
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    struct TextStats
+    {
+        uint32_t glyphs = 0;
+        uint32_t drawCalls = 0;
+
+        // glyphs skipped because they are still being rasterized
+        uint32_t missingGlyphs = 0;
+    };
+
+    // Batches text from any number of calls into one instanced draw, every glyph is a quad instance sampling the
+    // shared GlyphAtlas. Positions are in pixels with y pointing down, the pen starts on the baseline.
+    class TextRenderer
+    {
+    public:
+        TextRenderer() = default;
+        ~TextRenderer();
+
+        TextRenderer(const TextRenderer&) = delete;
+        TextRenderer& operator=(const TextRenderer&) = delete;
+
+        bool init(std::shared_ptr<OpenglProgram> program, uint32_t maxGlyphs = 1u << 18);
+        void destroy();
+
+        // drops the text of the previous frame
+        void begin();
+
+        // lays out UTF-8 text, newlines move down by the font's line height, returns the pen position at the end
+        glm::vec2 addText(GlyphAtlas& atlas, uint32_t font, const char* text, const glm::vec2& position, float size,
+            const glm::vec4& color = glm::vec4(1.0f));
+
+        void render(const GlyphAtlas& atlas, const glm::mat4& projection);
+
+        const TextStats& getStats() const { return mStats; }
+
+    private:
+        struct Instance
+        {
+            glm::vec4 rect;
+            glm::vec4 texels;
+            uint32_t color;
+            float pixelRange;
+        };
+
+        std::shared_ptr<OpenglProgram> mProgram;
+        GLuint mVao = 0;
+        GLuint mBuffer = 0;
+        uint32_t mCapacity = 0;
+
+        std::vector<Instance> mInstances;
+        TextStats mStats;
+    };
+}
@@ -0,0 +1,465 @@
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "Memory.h"
+
+namespace utils
+{
+    namespace
+    {
+        typedef GLuint64 (APIENTRYP GetTextureHandleProc)(GLuint texture);
+        typedef void (APIENTRYP MakeTextureHandleResidentProc)(GLuint64 handle);
+        typedef void (APIENTRYP MakeTextureHandleNonResidentProc)(GLuint64 handle);
+
+        GetTextureHandleProc gGetTextureHandle = nullptr;
+        MakeTextureHandleResidentProc gMakeTextureHandleResident = nullptr;
+        MakeTextureHandleNonResidentProc gMakeTextureHandleNonResident = nullptr;
+
+        bool hasExtension(const char* name)
+        {
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; ++i)
+            {
+                const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+                if (extension != nullptr && std::strcmp(extension, name) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t alignUp(uint32_t value, uint32_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    void SkylinePacker::init(uint32_t width, uint32_t height)
+    {
+        mWidth = width;
+        mHeight = height;
+        mUsedArea = 0;
+        mSkyline.assign(1, { 0, 0, width });
+    }
+
+    bool SkylinePacker::fits(size_t index, uint32_t width, uint32_t height, uint32_t& y) const
+    {
+        const uint32_t x = mSkyline[index].x;
+        if (x + width > mWidth)
+        {
+            return false;
+        }
+
+        // the rectangle rests on the highest segment it spans
+        y = 0;
+        uint32_t remaining = width;
+        for (size_t i = index; remaining > 0; ++i)
+        {
+            y = std::max(y, mSkyline[i].y);
+            if (y + height > mHeight)
+            {
+                return false;
+            }
+            remaining -= std::min(remaining, mSkyline[i].width);
+        }
+        return true;
+    }
+
+    bool SkylinePacker::pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y)
+    {
+        size_t best = mSkyline.size();
+        uint32_t bestTop = ~0u;
+        uint32_t bestWidth = ~0u;
+        uint32_t bestY = 0;
+
+        for (size_t i = 0; i < mSkyline.size(); ++i)
+        {
+            uint32_t top;
+            if (fits(i, width, height, top))
+            {
+                // lowest top edge first, the narrower segment wastes less on ties
+                if (top + height < bestTop || (top + height == bestTop && mSkyline[i].width < bestWidth))
+                {
+                    best = i;
+                    bestTop = top + height;
+                    bestWidth = mSkyline[i].width;
+                    bestY = top;
+                }
+            }
+        }
+
+        if (best == mSkyline.size())
+        {
+            return false;
+        }
+
+        x = mSkyline[best].x;
+        y = bestY;
+        mSkyline.insert(mSkyline.begin() + best, { x, y + height, width });
+
+        // trim or remove the segments now covered by the new one
+        for (size_t i = best + 1; i < mSkyline.size();)
+        {
+            const Segment& previous = mSkyline[i - 1];
+            Segment& segment = mSkyline[i];
+            if (segment.x >= previous.x + previous.width)
+            {
+                break;
+            }
+
+            const uint32_t shrink = previous.x + previous.width - segment.x;
+            if (shrink < segment.width)
+            {
+                segment.x += shrink;
+                segment.width -= shrink;
+                break;
+            }
+            mSkyline.erase(mSkyline.begin() + i);
+        }
+
+        for (size_t i = 0; i + 1 < mSkyline.size();)
+        {
+            if (mSkyline[i].y == mSkyline[i + 1].y)
+            {
+                mSkyline[i].width += mSkyline[i + 1].width;
+                mSkyline.erase(mSkyline.begin() + i + 1);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        mUsedArea += uint64_t(width) * height;
+        return true;
+    }
+
+    float SkylinePacker::getOccupancy() const
+    {
+        return mWidth == 0 ? 0.0f : float(double(mUsedArea) / (double(mWidth) * mHeight));
+    }
+
+    TextureAtlas::~TextureAtlas()
+    {
+        destroy();
+    }
+
+    bool TextureAtlas::init(const TextureAtlasSettings& settings)
+    {
+        destroy();
+
+        if (settings.pageSize == 0 || settings.maxLayers == 0 || settings.mipLevels == 0)
+        {
+            std::cerr << "Invalid texture atlas settings" << std::endl;
+            return false;
+        }
+
+        mSettings = settings;
+
+        // at least one texel per page on the smallest level
+        uint32_t levels = 1;
+        while ((mSettings.pageSize >> levels) > 0 && levels < mSettings.mipLevels)
+        {
+            ++levels;
+        }
+        mSettings.mipLevels = levels;
+        return true;
+    }
+
+    void TextureAtlas::destroy()
+    {
+        if (mId != 0)
+        {
+            glDeleteTextures(1, &mId);
+            mId = 0;
+        }
+        mCapacity = 0;
+        mTextureCount = 0;
+        mPages.clear();
+    }
+
+    bool TextureAtlas::add(const Image& image, TextureRegion& region)
+    {
+        if (image.mData == nullptr || image.mWidth <= 0 || image.mHeight <= 0)
+        {
+            return false;
+        }
+
+        const uint32_t width = uint32_t(image.mWidth);
+        const uint32_t height = uint32_t(image.mHeight);
+        const uint32_t pageSize = mSettings.pageSize;
+        const float scale = 1.0f / float(pageSize);
+
+        // a page sized image gets a layer of its own, clamping at the layer border replaces the gutter
+        if (width == pageSize && height == pageSize)
+        {
+            if (!addLayer())
+            {
+                return false;
+            }
+
+            const uint32_t layer = uint32_t(mPages.size()) - 1;
+            mPages[layer].full = true;
+            upload(image, layer, 0, 0, 0);
+
+            region.layer = layer;
+            region.uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            ++mTextureCount;
+            return true;
+        }
+
+        // sizes and positions stay multiples of the coarsest texel, so no level mixes two textures in one texel
+        const uint32_t gutter = getGutter();
+        const uint32_t alignment = 1u << (mSettings.mipLevels - 1);
+        const uint32_t blockWidth = alignUp(width + gutter * 2, alignment);
+        const uint32_t blockHeight = alignUp(height + gutter * 2, alignment);
+        if (blockWidth > pageSize || blockHeight > pageSize)
+        {
+            std::cerr << "Texture of " << width << "x" << height << " doesn't fit into an atlas page of " << pageSize << std::endl;
+            return false;
+        }
+
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t layer = 0;
+        for (; layer < uint32_t(mPages.size()); ++layer)
+        {
+            if (!mPages[layer].full && mPages[layer].packer.pack(blockWidth, blockHeight, x, y))
+            {
+                break;
+            }
+        }
+
+        if (layer == uint32_t(mPages.size()))
+        {
+            if (!addLayer())
+            {
+                return false;
+            }
+            mPages.back().packer.pack(blockWidth, blockHeight, x, y);
+        }
+
+        upload(image, layer, x, y, gutter);
+
+        region.layer = layer;
+        region.uvRect = glm::vec4(float(x + gutter) * scale, float(y + gutter) * scale, float(width) * scale, float(height) * scale);
+        ++mTextureCount;
+        return true;
+    }
+
+    bool TextureAtlas::addLayer()
+    {
+        const uint32_t layers = uint32_t(mPages.size());
+        if (layers == mSettings.maxLayers)
+        {
+            std::cerr << "Texture atlas is full, all " << mSettings.maxLayers << " layers are used" << std::endl;
+            return false;
+        }
+
+        if (layers == mCapacity)
+        {
+            // grow by doubling and copy the layers that are already filled
+            const uint32_t capacity = std::min(std::max(mCapacity * 2, 4u), mSettings.maxLayers);
+            const GLsizei size = GLsizei(mSettings.pageSize);
+
+            GLuint texture;
+            glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture);
+            glTextureStorage3D(texture, GLsizei(mSettings.mipLevels), mSettings.internalFormat, size, size, GLsizei(capacity));
+            glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, mSettings.mipLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTextureParameteri(texture, GL_TEXTURE_MAX_LEVEL, GLint(mSettings.mipLevels - 1));
+
+            if (mId != 0)
+            {
+                for (uint32_t level = 0; level < mSettings.mipLevels; ++level)
+                {
+                    const GLsizei levelSize = std::max(size >> level, 1);
+                    glCopyImageSubData(mId, GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0,
+                        texture, GL_TEXTURE_2D_ARRAY, GLint(level), 0, 0, 0, levelSize, levelSize, GLsizei(layers));
+                }
+                glDeleteTextures(1, &mId);
+            }
+
+            mId = texture;
+            mCapacity = capacity;
+        }
+
+        mPages.emplace_back();
+        mPages.back().packer.init(mSettings.pageSize, mSettings.pageSize);
+        return true;
+    }
+
+    void TextureAtlas::upload(const Image& image, uint32_t layer, uint32_t x, uint32_t y, uint32_t gutter)
+    {
+        const uint32_t width = uint32_t(image.mWidth);
+        const uint32_t height = uint32_t(image.mHeight);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        if (gutter == 0)
+        {
+            glTextureSubImage3D(mId, 0, GLint(x), GLint(y), GLint(layer), GLsizei(width), GLsizei(height), 1, GL_RGBA, GL_UNSIGNED_BYTE, image.mData);
+            return;
+        }
+
+        // replicate the border texels into the gutter, filtering at the edge then reads the texture's own colors
+        const uint32_t paddedWidth = width + gutter * 2;
+        const uint32_t paddedHeight = height + gutter * 2;
+
+        ScratchScope scratch;
+        uint32_t* padded = scratch.makeArray<uint32_t>(size_t(paddedWidth) * paddedHeight);
+        const uint32_t* source = reinterpret_cast<const uint32_t*>(image.mData);
+
+        for (uint32_t row = 0; row < paddedHeight; ++row)
+        {
+            const uint32_t sourceRow = std::min(std::max(row, gutter) - gutter, height - 1);
+            const uint32_t* sourceLine = source + size_t(sourceRow) * width;
+            uint32_t* line = padded + size_t(row) * paddedWidth;
+
+            std::fill(line, line + gutter, sourceLine[0]);
+            std::memcpy(line + gutter, sourceLine, width * sizeof(uint32_t));
+            std::fill(line + gutter + width, line + paddedWidth, sourceLine[width - 1]);
+        }
+
+        glTextureSubImage3D(mId, 0, GLint(x), GLint(y), GLint(layer), GLsizei(paddedWidth), GLsizei(paddedHeight), 1, GL_RGBA, GL_UNSIGNED_BYTE, padded);
+    }
+
+    void TextureAtlas::generateMipmaps()
+    {
+        if (mId != 0 && mSettings.mipLevels > 1)
+        {
+            glGenerateTextureMipmap(mId);
+        }
+    }
+
+    float TextureAtlas::getOccupancy() const
+    {
+        if (mPages.empty())
+        {
+            return 0.0f;
+        }
+
+        float occupancy = 0.0f;
+        for (const Page& page : mPages)
+        {
+            occupancy += page.full ? 1.0f : page.packer.getOccupancy();
+        }
+        return occupancy / float(mPages.size());
+    }
+
+    bool TexturePacker::add(const Image& image, GLenum internalFormat, TextureRegion& region)
+    {
+        uint32_t index = 0;
+        while (index < uint32_t(mAtlases.size()) && mAtlases[index]->getInternalFormat() != internalFormat)
+        {
+            ++index;
+        }
+
+        if (index == uint32_t(mAtlases.size()))
+        {
+            TextureAtlasSettings settings = mSettings;
+            settings.internalFormat = internalFormat;
+
+            auto atlas = std::make_unique<TextureAtlas>();
+            if (!atlas->init(settings))
+            {
+                return false;
+            }
+            mAtlases.push_back(std::move(atlas));
+        }
+
+        region.atlas = index;
+        return mAtlases[index]->add(image, region);
+    }
+
+    void TexturePacker::generateMipmaps()
+    {
+        for (auto& atlas : mAtlases)
+        {
+            atlas->generateMipmaps();
+        }
+    }
+
+    bool BindlessTextureTable::load(GLADloadproc loader)
+    {
+        if (!hasExtension("GL_ARB_bindless_texture"))
+        {
+            return false;
+        }
+
+        gGetTextureHandle = reinterpret_cast<GetTextureHandleProc>(loader("glGetTextureHandleARB"));
+        gMakeTextureHandleResident = reinterpret_cast<MakeTextureHandleResidentProc>(loader("glMakeTextureHandleResidentARB"));
+        gMakeTextureHandleNonResident = reinterpret_cast<MakeTextureHandleNonResidentProc>(loader("glMakeTextureHandleNonResidentARB"));
+        return isSupported();
+    }
+
+    bool BindlessTextureTable::isSupported()
+    {
+        return gGetTextureHandle != nullptr && gMakeTextureHandleResident != nullptr && gMakeTextureHandleNonResident != nullptr;
+    }
+
+    BindlessTextureTable::~BindlessTextureTable()
+    {
+        destroy();
+    }
+
+    bool BindlessTextureTable::init(uint32_t capacity)
+    {
+        destroy();
+
+        if (!isSupported())
+        {
+            std::cerr << "ARB_bindless_texture isn't available, call BindlessTextureTable::load first" << std::endl;
+            return false;
+        }
+
+        glCreateBuffers(1, &mBuffer);
+        glNamedBufferStorage(mBuffer, GLsizeiptr(capacity) * sizeof(uint64_t), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        mCapacity = capacity;
+        mHandles.reserve(capacity);
+        return true;
+    }
+
+    void BindlessTextureTable::destroy()
+    {
+        if (isSupported())
+        {
+            for (uint64_t handle : mHandles)
+            {
+                gMakeTextureHandleNonResident(handle);
+            }
+        }
+        mHandles.clear();
+
+        if (mBuffer != 0)
+        {
+            glDeleteBuffers(1, &mBuffer);
+            mBuffer = 0;
+        }
+        mCapacity = 0;
+    }
+
+    uint32_t BindlessTextureTable::add(GLuint texture)
+    {
+        if (mHandles.size() == mCapacity)
+        {
+            std::cerr << "Bindless texture table is full (" << mCapacity << " handles)" << std::endl;
+            return ~0u;
+        }
+
+        // the texture's sampling state is frozen into the handle
+        const uint64_t handle = gGetTextureHandle(texture);
+        gMakeTextureHandleResident(handle);
+
+        const uint32_t index = uint32_t(mHandles.size());
+        mHandles.push_back(handle);
+        glNamedBufferSubData(mBuffer, GLintptr(index) * sizeof(uint64_t), sizeof(uint64_t), &handle);
+        return index;
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "OpenGLUtils.h"
+
+namespace utils
+{
+    // skyline bottom-left rectangle packer, positions are in texels of a width x height page
+    class SkylinePacker
+    {
+    public:
+        void init(uint32_t width, uint32_t height);
+
+        bool pack(uint32_t width, uint32_t height, uint32_t& x, uint32_t& y);
+
+        // fraction of the page covered by packed rectangles
+        float getOccupancy() const;
+
+    private:
+        struct Segment
+        {
+            uint32_t x;
+            uint32_t y;
+            uint32_t width;
+        };
+
+        // lowest y a width wide rectangle can be placed at when starting on segment index, false if it doesn't fit
+        bool fits(size_t index, uint32_t width, uint32_t height, uint32_t& y) const;
+
+        std::vector<Segment> mSkyline;
+        uint32_t mWidth = 0;
+        uint32_t mHeight = 0;
+        uint64_t mUsedArea = 0;
+    };
+
+    // where a packed texture ended up, sample with texture(array, vec3(uvRect.xy + uv * uvRect.zw, layer))
+    struct TextureRegion
+    {
+        uint32_t atlas = 0;
+        uint32_t layer = 0;
+        glm::vec4 uvRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+    };
+
+    struct TextureAtlasSettings
+    {
+        GLenum internalFormat = GL_RGBA8;
+
+        // every layer of the array is a pageSize x pageSize atlas page
+        uint32_t pageSize = 2048;
+        uint32_t maxLayers = 256;
+
+        // mip levels are limited so that every level keeps padding texels of gutter around each texture
+        uint32_t mipLevels = 4;
+        uint32_t padding = 1;
+    };
+
+    // packs same-format images into the layers of one GL_TEXTURE_2D_ARRAY, so draws using any of them share a
+    // single binding. Images of exactly the page size take a whole layer, smaller ones are packed into pages
+    // with edge-replicated gutters. The array grows on demand, call generateMipmaps once all images are added.
+    class TextureAtlas
+    {
+    public:
+        TextureAtlas() = default;
+        ~TextureAtlas();
+
+        TextureAtlas(const TextureAtlas&) = delete;
+        TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+        bool init(const TextureAtlasSettings& settings);
+        void destroy();
+
+        // uploads an RGBA8 image, fails when it is larger than a page or all layers are full
+        bool add(const Image& image, TextureRegion& region);
+
+        void generateMipmaps();
+
+        void bind(uint32_t slot) const { glBindTextureUnit(slot, mId); }
+
+        GLuint getId() const { return mId; }
+        GLenum getInternalFormat() const { return mSettings.internalFormat; }
+        uint32_t getLayerCount() const { return uint32_t(mPages.size()); }
+        uint32_t getTextureCount() const { return mTextureCount; }
+        float getOccupancy() const;
+
+    private:
+        uint32_t getGutter() const { return mSettings.padding << (mSettings.mipLevels - 1); }
+
+        bool addLayer();
+        void upload(const Image& image, uint32_t layer, uint32_t x, uint32_t y, uint32_t gutter);
+
+        TextureAtlasSettings mSettings;
+        GLuint mId = 0;
+        uint32_t mCapacity = 0;
+        uint32_t mTextureCount = 0;
+
+        // a full page has no packer, whole-layer images are never packed together with others
+        struct Page
+        {
+            SkylinePacker packer;
+            bool full = false;
+        };
+        std::vector<Page> mPages;
+    };
+
+    // bins images by internal format, one TextureAtlas per format
+    class TexturePacker
+    {
+    public:
+        explicit TexturePacker(const TextureAtlasSettings& settings = TextureAtlasSettings()) : mSettings(settings) {}
+
+        bool add(const Image& image, GLenum internalFormat, TextureRegion& region);
+        bool add(const Image& image, TextureRegion& region) { return add(image, mSettings.internalFormat, region); }
+
+        void generateMipmaps();
+
+        uint32_t getAtlasCount() const { return uint32_t(mAtlases.size()); }
+        TextureAtlas& getAtlas(uint32_t index) { return *mAtlases[index]; }
+
+    private:
+        TextureAtlasSettings mSettings;
+        std::vector<std::unique_ptr<TextureAtlas>> mAtlases;
+    };
+
+    // ARB_bindless_texture handles stored in a shader storage buffer, shaders index them with
+    //     #extension GL_ARB_bindless_texture : require
+    //     layout(std430, binding = N) readonly buffer Textures { sampler2D textures[]; };
+    // Handles stay resident until destroy, textures must not be deleted or resized before that.
+    class BindlessTextureTable
+    {
+    public:
+        // glad is generated without extensions, the entry points are loaded through the context's loader
+        static bool load(GLADloadproc loader);
+        static bool isSupported();
+
+        BindlessTextureTable() = default;
+        ~BindlessTextureTable();
+
+        BindlessTextureTable(const BindlessTextureTable&) = delete;
+        BindlessTextureTable& operator=(const BindlessTextureTable&) = delete;
+
+        bool init(uint32_t capacity);
+        void destroy();
+
+        // returns the index to use in the shader, or ~0u when the table is full
+        uint32_t add(GLuint texture);
+
+        void bind(GLuint binding) const { glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, mBuffer); }
+
+        uint32_t size() const { return uint32_t(mHandles.size()); }
+
+    private:
+        GLuint mBuffer = 0;
+        uint32_t mCapacity = 0;
+        std::vector<uint64_t> mHandles;
+    };
+}
@@ -0,0 +1,31 @@
+#include "ThreadPool.h"
+
+namespace utils
+{
+    ThreadPool::ThreadPool(uint32_t threadCount)
+        : mOwnedJobSystem(new JobSystem(threadCount))
+        , mJobSystem(mOwnedJobSystem.get())
+    {
+    }
+
+    ThreadPool::ThreadPool(JobSystem& jobSystem)
+        : mJobSystem(&jobSystem)
+    {
+    }
+
+    ThreadPool& ThreadPool::global()
+    {
+        static ThreadPool pool(JobSystem::global());
+        return pool;
+    }
+
+    void ThreadPool::enqueue(Task task)
+    {
+        mJobSystem->run(std::move(task), nullptr, JOB_PRIORITY_LOW);
+    }
+
+    void ThreadPool::parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function)
+    {
+        mJobSystem->parallelFor(count, grainSize, function);
+    }
+}
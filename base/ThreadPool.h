@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "JobSystem.h"
+
+namespace utils
+{
+    // the pool interface the base library was written against, scheduled by a JobSystem
+    class ThreadPool
+    {
+    public:
+        using Task = JobSystem::JobFunction;
+        using RangeFunction = JobSystem::RangeFunction;
+
+        // 0 uses one thread per hardware thread minus the calling thread
+        explicit ThreadPool(uint32_t threadCount = 0);
+        explicit ThreadPool(JobSystem& jobSystem);
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // shared pool used by the base library, runs on JobSystem::global()
+        static ThreadPool& global();
+
+        // background work, runs at JOB_PRIORITY_LOW after everything the frame waits for
+        void enqueue(Task task);
+
+        // grainSize is the smallest chunk handed to function, see JobSystem::parallelFor.
+        // The calling thread helps until all chunks are done
+        void parallelFor(uint32_t count, uint32_t grainSize, const RangeFunction& function);
+
+        uint32_t getThreadCount() const { return mJobSystem->getWorkerCount(); }
+        JobSystem& getJobSystem() { return *mJobSystem; }
+
+    private:
+        std::unique_ptr<JobSystem> mOwnedJobSystem;
+        JobSystem* mJobSystem = nullptr;
+    };
+}
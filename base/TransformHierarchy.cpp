@@ -0,0 +1,542 @@
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "Memory.h"
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define TRANSFORMS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(TRANSFORMS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace utils
+{
+    namespace
+    {
+        // column-major like glm, the sums are added in glm's order so every level gives identical results
+        using MultiplyFunction = void (*)(const float* lhs, const float* rhs, float* out);
+        using MultiplyArrayFunction = void (*)(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count);
+
+        struct Kernels
+        {
+            MultiplyFunction multiply;
+            MultiplyArrayFunction multiplyArray;
+        };
+
+        inline void multiplyScalar(const float* lhs, const float* rhs, float* out)
+        {
+            glm::mat4 result;
+            const glm::mat4& a = *reinterpret_cast<const glm::mat4*>(lhs);
+            const glm::mat4& b = *reinterpret_cast<const glm::mat4*>(rhs);
+            result = a * b;
+            std::memcpy(out, &result[0][0], sizeof(glm::mat4));
+        }
+
+        void multiplyArrayScalar(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                out[i] = lhs * rhs[i];
+            }
+        }
+
+        const Kernels kScalarKernels = { multiplyScalar, multiplyArrayScalar };
+
+#if defined(TRANSFORMS_X86)
+        TARGET_SSE41 inline void multiplySse41Inline(const __m128 a[4], const float* rhs, float* out)
+        {
+            for (uint32_t column = 0; column < 4; ++column)
+            {
+                const __m128 b = _mm_loadu_ps(rhs + column * 4);
+                __m128 result = _mm_mul_ps(a[0], _mm_shuffle_ps(b, b, 0x00));
+                result = _mm_add_ps(result, _mm_mul_ps(a[1], _mm_shuffle_ps(b, b, 0x55)));
+                result = _mm_add_ps(result, _mm_mul_ps(a[2], _mm_shuffle_ps(b, b, 0xaa)));
+                result = _mm_add_ps(result, _mm_mul_ps(a[3], _mm_shuffle_ps(b, b, 0xff)));
+                _mm_storeu_ps(out + column * 4, result);
+            }
+        }
+
+        TARGET_SSE41 void multiplySse41(const float* lhs, const float* rhs, float* out)
+        {
+            const __m128 a[4] = { _mm_loadu_ps(lhs), _mm_loadu_ps(lhs + 4), _mm_loadu_ps(lhs + 8), _mm_loadu_ps(lhs + 12) };
+            multiplySse41Inline(a, rhs, out);
+        }
+
+        TARGET_SSE41 void multiplyArraySse41(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count)
+        {
+            const float* l = &lhs[0][0];
+            const __m128 a[4] = { _mm_loadu_ps(l), _mm_loadu_ps(l + 4), _mm_loadu_ps(l + 8), _mm_loadu_ps(l + 12) };
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                multiplySse41Inline(a, &rhs[i][0][0], &out[i][0][0]);
+            }
+        }
+
+        const Kernels kSse41Kernels = { multiplySse41, multiplyArraySse41 };
+
+        // two result columns per iteration, each 128-bit lane works on one column
+        TARGET_AVX2 inline void multiplyAvx2Inline(const __m256 a[4], const float* rhs, float* out)
+        {
+            for (uint32_t column = 0; column < 4; column += 2)
+            {
+                const __m256 b = _mm256_loadu_ps(rhs + column * 4);
+                __m256 result = _mm256_mul_ps(a[0], _mm256_shuffle_ps(b, b, 0x00));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a[1], _mm256_shuffle_ps(b, b, 0x55)));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a[2], _mm256_shuffle_ps(b, b, 0xaa)));
+                result = _mm256_add_ps(result, _mm256_mul_ps(a[3], _mm256_shuffle_ps(b, b, 0xff)));
+                _mm256_storeu_ps(out + column * 4, result);
+            }
+        }
+
+        TARGET_AVX2 inline void loadColumnsAvx2(const float* lhs, __m256 a[4])
+        {
+            for (uint32_t column = 0; column < 4; ++column)
+            {
+                a[column] = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + column * 4));
+            }
+        }
+
+        TARGET_AVX2 void multiplyAvx2(const float* lhs, const float* rhs, float* out)
+        {
+            __m256 a[4];
+            loadColumnsAvx2(lhs, a);
+            multiplyAvx2Inline(a, rhs, out);
+        }
+
+        TARGET_AVX2 void multiplyArrayAvx2(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count)
+        {
+            __m256 a[4];
+            loadColumnsAvx2(&lhs[0][0], a);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                multiplyAvx2Inline(a, &rhs[i][0][0], &out[i][0][0]);
+            }
+        }
+
+        const Kernels kAvx2Kernels = { multiplyAvx2, multiplyArrayAvx2 };
+#endif
+
+        const Kernels& getKernels(SimdLevel level)
+        {
+#if defined(TRANSFORMS_X86)
+            switch (clampSimdLevel(level))
+            {
+            case SimdLevel::SIMD_AVX2:
+                return kAvx2Kernels;
+            case SimdLevel::SIMD_SSE41:
+                return kSse41Kernels;
+            default:
+                break;
+            }
+#endif
+            return kScalarKernels;
+        }
+
+        inline void composeLocal(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale, glm::mat4& local)
+        {
+            const glm::mat3 r = glm::mat3_cast(rotation);
+            local[0] = glm::vec4(r[0] * scale.x, 0.0f);
+            local[1] = glm::vec4(r[1] * scale.y, 0.0f);
+            local[2] = glm::vec4(r[2] * scale.z, 0.0f);
+            local[3] = glm::vec4(position, 1.0f);
+        }
+    }
+
+    void multiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count, SimdLevel level)
+    {
+        getKernels(level).multiplyArray(lhs, rhs, out, count);
+    }
+
+    void TransformHierarchy::reserve(uint32_t count)
+    {
+        mPositions.reserve(count);
+        mRotations.reserve(count);
+        mScales.reserve(count);
+        mParents.reserve(count);
+        mSubtreeSizes.reserve(count);
+        mDirty.reserve(count);
+        mWorld.reserve(count);
+        mMvp.reserve(count);
+        mHandles.reserve(count);
+        mIndices.reserve(count);
+        mDestroyed.reserve(count);
+    }
+
+    TransformHandle TransformHierarchy::create(TransformHandle parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        HandleBase::HandleId id;
+        if (!mFreeHandles.empty())
+        {
+            id = mFreeHandles.back();
+            mFreeHandles.pop_back();
+        }
+        else
+        {
+            id = HandleBase::HandleId(mIndices.size());
+            mIndices.push_back(kInvalidIndex);
+            mDestroyed.push_back(false);
+        }
+
+        const uint32_t index = size();
+        const uint32_t parentIndex = parent ? getIndex(parent) : kInvalidIndex;
+
+        mIndices[id] = index;
+        mPositions.push_back(position);
+        mRotations.push_back(rotation);
+        mScales.push_back(scale);
+        mParents.push_back(parentIndex);
+        mSubtreeSizes.push_back(1);
+        mDirty.push_back(1);
+        mWorld.emplace_back(1.0f);
+        mMvp.emplace_back(1.0f);
+        mHandles.push_back(id);
+
+        // appending keeps the depth-first order as long as every ancestor's subtree ends at the back
+        for (uint32_t ancestor = parentIndex; ancestor != kInvalidIndex && !mNeedsRebuild; ancestor = mParents[ancestor])
+        {
+            if (ancestor + mSubtreeSizes[ancestor] != index)
+            {
+                mNeedsRebuild = true;
+            }
+            ++mSubtreeSizes[ancestor];
+        }
+
+        mAnyDirty = true;
+        mNeedsPartition = true;
+        return TransformHandle(id);
+    }
+
+    void TransformHierarchy::destroy(TransformHandle handle)
+    {
+        if (!handle || mIndices[handle.getId()] == kInvalidIndex)
+        {
+            return;
+        }
+
+        mDestroyed[handle.getId()] = true;
+        mNeedsRebuild = true;
+    }
+
+    bool TransformHierarchy::setParent(TransformHandle handle, TransformHandle parent)
+    {
+        const uint32_t index = getIndex(handle);
+        const uint32_t parentIndex = parent ? getIndex(parent) : kInvalidIndex;
+
+        for (uint32_t ancestor = parentIndex; ancestor != kInvalidIndex; ancestor = mParents[ancestor])
+        {
+            if (ancestor == index)
+            {
+                std::cerr << "Cannot parent a transform to itself or one of its descendants." << std::endl;
+                return false;
+            }
+        }
+
+        mParents[index] = parentIndex;
+        markDirty(index);
+        mNeedsRebuild = true;
+        return true;
+    }
+
+    void TransformHierarchy::setLocalPosition(TransformHandle handle, const glm::vec3& position)
+    {
+        const uint32_t index = getIndex(handle);
+        mPositions[index] = position;
+        markDirty(index);
+    }
+
+    void TransformHierarchy::setLocalRotation(TransformHandle handle, const glm::quat& rotation)
+    {
+        const uint32_t index = getIndex(handle);
+        mRotations[index] = rotation;
+        markDirty(index);
+    }
+
+    void TransformHierarchy::setLocalScale(TransformHandle handle, const glm::vec3& scale)
+    {
+        const uint32_t index = getIndex(handle);
+        mScales[index] = scale;
+        markDirty(index);
+    }
+
+    void TransformHierarchy::setLocal(TransformHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        const uint32_t index = getIndex(handle);
+        mPositions[index] = position;
+        mRotations[index] = rotation;
+        mScales[index] = scale;
+        markDirty(index);
+    }
+
+    void TransformHierarchy::markDirty(uint32_t index)
+    {
+        // descendants pick the flag up from their parent during the update
+        mDirty[index] = 1;
+        mAnyDirty = true;
+    }
+
+    void TransformHierarchy::update(const glm::mat4& viewProjection, ThreadPool* pool)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        if (mNeedsRebuild)
+        {
+            rebuild();
+        }
+        if (mNeedsPartition)
+        {
+            partition();
+        }
+
+        const bool allMvp = viewProjection != mViewProjection;
+        mViewProjection = viewProjection;
+
+        uint32_t updated = 0;
+        if (mAnyDirty || allMvp)
+        {
+            for (uint32_t index : mSerialNodes)
+            {
+                updated += updateRange(index, index + 1, allMvp);
+            }
+
+            if (pool != nullptr && mRanges.size() > 1)
+            {
+                std::atomic<uint32_t> counter{ 0 };
+                pool->parallelFor(uint32_t(mRanges.size()), 1, [&](uint32_t begin, uint32_t end)
+                {
+                    uint32_t count = 0;
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        count += updateRange(mRanges[i].first, mRanges[i].second, allMvp);
+                    }
+                    counter += count;
+                });
+                updated += counter.load();
+            }
+            else
+            {
+                for (const auto& range : mRanges)
+                {
+                    updated += updateRange(range.first, range.second, allMvp);
+                }
+            }
+
+            std::fill(mDirty.begin(), mDirty.end(), uint8_t(0));
+            mAnyDirty = false;
+        }
+
+        mStats.nodeCount = size();
+        mStats.updatedCount = updated;
+        mStats.taskCount = uint32_t(mRanges.size());
+        mStats.serialCount = uint32_t(mSerialNodes.size());
+        mStats.updateTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint32_t TransformHierarchy::updateRange(uint32_t begin, uint32_t end, bool allMvp)
+    {
+        const Kernels& kernels = getKernels(mSimdLevel);
+
+        ScratchScope scratch;
+        uint32_t* updated = static_cast<uint32_t*>(scratch.allocate(sizeof(uint32_t) * (end - begin), alignof(uint32_t)));
+        uint32_t count = 0;
+
+        glm::mat4 local;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            // parents come first, so their flag already includes every change further up
+            const uint32_t parent = mParents[i];
+            if (!mDirty[i] && (parent == kInvalidIndex || !mDirty[parent]))
+            {
+                continue;
+            }
+            mDirty[i] = 1;
+
+            composeLocal(mPositions[i], mRotations[i], mScales[i], local);
+            if (parent == kInvalidIndex)
+            {
+                mWorld[i] = local;
+            }
+            else
+            {
+                kernels.multiply(&mWorld[parent][0][0], &local[0][0], &mWorld[i][0][0]);
+            }
+            updated[count++] = i;
+        }
+
+        if (allMvp)
+        {
+            kernels.multiplyArray(mViewProjection, &mWorld[begin], &mMvp[begin], end - begin);
+        }
+        else
+        {
+            for (uint32_t k = 0; k < count; ++k)
+            {
+                kernels.multiply(&mViewProjection[0][0], &mWorld[updated[k]][0][0], &mMvp[updated[k]][0][0]);
+            }
+        }
+
+        return count;
+    }
+
+    void TransformHierarchy::rebuild()
+    {
+        const uint32_t count = size();
+
+        // children grouped by parent with a counting sort, roots use the extra slot at the end
+        std::vector<uint32_t> childStart(count + 2, 0);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t parent = mParents[i] == kInvalidIndex ? count : mParents[i];
+            ++childStart[parent + 1];
+        }
+        for (uint32_t i = 0; i < count + 1; ++i)
+        {
+            childStart[i + 1] += childStart[i];
+        }
+
+        std::vector<uint32_t> children(count);
+        std::vector<uint32_t> cursor(childStart.begin(), childStart.end() - 1);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t parent = mParents[i] == kInvalidIndex ? count : mParents[i];
+            children[cursor[parent]++] = i;
+        }
+
+        // depth-first walk, destroyed nodes are skipped along with everything below them
+        std::vector<uint32_t> order;
+        order.reserve(count);
+        std::vector<uint32_t> stack;
+        for (uint32_t c = childStart[count + 1]; c-- > childStart[count];)
+        {
+            stack.push_back(children[c]);
+        }
+        while (!stack.empty())
+        {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+            if (mDestroyed[mHandles[node]])
+            {
+                continue;
+            }
+
+            order.push_back(node);
+            for (uint32_t c = childStart[node + 1]; c-- > childStart[node];)
+            {
+                stack.push_back(children[c]);
+            }
+        }
+
+        std::vector<uint32_t> remap(count, kInvalidIndex);
+        for (uint32_t i = 0; i < uint32_t(order.size()); ++i)
+        {
+            remap[order[i]] = i;
+        }
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (remap[i] == kInvalidIndex)
+            {
+                const HandleBase::HandleId id = mHandles[i];
+                mIndices[id] = kInvalidIndex;
+                mDestroyed[id] = false;
+                mFreeHandles.push_back(id);
+            }
+        }
+
+        auto permute = [&order](auto& values)
+        {
+            std::remove_reference_t<decltype(values)> sorted;
+            sorted.reserve(values.capacity());
+            for (uint32_t index : order)
+            {
+                sorted.push_back(values[index]);
+            }
+            values.swap(sorted);
+        };
+
+        permute(mPositions);
+        permute(mRotations);
+        permute(mScales);
+        permute(mParents);
+        permute(mDirty);
+        permute(mWorld);
+        permute(mMvp);
+        permute(mHandles);
+
+        const uint32_t liveCount = uint32_t(order.size());
+        mSubtreeSizes.assign(liveCount, 1);
+        for (uint32_t i = 0; i < liveCount; ++i)
+        {
+            mParents[i] = mParents[i] == kInvalidIndex ? kInvalidIndex : remap[mParents[i]];
+            mIndices[mHandles[i]] = i;
+        }
+        for (uint32_t i = liveCount; i-- > 0;)
+        {
+            if (mParents[i] != kInvalidIndex)
+            {
+                mSubtreeSizes[mParents[i]] += mSubtreeSizes[i];
+            }
+        }
+
+        mNeedsRebuild = false;
+        mNeedsPartition = true;
+    }
+
+    void TransformHierarchy::partition()
+    {
+        mSerialNodes.clear();
+        mRanges.clear();
+
+        // subtrees up to the grain size become tasks, larger ones are updated serially at the root and split
+        std::vector<uint32_t> stack;
+        for (uint32_t root = 0; root < size(); root += mSubtreeSizes[root])
+        {
+            stack.push_back(root);
+        }
+        std::reverse(stack.begin(), stack.end());
+
+        while (!stack.empty())
+        {
+            const uint32_t node = stack.back();
+            stack.pop_back();
+
+            const uint32_t end = node + mSubtreeSizes[node];
+            if (mSubtreeSizes[node] <= mGrainSize)
+            {
+                // adjacent siblings are merged as long as the range stays within the grain size
+                if (!mRanges.empty() && mRanges.back().second == node && end - mRanges.back().first <= mGrainSize)
+                {
+                    mRanges.back().second = end;
+                }
+                else
+                {
+                    mRanges.emplace_back(node, end);
+                }
+                continue;
+            }
+
+            mSerialNodes.push_back(node);
+
+            const size_t first = stack.size();
+            for (uint32_t child = node + 1; child < end; child += mSubtreeSizes[child])
+            {
+                stack.push_back(child);
+            }
+            std::reverse(stack.begin() + first, stack.end());
+        }
+
+        mNeedsPartition = false;
+    }
+}
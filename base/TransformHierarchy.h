@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Cpu.h"
+#include "Handle.h"
+
+namespace utils
+{
+    class ThreadPool;
+
+    struct TransformNode;
+    using TransformHandle = Handle<TransformNode>;
+
+    struct TransformStats
+    {
+        uint32_t nodeCount = 0;
+
+        // world matrices recomputed by the last update
+        uint32_t updatedCount = 0;
+
+        // independent subtrees handed to the thread pool, plus nodes above them updated serially
+        uint32_t taskCount = 0;
+        uint32_t serialCount = 0;
+
+        // milliseconds spent in the last update, including a rebuild of the node order
+        double updateTime = 0.0;
+    };
+
+    // out[i] = lhs * rhs[i], levels above the supported one fall back to it
+    void multiplyMatrices(const glm::mat4& lhs, const glm::mat4* rhs, glm::mat4* out, uint32_t count,
+        SimdLevel level = getSupportedSimdLevel());
+
+    // Local TRS, world and model-view-projection matrices stored as parallel arrays in depth-first order,
+    // so parents precede their children and every subtree is a contiguous range.
+    // Only nodes whose local transform or an ancestor changed are recomputed by update().
+    class TransformHierarchy
+    {
+    public:
+        static constexpr uint32_t kInvalidIndex = ~0u;
+
+        TransformHierarchy() = default;
+
+        TransformHierarchy(const TransformHierarchy&) = delete;
+        TransformHierarchy& operator=(const TransformHierarchy&) = delete;
+
+        void reserve(uint32_t count);
+
+        TransformHandle create(TransformHandle parent = {}, const glm::vec3& position = glm::vec3(0.0f),
+            const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+        // destroys the node and all of its descendants, their handles become invalid
+        void destroy(TransformHandle handle);
+
+        // fails if the new parent is the node itself or one of its descendants
+        bool setParent(TransformHandle handle, TransformHandle parent);
+
+        void setLocalPosition(TransformHandle handle, const glm::vec3& position);
+        void setLocalRotation(TransformHandle handle, const glm::quat& rotation);
+        void setLocalScale(TransformHandle handle, const glm::vec3& scale);
+        void setLocal(TransformHandle handle, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+        const glm::vec3& getLocalPosition(TransformHandle handle) const { return mPositions[getIndex(handle)]; }
+        const glm::quat& getLocalRotation(TransformHandle handle) const { return mRotations[getIndex(handle)]; }
+        const glm::vec3& getLocalScale(TransformHandle handle) const { return mScales[getIndex(handle)]; }
+
+        // valid after update()
+        const glm::mat4& getWorldMatrix(TransformHandle handle) const { return mWorld[getIndex(handle)]; }
+        const glm::mat4& getMvpMatrix(TransformHandle handle) const { return mMvp[getIndex(handle)]; }
+
+        // recomputes dirty world matrices and the model-view-projection matrices, in parallel when a pool is given
+        void update(const glm::mat4& viewProjection, ThreadPool* pool = nullptr);
+
+        // dense arrays in update order, e.g. for a single buffer upload; indices change when nodes are added or removed
+        uint32_t size() const { return uint32_t(mParents.size()); }
+        uint32_t getIndex(TransformHandle handle) const { return mIndices[handle.getId()]; }
+        const glm::mat4* getWorldMatrices() const { return mWorld.data(); }
+        const glm::mat4* getMvpMatrices() const { return mMvp.data(); }
+
+        // nodes per parallel task, subtrees larger than this are split at their children
+        void setGrainSize(uint32_t grainSize) { mGrainSize = grainSize > 0 ? grainSize : 1; mNeedsPartition = true; }
+
+        // matrix kernels of update(), clamped to the supported level. Every level gives identical results
+        void setSimdLevel(SimdLevel level) { mSimdLevel = clampSimdLevel(level); }
+        SimdLevel getSimdLevel() const { return mSimdLevel; }
+
+        const TransformStats& getStats() const { return mStats; }
+
+    private:
+        void markDirty(uint32_t index);
+
+        // restores depth-first order and drops destroyed subtrees
+        void rebuild();
+        void partition();
+
+        uint32_t updateRange(uint32_t begin, uint32_t end, bool allMvp);
+
+        // indexed by node position
+        std::vector<glm::vec3> mPositions;
+        std::vector<glm::quat> mRotations;
+        std::vector<glm::vec3> mScales;
+        std::vector<uint32_t> mParents;
+        std::vector<uint32_t> mSubtreeSizes;
+        std::vector<uint8_t> mDirty;
+        std::vector<glm::mat4> mWorld;
+        std::vector<glm::mat4> mMvp;
+        std::vector<HandleBase::HandleId> mHandles;
+
+        // indexed by handle id
+        std::vector<uint32_t> mIndices;
+        std::vector<HandleBase::HandleId> mFreeHandles;
+        std::vector<bool> mDestroyed;
+
+        // nodes above the parallel ranges are updated first, each range holds whole sibling subtrees
+        std::vector<uint32_t> mSerialNodes;
+        std::vector<std::pair<uint32_t, uint32_t>> mRanges;
+
+        glm::mat4 mViewProjection = glm::mat4(0.0f);
+        uint32_t mGrainSize = 4096;
+        SimdLevel mSimdLevel = getSupportedSimdLevel();
+        bool mNeedsRebuild = false;
+        bool mNeedsPartition = true;
+        bool mAnyDirty = false;
+
+        TransformStats mStats;
+    };
+}
@@ -0,0 +1,116 @@
+#include "VertexLayout.h"
+
+namespace utils
+{
+    bool VertexFormat::operator==(const VertexFormat& other) const
+    {
+        if (attributeCount != other.attributeCount || bindingCount != other.bindingCount)
+        {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < attributeCount; ++i)
+        {
+            const Attribute& a = attributes[i];
+            const Attribute& b = other.attributes[i];
+            if (a.type != b.type || a.offset != b.offset || a.count != b.count || a.binding != b.binding || a.mode != b.mode)
+            {
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < bindingCount; ++i)
+        {
+            if (bindings[i].stride != other.bindings[i].stride || bindings[i].divisor != other.bindings[i].divisor)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t VertexFormat::hash() const
+    {
+        // FNV-1a over the used fields only, unused slots may hold anything
+        uint64_t hash = 14695981039346656037ull;
+        auto add = [&hash](uint32_t value)
+        {
+            hash ^= value;
+            hash *= 1099511628211ull;
+        };
+
+        add(attributeCount);
+        add(bindingCount);
+        for (uint32_t i = 0; i < attributeCount; ++i)
+        {
+            const Attribute& attribute = attributes[i];
+            add(attribute.type);
+            add(attribute.offset);
+            add(uint32_t(attribute.count) | uint32_t(attribute.binding) << 8 | uint32_t(attribute.mode) << 16);
+        }
+        for (uint32_t i = 0; i < bindingCount; ++i)
+        {
+            add(bindings[i].stride);
+            add(bindings[i].divisor);
+        }
+        return hash;
+    }
+
+    VertexArrayCache& VertexArrayCache::global()
+    {
+        static VertexArrayCache cache;
+        return cache;
+    }
+
+    GLuint VertexArrayCache::acquire(const VertexFormat& format)
+    {
+        ++mStats.requests;
+
+        const uint64_t hash = format.hash();
+        for (const Entry& entry : mEntries)
+        {
+            if (entry.hash == hash && entry.format == format)
+            {
+                return entry.vertexArray;
+            }
+        }
+
+        Entry entry;
+        entry.hash = hash;
+        entry.format = format;
+        glCreateVertexArrays(1, &entry.vertexArray);
+
+        for (uint32_t binding = 0; binding < format.bindingCount; ++binding)
+        {
+            glVertexArrayBindingDivisor(entry.vertexArray, binding, format.bindings[binding].divisor);
+        }
+        for (uint32_t location = 0; location < format.attributeCount; ++location)
+        {
+            const VertexFormat::Attribute& attribute = format.attributes[location];
+            if (attribute.mode == VERTEX_ATTRIBUTE_INTEGER)
+            {
+                glVertexArrayAttribIFormat(entry.vertexArray, location, attribute.count, attribute.type, attribute.offset);
+            }
+            else
+            {
+                glVertexArrayAttribFormat(entry.vertexArray, location, attribute.count, attribute.type,
+                    attribute.mode == VERTEX_ATTRIBUTE_NORMALIZED ? GL_TRUE : GL_FALSE, attribute.offset);
+            }
+            glVertexArrayAttribBinding(entry.vertexArray, location, attribute.binding);
+            glEnableVertexArrayAttrib(entry.vertexArray, location);
+        }
+
+        mEntries.push_back(entry);
+        mStats.vertexArrays = uint32_t(mEntries.size());
+        return entry.vertexArray;
+    }
+
+    void VertexArrayCache::destroy()
+    {
+        for (const Entry& entry : mEntries)
+        {
+            glDeleteVertexArrays(1, &entry.vertexArray);
+        }
+        mEntries.clear();
+        mStats.vertexArrays = 0;
+    }
+}
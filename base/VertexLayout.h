@@ -0,0 +1,189 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace utils
+{
+    // GL component type and count of a vertex member, specialize it for other member types
+    template<typename T>
+    struct VertexComponent;
+
+    template<> struct VertexComponent<float> { static constexpr GLenum type = GL_FLOAT; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<int8_t> { static constexpr GLenum type = GL_BYTE; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<uint8_t> { static constexpr GLenum type = GL_UNSIGNED_BYTE; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<int16_t> { static constexpr GLenum type = GL_SHORT; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<uint16_t> { static constexpr GLenum type = GL_UNSIGNED_SHORT; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<int32_t> { static constexpr GLenum type = GL_INT; static constexpr GLint count = 1; };
+    template<> struct VertexComponent<uint32_t> { static constexpr GLenum type = GL_UNSIGNED_INT; static constexpr GLint count = 1; };
+
+    template<typename T, glm::precision P>
+    struct VertexComponent<glm::tvec2<T, P>> { static constexpr GLenum type = VertexComponent<T>::type; static constexpr GLint count = 2; };
+    template<typename T, glm::precision P>
+    struct VertexComponent<glm::tvec3<T, P>> { static constexpr GLenum type = VertexComponent<T>::type; static constexpr GLint count = 3; };
+    template<typename T, glm::precision P>
+    struct VertexComponent<glm::tvec4<T, P>> { static constexpr GLenum type = VertexComponent<T>::type; static constexpr GLint count = 4; };
+
+    template<typename T, size_t N>
+    struct VertexComponent<std::array<T, N>> { static constexpr GLenum type = VertexComponent<T>::type; static constexpr GLint count = GLint(N); };
+    template<typename T, size_t N>
+    struct VertexComponent<T[N]> { static constexpr GLenum type = VertexComponent<T>::type; static constexpr GLint count = GLint(N); };
+
+    enum VertexAttributeMode : uint32_t
+    {
+        // converted to float as they are, what glVertexAttribPointer does without normalization
+        VERTEX_ATTRIBUTE_FLOAT,
+        // unsigned integers map to [0, 1], signed ones to [-1, 1]
+        VERTEX_ATTRIBUTE_NORMALIZED,
+        // read by ivec and uvec shader inputs
+        VERTEX_ATTRIBUTE_INTEGER,
+    };
+
+    template<typename Member, size_t Offset, VertexAttributeMode Mode = VERTEX_ATTRIBUTE_FLOAT>
+    struct VertexAttribute
+    {
+        static constexpr GLenum type = VertexComponent<Member>::type;
+        static constexpr GLint count = VertexComponent<Member>::count;
+        static constexpr uint32_t offset = uint32_t(Offset);
+        static constexpr uint32_t size = uint32_t(sizeof(Member));
+        static constexpr VertexAttributeMode mode = Mode;
+
+        static_assert(count >= 1 && count <= 4, "vertex attributes have one to four components");
+        static_assert(Mode == VERTEX_ATTRIBUTE_FLOAT || type != GL_FLOAT, "float attributes can't be normalized or integer");
+    };
+
+    // attribute of a member, e.g. UTILS_VERTEX_ATTRIBUTE(Vertex, position)
+    #define UTILS_VERTEX_ATTRIBUTE(vertex, member) \
+        utils::VertexAttribute<decltype(vertex::member), offsetof(vertex, member)>
+    #define UTILS_VERTEX_ATTRIBUTE_MODE(vertex, member, mode) \
+        utils::VertexAttribute<decltype(vertex::member), offsetof(vertex, member), mode>
+
+    // everything a vertex array needs besides its buffers, VertexArrayCache creates one vertex array per format
+    struct VertexFormat
+    {
+        static constexpr uint32_t kMaxAttributes = 16;
+        static constexpr uint32_t kMaxBindings = 4;
+
+        struct Attribute
+        {
+            GLenum type = GL_FLOAT;
+            uint32_t offset = 0;
+            uint8_t count = 0;
+            uint8_t binding = 0;
+            uint8_t mode = VERTEX_ATTRIBUTE_FLOAT;
+            uint8_t padding = 0;
+        };
+
+        struct Binding
+        {
+            uint32_t stride = 0;
+
+            // 0 advances per vertex, n per n instances
+            uint32_t divisor = 0;
+        };
+
+        // attribute i is read at location i
+        Attribute attributes[kMaxAttributes];
+        Binding bindings[kMaxBindings];
+        uint32_t attributeCount = 0;
+        uint32_t bindingCount = 0;
+
+        bool operator==(const VertexFormat& other) const;
+        bool operator!=(const VertexFormat& other) const { return !(*this == other); }
+        uint64_t hash() const;
+    };
+
+    // Layout of a vertex struct, the stride and every attribute's offset, type and normalization are constants
+    // derived from the struct. Attributes are read at consecutive locations in the order they are listed:
+    //   using CubeLayout = VertexLayout<Vertex, UTILS_VERTEX_ATTRIBUTE(Vertex, position), UTILS_VERTEX_ATTRIBUTE(Vertex, color)>;
+    template<typename Vertex, typename... Attributes>
+    struct VertexLayout
+    {
+        static constexpr uint32_t stride = uint32_t(sizeof(Vertex));
+        static constexpr uint32_t attributeCount = uint32_t(sizeof...(Attributes));
+
+        static_assert(attributeCount > 0 && attributeCount <= VertexFormat::kMaxAttributes, "too many vertex attributes");
+        static_assert(((Attributes::offset + Attributes::size <= stride) && ...), "vertex attribute outside of the vertex");
+
+        // adds the attributes after the ones already in format, fed by the next free binding. Instance data is
+        // appended with a divisor, e.g. VertexLayout<Instance, ...>::append(format, 1)
+        static bool append(VertexFormat& format, uint32_t divisor = 0)
+        {
+            if (format.attributeCount + attributeCount > VertexFormat::kMaxAttributes || format.bindingCount >= VertexFormat::kMaxBindings)
+            {
+                return false;
+            }
+
+            const uint8_t binding = uint8_t(format.bindingCount++);
+            format.bindings[binding].stride = stride;
+            format.bindings[binding].divisor = divisor;
+            ((format.attributes[format.attributeCount++] = makeAttribute<Attributes>(binding)), ...);
+            return true;
+        }
+
+        static VertexFormat format()
+        {
+            VertexFormat result;
+            append(result);
+            return result;
+        }
+
+    private:
+        template<typename Attribute>
+        static VertexFormat::Attribute makeAttribute(uint8_t binding)
+        {
+            VertexFormat::Attribute attribute;
+            attribute.type = Attribute::type;
+            attribute.offset = Attribute::offset;
+            attribute.count = uint8_t(Attribute::count);
+            attribute.binding = binding;
+            attribute.mode = uint8_t(Attribute::mode);
+            return attribute;
+        }
+    };
+
+    struct VertexArrayCacheStats
+    {
+        uint32_t vertexArrays = 0;
+        uint64_t requests = 0;
+    };
+
+    // One vertex array per unique vertex format, set up with separate attribute formats. Meshes of the same
+    // format share it and only swap buffers: glVertexArrayVertexBuffer and glVertexArrayElementBuffer instead
+    // of binding a vertex array per mesh. Call destroy() while the context is still current.
+    class VertexArrayCache
+    {
+    public:
+        static VertexArrayCache& global();
+
+        GLuint acquire(const VertexFormat& format);
+
+        template<typename Layout>
+        GLuint acquire()
+        {
+            static const VertexFormat format = Layout::format();
+            return acquire(format);
+        }
+
+        void destroy();
+
+        const VertexArrayCacheStats& getStats() const { return mStats; }
+
+    private:
+        struct Entry
+        {
+            uint64_t hash = 0;
+            VertexFormat format;
+            GLuint vertexArray = 0;
+        };
+
+        // a handful of formats per application, a linear scan over the hashes beats a map
+        std::vector<Entry> mEntries;
+        VertexArrayCacheStats mStats;
+    };
+}
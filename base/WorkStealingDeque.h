@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace utils
+{
+    // bounded Chase-Lev deque, the owning thread pushes and pops at the bottom, any thread steals from the top.
+    // Only the last element is contended, the owner and a thief race for it with one CAS on top. Memory orders
+    // follow Le, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models".
+    template<typename T>
+    class WorkStealingDeque
+    {
+    public:
+        // capacity is rounded up to a power of two
+        explicit WorkStealingDeque(uint32_t capacity)
+        {
+            uint32_t size = 2;
+            while (size < capacity)
+            {
+                size <<= 1;
+            }
+
+            mItems.reset(new std::atomic<T>[size]);
+            mMask = size - 1;
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        // owner only, returns false if the deque is full
+        bool push(T item)
+        {
+            const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+            const int64_t top = mTop.load(std::memory_order_acquire);
+            if (bottom - top > int64_t(mMask))
+            {
+                return false;
+            }
+
+            // publishes the item and everything written before the push to thieves loading bottom
+            mItems[bottom & mMask].store(item, std::memory_order_relaxed);
+            mBottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        // owner only, newest first
+        bool pop(T& item)
+        {
+            const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+            mBottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = mTop.load(std::memory_order_relaxed);
+
+            if (top > bottom)
+            {
+                mBottom.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+
+            item = mItems[bottom & mMask].load(std::memory_order_relaxed);
+            if (top < bottom)
+            {
+                return true;
+            }
+
+            // the last item, a thief may be taking it at the same time
+            const bool won = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            mBottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+
+        // any thread, oldest first. Fails spuriously when another thief or the owner won the race
+        bool steal(T& item)
+        {
+            int64_t top = mTop.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t bottom = mBottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+            {
+                return false;
+            }
+
+            item = mItems[top & mMask].load(std::memory_order_relaxed);
+            return mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        }
+
+        // a snapshot, exact only on the owning thread while nobody steals
+        uint32_t size() const
+        {
+            const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+            const int64_t top = mTop.load(std::memory_order_relaxed);
+            return bottom > top ? uint32_t(bottom - top) : 0;
+        }
+
+    private:
+        // top and bottom on separate cache lines, thieves only write top
+        alignas(64) std::atomic<int64_t> mTop{ 0 };
+        alignas(64) std::atomic<int64_t> mBottom{ 0 };
+        std::unique_ptr<std::atomic<T>[]> mItems;
+        uint64_t mMask = 0;
+    };
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "AssetArchive.h"
+#include "BenchContext.h"
+#include "JobSystem.h"
+
+namespace
+{
+    namespace fs = std::filesystem;
+
+    enum AssetSource
+    {
+        ASSET_SOURCE_FILES,
+        ASSET_SOURCE_STORED_PACK,
+        ASSET_SOURCE_DEFLATE_PACK,
+    };
+
+    // data/ packed once per run, stored and compressed, next to the relative paths of its files
+    struct AssetPacks
+    {
+        std::vector<std::string> paths;
+        std::string storedPack;
+        std::string deflatePack;
+        bool valid = false;
+    };
+
+    const AssetPacks& getPacks()
+    {
+        static AssetPacks packs = []()
+        {
+            AssetPacks result;
+            const fs::path root = bench::getDataPath();
+            for (const auto& entry : fs::recursive_directory_iterator(root))
+            {
+                if (entry.is_regular_file() && entry.path().extension() != ".pack")
+                {
+                    result.paths.push_back(fs::relative(entry.path(), root).generic_string());
+                }
+            }
+            std::sort(result.paths.begin(), result.paths.end());
+
+            const fs::path directory = fs::temp_directory_path();
+            result.storedPack = (directory / "base_bench_stored.pack").string();
+            result.deflatePack = (directory / "base_bench_deflate.pack").string();
+
+            result.valid = !result.paths.empty();
+            for (utils::AssetCodec codec : { utils::ASSET_CODEC_NONE, utils::ASSET_CODEC_DEFLATE })
+            {
+                utils::AssetArchiveWriter writer;
+                for (const std::string& path : result.paths)
+                {
+                    result.valid = result.valid && writer.addFile(path, (root / path).string(), codec);
+                }
+                result.valid = result.valid && writer.write(codec == utils::ASSET_CODEC_NONE ? result.storedPack : result.deflatePack);
+            }
+            return result;
+        }();
+        return packs;
+    }
+
+    // drops the file's clean pages from the page cache, the next read goes to the disk
+    bool evictFile(const std::string& filename)
+    {
+#if defined(__linux__)
+        const int file = open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            return false;
+        }
+        const bool evicted = posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(file);
+        return evicted;
+#else
+        return false;
+#endif
+    }
+
+    // one byte of every page, a zero-copy view costs its page faults only once it's used
+    uint32_t touch(const unsigned char* data, size_t size)
+    {
+        uint32_t sum = 0;
+        for (size_t i = 0; i < size; i += 4096)
+        {
+            sum += data[i];
+        }
+        return sum;
+    }
+
+    // everything an example loads at startup: open, resolve and read every asset in data/.
+    // range(1) evicts the files from the page cache before every iteration
+    void BM_AssetStartup(benchmark::State& state)
+    {
+        const AssetPacks& packs = getPacks();
+        if (!packs.valid)
+        {
+            state.SkipWithError("could not pack data/");
+            return;
+        }
+
+        const AssetSource source = AssetSource(state.range(0));
+        const bool cold = state.range(1) != 0;
+        const std::string root = bench::getDataPath();
+        const std::string& packFile = source == ASSET_SOURCE_STORED_PACK ? packs.storedPack : packs.deflatePack;
+
+        std::vector<utils::AssetData> outputs(packs.paths.size());
+        std::vector<uint32_t> entries(packs.paths.size());
+        uint64_t bytes = 0;
+        for (auto _ : state)
+        {
+            if (cold)
+            {
+                state.PauseTiming();
+                bool evicted = true;
+                if (source == ASSET_SOURCE_FILES)
+                {
+                    for (const std::string& path : packs.paths)
+                    {
+                        evicted = evictFile(root + path) && evicted;
+                    }
+                }
+                else
+                {
+                    evicted = evictFile(packFile);
+                }
+                state.ResumeTiming();
+                if (!evicted)
+                {
+                    state.SkipWithError("page cache eviction is not supported");
+                    return;
+                }
+            }
+
+            uint32_t sum = 0;
+            bytes = 0;
+            if (source == ASSET_SOURCE_FILES)
+            {
+                for (const std::string& path : packs.paths)
+                {
+                    std::ifstream is(root + path, std::ios::binary);
+                    std::vector<unsigned char> data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+                    sum += touch(data.data(), data.size());
+                    bytes += data.size();
+                }
+            }
+            else
+            {
+                utils::AssetArchive archive;
+                archive.open(packFile);
+                for (size_t i = 0; i < packs.paths.size(); ++i)
+                {
+                    entries[i] = archive.find(packs.paths[i]);
+                }
+
+                utils::JobCounter counter;
+                archive.readAsync(entries.data(), uint32_t(entries.size()), outputs.data(), counter);
+                utils::JobSystem::global().wait(counter);
+                for (const utils::AssetData& output : outputs)
+                {
+                    sum += touch(output.data, output.size);
+                    bytes += output.size;
+                }
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+        state.SetBytesProcessed(state.iterations() * int64_t(bytes));
+        state.counters["files"] = double(packs.paths.size());
+    }
+    BENCHMARK(BM_AssetStartup)->ArgsProduct({ { ASSET_SOURCE_FILES, ASSET_SOURCE_STORED_PACK, ASSET_SOURCE_DEFLATE_PACK }, { 0, 1 } })
+        ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    // resolving a path through the index, the cost every load pays before touching any data
+    void BM_AssetLookup(benchmark::State& state)
+    {
+        const AssetPacks& packs = getPacks();
+        utils::AssetArchive archive;
+        if (!packs.valid || !archive.open(packs.storedPack))
+        {
+            state.SkipWithError("could not pack data/");
+            return;
+        }
+
+        size_t next = 0;
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(archive.find(packs.paths[next]));
+            next = next + 1 == packs.paths.size() ? 0 : next + 1;
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_AssetLookup);
+
+    // decompressing every compressed entry, on the calling thread or spread over the job system
+    void BM_AssetDecompress(benchmark::State& state)
+    {
+        const AssetPacks& packs = getPacks();
+        utils::AssetArchive archive;
+        if (!packs.valid || !archive.open(packs.deflatePack))
+        {
+            state.SkipWithError("could not pack data/");
+            return;
+        }
+
+        std::vector<uint32_t> entries;
+        uint64_t bytes = 0;
+        for (uint32_t i = 0; i < archive.getEntryCount(); ++i)
+        {
+            if (archive.getEntry(i).codec != utils::ASSET_CODEC_NONE)
+            {
+                entries.push_back(i);
+                bytes += archive.getEntry(i).size;
+            }
+        }
+
+        const bool async = state.range(0) != 0;
+        std::vector<utils::AssetData> outputs(entries.size());
+        for (auto _ : state)
+        {
+            if (async)
+            {
+                utils::JobCounter counter;
+                archive.readAsync(entries.data(), uint32_t(entries.size()), outputs.data(), counter);
+                utils::JobSystem::global().wait(counter);
+            }
+            else
+            {
+                for (size_t i = 0; i < entries.size(); ++i)
+                {
+                    archive.read(entries[i], outputs[i]);
+                }
+            }
+            benchmark::DoNotOptimize(outputs.data());
+        }
+        state.SetBytesProcessed(state.iterations() * int64_t(bytes));
+        state.counters["entries"] = double(entries.size());
+    }
+    BENCHMARK(BM_AssetDecompress)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,161 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchContext.h"
+#include "DebugDraw.h"
+#include "SpriteBatch.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr uint32_t kSpriteTextureCount = 16;
+
+    // range(0) sprites over 16 textures and two blend modes, range(1) writes vertices on the global pool
+    void BM_SpriteBatch(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const uint32_t count = uint32_t(state.range(0));
+        utils::SpriteBatch batch;
+        if (!batch.init(bench::loadProgram("sprites/sprite.vert", "sprites/sprite.frag"), count))
+        {
+            state.SkipWithError("could not initialize the sprite batch");
+            return;
+        }
+        utils::ThreadPool* pool = state.range(1) != 0 ? &utils::ThreadPool::global() : nullptr;
+
+        GLuint textures[kSpriteTextureCount] = {};
+        glCreateTextures(GL_TEXTURE_2D, kSpriteTextureCount, textures);
+        for (uint32_t i = 0; i < kSpriteTextureCount; ++i)
+        {
+            const uint32_t texel = 0xff000000u | (i * 0x102030u);
+            glTextureStorage2D(textures[i], 1, GL_RGBA8, 1, 1);
+            glTextureSubImage2D(textures[i], 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &texel);
+        }
+
+        std::vector<utils::Sprite> sprites(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t hash = i * 2654435761u;
+            sprites[i].position = glm::vec2(float(hash % bench::kTargetSize), float((hash >> 12) % bench::kTargetSize));
+            sprites[i].size = glm::vec2(4.0f);
+            sprites[i].rotation = float(i) * 0.01f;
+            sprites[i].texture = textures[(hash >> 8) % kSpriteTextureCount];
+            sprites[i].blend = (hash >> 24) % 4 == 0 ? utils::SPRITE_BLEND_ADDITIVE : utils::SPRITE_BLEND_ALPHA;
+        }
+
+        const glm::mat4 projection = glm::ortho(0.0f, float(bench::kTargetSize), 0.0f, float(bench::kTargetSize));
+        double buildTime = 0.0;
+        for (auto _ : state)
+        {
+            batch.begin(projection);
+            for (const utils::Sprite& sprite : sprites)
+            {
+                batch.draw(sprite);
+            }
+            batch.end(pool);
+            glFinish();
+            buildTime += batch.getStats().buildTime;
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["buildMs"] = buildTime / double(state.iterations());
+        state.counters["drawCalls"] = double(batch.getStats().drawCalls);
+
+        batch.destroy();
+        glDeleteTextures(kSpriteTextureCount, textures);
+    }
+    BENCHMARK(BM_SpriteBatch)->ArgsProduct({ { 10000, 100000 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    const glm::mat4 kViewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f)
+        * glm::lookAt(glm::vec3(0.0f, 5.0f, 20.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // only recording is timed, range(0) lines per frame
+    void BM_DebugDrawLines(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const uint32_t count = uint32_t(state.range(0));
+        utils::DebugDraw debugDraw;
+        if (!debugDraw.init(bench::loadProgram("debug/debug.vert", "debug/debug.frag"), count))
+        {
+            state.SkipWithError("could not initialize debug draw");
+            return;
+        }
+
+        const glm::vec4 color(0.0f, 1.0f, 0.0f, 1.0f);
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const glm::vec3 from(float(i % 100) * 0.1f - 5.0f, float(i / 100 % 100) * 0.1f, -float(i / 10000));
+                debugDraw.line(from, from + glm::vec3(0.05f, 0.0f, 0.0f), color, (i & 1) != 0);
+            }
+
+            state.PauseTiming();
+            debugDraw.render(kViewProjection);
+            glFinish();
+            state.ResumeTiming();
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["droppedLines"] = double(debugDraw.getStats().droppedLines);
+        debugDraw.destroy();
+    }
+    BENCHMARK(BM_DebugDrawLines)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+    // 10k shapes recorded and rendered, range(0) is 0 for box() and 1 for sphere()
+    void BM_DebugDrawShapes(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const uint32_t count = 10000;
+        const bool spheres = state.range(0) != 0;
+        state.SetLabel(spheres ? "sphere" : "box");
+
+        utils::DebugDraw debugDraw;
+        if (!debugDraw.init(bench::loadProgram("debug/debug.vert", "debug/debug.frag"), 1u << 20))
+        {
+            state.SkipWithError("could not initialize debug draw");
+            return;
+        }
+
+        const glm::vec4 color(1.0f, 0.5f, 0.0f, 1.0f);
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const glm::vec3 center(float(i % 100) * 0.1f - 5.0f, float(i / 100) * 0.1f, 0.0f);
+                if (spheres)
+                {
+                    debugDraw.sphere(center, 0.04f, color);
+                }
+                else
+                {
+                    debugDraw.box(glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(0.04f)), color);
+                }
+            }
+            debugDraw.render(kViewProjection);
+            glFinish();
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["lines"] = double(debugDraw.getStats().lines);
+        state.counters["droppedLines"] = double(debugDraw.getStats().droppedLines);
+        debugDraw.destroy();
+    }
+    BENCHMARK(BM_DebugDrawShapes)->DenseRange(0, 1)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,176 @@
+#include "BenchContext.h"
+
+#include <iostream>
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if BENCH_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace bench
+{
+    namespace
+    {
+        GLFWwindow* gWindow = nullptr;
+        bool gHasContext = false;
+        GLuint gFramebuffer = 0;
+        GLuint gRenderbuffers[2] = {};
+
+#if BENCH_HAVE_EGL
+        EGLDisplay gDisplay = EGL_NO_DISPLAY;
+        EGLContext gContext = EGL_NO_CONTEXT;
+#endif
+
+        bool createWindowContext()
+        {
+            if (!glfwInit())
+            {
+                return false;
+            }
+
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+            gWindow = glfwCreateWindow(int(kTargetSize), int(kTargetSize), "base_bench", nullptr, nullptr);
+            if (gWindow == nullptr)
+            {
+                glfwTerminate();
+                return false;
+            }
+
+            glfwMakeContextCurrent(gWindow);
+            return gladLoadGLLoader((GLADloadproc)glfwGetProcAddress) != 0;
+        }
+
+#if BENCH_HAVE_EGL
+        bool createSurfacelessContext()
+        {
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            gDisplay = getPlatformDisplay != nullptr ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (gDisplay == EGL_NO_DISPLAY || !eglInitialize(gDisplay, nullptr, nullptr) || !eglBindAPI(EGL_OPENGL_API))
+            {
+                return false;
+            }
+
+            const EGLint attributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION, 4,
+                EGL_CONTEXT_MINOR_VERSION, 5,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE,
+            };
+            gContext = eglCreateContext(gDisplay, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+            if (gContext == EGL_NO_CONTEXT || !eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, gContext))
+            {
+                return false;
+            }
+            return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+        }
+#endif
+    }
+
+    bool createContext()
+    {
+        gHasContext = createWindowContext();
+#if BENCH_HAVE_EGL
+        if (!gHasContext)
+        {
+            gHasContext = createSurfacelessContext();
+        }
+#endif
+        if (!gHasContext)
+        {
+            return false;
+        }
+
+        std::cout << "GL " << glGetString(GL_VERSION) << ", " << glGetString(GL_RENDERER) << std::endl;
+
+        // surfaceless contexts have no default framebuffer
+        glCreateRenderbuffers(2, gRenderbuffers);
+        glNamedRenderbufferStorage(gRenderbuffers[0], GL_RGBA8, kTargetSize, kTargetSize);
+        glNamedRenderbufferStorage(gRenderbuffers[1], GL_DEPTH_COMPONENT24, kTargetSize, kTargetSize);
+        glCreateFramebuffers(1, &gFramebuffer);
+        glNamedFramebufferRenderbuffer(gFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, gRenderbuffers[0]);
+        glNamedFramebufferRenderbuffer(gFramebuffer, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, gRenderbuffers[1]);
+        glBindFramebuffer(GL_FRAMEBUFFER, gFramebuffer);
+        glViewport(0, 0, kTargetSize, kTargetSize);
+        return true;
+    }
+
+    void destroyContext()
+    {
+        if (gHasContext)
+        {
+            glDeleteFramebuffers(1, &gFramebuffer);
+            glDeleteRenderbuffers(2, gRenderbuffers);
+            gHasContext = false;
+        }
+
+        if (gWindow != nullptr)
+        {
+            glfwDestroyWindow(gWindow);
+            glfwTerminate();
+            gWindow = nullptr;
+        }
+
+#if BENCH_HAVE_EGL
+        if (gDisplay != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(gDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (gContext != EGL_NO_CONTEXT)
+            {
+                eglDestroyContext(gDisplay, gContext);
+            }
+            eglTerminate(gDisplay);
+            gDisplay = EGL_NO_DISPLAY;
+            gContext = EGL_NO_CONTEXT;
+        }
+#endif
+    }
+
+    bool hasContext()
+    {
+        return gHasContext;
+    }
+
+    GLADloadproc getLoader()
+    {
+#if BENCH_HAVE_EGL
+        if (gContext != EGL_NO_CONTEXT)
+        {
+            return (GLADloadproc)eglGetProcAddress;
+        }
+#endif
+        return (GLADloadproc)glfwGetProcAddress;
+    }
+
+    bool requireContext(benchmark::State& state)
+    {
+        if (!gHasContext)
+        {
+            state.SkipWithError("no GL context");
+            return false;
+        }
+        return true;
+    }
+
+    std::string getDataPath()
+    {
+#if defined(ROOT_DATA_DIR)
+        return ROOT_DATA_DIR;
+#else
+        return "./../data/";
+#endif
+    }
+
+    std::shared_ptr<utils::OpenglProgram> loadProgram(const std::string& vertexShader, const std::string& fragmentShader)
+    {
+        auto vertex = utils::OpenglShader::create(getDataPath() + "shaders/" + vertexShader, GL_VERTEX_SHADER);
+        auto fragment = utils::OpenglShader::create(getDataPath() + "shaders/" + fragmentShader, GL_FRAGMENT_SHADER);
+        return utils::OpenglProgram::create(vertex, fragment);
+    }
+}
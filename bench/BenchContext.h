@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include "OpenGLUtils.h"
+
+namespace bench
+{
+    // GL benchmarks render into a framebuffer of this size, bound by createContext
+    constexpr uint32_t kTargetSize = 256;
+
+    // a hidden glfw window, or a surfaceless EGL context when there is no display
+    bool createContext();
+    void destroyContext();
+    bool hasContext();
+
+    // glfwGetProcAddress or eglGetProcAddress, for extension entry points glad doesn't load
+    GLADloadproc getLoader();
+
+    // skips the benchmark when there is no context, call before touching GL
+    bool requireContext(benchmark::State& state);
+
+    // data/ in the source tree
+    std::string getDataPath();
+
+    // paths relative to data/shaders/, nullptr when either stage fails to compile
+    std::shared_ptr<utils::OpenglProgram> loadProgram(const std::string& vertexShader, const std::string& fragmentShader);
+}
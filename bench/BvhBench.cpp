@@ -0,0 +1,234 @@
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    constexpr uint32_t kImageSize = 256;
+
+    struct BvhScene
+    {
+        std::shared_ptr<utils::Mesh> mesh;
+        utils::MeshBvh bvh;
+    };
+
+    // a rough sphere of 6 * resolution^2 * 2 triangles, built once per resolution
+    const BvhScene& getScene(uint32_t resolution)
+    {
+        static std::map<uint32_t, BvhScene> scenes;
+        BvhScene& scene = scenes[resolution];
+        if (scene.mesh == nullptr)
+        {
+            scene.mesh = utils::Mesh::createSphere(resolution, 0.05f);
+            scene.bvh.build(*scene.mesh, &utils::ThreadPool::global());
+        }
+        return scene;
+    }
+
+    // kImageSize^2 rays through the pixels of a camera looking at the origin from distance
+    std::vector<utils::Ray> createPrimaryRays(float distance)
+    {
+        const glm::mat4 inverse = glm::inverse(glm::perspective(glm::radians(60.0f), 1.0f, 0.1f, 100.0f)
+            * glm::lookAt(glm::vec3(0.3f, 0.4f, 1.0f) * distance, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        std::vector<utils::Ray> rays(kImageSize * kImageSize);
+        for (uint32_t y = 0; y < kImageSize; ++y)
+        {
+            for (uint32_t x = 0; x < kImageSize; ++x)
+            {
+                const glm::vec2 ndc = glm::vec2((float(x) + 0.5f) / kImageSize, (float(y) + 0.5f) / kImageSize) * 2.0f - 1.0f;
+                const glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+                const glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+                utils::Ray& ray = rays[y * kImageSize + x];
+                ray.origin = glm::vec3(nearPoint) / nearPoint.w;
+                ray.direction = glm::vec3(farPoint) / farPoint.w - ray.origin;
+            }
+        }
+        return rays;
+    }
+
+    // rays between random points around the mesh, like ambient occlusion or bounce rays
+    std::vector<utils::Ray> createRandomRays(float extent)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> uniform(-extent, extent);
+        std::vector<utils::Ray> rays(kImageSize * kImageSize);
+        for (utils::Ray& ray : rays)
+        {
+            ray.origin = glm::vec3(uniform(random), uniform(random), uniform(random));
+            ray.direction = glm::vec3(uniform(random), uniform(random), uniform(random)) - ray.origin;
+        }
+        return rays;
+    }
+
+    // range(0) sphere resolution, range(1) builds on the global pool
+    void BM_BvhBuild(benchmark::State& state)
+    {
+        auto mesh = utils::Mesh::createSphere(uint32_t(state.range(0)), 0.05f);
+        utils::ThreadPool* pool = state.range(1) != 0 ? &utils::ThreadPool::global() : nullptr;
+        utils::MeshBvh bvh;
+        for (auto _ : state)
+        {
+            bvh.build(*mesh, pool);
+            benchmark::DoNotOptimize(bvh.getBvh().getNodes().data());
+        }
+
+        const utils::BvhBuildStats& stats = bvh.getBvh().getStats();
+        state.SetItemsProcessed(state.iterations() * int64_t(bvh.getTriangleCount()));
+        state.counters["nodes"] = double(stats.nodes);
+        state.counters["triangles_per_leaf"] = double(bvh.getTriangleCount()) / double(stats.leaves);
+        state.counters["depth"] = double(stats.maxDepth);
+    }
+    BENCHMARK(BM_BvhBuild)->ArgsProduct({ { 200, 600 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->Iterations(2)->UseRealTime();
+
+    // closest hits per second, range(0) sphere resolution, range(1) 0 primary rays and 1 random rays
+    void BM_BvhRays(benchmark::State& state)
+    {
+        const BvhScene& scene = getScene(uint32_t(state.range(0)));
+        const std::vector<utils::Ray> rays = state.range(1) == 0 ? createPrimaryRays(2.5f) : createRandomRays(1.5f);
+
+        uint64_t hits = 0;
+        for (auto _ : state)
+        {
+            for (const utils::Ray& ray : rays)
+            {
+                utils::RayHit hit;
+                hits += scene.bvh.intersect(ray, hit) ? 1 : 0;
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * int64_t(rays.size()));
+        state.counters["hit_pct"] = 100.0 * double(hits) / double(state.iterations() * rays.size());
+    }
+    BENCHMARK(BM_BvhRays)->ArgsProduct({ { 200, 600 }, { 0, 1 } })->Unit(benchmark::kMillisecond);
+
+    // range(0) instances of one 480k triangle mesh scattered through a cube, rays from a camera outside
+    struct InstanceScene
+    {
+        std::vector<utils::BvhInstance> instances;
+        std::vector<glm::vec3> velocities;
+
+        explicit InstanceScene(const utils::MeshBvh& mesh, uint32_t count)
+        {
+            std::mt19937 random(3);
+            std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+            const float extent = 2.0f * std::cbrt(float(count));
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const glm::vec3 position = glm::vec3(uniform(random), uniform(random), uniform(random)) * extent;
+                const glm::vec3 axis = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + glm::vec3(0.0f, 0.0f, 2.0f));
+                utils::BvhInstance instance;
+                instance.mesh = &mesh;
+                instance.transform = glm::rotate(glm::translate(glm::mat4(1.0f), position), uniform(random) * 3.0f, axis)
+                    * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f + 0.4f * uniform(random)));
+                instances.push_back(instance);
+                velocities.push_back(glm::vec3(uniform(random), uniform(random), uniform(random)) * 0.05f);
+            }
+        }
+
+        void move()
+        {
+            for (size_t i = 0; i < instances.size(); ++i)
+            {
+                instances[i].transform = glm::translate(glm::mat4(1.0f), velocities[i]) * instances[i].transform;
+            }
+        }
+
+        float getExtent() const { return 2.0f * std::cbrt(float(instances.size())); }
+    };
+
+    void BM_BvhSceneRays(benchmark::State& state)
+    {
+        const BvhScene& scene = getScene(200);
+        const InstanceScene instances(scene.bvh, uint32_t(state.range(0)));
+        utils::SceneBvh bvh;
+        bvh.build(instances.instances.data(), uint32_t(instances.instances.size()), &utils::ThreadPool::global());
+
+        const std::vector<utils::Ray> rays = createPrimaryRays(instances.getExtent() * 2.5f);
+        uint64_t hits = 0;
+        for (auto _ : state)
+        {
+            for (const utils::Ray& ray : rays)
+            {
+                utils::RayHit hit;
+                hits += bvh.intersect(ray, hit) ? 1 : 0;
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * int64_t(rays.size()));
+        state.counters["hit_pct"] = 100.0 * double(hits) / double(state.iterations() * rays.size());
+        state.counters["triangles"] = double(instances.instances.size()) * scene.bvh.getTriangleCount();
+    }
+    BENCHMARK(BM_BvhSceneRays)->Arg(100)->Arg(10000)->Unit(benchmark::kMillisecond);
+
+    // moving every instance and updating the top level, range(1) 0 rebuilds and 1 refits
+    void BM_BvhSceneUpdate(benchmark::State& state)
+    {
+        const BvhScene& scene = getScene(200);
+        InstanceScene instances(scene.bvh, uint32_t(state.range(0)));
+        const bool refit = state.range(1) != 0;
+        utils::SceneBvh bvh;
+        bvh.build(instances.instances.data(), uint32_t(instances.instances.size()));
+        for (auto _ : state)
+        {
+            instances.move();
+            if (refit)
+            {
+                bvh.refit(instances.instances.data());
+            }
+            else
+            {
+                bvh.build(instances.instances.data(), uint32_t(instances.instances.size()));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_BvhSceneUpdate)->ArgsProduct({ { 10000 }, { 0, 1 } })->Unit(benchmark::kMicrosecond);
+
+    // range(0) 0 box and 1 sphere queries of about a hundred triangles each
+    void BM_BvhQuery(benchmark::State& state)
+    {
+        const BvhScene& scene = getScene(600);
+        std::mt19937 random(5);
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        std::vector<glm::vec3> centers(1024);
+        for (glm::vec3& center : centers)
+        {
+            center = glm::normalize(glm::vec3(normal(random), normal(random), normal(random)));
+        }
+
+        const float radius = 0.01f;
+        std::vector<uint32_t> triangles;
+        uint64_t found = 0;
+        for (auto _ : state)
+        {
+            for (const glm::vec3& center : centers)
+            {
+                triangles.clear();
+                if (state.range(0) == 0)
+                {
+                    scene.bvh.queryAabb(utils::Aabb{ center - radius, center + radius }, triangles);
+                }
+                else
+                {
+                    scene.bvh.querySphere(center, radius, triangles);
+                }
+                found += triangles.size();
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * int64_t(centers.size()));
+        state.counters["triangles"] = double(found) / double(state.iterations() * centers.size());
+    }
+    BENCHMARK(BM_BvhQuery)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+}
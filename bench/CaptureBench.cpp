@@ -0,0 +1,69 @@
+#include <filesystem>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "FrameCapture.h"
+
+namespace
+{
+    constexpr uint32_t kCaptureWidth = 1920;
+    constexpr uint32_t kCaptureHeight = 1080;
+
+    // render thread cost of FrameCapture::capture() for a 1080p frame, discarding the frames (0) or writing Y4M (2).
+    // the manual time is capture() alone, the clear and flush stand in for the frame and its swap
+    void BM_FrameCapture(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        GLuint texture = 0;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        glTextureStorage2D(texture, 1, GL_RGBA8, kCaptureWidth, kCaptureHeight);
+        GLuint framebuffer = 0;
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, texture, 0);
+
+        const std::string outputPath = (std::filesystem::temp_directory_path() / "base_bench_capture.y4m").string();
+
+        utils::FrameCaptureSettings settings;
+        settings.format = utils::CaptureFormat(state.range(0));
+        settings.outputPath = outputPath;
+
+        utils::FrameCapture capture;
+        if (!capture.start(kCaptureWidth, kCaptureHeight, settings))
+        {
+            state.SkipWithError("could not start the capture");
+        }
+        else
+        {
+            uint32_t frame = 0;
+            for (auto _ : state)
+            {
+                const float shade = float(frame++ % 256) / 255.0f;
+                const float color[4] = { shade, 0.5f, 1.0f - shade, 1.0f };
+                glClearNamedFramebufferfv(framebuffer, GL_COLOR, 0, color);
+                capture.capture(framebuffer);
+                glFlush();
+                state.SetIterationTime(capture.getStats().lastCaptureTime / 1000.0);
+            }
+
+            capture.stop();
+            const auto stats = capture.getStats();
+            state.counters["mean_ms"] = stats.meanCaptureTime;
+            state.counters["max_ms"] = stats.maxCaptureTime;
+            state.counters["dropped"] = double(stats.framesDropped);
+            state.counters["written"] = double(stats.framesWritten);
+            state.SetBytesProcessed(int64_t(stats.framesIssued) * kCaptureWidth * kCaptureHeight * 4);
+        }
+
+        std::error_code error;
+        std::filesystem::remove(outputPath, error);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &texture);
+    }
+    BENCHMARK(BM_FrameCapture)->Arg(int(utils::CaptureFormat::CAPTURE_NONE))->Arg(int(utils::CaptureFormat::CAPTURE_Y4M))
+        ->Unit(benchmark::kMillisecond)->UseManualTime();
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchContext.h"
+#include "ClusteredLighting.h"
+#include "OcclusionRasterizer.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    using utils::SimdLevel;
+
+    constexpr uint32_t kOccluderWidth = 256;
+    constexpr uint32_t kOccluderHeight = 128;
+
+    const glm::mat4 kOcclusionViewProjection = glm::perspective(glm::radians(60.0f), 2.0f, 0.5f, 500.0f)
+        * glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.0f, 2.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // 300 randomly sized boxes in front of the camera, 36 triangles each
+    struct OccluderScene
+    {
+        std::vector<float> positions;
+        std::vector<uint32_t> indices;
+        std::vector<glm::mat4> models;
+
+        OccluderScene()
+        {
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                positions.insert(positions.end(), { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f });
+            }
+            indices = { 0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5 };
+
+            std::mt19937 random(3);
+            std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+            for (uint32_t i = 0; i < 300; ++i)
+            {
+                const glm::vec3 center(uniform(random) * 80.0f - 40.0f, uniform(random) * 3.0f, -5.0f - uniform(random) * 60.0f);
+                const glm::vec3 scale(0.5f + uniform(random) * 3.0f, 0.5f + uniform(random) * 3.0f, 0.5f + uniform(random) * 3.0f);
+                models.push_back(glm::scale(glm::translate(glm::mat4(1.0f), center), scale));
+            }
+        }
+
+        void draw(utils::OcclusionRasterizer& rasterizer) const
+        {
+            for (const glm::mat4& model : models)
+            {
+                rasterizer.addOccluder(positions.data(), 8, 3, indices.data(), uint32_t(indices.size()), model);
+            }
+        }
+    };
+
+    const OccluderScene& getOccluderScene()
+    {
+        static const OccluderScene scene;
+        return scene;
+    }
+
+    // pixel center coverage and interpolated depth in double precision, without any binning or blocking
+    std::vector<double> rasterizeReference(const OccluderScene& scene, uint32_t width, uint32_t height)
+    {
+        std::vector<double> depth(size_t(width) * height, 1.0);
+        for (const glm::mat4& model : scene.models)
+        {
+            const glm::dmat4 mvp = glm::dmat4(kOcclusionViewProjection) * glm::dmat4(model);
+            for (size_t t = 0; t < scene.indices.size(); t += 3)
+            {
+                glm::dvec3 v[3];
+                bool clipped = false;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    const float* p = &scene.positions[scene.indices[t + k] * 3];
+                    const glm::dvec4 clip = mvp * glm::dvec4(p[0], p[1], p[2], 1.0);
+                    clipped |= clip.z < -clip.w;
+                    const glm::dvec3 ndc = glm::dvec3(clip) / clip.w;
+                    v[k] = glm::dvec3((ndc.x * 0.5 + 0.5) * width, (ndc.y * 0.5 + 0.5) * height, ndc.z * 0.5 + 0.5);
+                }
+
+                const double area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+                if (clipped || area <= 0.0)
+                {
+                    continue;
+                }
+
+                const int32_t x0 = std::max(int32_t(std::floor(std::min({ v[0].x, v[1].x, v[2].x }))), 0);
+                const int32_t x1 = std::min(int32_t(std::ceil(std::max({ v[0].x, v[1].x, v[2].x }))), int32_t(width));
+                const int32_t y0 = std::max(int32_t(std::floor(std::min({ v[0].y, v[1].y, v[2].y }))), 0);
+                const int32_t y1 = std::min(int32_t(std::ceil(std::max({ v[0].y, v[1].y, v[2].y }))), int32_t(height));
+                for (int32_t y = y0; y < y1; ++y)
+                {
+                    for (int32_t x = x0; x < x1; ++x)
+                    {
+                        const double px = x + 0.5;
+                        const double py = y + 0.5;
+                        const double e0 = (v[1].x - v[0].x) * (py - v[0].y) - (v[1].y - v[0].y) * (px - v[0].x);
+                        const double e1 = (v[2].x - v[1].x) * (py - v[1].y) - (v[2].y - v[1].y) * (px - v[1].x);
+                        const double e2 = (v[0].x - v[2].x) * (py - v[2].y) - (v[0].y - v[2].y) * (px - v[2].x);
+                        if (e0 >= 0.0 && e1 >= 0.0 && e2 >= 0.0)
+                        {
+                            double& pixel = depth[size_t(y) * width + x];
+                            pixel = std::min(pixel, (v[0].z * e1 + v[1].z * e2 + v[2].z * e0) / area);
+                        }
+                    }
+                }
+            }
+        }
+        return depth;
+    }
+
+    // the same test as isVisible against the reference buffer, any pixel at or behind the nearest depth is visible
+    bool isVisibleReference(const std::vector<double>& depth, uint32_t width, uint32_t height, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+    {
+        glm::dvec2 screenMin(1e9);
+        glm::dvec2 screenMax(-1e9);
+        double nearest = 1.0;
+        for (uint32_t k = 0; k < 8; ++k)
+        {
+            const glm::dvec3 corner((k & 1) ? boundsMax.x : boundsMin.x, (k & 2) ? boundsMax.y : boundsMin.y, (k & 4) ? boundsMax.z : boundsMin.z);
+            const glm::dvec4 clip = glm::dmat4(kOcclusionViewProjection) * glm::dvec4(corner, 1.0);
+            if (clip.z < -clip.w)
+            {
+                return true;
+            }
+            const glm::dvec3 ndc = glm::dvec3(clip) / clip.w;
+            const glm::dvec2 screen((ndc.x * 0.5 + 0.5) * width, (ndc.y * 0.5 + 0.5) * height);
+            screenMin = glm::min(screenMin, screen);
+            screenMax = glm::max(screenMax, screen);
+            nearest = std::min(nearest, ndc.z * 0.5 + 0.5);
+        }
+
+        const int32_t x0 = std::max(int32_t(std::floor(screenMin.x)), 0);
+        const int32_t x1 = std::min(int32_t(std::ceil(screenMax.x)), int32_t(width));
+        const int32_t y0 = std::max(int32_t(std::floor(screenMin.y)), 0);
+        const int32_t y1 = std::min(int32_t(std::ceil(screenMax.y)), int32_t(height));
+        for (int32_t y = y0; y < y1; ++y)
+        {
+            for (int32_t x = x0; x < x1; ++x)
+            {
+                if (depth[size_t(y) * width + x] >= nearest)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // range(0) SIMD level, range(1) rasterizes the tiles on the global pool; the scene is added ten times
+    void BM_OcclusionRasterize(benchmark::State& state)
+    {
+        const SimdLevel level = SimdLevel(state.range(0));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+        utils::ThreadPool* pool = state.range(1) != 0 ? &utils::ThreadPool::global() : nullptr;
+
+        utils::OcclusionRasterizer rasterizer;
+        rasterizer.init(kOccluderWidth, kOccluderHeight);
+        rasterizer.setSimdLevel(level);
+
+        const OccluderScene& scene = getOccluderScene();
+        double transformTime = 0.0;
+        double rasterTime = 0.0;
+        for (auto _ : state)
+        {
+            rasterizer.beginFrame(kOcclusionViewProjection);
+            for (uint32_t i = 0; i < 10; ++i)
+            {
+                scene.draw(rasterizer);
+            }
+            rasterizer.rasterize(pool);
+            transformTime += rasterizer.getStats().transformTime;
+            rasterTime += rasterizer.getStats().rasterTime;
+        }
+
+        const utils::OcclusionRasterizerStats stats = rasterizer.getStats();
+        state.SetItemsProcessed(state.iterations() * stats.triangles);
+        state.counters["transformMs"] = transformTime / double(state.iterations());
+        state.counters["rasterMs"] = rasterTime / double(state.iterations());
+        state.counters["rasterized"] = double(stats.trianglesRasterized);
+    }
+    BENCHMARK(BM_OcclusionRasterize)
+        ->ArgsProduct({ { int64_t(SimdLevel::SIMD_SCALAR), int64_t(SimdLevel::SIMD_AVX2) }, { 0, 1 } })
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+
+    // isVisible throughput for 20k random boxes, the counters compare the depth buffer and every answer with
+    // the double precision reference
+    void BM_OcclusionAccuracy(benchmark::State& state)
+    {
+        const SimdLevel level = SimdLevel(state.range(0));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+
+        utils::OcclusionRasterizer rasterizer;
+        rasterizer.init(kOccluderWidth, kOccluderHeight);
+        rasterizer.setSimdLevel(level);
+        rasterizer.beginFrame(kOcclusionViewProjection);
+        getOccluderScene().draw(rasterizer);
+        rasterizer.rasterize();
+
+        const uint32_t width = rasterizer.getWidth();
+        const uint32_t height = rasterizer.getHeight();
+        const std::vector<double> reference = rasterizeReference(getOccluderScene(), width, height);
+
+        uint32_t coverageMismatches = 0;
+        double maxDepthError = 0.0;
+        for (size_t i = 0; i < reference.size(); ++i)
+        {
+            const float depth = rasterizer.getDepth()[i];
+            if ((reference[i] < 1.0) != (depth < 1.0f))
+            {
+                ++coverageMismatches;
+            }
+            else if (depth < 1.0f)
+            {
+                maxDepthError = std::max(maxDepthError, std::abs(reference[i] - double(depth)));
+            }
+        }
+
+        std::vector<glm::vec3> bounds;
+        std::vector<bool> expected;
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (uint32_t i = 0; i < 20000; ++i)
+        {
+            const glm::vec3 center(uniform(random) * 80.0f - 40.0f, uniform(random) * 3.0f, -5.0f - uniform(random) * 80.0f);
+            const glm::vec3 extent(0.2f + uniform(random));
+            bounds.push_back(center - extent);
+            bounds.push_back(center + extent);
+            expected.push_back(isVisibleReference(reference, width, height, center - extent, center + extent));
+        }
+
+        uint32_t wronglyVisible = 0;
+        uint32_t wronglyOccluded = 0;
+        for (auto _ : state)
+        {
+            wronglyVisible = 0;
+            wronglyOccluded = 0;
+            for (size_t i = 0; i < expected.size(); ++i)
+            {
+                const bool visible = rasterizer.isVisible(bounds[i * 2], bounds[i * 2 + 1]);
+                wronglyVisible += visible && !expected[i];
+                wronglyOccluded += !visible && expected[i];
+            }
+        }
+
+        state.SetItemsProcessed(state.iterations() * int64_t(expected.size()));
+        state.counters["coverageMismatches"] = double(coverageMismatches);
+        state.counters["maxDepthError"] = maxDepthError;
+        state.counters["wronglyVisible"] = double(wronglyVisible);
+        state.counters["wronglyOccluded"] = double(wronglyOccluded);
+    }
+    BENCHMARK(BM_OcclusionAccuracy)
+        ->Arg(int64_t(SimdLevel::SIMD_SCALAR))
+        ->Arg(int64_t(SimdLevel::SIMD_AVX2))
+        ->Unit(benchmark::kMicrosecond);
+
+    // range(0) lights, range(1) SIMD level, range(2) assigns on the global pool
+    void BM_ClusteredLightAssign(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const SimdLevel level = SimdLevel(state.range(1));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+        utils::ThreadPool* pool = state.range(2) != 0 ? &utils::ThreadPool::global() : nullptr;
+
+        utils::ClusteredLighting lighting;
+        if (!lighting.init())
+        {
+            state.SkipWithError("could not initialize clustered lighting");
+            return;
+        }
+        lighting.setSimdLevel(level);
+
+        const uint32_t count = uint32_t(state.range(0));
+        std::vector<utils::Light> lights(count);
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        for (utils::Light& light : lights)
+        {
+            light.position = glm::vec3(uniform(random) * 200.0f - 100.0f, uniform(random) * 10.0f, uniform(random) * 200.0f - 100.0f);
+            light.range = 3.0f + uniform(random) * 10.0f;
+            light.type = uniform(random) < 0.25f ? utils::LIGHT_SPOT : utils::LIGHT_POINT;
+        }
+
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+        double assignTime = 0.0;
+        for (auto _ : state)
+        {
+            lighting.update(view, projection, lights.data(), count, pool);
+            assignTime += lighting.getStats().assignTime;
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["assignMs"] = assignTime / double(state.iterations());
+        state.counters["maxLightsPerCluster"] = double(lighting.getStats().maxLightsPerCluster);
+        state.counters["droppedIndices"] = double(lighting.getStats().droppedIndices);
+    }
+    BENCHMARK(BM_ClusteredLightAssign)
+        ->ArgsProduct({ { 1000, 10000 }, { int64_t(SimdLevel::SIMD_SCALAR), int64_t(SimdLevel::SIMD_AVX2) }, { 0, 1 } })
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+}
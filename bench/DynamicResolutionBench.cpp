@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "DynamicResolution.h"
+
+namespace
+{
+    constexpr uint32_t kFrames = 600;
+    constexpr uint32_t kTimingLatency = 3;
+    constexpr double kFrameBudget = 1000.0 / 60.0;
+
+    // synthetic GPU: a fixed cost plus a cost per pixel that is 1.8x higher during two load spikes,
+    // 17.5 ms at full resolution outside of them
+    double gpuTime(uint32_t frame, float scale, std::mt19937& random)
+    {
+        const bool spike = (frame >= 200 && frame < 300) || (frame >= 420 && frame < 440);
+        const double noise = std::normal_distribution<double>(1.0, 0.03)(random);
+        return 1.5 + 16.0 * double(scale) * scale * (spike ? 1.8 : 1.0) * noise;
+    }
+
+    // frame time stability of kFrames simulated frames at full resolution (0) or with the controller (1),
+    // timings reach the controller kTimingLatency frames late like the queries of a real frame
+    void BM_DynamicResolution(benchmark::State& state)
+    {
+        const bool dynamic = state.range(0) != 0;
+
+        utils::DynamicResolutionSettings settings;
+        settings.targetGpuTime = 14.0;
+
+        std::vector<double> times(kFrames);
+        std::vector<float> scales(kFrames);
+        for (auto _ : state)
+        {
+            utils::DynamicResolutionController controller(settings);
+            std::mt19937 random(3);
+            for (uint32_t frame = 0; frame < kFrames; ++frame)
+            {
+                scales[frame] = dynamic ? controller.getScale() : 1.0f;
+                times[frame] = gpuTime(frame, scales[frame], random);
+                if (dynamic && frame >= kTimingLatency)
+                {
+                    const uint32_t measured = frame - kTimingLatency;
+                    controller.update(times[measured], scales[measured]);
+                }
+            }
+            benchmark::DoNotOptimize(times.data());
+        }
+
+        double sum = 0.0;
+        double squares = 0.0;
+        double scaleSum = 0.0;
+        uint32_t missed = 0;
+        for (uint32_t frame = 0; frame < kFrames; ++frame)
+        {
+            sum += times[frame];
+            squares += times[frame] * times[frame];
+            scaleSum += scales[frame];
+            missed += times[frame] > kFrameBudget ? 1 : 0;
+        }
+        const double mean = sum / kFrames;
+        state.counters["gpu_ms"] = mean;
+        state.counters["stddev_ms"] = std::sqrt(std::max(squares / kFrames - mean * mean, 0.0));
+        state.counters["missed"] = double(missed);
+        state.counters["scale"] = scaleSum / kFrames;
+        state.SetItemsProcessed(state.iterations() * kFrames);
+    }
+    BENCHMARK(BM_DynamicResolution)->Arg(0)->Arg(1);
+
+    // what the internal target costs per frame: clearing the scene at a pinned scale and the sharpening upscale
+    // to kTargetSize, the fixed price dynamic resolution has to earn back
+    void BM_DynamicResolutionUpscale(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        auto program = bench::loadProgram("upscale/upscale.vert", "upscale/upscale.frag");
+        // no frame meets the target, the scale drops to minScale as soon as the first timing is in
+        utils::DynamicResolutionSettings settings;
+        settings.minScale = float(state.range(0)) / 100.0f;
+        settings.targetGpuTime = 1e-6;
+
+        GLint framebuffer = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &framebuffer);
+
+        utils::DynamicResolution resolution;
+        if (program == nullptr || !resolution.init(program, settings))
+        {
+            state.SkipWithError("could not load the upscale shaders");
+            return;
+        }
+
+        // the frames at full scale leave green outside of the rendered corner, the upscale must never sample it
+        for (uint32_t frame = 0; frame < utils::DynamicResolution::kQueryLatency * 2; ++frame)
+        {
+            resolution.beginFrame(bench::kTargetSize, bench::kTargetSize);
+            glClearColor(0.0f, 1.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            resolution.endFrame(GLuint(framebuffer));
+            glFinish();
+        }
+
+        for (auto _ : state)
+        {
+            resolution.beginFrame(bench::kTargetSize, bench::kTargetSize);
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(0, 0, GLsizei(resolution.getRenderWidth()), GLsizei(resolution.getRenderHeight()));
+            glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glDisable(GL_SCISSOR_TEST);
+            resolution.endFrame(GLuint(framebuffer));
+            glFinish();
+        }
+
+        // the scene's color has to cover the whole output, corners included
+        unsigned char pixels[2][4] = {};
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels[0]);
+        glReadPixels(bench::kTargetSize - 1, bench::kTargetSize - 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels[1]);
+        if (pixels[0][0] != 255 || pixels[0][1] != 0 || pixels[1][0] != 255 || pixels[1][1] != 0)
+        {
+            state.SkipWithError("the upscaled image doesn't match the scene");
+        }
+
+        state.counters["render_width"] = double(resolution.getRenderWidth());
+        resolution.destroy();
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    BENCHMARK(BM_DynamicResolutionUpscale)->Arg(50)->Arg(75)->Arg(100)->Unit(benchmark::kMicrosecond)->UseRealTime();
+}
@@ -0,0 +1,126 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+
+#include "EntityWorld.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    struct Position
+    {
+        glm::vec3 value;
+    };
+
+    struct Velocity
+    {
+        glm::vec3 value;
+    };
+
+    struct Health
+    {
+        float value;
+    };
+
+    struct Selected
+    {
+        uint32_t frame;
+    };
+
+    // every third entity also has health, so queries span two archetypes
+    void populate(utils::EntityWorld& world, uint32_t count, std::vector<utils::Entity>* entities = nullptr)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Position position = { glm::vec3(float(i), 0.0f, 0.0f) };
+            const Velocity velocity = { glm::vec3(0.0f, 1.0f, float(i % 3)) };
+            const utils::Entity entity = i % 3 == 0 ? world.create(position, velocity, Health{ 100.0f }) : world.create(position, velocity);
+            if (entities != nullptr)
+            {
+                entities->push_back(entity);
+            }
+        }
+    }
+
+    void BM_EntityForEach(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::EntityWorld world;
+        populate(world, count);
+
+        for (auto _ : state)
+        {
+            world.forEach<Position, Velocity>([](utils::Entity, Position& position, Velocity& velocity)
+            {
+                position.value += velocity.value * 0.016f;
+            });
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_EntityForEach)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+    void BM_EntityParallelForEach(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::EntityWorld world;
+        populate(world, count);
+
+        for (auto _ : state)
+        {
+            world.parallelForEach<Position, Velocity>(utils::ThreadPool::global(), [](utils::Entity, Position& position, Velocity& velocity)
+            {
+                position.value += velocity.value * 0.016f;
+            });
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_EntityParallelForEach)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMicrosecond);
+
+    // adding and removing a component moves the entity between archetypes and back
+    void BM_EntityAddRemove(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::EntityWorld world;
+        std::vector<utils::Entity> entities;
+        populate(world, 100000, &entities);
+
+        uint32_t frame = 0;
+        for (auto _ : state)
+        {
+            ++frame;
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                world.add(entities[i], Selected{ frame });
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                world.remove<Selected>(entities[i]);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * count * 2);
+    }
+    BENCHMARK(BM_EntityAddRemove)->Arg(1000)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+    // entity handle allocation, destroyed indices are reused with a new generation
+    void BM_EntityCreateDestroy(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::EntityWorld world;
+        std::vector<utils::Entity> entities;
+        entities.reserve(count);
+
+        for (auto _ : state)
+        {
+            entities.clear();
+            populate(world, count, &entities);
+            for (const utils::Entity& entity : entities)
+            {
+                world.destroy(entity);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_EntityCreateDestroy)->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,213 @@
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+
+#include "BenchContext.h"
+#include "TextureAtlas.h"
+
+namespace
+{
+    constexpr uint32_t kUniformCount = 10000;
+
+    enum UniformPath
+    {
+        UNIFORM_BY_NAME,
+        UNIFORM_CACHED_LOCATION,
+        UNIFORM_PROGRAM_UNIFORM,
+    };
+
+    // range(0) is the UniformPath, every iteration sets the matrix kUniformCount times
+    void BM_GlSetUniform(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        auto program = bench::loadProgram("cubes/cubes.vert", "cubes/cubes.frag");
+        if (program == nullptr)
+        {
+            state.SkipWithError("could not load the cubes shaders");
+            return;
+        }
+
+        const char* const labels[] = { "setMat4", "cached location", "glProgramUniform" };
+        const UniformPath path = UniformPath(state.range(0));
+        state.SetLabel(labels[path]);
+
+        const GLint location = glGetUniformLocation(program->id, "u_modelViewProjectionMatrix");
+        glm::mat4 mvp(1.0f);
+        program->use();
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < kUniformCount; ++i)
+            {
+                mvp[3][0] = float(i);
+                switch (path)
+                {
+                case UNIFORM_BY_NAME:
+                    program->setMat4("u_modelViewProjectionMatrix", mvp);
+                    break;
+                case UNIFORM_CACHED_LOCATION:
+                    glUniformMatrix4fv(location, 1, GL_FALSE, &mvp[0][0]);
+                    break;
+                default:
+                    glProgramUniformMatrix4fv(program->id, location, 1, GL_FALSE, &mvp[0][0]);
+                    break;
+                }
+            }
+        }
+        glUseProgram(0);
+        state.SetItemsProcessed(state.iterations() * kUniformCount);
+    }
+    BENCHMARK(BM_GlSetUniform)->DenseRange(UNIFORM_BY_NAME, UNIFORM_PROGRAM_UNIFORM)->Unit(benchmark::kMicrosecond);
+
+    constexpr uint32_t kDrawCount = 10000;
+    constexpr uint32_t kTextureCount = 1000;
+    constexpr uint32_t kTextureSize = 32;
+    constexpr uint32_t kGridSize = 100;
+
+    enum TexturePath
+    {
+        TEXTURE_BIND_PER_DRAW,
+        TEXTURE_ATLAS,
+        TEXTURE_BINDLESS,
+    };
+
+    void fillTexture(utils::Image& image, uint32_t index)
+    {
+        image.create(int(kTextureSize), int(kTextureSize));
+        for (uint32_t i = 0; i < kTextureSize * kTextureSize; ++i)
+        {
+            image.mData[i * 4 + 0] = uint8_t(index * 37);
+            image.mData[i * 4 + 1] = uint8_t(index * 91 + i);
+            image.mData[i * 4 + 2] = uint8_t(index >> 2);
+            image.mData[i * 4 + 3] = 255;
+        }
+    }
+
+    glm::vec4 getRect(uint32_t draw)
+    {
+        const float size = 2.0f / float(kGridSize);
+        return glm::vec4(-1.0f + float(draw % kGridSize) * size, -1.0f + float(draw / kGridSize) * size, size, size);
+    }
+
+    // 10k quads drawn with 1k unique textures in draw order, range(0) is the TexturePath:
+    // a glBindTextureUnit per draw, one TextureAtlas array with per-draw uv rects, or bindless handles by index
+    void BM_GlTextureDraws(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const char* const labels[] = { "bind per draw", "atlas", "bindless" };
+        const TexturePath path = TexturePath(state.range(0));
+        state.SetLabel(labels[path]);
+
+        if (path == TEXTURE_BINDLESS && !utils::BindlessTextureTable::load(bench::getLoader()))
+        {
+            state.SkipWithError("ARB_bindless_texture not supported");
+            return;
+        }
+
+        const char* const fragmentShaders[] = { "bench/texture.frag", "bench/atlas.frag", "bench/bindless.frag" };
+        auto program = bench::loadProgram("bench/quad.vert", fragmentShaders[path]);
+        if (program == nullptr)
+        {
+            state.SkipWithError("could not load the bench shaders");
+            return;
+        }
+
+        // separate textures back both the bind per draw and the bindless path
+        std::vector<GLuint> textures;
+        utils::TextureAtlasSettings settings;
+        settings.pageSize = 1024;
+        utils::TextureAtlas atlas;
+        std::vector<utils::TextureRegion> regions(kTextureCount);
+        utils::BindlessTextureTable table;
+
+        utils::Image image;
+        if (path == TEXTURE_ATLAS)
+        {
+            atlas.init(settings);
+            for (uint32_t i = 0; i < kTextureCount; ++i)
+            {
+                fillTexture(image, i);
+                atlas.add(image, regions[i]);
+            }
+            atlas.generateMipmaps();
+            atlas.bind(0);
+        }
+        else
+        {
+            textures.resize(kTextureCount);
+            glCreateTextures(GL_TEXTURE_2D, kTextureCount, textures.data());
+            for (uint32_t i = 0; i < kTextureCount; ++i)
+            {
+                fillTexture(image, i);
+                glTextureStorage2D(textures[i], 1, GL_RGBA8, kTextureSize, kTextureSize);
+                glTextureSubImage2D(textures[i], 0, 0, 0, kTextureSize, kTextureSize, GL_RGBA, GL_UNSIGNED_BYTE, image.mData);
+            }
+
+            if (path == TEXTURE_BINDLESS)
+            {
+                table.init(kTextureCount);
+                for (GLuint texture : textures)
+                {
+                    table.add(texture);
+                }
+                table.bind(0);
+            }
+        }
+
+        const GLint rectLocation = glGetUniformLocation(program->id, "u_rect");
+        const GLint uvRectLocation = glGetUniformLocation(program->id, "u_uvRect");
+        const GLint layerLocation = glGetUniformLocation(program->id, "u_layer");
+        const GLint textureLocation = glGetUniformLocation(program->id, "u_texture");
+
+        GLuint vao = 0;
+        glCreateVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        program->use();
+
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < kDrawCount; ++i)
+            {
+                const uint32_t texture = (i * 7) % kTextureCount;
+                glUniform4fv(rectLocation, 1, &getRect(i)[0]);
+                switch (path)
+                {
+                case TEXTURE_BIND_PER_DRAW:
+                    glBindTextureUnit(0, textures[texture]);
+                    break;
+                case TEXTURE_ATLAS:
+                    glUniform4fv(uvRectLocation, 1, &regions[texture].uvRect[0]);
+                    glUniform1f(layerLocation, float(regions[texture].layer));
+                    break;
+                default:
+                    glUniform1ui(textureLocation, texture);
+                    break;
+                }
+                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            }
+            glFinish();
+        }
+        state.SetItemsProcessed(state.iterations() * kDrawCount);
+
+        glUseProgram(0);
+        glBindVertexArray(0);
+        glBindTextureUnit(0, 0);
+        glDeleteVertexArrays(1, &vao);
+        table.destroy();
+        if (!textures.empty())
+        {
+            glDeleteTextures(GLsizei(textures.size()), textures.data());
+        }
+    }
+    BENCHMARK(BM_GlTextureDraws)->DenseRange(TEXTURE_BIND_PER_DRAW, TEXTURE_BINDLESS)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
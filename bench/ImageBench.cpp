@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "ImageFilters.h"
+#include "OpenGLUtils.h"
+
+namespace
+{
+    using utils::SimdLevel;
+
+    const std::string kImageFile = "textures/desert.tga";
+
+    void BM_ImageDecodeFile(benchmark::State& state)
+    {
+        const std::string filename = bench::getDataPath() + kImageFile;
+        utils::Image image;
+        for (auto _ : state)
+        {
+            if (!image.loadFromFile(filename))
+            {
+                state.SkipWithError(utils::Image::getLastError());
+                return;
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(image.mWidth) * image.mHeight);
+    }
+    BENCHMARK(BM_ImageDecodeFile)->Unit(benchmark::kMillisecond);
+
+    void BM_ImageDecodePng(benchmark::State& state)
+    {
+        utils::Image image;
+        std::vector<unsigned char> png;
+        if (!image.loadFromFile(bench::getDataPath() + kImageFile) || !image.encodePng(png))
+        {
+            state.SkipWithError("could not prepare the png");
+            return;
+        }
+
+        for (auto _ : state)
+        {
+            image.loadFromMemory(png.data(), png.size());
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(image.mWidth) * image.mHeight);
+        state.SetBytesProcessed(state.iterations() * int64_t(png.size()));
+    }
+    BENCHMARK(BM_ImageDecodePng)->Unit(benchmark::kMillisecond);
+
+    void BM_ImageEncodePng(benchmark::State& state)
+    {
+        utils::Image image;
+        if (!image.loadFromFile(bench::getDataPath() + kImageFile))
+        {
+            state.SkipWithError(utils::Image::getLastError());
+            return;
+        }
+
+        std::vector<unsigned char> png;
+        for (auto _ : state)
+        {
+            png.clear();
+            image.encodePng(png);
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(image.mWidth) * image.mHeight);
+    }
+    BENCHMARK(BM_ImageEncodePng)->Unit(benchmark::kMillisecond);
+
+    // range(0) kernel, range(1) SIMD level
+    void BM_ImageFilter(benchmark::State& state)
+    {
+        const SimdLevel level = SimdLevel(state.range(1));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+
+        utils::Image src;
+        utils::Image dst;
+        if (!src.loadFromFile(bench::getDataPath() + kImageFile))
+        {
+            state.SkipWithError(utils::Image::getLastError());
+            return;
+        }
+
+        const utils::filters::FilterKernel kernel = utils::filters::FilterKernel(state.range(0));
+        state.SetLabel(utils::filters::getKernelName(kernel));
+
+        const SimdLevel previous = utils::filters::getSimdLevel();
+        utils::filters::setSimdLevel(level);
+        for (auto _ : state)
+        {
+            switch (kernel)
+            {
+            case utils::filters::KERNEL_LUMINANCE:
+                utils::filters::luminance(src, dst);
+                break;
+            case utils::filters::KERNEL_COLOR_MATRIX:
+                utils::filters::colorMatrix(src, dst, glm::mat4(0.9f));
+                break;
+            case utils::filters::KERNEL_BLUR:
+                utils::filters::gaussianBlur(src, dst, 2.0f);
+                break;
+            default:
+                utils::filters::sharpen(src, dst, 0.5f);
+                break;
+            }
+            benchmark::DoNotOptimize(dst.mData);
+        }
+        utils::filters::setSimdLevel(previous);
+        state.SetItemsProcessed(state.iterations() * int64_t(src.mWidth) * src.mHeight);
+    }
+    BENCHMARK(BM_ImageFilter)
+        ->ArgsProduct({ benchmark::CreateDenseRange(0, utils::filters::KERNEL_COUNT - 1, 1), { 0, 1, 2 } })
+        ->Unit(benchmark::kMillisecond);
+
+    // The grayfilter shader over the whole image, read back and compared with filters::luminance at every
+    // supported SIMD level. The shader keeps the left half as it is, so the expected image does too. Timing
+    // covers the draw and the readback, the counters hold the largest channel difference per level.
+    // Arg 0 is the desert texture, 1 a 4096x8192 image holding every rgb color in each half
+    void BM_ImageLuminanceGpu(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        utils::Image src;
+        if (state.range(0) == 0)
+        {
+            if (!src.loadFromFile(bench::getDataPath() + kImageFile))
+            {
+                state.SkipWithError(utils::Image::getLastError());
+                return;
+            }
+        }
+        else
+        {
+            src.create(4096, 8192);
+            for (uint32_t y = 0; y < 8192; ++y)
+            {
+                for (uint32_t x = 0; x < 4096; ++x)
+                {
+                    const uint32_t color = y * 2048 + x % 2048;
+                    uint8_t* pixel = src.mData + (size_t(y) * 4096 + x) * 4;
+                    pixel[0] = uint8_t(color);
+                    pixel[1] = uint8_t(color >> 8);
+                    pixel[2] = uint8_t(color >> 16);
+                    pixel[3] = 255;
+                }
+            }
+        }
+
+        auto program = bench::loadProgram("grayfilter/grayfilter.vert", "grayfilter/grayfilter.frag");
+        if (program == nullptr)
+        {
+            state.SkipWithError("could not load the grayfilter shaders");
+            return;
+        }
+
+        // nearest sampling and a viewport of the image's size, every fragment reads exactly its own texel
+        const int width = src.mWidth;
+        const int height = src.mHeight;
+        GLuint textures[2] = {};
+        glCreateTextures(GL_TEXTURE_2D, 2, textures);
+        glTextureStorage2D(textures[0], 1, GL_RGBA8, width, height);
+        glTextureSubImage2D(textures[0], 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, src.mData);
+        glTextureParameteri(textures[0], GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTextureParameteri(textures[0], GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTextureStorage2D(textures[1], 1, GL_RGBA8, width, height);
+
+        GLuint framebuffer = 0;
+        glCreateFramebuffers(1, &framebuffer);
+        glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, textures[1], 0);
+
+        auto plane = utils::Mesh::createPlane(1.0f);
+        GLuint buffers[3] = {};
+        glCreateBuffers(3, buffers);
+        glNamedBufferStorage(buffers[0], GLsizeiptr(plane->mVertices.size() * sizeof(float)), plane->mVertices.data(), 0);
+        glNamedBufferStorage(buffers[1], GLsizeiptr(plane->mTextCoords.size() * sizeof(float)), plane->mTextCoords.data(), 0);
+        glNamedBufferStorage(buffers[2], GLsizeiptr(plane->mIndices.size() * sizeof(uint32_t)), plane->mIndices.data(), 0);
+
+        GLuint vao = 0;
+        glCreateVertexArrays(1, &vao);
+        const GLuint vertexLocation = GLuint(glGetAttribLocation(program->id, "a_vertex"));
+        const GLuint texCoordLocation = GLuint(glGetAttribLocation(program->id, "a_texCoord"));
+        glVertexArrayVertexBuffer(vao, 0, buffers[0], 0, 4 * sizeof(float));
+        glVertexArrayVertexBuffer(vao, 1, buffers[1], 0, 2 * sizeof(float));
+        glVertexArrayElementBuffer(vao, buffers[2]);
+        glVertexArrayAttribFormat(vao, vertexLocation, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribFormat(vao, texCoordLocation, 2, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribBinding(vao, vertexLocation, 0);
+        glVertexArrayAttribBinding(vao, texCoordLocation, 1);
+        glEnableVertexArrayAttrib(vao, vertexLocation);
+        glEnableVertexArrayAttrib(vao, texCoordLocation);
+
+        utils::Image gpu;
+        gpu.create(width, height);
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+        program->use();
+        program->setMat4("u_modelViewProjectionMatrix", glm::mat4(1.0f));
+        program->setInt("u_texture", 0);
+        glBindTextureUnit(0, textures[0]);
+        glBindVertexArray(vao);
+        for (auto _ : state)
+        {
+            glDrawElements(GL_TRIANGLES, GLsizei(plane->mIndices.size()), GL_UNSIGNED_INT, nullptr);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, gpu.mData);
+        }
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previousFramebuffer));
+        glViewport(0, 0, bench::kTargetSize, bench::kTargetSize);
+
+        // the shader's branch is on the interpolated s of the pixel center
+        const int split = width / 2;
+        utils::Image expected;
+        utils::Image cpu;
+        expected.create(width, height);
+        uint32_t worst = 0;
+        const SimdLevel previous = utils::filters::getSimdLevel();
+        for (uint32_t level = 0; level <= uint32_t(utils::getSupportedSimdLevel()); ++level)
+        {
+            utils::filters::setSimdLevel(SimdLevel(level));
+            utils::filters::luminance(src, cpu);
+            for (int y = 0; y < height; ++y)
+            {
+                const size_t row = size_t(y) * width * 4;
+                std::memcpy(expected.mData + row, src.mData + row, size_t(split) * 4);
+                std::memcpy(expected.mData + row + split * 4, cpu.mData + row + split * 4, size_t(width - split) * 4);
+            }
+
+            const uint32_t difference = utils::filters::maxDifference(expected, gpu);
+            state.counters[std::string("max_difference_") + utils::getSimdLevelName(SimdLevel(level))] = double(difference);
+            worst = std::max(worst, difference);
+        }
+        utils::filters::setSimdLevel(previous);
+        if (worst != 0)
+        {
+            state.SkipWithError("the CPU luminance filter differs from the grayfilter shader");
+        }
+
+        state.SetItemsProcessed(state.iterations() * int64_t(width) * height);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(3, buffers);
+        glDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(2, textures);
+    }
+    BENCHMARK(BM_ImageLuminanceGpu)->DenseRange(0, 1)->Unit(benchmark::kMillisecond);
+}
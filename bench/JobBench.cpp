@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "JobSystem.h"
+
+namespace
+{
+    constexpr uint32_t kJobCount = 10000;
+
+    // one mutex protected queue and a condition variable, how the base library's pool used to schedule
+    class LockedQueuePool
+    {
+    public:
+        explicit LockedQueuePool(uint32_t threadCount)
+        {
+            for (uint32_t i = 0; i < threadCount; ++i)
+            {
+                mThreads.emplace_back([this]()
+                {
+                    for (;;)
+                    {
+                        std::function<void()> task;
+                        {
+                            std::unique_lock<std::mutex> lock(mMutex);
+                            mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+                            if (mStopping && mTasks.empty())
+                            {
+                                return;
+                            }
+                            task = std::move(mTasks.front());
+                            mTasks.pop_front();
+                        }
+                        task();
+                    }
+                });
+            }
+        }
+
+        ~LockedQueuePool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+            mCondition.notify_all();
+            for (auto& thread : mThreads)
+            {
+                thread.join();
+            }
+        }
+
+        void enqueue(std::function<void()> task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mTasks.push_back(std::move(task));
+            }
+            mCondition.notify_one();
+        }
+
+    private:
+        std::vector<std::thread> mThreads;
+        std::deque<std::function<void()>> mTasks;
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        bool mStopping = false;
+    };
+
+    uint32_t getWorkerCount(benchmark::State& state)
+    {
+        return std::max(uint32_t(state.range(0)), 1u);
+    }
+
+    // empty jobs started from the main thread and waited for, the time per item is the scheduling cost
+    void BM_JobOverhead(benchmark::State& state)
+    {
+        utils::JobSystem jobs(getWorkerCount(state));
+        std::atomic<uint32_t> executed{ 0 };
+        for (auto _ : state)
+        {
+            utils::JobCounter counter;
+            for (uint32_t i = 0; i < kJobCount; ++i)
+            {
+                jobs.run([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+            }
+            jobs.wait(counter);
+        }
+        state.SetItemsProcessed(state.iterations() * kJobCount);
+        state.counters["stolen"] = benchmark::Counter(double(jobs.getStats().stolenJobs), benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK(BM_JobOverhead)->Arg(1)->Arg(3)->Arg(7)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+    void BM_LockedQueueOverhead(benchmark::State& state)
+    {
+        LockedQueuePool pool(getWorkerCount(state));
+        std::atomic<uint32_t> remaining{ 0 };
+        for (auto _ : state)
+        {
+            remaining.store(kJobCount);
+            for (uint32_t i = 0; i < kJobCount; ++i)
+            {
+                pool.enqueue([&remaining]() { remaining.fetch_sub(1, std::memory_order_acq_rel); });
+            }
+            while (remaining.load(std::memory_order_acquire) != 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * kJobCount);
+    }
+    BENCHMARK(BM_LockedQueueOverhead)->Arg(1)->Arg(3)->Arg(7)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+    // embarrassingly parallel, range(0) workers besides the calling thread
+    void BM_JobParallelFor(benchmark::State& state)
+    {
+        utils::JobSystem jobs(getWorkerCount(state));
+        const uint32_t count = 1u << 20;
+        std::vector<float> values(count);
+        for (auto _ : state)
+        {
+            jobs.parallelFor(count, 1024, [&values](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    values[i] = std::sqrt(float(i)) * std::sin(float(i));
+                }
+            });
+            benchmark::DoNotOptimize(values.data());
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_JobParallelFor)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    uint64_t fibonacci(utils::JobSystem& jobs, uint32_t n)
+    {
+        if (n < 16)
+        {
+            uint64_t a = 0;
+            uint64_t b = 1;
+            for (uint32_t i = 0; i < n; ++i)
+            {
+                const uint64_t sum = a + b;
+                a = b;
+                b = sum;
+            }
+            return a;
+        }
+
+        uint64_t left = 0;
+        utils::JobCounter counter;
+        jobs.run([&jobs, &left, n]() { left = fibonacci(jobs, n - 1); }, &counter);
+        const uint64_t right = fibonacci(jobs, n - 2);
+        jobs.wait(counter);
+        return left + right;
+    }
+
+    // fork-join, every level starts one child and waits for it while working on the other half
+    void BM_JobForkJoin(benchmark::State& state)
+    {
+        utils::JobSystem jobs(getWorkerCount(state));
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(fibonacci(jobs, 30));
+        }
+        state.counters["jobs"] = benchmark::Counter(double(jobs.getStats().executedJobs), benchmark::Counter::kAvgIterations);
+        state.counters["stolen"] = benchmark::Counter(double(jobs.getStats().stolenJobs), benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK(BM_JobForkJoin)->RangeMultiplier(2)->Range(1, 8)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
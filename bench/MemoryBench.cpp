@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "Memory.h"
+
+namespace
+{
+    constexpr uint32_t kAllocationsPerFrame = 1000;
+
+    size_t getAllocationSize(uint32_t i)
+    {
+        return 16 + (i % 13) * 24;
+    }
+
+    // after the first frames every buffer is large enough, heapAllocations has to stay 0
+    void BM_FrameAllocatorSteadyState(benchmark::State& state)
+    {
+        utils::FrameAllocator allocator(256 << 10, 2);
+        for (uint32_t frame = 0; frame < 4; ++frame)
+        {
+            allocator.beginFrame();
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                benchmark::DoNotOptimize(allocator.allocate(getAllocationSize(i)));
+            }
+        }
+
+        const uint64_t heapAllocations = utils::getHeapAllocationCount();
+        for (auto _ : state)
+        {
+            allocator.beginFrame();
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                benchmark::DoNotOptimize(allocator.allocate(getAllocationSize(i)));
+            }
+        }
+        state.counters["heapAllocations"] = benchmark::Counter(double(utils::getHeapAllocationCount() - heapAllocations), benchmark::Counter::kAvgIterations);
+        state.SetItemsProcessed(state.iterations() * kAllocationsPerFrame);
+    }
+    BENCHMARK(BM_FrameAllocatorSteadyState)->Unit(benchmark::kMicrosecond);
+
+    // the same allocations through malloc and free, for comparison
+    void BM_MallocPerFrame(benchmark::State& state)
+    {
+        std::vector<void*> pointers(kAllocationsPerFrame);
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                pointers[i] = std::malloc(getAllocationSize(i));
+                benchmark::DoNotOptimize(pointers[i]);
+            }
+            for (void* pointer : pointers)
+            {
+                std::free(pointer);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * kAllocationsPerFrame);
+    }
+    BENCHMARK(BM_MallocPerFrame)->Unit(benchmark::kMicrosecond);
+
+    void BM_ScratchScope(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            utils::ScratchScope scratch;
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                benchmark::DoNotOptimize(scratch.allocate(getAllocationSize(i)));
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * kAllocationsPerFrame);
+    }
+    BENCHMARK(BM_ScratchScope)->Unit(benchmark::kMicrosecond);
+
+    // earlier allocations fill most of the first block, an outer scope overflows into a second block and an
+    // inner scope into a third. The outer data has to survive the inner rewind and the dropped blocks are
+    // reused, so heapAllocations stays 0
+    void BM_ScratchScopeNestedOverflow(benchmark::State& state)
+    {
+        constexpr size_t kOuterSize = 3 << 10;
+        constexpr size_t kInnerSize = 256 << 10;
+        utils::LinearAllocator allocator(4 << 10);
+
+        auto frame = [&allocator]()
+        {
+            const size_t frameMarker = allocator.getMarker();
+            benchmark::DoNotOptimize(allocator.allocate(3 << 10));
+
+            const size_t outerMarker = allocator.getMarker();
+            uint8_t* outer = static_cast<uint8_t*>(allocator.allocate(kOuterSize));
+            for (size_t i = 0; i < kOuterSize; ++i)
+            {
+                outer[i] = uint8_t(i * 7);
+            }
+
+            const size_t innerMarker = allocator.getMarker();
+            uint8_t* inner = static_cast<uint8_t*>(allocator.allocate(kInnerSize));
+            benchmark::DoNotOptimize(inner);
+            allocator.rewind(innerMarker);
+
+            // allocations after the inner scope must not land on top of the outer data
+            uint8_t* after = static_cast<uint8_t*>(allocator.allocate(kOuterSize));
+            std::fill(after, after + kOuterSize, uint8_t(0xff));
+
+            bool intact = true;
+            for (size_t i = 0; i < kOuterSize; ++i)
+            {
+                intact &= outer[i] == uint8_t(i * 7);
+            }
+            allocator.rewind(outerMarker);
+            allocator.rewind(frameMarker);
+            return intact;
+        };
+
+        // the first frames grow the blocks and settle on the spare
+        frame();
+        frame();
+        const uint64_t heapAllocations = utils::getHeapAllocationCount();
+        for (auto _ : state)
+        {
+            if (!frame())
+            {
+                state.SkipWithError("outer scope data overwritten after the inner scope rewound");
+                return;
+            }
+        }
+        state.counters["heapAllocations"] = benchmark::Counter(double(utils::getHeapAllocationCount() - heapAllocations), benchmark::Counter::kAvgIterations);
+    }
+    BENCHMARK(BM_ScratchScopeNestedOverflow)->Unit(benchmark::kMicrosecond);
+
+    struct Particle
+    {
+        float position[3];
+        float velocity[3];
+        float age;
+    };
+
+    void BM_ObjectPoolChurn(benchmark::State& state)
+    {
+        utils::ObjectPool<Particle> pool(1024);
+        pool.reserve(kAllocationsPerFrame);
+        std::vector<Particle*> particles(kAllocationsPerFrame);
+
+        const uint64_t heapAllocations = utils::getHeapAllocationCount();
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                particles[i] = pool.create();
+            }
+            for (Particle* particle : particles)
+            {
+                pool.destroy(particle);
+            }
+        }
+        state.counters["heapAllocations"] = benchmark::Counter(double(utils::getHeapAllocationCount() - heapAllocations), benchmark::Counter::kAvgIterations);
+        state.SetItemsProcessed(state.iterations() * kAllocationsPerFrame);
+    }
+    BENCHMARK(BM_ObjectPoolChurn)->Unit(benchmark::kMicrosecond);
+
+    void BM_NewDeleteChurn(benchmark::State& state)
+    {
+        std::vector<Particle*> particles(kAllocationsPerFrame);
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < kAllocationsPerFrame; ++i)
+            {
+                particles[i] = new Particle();
+                benchmark::DoNotOptimize(particles[i]);
+            }
+            for (Particle* particle : particles)
+            {
+                delete particle;
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * kAllocationsPerFrame);
+    }
+    BENCHMARK(BM_NewDeleteChurn)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,50 @@
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionRasterizer.h"
+#include "OpenGLUtils.h"
+
+namespace
+{
+    void BM_MeshCreateGrid(benchmark::State& state)
+    {
+        const uint32_t resolution = uint32_t(state.range(0));
+        for (auto _ : state)
+        {
+            auto mesh = utils::Mesh::createGrid(resolution);
+            benchmark::DoNotOptimize(mesh->mIndices.data());
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(resolution + 1) * int64_t(resolution + 1));
+    }
+    BENCHMARK(BM_MeshCreateGrid)->Arg(64)->Arg(256)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+    void BM_MeshCreatePlane(benchmark::State& state)
+    {
+        for (auto _ : state)
+        {
+            auto mesh = utils::Mesh::createPlane(2.0f, 1.0f);
+            benchmark::DoNotOptimize(mesh->mVertices.data());
+        }
+    }
+    BENCHMARK(BM_MeshCreatePlane);
+
+    // a grid as an occluder: transform, near plane clipping, backface culling and binning into tiles
+    void BM_MeshOccluderSetup(benchmark::State& state)
+    {
+        auto mesh = utils::Mesh::createGrid(uint32_t(state.range(0)));
+        const glm::mat4 viewProjection = glm::perspective(glm::radians(60.0f), 2.0f, 0.5f, 200.0f)
+            * glm::lookAt(glm::vec3(0.5f, 0.6f, 1.2f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        utils::OcclusionRasterizer rasterizer;
+        rasterizer.init(256, 128);
+        for (auto _ : state)
+        {
+            rasterizer.beginFrame(viewProjection);
+            rasterizer.addOccluder(*mesh, glm::mat4(1.0f), true);
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(mesh->mIndices.size() / 3));
+    }
+    BENCHMARK(BM_MeshOccluderSetup)->Arg(64)->Arg(256)->Unit(benchmark::kMicrosecond);
+}
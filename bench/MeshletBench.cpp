@@ -0,0 +1,220 @@
+#include <cmath>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchContext.h"
+#include "Meshlets.h"
+
+namespace
+{
+    using utils::SimdLevel;
+
+    // displacement of the sphere, enough to spread the normals of a meshlet like a scanned surface does
+    constexpr float kRoughness = 0.05f;
+    constexpr uint32_t kViews = 16;
+
+    struct MeshletScene
+    {
+        std::shared_ptr<utils::Mesh> mesh;
+        utils::MeshletMesh meshlets;
+    };
+
+    // building takes a while at millions of triangles, every benchmark of a resolution shares one
+    const MeshletScene& getScene(uint32_t resolution)
+    {
+        static std::map<uint32_t, MeshletScene> scenes;
+        MeshletScene& scene = scenes[resolution];
+        if (scene.mesh == nullptr)
+        {
+            scene.mesh = utils::Mesh::createSphere(resolution, kRoughness);
+            utils::buildMeshlets(*scene.mesh, scene.meshlets);
+        }
+        return scene;
+    }
+
+    // a camera circling the sphere close enough that the silhouette leaves the frustum
+    void getView(uint32_t view, glm::mat4& viewProjection, glm::vec3& camera)
+    {
+        const float angle = float(view) * 6.2831853f / float(kViews);
+        camera = glm::vec3(std::cos(angle), 0.4f * std::sin(angle * 3.0f), std::sin(angle)) * 1.5f;
+        viewProjection = glm::perspective(glm::radians(60.0f), 1.0f, 0.05f, 10.0f) * glm::lookAt(camera, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    void setCullCounters(benchmark::State& state, const utils::MeshletCullStats& stats, uint32_t views)
+    {
+        state.counters["meshlets"] = double(stats.meshlets) / views;
+        state.counters["frustum_culled"] = double(stats.frustumCulled) / views;
+        state.counters["cone_culled"] = double(stats.coneCulled) / views;
+        state.counters["triangles_culled_pct"] = 100.0 * (1.0 - double(stats.visibleTriangles) / double(stats.triangles));
+    }
+
+    void accumulate(utils::MeshletCullStats& sum, const utils::MeshletCullStats& stats)
+    {
+        sum.meshlets += stats.meshlets;
+        sum.frustumCulled += stats.frustumCulled;
+        sum.coneCulled += stats.coneCulled;
+        sum.visibleMeshlets += stats.visibleMeshlets;
+        sum.triangles += stats.triangles;
+        sum.visibleTriangles += stats.visibleTriangles;
+    }
+
+    // range(0) sphere resolution, 6 * resolution^2 * 2 triangles
+    void BM_MeshletBuild(benchmark::State& state)
+    {
+        auto mesh = utils::Mesh::createSphere(uint32_t(state.range(0)), kRoughness);
+        utils::MeshletMesh meshlets;
+        for (auto _ : state)
+        {
+            utils::buildMeshlets(*mesh, meshlets);
+            benchmark::DoNotOptimize(meshlets.indices.data());
+        }
+
+        uint64_t vertices = 0;
+        for (const utils::Meshlet& meshlet : meshlets.meshlets)
+        {
+            vertices += meshlet.vertexCount;
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(mesh->mIndices.size() / 3));
+        state.counters["meshlets"] = double(meshlets.meshlets.size());
+        state.counters["triangles_per_meshlet"] = double(mesh->mIndices.size() / 3) / double(meshlets.meshlets.size());
+        state.counters["vertices_per_meshlet"] = double(vertices) / double(meshlets.meshlets.size());
+    }
+    BENCHMARK(BM_MeshletBuild)->Arg(100)->Arg(400)->Unit(benchmark::kMillisecond)->Iterations(3);
+
+    // range(0) sphere resolution, range(1) SIMD level, range(2) cone culling
+    void BM_MeshletCull(benchmark::State& state)
+    {
+        const SimdLevel level = SimdLevel(state.range(1));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+
+        const MeshletScene& scene = getScene(uint32_t(state.range(0)));
+        const uint32_t count = uint32_t(scene.meshlets.meshlets.size());
+        std::vector<utils::DrawElementsIndirectCommand> commands(count);
+        utils::MeshletCullStats sum;
+        uint32_t view = 0;
+        for (auto _ : state)
+        {
+            glm::mat4 viewProjection;
+            glm::vec3 camera;
+            getView(view++ % kViews, viewProjection, camera);
+
+            utils::MeshletCullStats stats;
+            benchmark::DoNotOptimize(utils::cullMeshlets(scene.meshlets.meshlets.data(), count, viewProjection, camera, commands.data(), stats,
+                state.range(2) != 0, level));
+            accumulate(sum, stats);
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        setCullCounters(state, sum, uint32_t(state.iterations()));
+    }
+    BENCHMARK(BM_MeshletCull)
+        ->ArgsProduct({ { 400 }, { int64_t(SimdLevel::SIMD_SCALAR), int64_t(SimdLevel::SIMD_AVX2) }, { 0, 1 } })
+        ->Unit(benchmark::kMicrosecond);
+
+    // range(0) 0 draws the whole mesh, 1 the meshlets the compute shader keeps; the frame cost on the GPU
+    void BM_MeshletDraw(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        const bool culled = state.range(0) != 0;
+        const MeshletScene& scene = getScene(400);
+        const utils::MeshletMesh& meshlets = scene.meshlets;
+        const uint32_t count = uint32_t(meshlets.meshlets.size());
+
+        auto program = bench::loadProgram("meshlets/meshlets.vert", "meshlets/meshlets.frag");
+        auto cullShader = utils::OpenglShader::create(bench::getDataPath() + "shaders/meshlets/meshlet_cull.comp", GL_COMPUTE_SHADER);
+        utils::MeshletCuller culler;
+        if (program == nullptr || cullShader == nullptr || !culler.init(utils::OpenglProgram::create(cullShader), count)
+            || !culler.setMeshlets(meshlets.meshlets.data(), count))
+        {
+            state.SkipWithError("could not load the meshlet shaders");
+            return;
+        }
+
+        std::vector<uint32_t> ids(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ids[i] = i;
+        }
+
+        GLuint buffers[4] = {};
+        glCreateBuffers(4, buffers);
+        glNamedBufferStorage(buffers[0], GLsizeiptr(scene.mesh->mVertices.size() * sizeof(float)), scene.mesh->mVertices.data(), 0);
+        glNamedBufferStorage(buffers[1], GLsizeiptr(scene.mesh->mNormals.size() * sizeof(float)), scene.mesh->mNormals.data(), 0);
+        glNamedBufferStorage(buffers[2], GLsizeiptr(ids.size() * sizeof(uint32_t)), ids.data(), 0);
+        glNamedBufferStorage(buffers[3], GLsizeiptr(meshlets.indices.size() * sizeof(uint32_t)), meshlets.indices.data(), 0);
+
+        GLuint vao = 0;
+        glCreateVertexArrays(1, &vao);
+        glVertexArrayVertexBuffer(vao, 0, buffers[0], 0, 4 * sizeof(float));
+        glVertexArrayVertexBuffer(vao, 1, buffers[1], 0, 3 * sizeof(float));
+        glVertexArrayVertexBuffer(vao, 2, buffers[2], 0, sizeof(uint32_t));
+        glVertexArrayBindingDivisor(vao, 2, 1);
+        glVertexArrayElementBuffer(vao, buffers[3]);
+        glVertexArrayAttribFormat(vao, 0, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribIFormat(vao, 2, 1, GL_UNSIGNED_INT, 0);
+        for (GLuint attribute = 0; attribute < 3; ++attribute)
+        {
+            glVertexArrayAttribBinding(vao, attribute, attribute);
+            glEnableVertexArrayAttrib(vao, attribute);
+        }
+
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+        uint32_t view = 0;
+        for (auto _ : state)
+        {
+            glm::mat4 viewProjection;
+            glm::vec3 camera;
+            getView(view++ % kViews, viewProjection, camera);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            if (culled)
+            {
+                culler.cull(viewProjection, camera);
+            }
+
+            program->use();
+            program->setMat4("u_viewProjection", viewProjection);
+            program->setVec3("u_lightDirection", glm::vec3(0.0f, -1.0f, 0.0f));
+            glBindVertexArray(vao);
+            if (culled)
+            {
+                culler.draw();
+            }
+            else
+            {
+                glDrawElements(GL_TRIANGLES, GLsizei(meshlets.indices.size()), GL_UNSIGNED_INT, nullptr);
+            }
+            glBindVertexArray(0);
+            glFinish();
+        }
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+
+        if (culled)
+        {
+            setCullCounters(state, culler.getStats(), 1);
+        }
+        state.SetItemsProcessed(state.iterations() * int64_t(meshlets.indices.size() / 3));
+
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(4, buffers);
+        culler.destroy();
+    }
+    BENCHMARK(BM_MeshletDraw)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "RenderGraph.h"
+
+namespace
+{
+    using utils::RenderGraphAccess;
+    using utils::RenderGraphBuilder;
+    using utils::RenderGraphResources;
+    using utils::RenderGraphTextureHandle;
+    using utils::RenderTextureDesc;
+
+    constexpr uint32_t kBloomLevels = 5;
+
+    // passes are only compiled here, nothing is drawn
+    void skipExecute(const RenderGraphResources&) {}
+
+    RenderTextureDesc getDesc(uint32_t width, uint32_t height, GLenum format)
+    {
+        RenderTextureDesc desc;
+        desc.width = std::max(width, 1u);
+        desc.height = std::max(height, 1u);
+        desc.format = format;
+        return desc;
+    }
+
+    // A deferred frame: gbuffer, ssao, lighting, a bloom chain, tonemapping and fxaa into the backbuffer.
+    // Lighting also writes per pixel light counts for a debug view that nothing presents, so the debug
+    // pass is culled while lighting has to stay alive for its hdr target
+    void addFrame(utils::RenderGraph& graph, uint32_t width, uint32_t height)
+    {
+        const RenderGraphTextureHandle backbuffer = graph.importBackbuffer("backbuffer", width, height);
+
+        RenderGraphTextureHandle albedo;
+        RenderGraphTextureHandle normal;
+        RenderGraphTextureHandle depth;
+        graph.addPass("gbuffer", [&](RenderGraphBuilder& builder)
+        {
+            albedo = builder.write(builder.create("albedo", getDesc(width, height, GL_RGBA8)));
+            normal = builder.write(builder.create("normal", getDesc(width, height, GL_RGBA16F)));
+            depth = builder.write(builder.create("depth", getDesc(width, height, GL_DEPTH32F_STENCIL8)));
+        }, skipExecute);
+
+        RenderGraphTextureHandle ao;
+        graph.addPass("ssao", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(normal);
+            builder.read(depth);
+            ao = builder.write(builder.create("ao", getDesc(width / 2, height / 2, GL_R8)), RenderGraphAccess::ACCESS_STORAGE);
+        }, skipExecute);
+
+        RenderGraphTextureHandle aoBlurred;
+        graph.addPass("ssao blur", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(ao);
+            aoBlurred = builder.write(builder.create("ao blurred", getDesc(width / 2, height / 2, GL_R8)), RenderGraphAccess::ACCESS_STORAGE);
+        }, skipExecute);
+
+        RenderGraphTextureHandle hdr;
+        RenderGraphTextureHandle lightCounts;
+        graph.addPass("lighting", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(albedo);
+            builder.read(normal);
+            builder.read(depth);
+            builder.read(aoBlurred);
+            hdr = builder.write(builder.create("hdr", getDesc(width, height, GL_RGBA16F)));
+            lightCounts = builder.write(builder.create("light counts", getDesc(width, height, GL_R8)));
+        }, skipExecute);
+
+        graph.addPass("light count debug", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(lightCounts);
+        }, skipExecute);
+
+        std::vector<RenderGraphTextureHandle> bloom(kBloomLevels);
+        for (uint32_t level = 0; level < kBloomLevels; ++level)
+        {
+            graph.addPass("bloom down " + std::to_string(level), [&](RenderGraphBuilder& builder)
+            {
+                builder.read(level == 0 ? hdr : bloom[level - 1]);
+                bloom[level] = builder.write(builder.create("bloom " + std::to_string(level),
+                    getDesc(width >> (level + 1), height >> (level + 1), GL_R11F_G11F_B10F)));
+            }, skipExecute);
+        }
+        for (uint32_t level = kBloomLevels - 1; level > 0; --level)
+        {
+            graph.addPass("bloom up " + std::to_string(level), [&](RenderGraphBuilder& builder)
+            {
+                builder.read(bloom[level]);
+                bloom[level - 1] = builder.write(builder.create("bloom up " + std::to_string(level),
+                    getDesc(width >> level, height >> level, GL_R11F_G11F_B10F)));
+            }, skipExecute);
+        }
+
+        RenderGraphTextureHandle ldr;
+        graph.addPass("tonemap", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(hdr);
+            builder.read(bloom[0]);
+            ldr = builder.write(builder.create("ldr", getDesc(width, height, GL_RGBA8)));
+        }, skipExecute);
+
+        graph.addPass("fxaa", [&](RenderGraphBuilder& builder)
+        {
+            builder.read(ldr);
+            builder.write(backbuffer);
+        }, skipExecute);
+    }
+
+    // building and compiling the frame graph at 1080p, the counters compare render target memory with
+    // and without aliasing transient textures whose lifetimes don't overlap
+    void BM_RenderGraphCompile(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        utils::RenderTargetPool pool;
+        utils::RenderGraph graph(pool);
+        for (auto _ : state)
+        {
+            graph.reset();
+            addFrame(graph, 1920, 1080);
+            graph.compile();
+        }
+
+        const std::vector<std::string> order = graph.getExecutionOrder();
+        const utils::RenderGraphStats& stats = graph.getStats();
+        if (stats.culledPassCount != 1 || std::find(order.begin(), order.end(), "lighting") == order.end())
+        {
+            state.SkipWithError("only the light count debug pass should be culled");
+        }
+
+        state.counters["passes"] = double(stats.passCount);
+        state.counters["culled"] = double(stats.culledPassCount);
+        state.counters["textures"] = double(stats.textureCount);
+        state.counters["physical_textures"] = double(stats.physicalTextureCount);
+        state.counters["peak_mb"] = double(stats.peakMemory) / double(1 << 20);
+        state.counters["peak_mb_without_aliasing"] = double(stats.peakMemoryWithoutAliasing) / double(1 << 20);
+
+        graph.reset();
+        pool.destroy();
+    }
+    BENCHMARK(BM_RenderGraphCompile)->Unit(benchmark::kMicrosecond);
+}
@@ -0,0 +1,248 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+
+#include "BenchContext.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "VertexLayout.h"
+
+namespace
+{
+    constexpr uint32_t kVertexArrayCount = 16;
+
+    // a scrambled but repeatable key sequence, state changes are spread over the whole queue
+    void fillCommand(utils::DrawCommand& command, uint32_t i, GLuint program, GLint mvpLocation, const GLuint* vertexArrays)
+    {
+        const uint32_t hash = i * 2654435761u;
+        command.program = program;
+        command.mvpLocation = mvpLocation;
+        command.vao = vertexArrays != nullptr ? vertexArrays[hash % kVertexArrayCount] : 1 + hash % kVertexArrayCount;
+        command.mode = GL_TRIANGLES;
+        command.count = 3;
+        command.indexType = 0;
+        command.mvp = glm::mat4(0.01f);
+        command.mvp[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        command.sortKey = utils::RenderQueue::makeSortKey(hash >> 28, command.program, command.vao, 0, float(hash % 1000));
+    }
+
+    void BM_RenderQueueMakeSortKey(benchmark::State& state)
+    {
+        uint32_t i = 0;
+        for (auto _ : state)
+        {
+            benchmark::DoNotOptimize(utils::RenderQueue::makeSortKey(i & 3, i & 7, i & 15, 0, float(i)));
+            ++i;
+        }
+    }
+    BENCHMARK(BM_RenderQueueMakeSortKey);
+
+    void BM_RenderQueueSort(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::RenderQueue queue;
+        for (auto _ : state)
+        {
+            queue.reset(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                fillCommand(*queue.allocate(1), i, 1, 0, nullptr);
+            }
+            queue.sort();
+            benchmark::DoNotOptimize(&queue[0]);
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_RenderQueueSort)->Arg(10000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+
+    // commands are allocated from the pool workers in batches of 64, as culling jobs do
+    void BM_RenderQueueParallelAllocate(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::RenderQueue queue;
+        for (auto _ : state)
+        {
+            queue.reset(count);
+            utils::ThreadPool::global().parallelFor(count / 64, 1, [&queue](uint32_t begin, uint32_t end)
+            {
+                for (uint32_t batch = begin; batch < end; ++batch)
+                {
+                    utils::DrawCommand* commands = queue.allocate(64);
+                    for (uint32_t i = 0; i < 64; ++i)
+                    {
+                        fillCommand(commands[i], batch * 64 + i, 1, 0, nullptr);
+                    }
+                }
+            });
+            benchmark::DoNotOptimize(queue.size());
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_RenderQueueParallelAllocate)->Arg(10000 / 64 * 64)->Arg(100000 / 64 * 64)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+    // sorted submission of single triangles, the counters show how many binds the sort saved
+    void BM_RenderQueueExecute(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        auto program = bench::loadProgram("cubes/cubes.vert", "cubes/cubes.frag");
+        if (program == nullptr)
+        {
+            state.SkipWithError("could not load the cubes shaders");
+            return;
+        }
+        const GLint mvpLocation = glGetUniformLocation(program->id, "u_modelViewProjectionMatrix");
+
+        const float vertices[] = {
+            -1.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f,
+             1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
+             0.0f,  1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+        };
+        GLuint buffer = 0;
+        glCreateBuffers(1, &buffer);
+        glNamedBufferStorage(buffer, sizeof(vertices), vertices, 0);
+
+        GLuint vertexArrays[kVertexArrayCount] = {};
+        glCreateVertexArrays(kVertexArrayCount, vertexArrays);
+        for (GLuint vao : vertexArrays)
+        {
+            glVertexArrayVertexBuffer(vao, 0, buffer, 0, 7 * sizeof(float));
+            glEnableVertexArrayAttrib(vao, 0);
+            glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_FALSE, 0);
+            glVertexArrayAttribBinding(vao, 0, 0);
+            glEnableVertexArrayAttrib(vao, 1);
+            glVertexArrayAttribFormat(vao, 1, 4, GL_FLOAT, GL_FALSE, 3 * sizeof(float));
+            glVertexArrayAttribBinding(vao, 1, 0);
+        }
+
+        const uint32_t count = uint32_t(state.range(0));
+        utils::RenderQueue queue;
+        for (auto _ : state)
+        {
+            queue.reset(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                fillCommand(*queue.allocate(1), i, program->id, mvpLocation, vertexArrays);
+            }
+            queue.execute();
+            glFinish();
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["programChanges"] = double(queue.getStats().programChanges);
+        state.counters["vertexArrayChanges"] = double(queue.getStats().vertexArrayChanges);
+
+        glDeleteVertexArrays(kVertexArrayCount, vertexArrays);
+        glDeleteBuffers(1, &buffer);
+    }
+    BENCHMARK(BM_RenderQueueExecute)->Arg(1000)->Arg(10000)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    struct MeshVertex
+    {
+        glm::vec3 position;
+        glm::vec4 color;
+    };
+    using MeshLayout = utils::VertexLayout<MeshVertex, UTILS_VERTEX_ATTRIBUTE(MeshVertex, position), UTILS_VERTEX_ATTRIBUTE(MeshVertex, color)>;
+
+    // kVertexArrayCount meshes of the same layout, each in its own buffers. range(1) 0 gives every mesh its own
+    // vao, 1 shares one vao from VertexArrayCache and only swaps the buffers between meshes
+    void BM_RenderQueueMeshes(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        auto program = bench::loadProgram("cubes/cubes.vert", "cubes/cubes.frag");
+        if (program == nullptr)
+        {
+            state.SkipWithError("could not load the cubes shaders");
+            return;
+        }
+        const GLint mvpLocation = glGetUniformLocation(program->id, "u_modelViewProjectionMatrix");
+
+        const MeshVertex vertices[] = {
+            { { -1.0f, -1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f, 1.0f } },
+            { {  1.0f, -1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 1.0f } },
+            { {  0.0f,  1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 1.0f } },
+        };
+        const uint32_t indices[] = { 0, 1, 2 };
+
+        GLuint vertexBuffers[kVertexArrayCount] = {};
+        GLuint indexBuffers[kVertexArrayCount] = {};
+        glCreateBuffers(kVertexArrayCount, vertexBuffers);
+        glCreateBuffers(kVertexArrayCount, indexBuffers);
+        for (uint32_t i = 0; i < kVertexArrayCount; ++i)
+        {
+            glNamedBufferStorage(vertexBuffers[i], sizeof(vertices), vertices, 0);
+            glNamedBufferStorage(indexBuffers[i], sizeof(indices), indices, 0);
+        }
+
+        const bool shared = state.range(1) != 0;
+        utils::VertexArrayCache cache;
+        GLuint vertexArrays[kVertexArrayCount] = {};
+        if (!shared)
+        {
+            glCreateVertexArrays(kVertexArrayCount, vertexArrays);
+            for (uint32_t i = 0; i < kVertexArrayCount; ++i)
+            {
+                glVertexArrayVertexBuffer(vertexArrays[i], 0, vertexBuffers[i], 0, MeshLayout::stride);
+                glVertexArrayElementBuffer(vertexArrays[i], indexBuffers[i]);
+                glVertexArrayAttribFormat(vertexArrays[i], 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position));
+                glVertexArrayAttribFormat(vertexArrays[i], 1, 4, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, color));
+                for (GLuint attribute = 0; attribute < 2; ++attribute)
+                {
+                    glVertexArrayAttribBinding(vertexArrays[i], attribute, 0);
+                    glEnableVertexArrayAttrib(vertexArrays[i], attribute);
+                }
+            }
+        }
+        const GLuint sharedVertexArray = shared ? cache.acquire<MeshLayout>() : 0;
+
+        const uint32_t count = uint32_t(state.range(0));
+        utils::RenderQueue queue;
+        for (auto _ : state)
+        {
+            queue.reset(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                utils::DrawCommand& command = *queue.allocate(1);
+                fillCommand(command, i, program->id, mvpLocation, vertexArrays);
+                command.indexType = GL_UNSIGNED_INT;
+                if (shared)
+                {
+                    const uint32_t mesh = (i * 2654435761u) % kVertexArrayCount;
+                    command.vao = sharedVertexArray;
+                    command.vertexBuffer = vertexBuffers[mesh];
+                    command.indexBuffer = indexBuffers[mesh];
+                    command.vertexStride = MeshLayout::stride;
+                    command.sortKey = utils::RenderQueue::makeSortKey(0, command.program, command.vao, command.vertexBuffer, float(i % 1000));
+                }
+                else
+                {
+                    command.sortKey = utils::RenderQueue::makeSortKey(0, command.program, command.vao, 0, float(i % 1000));
+                }
+            }
+            queue.execute();
+            glFinish();
+        }
+
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["vertexArrayChanges"] = double(queue.getStats().vertexArrayChanges);
+        state.counters["vertexBufferChanges"] = double(queue.getStats().vertexBufferChanges);
+
+        cache.destroy();
+        if (!shared)
+        {
+            glDeleteVertexArrays(kVertexArrayCount, vertexArrays);
+        }
+        glDeleteBuffers(kVertexArrayCount, vertexBuffers);
+        glDeleteBuffers(kVertexArrayCount, indexBuffers);
+    }
+    BENCHMARK(BM_RenderQueueMeshes)->ArgsProduct({ { 1000, 10000 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+}
@@ -0,0 +1,152 @@
+#include <cstring>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "GpuResidency.h"
+
+namespace
+{
+    constexpr uint32_t kTextureCount = 200;
+    constexpr uint64_t kTextureBytes = 1u << 20;
+    constexpr uint32_t kTextureLevels = 10;
+
+    // a mip chain with the top droppedMips levels missing
+    uint64_t getTextureBytes(uint32_t droppedMips)
+    {
+        return (kTextureBytes >> (2 * droppedMips)) * 4 / 3;
+    }
+
+    // 200 fake textures against a budget for half of them, every frame touches a window of range(0) textures
+    // that slides by range(1), so the working set over a few frames is twice the budget. range(2) is the number of
+    // mips that may be dropped before a texture is evicted. No GL is involved, the callbacks only return sizes,
+    // which leaves the cost of the bookkeeping and LRU selection
+    void BM_GpuResidencyFrame(benchmark::State& state)
+    {
+        const uint32_t window = uint32_t(state.range(0));
+        const uint32_t step = uint32_t(state.range(1));
+
+        utils::GpuResidency residency;
+        const uint64_t budget = kTextureCount / 2 * getTextureBytes(0);
+        residency.setBudget(utils::GPU_MEMORY_TEXTURE, budget);
+        residency.setMaxDroppedMips(uint32_t(state.range(2)));
+
+        std::vector<utils::GpuResidency::ResourceId> textures(kTextureCount);
+        for (utils::GpuResidency::ResourceId& texture : textures)
+        {
+            texture = residency.add(utils::GPU_MEMORY_TEXTURE, getTextureBytes(0), { []() {}, [](uint32_t droppedMips) { return getTextureBytes(droppedMips); } }, kTextureLevels);
+        }
+
+        uint32_t first = 0;
+        uint64_t evictions = 0;
+        uint64_t mipDrops = 0;
+        uint64_t restreams = 0;
+        uint32_t budgetViolations = 0;
+        for (auto _ : state)
+        {
+            residency.beginFrame();
+            for (uint32_t i = 0; i < window; ++i)
+            {
+                residency.touch(textures[(first + i) % kTextureCount]);
+            }
+            residency.endFrame();
+            first += step;
+
+            const utils::GpuResidencyStats& stats = residency.getStats();
+            evictions += stats.evictions;
+            mipDrops += stats.mipDrops;
+            restreams += stats.restreams;
+            budgetViolations += stats.bytes[utils::GPU_MEMORY_TEXTURE] > budget && !stats.overBudget;
+        }
+
+        const double frames = double(state.iterations());
+        state.counters["evictions"] = double(evictions) / frames;
+        state.counters["mipDrops"] = double(mipDrops) / frames;
+        state.counters["restreams"] = double(restreams) / frames;
+        state.counters["budgetViolations"] = double(budgetViolations);
+        state.counters["residentMB"] = double(residency.getStats().bytes[utils::GPU_MEMORY_TEXTURE]) / double(1 << 20);
+    }
+    BENCHMARK(BM_GpuResidencyFrame)->ArgsProduct({ { 60, 90 }, { 20 }, { 0, 2 } })->Unit(benchmark::kMicrosecond);
+
+    // levels base to max of the texture as RGBA8, top level first
+    std::vector<uint8_t> readMipChain(const utils::Texture2D& texture)
+    {
+        std::vector<uint8_t> pixels;
+        GLint baseLevel = 0;
+        GLint maxLevel = 0;
+        glGetTextureParameteriv(texture.mId, GL_TEXTURE_BASE_LEVEL, &baseLevel);
+        glGetTextureParameteriv(texture.mId, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        for (GLint level = baseLevel; level <= maxLevel; ++level)
+        {
+            GLint width = 0;
+            GLint height = 0;
+            glGetTextureLevelParameteriv(texture.mId, level, GL_TEXTURE_WIDTH, &width);
+            glGetTextureLevelParameteriv(texture.mId, level, GL_TEXTURE_HEIGHT, &height);
+            const size_t offset = pixels.size();
+            pixels.resize(offset + size_t(width) * height * 4);
+            glGetTextureImage(texture.mId, level, GL_RGBA, GL_UNSIGNED_BYTE, GLsizei(pixels.size() - offset), pixels.data() + offset);
+        }
+        return pixels;
+    }
+
+    // A real texture losing its top mip at the end of a frame over budget and getting it back on the next touch.
+    // The dropped level's storage is freed and the file is decoded again for it, the kept levels are untouched.
+    // The texture keeps its name throughout and the restored chain has to match the one uploaded at load
+    void BM_TextureMipRestream(benchmark::State& state)
+    {
+        if (!bench::requireContext(state))
+        {
+            return;
+        }
+
+        utils::GpuResidency& residency = utils::GpuResidency::global();
+        auto texture = utils::Texture2D::create(bench::getDataPath() + "textures/desert.tga");
+        if (texture == nullptr)
+        {
+            state.SkipWithError("could not load the texture");
+            return;
+        }
+
+        const std::vector<uint8_t> loaded = readMipChain(*texture);
+        const uint64_t bytes = residency.getStats().bytes[utils::GPU_MEMORY_TEXTURE];
+        const GLuint name = texture->mId;
+        uint64_t restreamedBytes = 0;
+        bool dropped = true;
+        for (auto _ : state)
+        {
+            residency.setBudget(utils::GPU_MEMORY_TEXTURE, bytes - 1);
+            residency.beginFrame();
+            residency.endFrame();
+            GLint topWidth = 0;
+            glGetTextureLevelParameteriv(texture->mId, 0, GL_TEXTURE_WIDTH, &topWidth);
+            dropped = dropped && residency.getDroppedMips(texture->mResidency) == 1 && topWidth == 0;
+
+            residency.setBudget(utils::GPU_MEMORY_TEXTURE, 0);
+            residency.beginFrame();
+            texture->touch();
+            residency.endFrame();
+            restreamedBytes += residency.getStats().restreamedBytes;
+            glFinish();
+        }
+
+        const std::vector<uint8_t> restored = readMipChain(*texture);
+        if (!dropped || residency.getDroppedMips(texture->mResidency) != 0)
+        {
+            state.SkipWithError("the top mip should be freed and restored every iteration");
+        }
+        else if (texture->mId != name)
+        {
+            state.SkipWithError("the texture name changed");
+        }
+        else if (restored.size() != loaded.size() || std::memcmp(restored.data(), loaded.data(), loaded.size()) != 0)
+        {
+            state.SkipWithError("the restored mip chain differs from the loaded one");
+        }
+
+        state.counters["chain_kb"] = double(bytes) / 1024.0;
+        state.counters["restreamed_kb"] = double(restreamedBytes) / double(state.iterations()) / 1024.0;
+        texture.reset();
+    }
+    BENCHMARK(BM_TextureMipRestream)->Unit(benchmark::kMillisecond);
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+
+namespace
+{
+    using utils::SimdLevel;
+
+    const glm::mat4 kViewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f)
+        * glm::lookAt(glm::vec3(0.0f, 10.0f, 30.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // every node's parent is one of the eight nodes before it in breadth-first order
+    uint32_t getParent(uint32_t node)
+    {
+        return (node - 1) / 8;
+    }
+
+    glm::vec3 getOffset(uint32_t node)
+    {
+        return glm::vec3(float(node % 7) - 3.0f, 1.0f, float(node % 5) - 2.0f);
+    }
+
+    void BM_MultiplyMatrices(benchmark::State& state)
+    {
+        const SimdLevel level = SimdLevel(state.range(0));
+        if (level > utils::getSupportedSimdLevel())
+        {
+            state.SkipWithError("SIMD level not supported");
+            return;
+        }
+
+        const uint32_t count = 10000;
+        std::vector<glm::mat4> models(count);
+        std::vector<glm::mat4> results(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            models[i] = glm::translate(glm::mat4(1.0f), getOffset(i)) * glm::mat4_cast(glm::quat(glm::vec3(0.1f * float(i), 0.0f, 0.0f)));
+        }
+
+        for (auto _ : state)
+        {
+            utils::multiplyMatrices(kViewProjection, models.data(), results.data(), count, level);
+            benchmark::DoNotOptimize(results.data());
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_MultiplyMatrices)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+
+    // range(0) nodes, range(1) percent of them moved per update, range(2) uses the global pool
+    void BM_TransformHierarchyUpdate(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        const uint32_t stride = std::max(uint32_t(100 / state.range(1)), 1u);
+        utils::ThreadPool* pool = state.range(2) != 0 ? &utils::ThreadPool::global() : nullptr;
+
+        utils::TransformHierarchy hierarchy;
+        hierarchy.reserve(count);
+        std::vector<utils::TransformHandle> handles(count);
+        handles[0] = hierarchy.create();
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            handles[i] = hierarchy.create(handles[getParent(i)], getOffset(i));
+        }
+        hierarchy.update(kViewProjection, pool);
+
+        float time = 0.0f;
+        for (auto _ : state)
+        {
+            time += 0.01f;
+            for (uint32_t i = 0; i < count; i += stride)
+            {
+                hierarchy.setLocalPosition(handles[i], getOffset(i) + glm::vec3(0.0f, time, 0.0f));
+            }
+            hierarchy.update(kViewProjection, pool);
+            benchmark::DoNotOptimize(hierarchy.getMvpMatrices());
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+        state.counters["updated"] = double(hierarchy.getStats().updatedCount);
+    }
+    BENCHMARK(BM_TransformHierarchyUpdate)
+        ->ArgsProduct({ { 100000, 1000000 }, { 1, 10, 100 }, { 0, 1 } })
+        ->Unit(benchmark::kMillisecond);
+
+    struct NaiveNode
+    {
+        glm::vec3 position;
+        glm::quat rotation;
+        glm::vec3 scale;
+        std::vector<uint32_t> children;
+    };
+
+    void updateNaive(std::vector<NaiveNode>& nodes, std::vector<glm::mat4>& world, std::vector<glm::mat4>& mvp, uint32_t node, const glm::mat4& parent)
+    {
+        const NaiveNode& current = nodes[node];
+        world[node] = parent * glm::translate(glm::mat4(1.0f), current.position) * glm::mat4_cast(current.rotation) * glm::scale(glm::mat4(1.0f), current.scale);
+        mvp[node] = kViewProjection * world[node];
+        for (uint32_t child : current.children)
+        {
+            updateNaive(nodes, world, mvp, child, world[node]);
+        }
+    }
+
+    // pointer chasing recursion over the same tree, everything is recomputed every time
+    void BM_TransformNaiveUpdate(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        std::vector<NaiveNode> nodes(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            nodes[i] = { getOffset(i), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f), {} };
+            if (i > 0)
+            {
+                nodes[getParent(i)].children.push_back(i);
+            }
+        }
+
+        std::vector<glm::mat4> world(count);
+        std::vector<glm::mat4> mvp(count);
+        float time = 0.0f;
+        for (auto _ : state)
+        {
+            time += 0.01f;
+            nodes[0].position.y = time;
+            updateNaive(nodes, world, mvp, 0, glm::mat4(1.0f));
+            benchmark::DoNotOptimize(mvp.data());
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_TransformNaiveUpdate)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+    // handles are recycled through the free list once destroyed nodes are compacted by update
+    void BM_TransformHandleChurn(benchmark::State& state)
+    {
+        const uint32_t count = uint32_t(state.range(0));
+        utils::TransformHierarchy hierarchy;
+        const utils::TransformHandle root = hierarchy.create();
+        std::vector<utils::TransformHandle> handles(count);
+        for (auto _ : state)
+        {
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                handles[i] = hierarchy.create(root, getOffset(i));
+            }
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                hierarchy.destroy(handles[i]);
+            }
+            hierarchy.update(kViewProjection);
+        }
+        state.SetItemsProcessed(state.iterations() * count);
+    }
+    BENCHMARK(BM_TransformHandleChurn)->Arg(1000)->Arg(100000)->Unit(benchmark::kMicrosecond);
+}
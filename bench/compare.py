@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+"""Compares two Google Benchmark JSON outputs by benchmark name.
+
+    compare.py baseline.json current.json [--threshold 0.10]
+
+Prints every benchmark present in both files and exits with 1 when any of them got slower than the
+baseline by more than the threshold. Benchmarks that errored or were skipped in either run are ignored.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(filename):
+    with open(filename) as file:
+        data = json.load(file)
+
+    results = {}
+    for benchmark in data.get("benchmarks", []):
+        # aggregates of repeated runs only count through their mean
+        if benchmark.get("run_type") == "aggregate" and benchmark.get("aggregate_name") != "mean":
+            continue
+        if benchmark.get("error_occurred"):
+            continue
+        results[benchmark.get("run_name", benchmark["name"])] = benchmark
+    return results
+
+
+def to_nanoseconds(benchmark):
+    scale = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+    return benchmark["real_time"] * scale[benchmark.get("time_unit", "ns")]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="flags benchmarks that regressed against a baseline")
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=0.10, help="allowed slowdown, 0.10 is 10%%")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    current = load(args.current)
+
+    regressions = []
+    width = max((len(name) for name in list(current) + list(baseline)), default=0)
+    for name, result in current.items():
+        if name not in baseline:
+            print("{:<{}}  new".format(name, width))
+            continue
+
+        before = to_nanoseconds(baseline[name])
+        after = to_nanoseconds(result)
+        change = after / before - 1.0 if before > 0.0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print("{:<{}}  {:>14.0f} ns  {:>14.0f} ns  {:>+7.1%}{}".format(name, width, before, after, change, flag))
+
+    missing = sorted(set(baseline) - set(current))
+    for name in missing:
+        print("{:<{}}  missing".format(name, width))
+
+    if regressions:
+        print("\n{} benchmark(s) more than {:.0%} slower than the baseline".format(len(regressions), args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,29 @@
+#include <iostream>
+
+#include <benchmark/benchmark.h>
+
+#include "BenchContext.h"
+#include "Memory.h"
+
+// the allocator benchmarks report heap allocations per iteration
+UTILS_COUNT_HEAP_ALLOCATIONS()
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    if (!bench::createContext())
+    {
+        std::cerr << "No GL context, the GL benchmarks are skipped" << std::endl;
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    bench::destroyContext();
+    return 0;
+}
@@ -0,0 +1,16 @@
+#version 450
+
+in vec2 v_uv;
+
+out vec4 fragColor;
+
+uniform sampler2DArray u_atlas;
+
+// TextureRegion::uvRect and layer
+uniform vec4 u_uvRect;
+uniform float u_layer;
+
+void main()
+{
+    fragColor = texture(u_atlas, vec3(u_uvRect.xy + v_uv * u_uvRect.zw, u_layer));
+}
@@ -0,0 +1,18 @@
+#version 450
+#extension GL_ARB_bindless_texture : require
+
+in vec2 v_uv;
+
+out vec4 fragColor;
+
+layout(std430, binding = 0) readonly buffer Textures
+{
+    sampler2D textures[];
+};
+
+uniform uint u_texture;
+
+void main()
+{
+    fragColor = texture(textures[u_texture], v_uv);
+}
@@ -0,0 +1,13 @@
+#version 450
+
+out vec2 v_uv;
+
+// xy offset and zw size in clip space
+uniform vec4 u_rect;
+
+void main()
+{
+    v_uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+    gl_Position = vec4(u_rect.xy + v_uv * u_rect.zw, 0.0, 1.0);
+}
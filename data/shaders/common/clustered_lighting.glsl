@@ -0,0 +1,88 @@
+// Clustered forward lighting, written by utils::ClusteredLighting. bind() provides the buffers and uniforms below.
+
+struct ClusterLight
+{
+    vec4 positionRange;
+    vec4 colorIntensity;
+
+    // xyz direction, w 0 for point and 1 for spot lights
+    vec4 directionType;
+
+    // cosines of the inner and outer cone angle
+    vec4 cone;
+};
+
+struct Cluster
+{
+    uint offset;
+    uint count;
+};
+
+layout(std430, binding = 8) readonly buffer ClusterLights { ClusterLight u_lights[]; };
+layout(std430, binding = 9) readonly buffer Clusters { Cluster u_clusters[]; };
+layout(std430, binding = 10) readonly buffer ClusterLightIndices { uint u_lightIndices[]; };
+
+uniform uvec3 u_clusterGrid;
+uniform vec2 u_clusterViewport;
+
+// slice = log(depth) * x - y
+uniform vec2 u_clusterDepth;
+uniform vec2 u_clusterPlanes;
+uniform uint u_lightCount;
+
+uint getClusterIndex()
+{
+    float ndcDepth = gl_FragCoord.z * 2.0 - 1.0;
+    float viewDepth = 2.0 * u_clusterPlanes.x * u_clusterPlanes.y / (u_clusterPlanes.y + u_clusterPlanes.x - ndcDepth * (u_clusterPlanes.y - u_clusterPlanes.x));
+
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / u_clusterViewport * vec2(u_clusterGrid.xy)), u_clusterGrid.xy - 1u);
+    uint slice = uint(clamp(log(viewDepth) * u_clusterDepth.x - u_clusterDepth.y, 0.0, float(u_clusterGrid.z - 1u)));
+    return (slice * u_clusterGrid.y + tile.y) * u_clusterGrid.x + tile.x;
+}
+
+vec3 evaluateLight(ClusterLight light, vec3 position, vec3 normal, vec3 viewDirection, vec3 albedo)
+{
+    vec3 toLight = light.positionRange.xyz - position;
+    float distanceSquared = dot(toLight, toLight);
+    float rangeSquared = light.positionRange.w * light.positionRange.w;
+    if (distanceSquared >= rangeSquared)
+    {
+        return vec3(0.0);
+    }
+
+    // inverse square falloff windowed to reach zero at the range
+    vec3 direction = toLight * inversesqrt(distanceSquared);
+    float window = clamp(1.0 - (distanceSquared * distanceSquared) / (rangeSquared * rangeSquared), 0.0, 1.0);
+    float attenuation = window * window / (distanceSquared + 1.0);
+    if (light.directionType.w > 0.5)
+    {
+        attenuation *= smoothstep(light.cone.y, light.cone.x, dot(-direction, light.directionType.xyz));
+    }
+
+    float diffuse = max(dot(normal, direction), 0.0);
+    float specular = pow(max(dot(normal, normalize(direction + viewDirection)), 0.0), 32.0) * 0.5;
+    return light.colorIntensity.rgb * (light.colorIntensity.w * attenuation * diffuse) * (albedo + specular);
+}
+
+// the lights of the fragment's cluster
+vec3 shadeClusteredLights(vec3 position, vec3 normal, vec3 viewDirection, vec3 albedo)
+{
+    Cluster cluster = u_clusters[getClusterIndex()];
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < cluster.count; ++i)
+    {
+        color += evaluateLight(u_lights[u_lightIndices[cluster.offset + i]], position, normal, viewDirection, albedo);
+    }
+    return color;
+}
+
+// every light, the reference clustered shading is compared against
+vec3 shadeAllLights(vec3 position, vec3 normal, vec3 viewDirection, vec3 albedo)
+{
+    vec3 color = vec3(0.0);
+    for (uint i = 0u; i < u_lightCount; ++i)
+    {
+        color += evaluateLight(u_lights[i], position, normal, viewDirection, albedo);
+    }
+    return color;
+}
@@ -1,7 +1,7 @@
 #version 450
 
-in vec3 a_position;
-in vec4 a_color;
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec4 a_color;
 
 out vec4 v_color;
 
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec4 a_position;
+layout(location = 1) in vec4 a_color;
+
+out vec4 v_color;
+
+uniform mat4 u_viewProjection;
+
+void main()
+{
+    v_color = a_color;
+    gl_Position = u_viewProjection * vec4(a_position.xyz, 1.0);
+
+    // w = 0 marks shapes drawn on top, they land on the near plane and pass the depth test
+    if (a_position.w == 0.0)
+    {
+        gl_Position.z = -gl_Position.w;
+    }
+}
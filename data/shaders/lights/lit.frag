@@ -0,0 +1,24 @@
+#version 450
+
+#include "../common/clustered_lighting.glsl"
+
+in vec3 v_world;
+in vec3 v_normal;
+flat in float v_seed;
+
+out vec4 fragColor;
+
+uniform vec3 u_eye;
+uniform bool u_naive;
+
+void main()
+{
+    // seed -1 is the floor, everything else a pillar
+    vec3 albedo = v_seed < 0.0 ? vec3(0.5) : mix(vec3(0.7, 0.65, 0.6), vec3(0.45, 0.5, 0.6), v_seed);
+    vec3 normal = normalize(v_normal);
+    vec3 viewDirection = normalize(u_eye - v_world);
+
+    vec3 color = albedo * 0.02;
+    color += u_naive ? shadeAllLights(v_world, normal, viewDirection, albedo) : shadeClusteredLights(v_world, normal, viewDirection, albedo);
+    fragColor = vec4(color / (color + 1.0), 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450
+
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec4 a_center;
+layout(location = 3) in vec4 a_halfExtent;
+
+out vec3 v_world;
+out vec3 v_normal;
+flat out float v_seed;
+
+uniform mat4 u_viewProjection;
+
+void main()
+{
+    v_world = a_center.xyz + a_position * a_halfExtent.xyz;
+    v_normal = a_normal;
+    v_seed = a_center.w;
+
+    gl_Position = u_viewProjection * vec4(v_world, 1.0);
+}
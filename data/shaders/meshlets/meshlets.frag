@@ -0,0 +1,22 @@
+#version 450
+
+in vec3 v_normal;
+flat in uint v_meshlet;
+
+out vec4 fragColor;
+
+uniform vec3 u_lightDirection;
+uniform bool u_showMeshlets;
+
+vec3 meshletColor(uint meshlet)
+{
+    uint hash = meshlet * 2654435761u;
+    return vec3(uvec3(hash >> 8u, hash >> 16u, hash >> 24u) & 255u) / 255.0 * 0.6 + 0.4;
+}
+
+void main()
+{
+    vec3 albedo = u_showMeshlets ? meshletColor(v_meshlet) : vec3(0.8);
+    float diffuse = max(dot(normalize(v_normal), -u_lightDirection), 0.0);
+    fragColor = vec4(albedo * (0.15 + 0.85 * diffuse), 1.0);
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec4 a_position;
+layout(location = 1) in vec3 a_normal;
+// instanced with divisor 1, the culler's baseInstance selects the meshlet
+layout(location = 2) in uint a_meshlet;
+
+out vec3 v_normal;
+flat out uint v_meshlet;
+
+uniform mat4 u_viewProjection;
+
+void main()
+{
+    v_normal = a_normal;
+    v_meshlet = a_meshlet;
+    gl_Position = u_viewProjection * vec4(a_position.xyz, 1.0);
+}
@@ -0,0 +1,65 @@
+#version 450
+
+in vec3 v_world;
+in vec3 v_normal;
+flat in float v_seed;
+
+out vec4 fragColor;
+
+uniform vec3 u_eye;
+
+float hash(vec2 p)
+{
+    return fract(sin(dot(p, vec2(127.1, 311.7))) * 43758.5453);
+}
+
+float noise(vec2 p)
+{
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    vec2 s = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1.0, 0.0)), s.x), mix(hash(i + vec2(0.0, 1.0)), hash(i + vec2(1.0, 1.0)), s.x), s.y);
+}
+
+void main()
+{
+    // seed -1 is the ground, everything else a building facade
+    vec3 albedo;
+    vec2 facade = abs(v_normal.x) > 0.5 ? v_world.zy : v_world.xy;
+    if (v_seed < 0.0)
+    {
+        albedo = vec3(0.25, 0.26, 0.28);
+        facade = v_world.xz;
+    }
+    else
+    {
+        albedo = mix(vec3(0.55, 0.52, 0.5), vec3(0.35, 0.4, 0.48), v_seed);
+
+        // a 3 m window grid, some windows lit
+        vec2 cell = floor(facade / 3.0);
+        vec2 local = fract(facade / 3.0);
+        bool window = abs(v_normal.y) < 0.5 && all(greaterThan(local, vec2(0.2, 0.3))) && all(lessThan(local, vec2(0.8, 0.85)));
+        if (window)
+        {
+            albedo = hash(cell + v_seed * 100.0) > 0.7 ? vec3(0.95, 0.85, 0.5) : vec3(0.12, 0.15, 0.2);
+        }
+    }
+
+    // weathering, a deliberately expensive material so hidden fragments cost something
+    float grime = 0.0;
+    float amplitude = 0.5;
+    vec2 p = facade * 0.7;
+    for (int i = 0; i < 6; ++i)
+    {
+        grime += noise(p) * amplitude;
+        p *= 2.03;
+        amplitude *= 0.5;
+    }
+    albedo *= 0.8 + 0.4 * grime;
+
+    vec3 light = normalize(vec3(0.4, 0.8, 0.3));
+    float diffuse = max(dot(v_normal, light), 0.0) * 0.7 + 0.3;
+
+    float fog = 1.0 - exp(-length(v_world - u_eye) * 0.004);
+    fragColor = vec4(mix(albedo * diffuse, vec3(0.55, 0.65, 0.8), fog), 1.0);
+}
@@ -0,0 +1,42 @@
+#version 450
+
+in vec2 v_uv;
+in vec4 v_color;
+flat in uint v_texture;
+flat in float v_layer;
+
+out vec4 fragColor;
+
+// slots 0-7 are 2D textures, 8-15 texture arrays, anything else is untextured
+uniform sampler2D u_textures[8];
+uniform sampler2DArray u_arrays[8];
+
+vec4 sampleSprite()
+{
+    // the slot differs between sprites of one draw, so the samplers are selected with constant indices
+    switch (v_texture)
+    {
+    case 0u: return texture(u_textures[0], v_uv);
+    case 1u: return texture(u_textures[1], v_uv);
+    case 2u: return texture(u_textures[2], v_uv);
+    case 3u: return texture(u_textures[3], v_uv);
+    case 4u: return texture(u_textures[4], v_uv);
+    case 5u: return texture(u_textures[5], v_uv);
+    case 6u: return texture(u_textures[6], v_uv);
+    case 7u: return texture(u_textures[7], v_uv);
+    case 8u: return texture(u_arrays[0], vec3(v_uv, v_layer));
+    case 9u: return texture(u_arrays[1], vec3(v_uv, v_layer));
+    case 10u: return texture(u_arrays[2], vec3(v_uv, v_layer));
+    case 11u: return texture(u_arrays[3], vec3(v_uv, v_layer));
+    case 12u: return texture(u_arrays[4], vec3(v_uv, v_layer));
+    case 13u: return texture(u_arrays[5], vec3(v_uv, v_layer));
+    case 14u: return texture(u_arrays[6], vec3(v_uv, v_layer));
+    case 15u: return texture(u_arrays[7], vec3(v_uv, v_layer));
+    default: return vec4(1.0);
+    }
+}
+
+void main()
+{
+    fragColor = sampleSprite() * v_color;
+}
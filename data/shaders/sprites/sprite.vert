@@ -0,0 +1,23 @@
+#version 450
+
+layout(location = 0) in vec2 a_position;
+layout(location = 1) in vec2 a_uv;
+layout(location = 2) in vec4 a_color;
+layout(location = 3) in uvec2 a_texture;
+
+out vec2 v_uv;
+out vec4 v_color;
+flat out uint v_texture;
+flat out float v_layer;
+
+uniform mat4 u_projection;
+
+void main()
+{
+    v_uv = a_uv;
+    v_color = a_color;
+    v_texture = a_texture.x;
+    v_layer = float(a_texture.y);
+
+    gl_Position = u_projection * vec4(a_position, 0.0, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+in vec3 v_position;
+in vec2 v_texcoord;
+flat in float v_layer;
+
+out vec4 fragColor;
+
+uniform vec3 u_eye;
+uniform float u_heightScale;
+uniform sampler2DArray u_normals;
+
+void main()
+{
+    vec2 xz = texture(u_normals, vec3(v_texcoord, v_layer)).rg;
+    vec3 normal = vec3(xz.x, sqrt(max(1.0 - dot(xz, xz), 0.0)), xz.y);
+
+    float height = clamp(v_position.y / u_heightScale, 0.0, 1.0);
+    vec3 grass = vec3(0.25, 0.45, 0.18);
+    vec3 rock = vec3(0.45, 0.40, 0.35);
+    vec3 snow = vec3(0.95, 0.95, 0.97);
+    vec3 albedo = mix(grass, rock, smoothstep(0.3, 0.6, height));
+    albedo = mix(albedo, rock, smoothstep(0.6, 0.8, 1.0 - normal.y) * 0.8);
+    albedo = mix(albedo, snow, smoothstep(0.75, 0.85, height) * normal.y);
+
+    vec3 light = normalize(vec3(0.4, 0.8, 0.3));
+    float diffuse = max(dot(normal, light), 0.0);
+
+    // distance fog hides the far end of the coarsest level
+    float fog = 1.0 - exp(-distance(u_eye, v_position) * 0.0002);
+    vec3 color = albedo * (0.25 + 0.75 * diffuse);
+    fragColor = vec4(mix(color, vec3(0.6, 0.7, 0.8), fog), 1.0);
+}
@@ -0,0 +1,48 @@
+#version 450
+
+layout(location = 0) in vec4 a_position;
+layout(location = 1) in vec4 a_node;
+layout(location = 2) in vec4 a_params;
+
+out vec3 v_position;
+out vec2 v_texcoord;
+flat out float v_layer;
+
+uniform mat4 u_viewProjection;
+uniform vec3 u_eye;
+uniform float u_gridResolution;
+uniform float u_heightScale;
+uniform float u_tileSamples;
+uniform sampler2DArray u_heights;
+
+// samples sit on texel centers, the grid corners map onto the tile's border samples
+vec2 toTexcoord(vec2 uv)
+{
+    return (0.5 + uv * (u_tileSamples - 1.0)) / u_tileSamples;
+}
+
+float sampleHeight(vec2 uv, float layer)
+{
+    return textureLod(u_heights, vec3(toTexcoord(uv), layer), 0.0).r * u_heightScale;
+}
+
+void main()
+{
+    // a_node: x, z, size, a_params: layer, morph start, morph end
+    vec2 uv = a_position.xz;
+    float layer = a_params.x;
+
+    vec2 world = a_node.xy + uv * a_node.z;
+    float dist = distance(u_eye, vec3(world.x, sampleHeight(uv, layer), world.y));
+    float morph = clamp((dist - a_params.y) / (a_params.z - a_params.y), 0.0, 1.0);
+
+    // odd vertices slide onto their even neighbours, matching the next coarser level at the end of the range
+    uv -= fract(uv * u_gridResolution * 0.5) * 2.0 / u_gridResolution * morph;
+
+    world = a_node.xy + uv * a_node.z;
+    v_position = vec3(world.x, sampleHeight(uv, layer), world.y);
+    v_texcoord = toTexcoord(uv);
+    v_layer = layer;
+
+    gl_Position = u_viewProjection * vec4(v_position, 1.0);
+}
@@ -0,0 +1,25 @@
+#version 450
+
+in vec2 v_texel;
+in vec4 v_color;
+in float v_pixelRange;
+
+out vec4 fragColor;
+
+uniform sampler2D u_atlas;
+
+float median(float r, float g, float b)
+{
+    return max(min(r, g), min(max(r, g), b));
+}
+
+void main()
+{
+    vec3 distances = texture(u_atlas, v_texel / vec2(textureSize(u_atlas, 0))).rgb;
+
+    // distance to the outline in screen pixels, never below one pixel of antialiasing
+    float distance = (median(distances.r, distances.g, distances.b) - 0.5) * max(v_pixelRange, 1.0);
+    float opacity = clamp(distance + 0.5, 0.0, 1.0);
+
+    fragColor = vec4(v_color.rgb, v_color.a * opacity);
+}
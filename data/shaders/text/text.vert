@@ -0,0 +1,24 @@
+#version 450
+
+layout(location = 0) in vec4 a_rect;
+layout(location = 1) in vec4 a_texels;
+layout(location = 2) in vec4 a_color;
+layout(location = 3) in float a_pixelRange;
+
+out vec2 v_texel;
+out vec4 v_color;
+out float v_pixelRange;
+
+uniform mat4 u_projection;
+
+void main()
+{
+    // triangle strip corners: (0, 0), (1, 0), (0, 1), (1, 1)
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+    v_texel = mix(a_texels.xy, a_texels.zw, corner);
+    v_color = a_color;
+    v_pixelRange = a_pixelRange;
+
+    gl_Position = u_projection * vec4(mix(a_rect.xy, a_rect.zw, corner), 0.0, 1.0);
+}
@@ -1,7 +1,7 @@
 #version 450
 
-in vec3 vertex;
-in vec3 color;
+layout(location = 0) in vec3 vertex;
+layout(location = 1) in vec3 color;
 
 out vec3 outColor; 
 
@@ -0,0 +1,35 @@
+#version 450
+
+in vec2 v_uv;
+
+out vec4 fragColor;
+
+uniform sampler2D u_source;
+uniform vec2 u_uvMax;
+uniform vec2 u_texelSize;
+uniform float u_sharpness;
+
+vec3 fetch(vec2 uv)
+{
+    // the rest of the texture holds stale pixels of larger scales
+    return texture(u_source, min(uv, u_uvMax)).rgb;
+}
+
+void main()
+{
+    // contrast adaptive sharpening on the bilinear result: a negative lobe on the cross neighbours,
+    // weakened where the local contrast is already high so edges don't ring
+    vec3 center = fetch(v_uv);
+    vec3 north = fetch(v_uv + vec2(0.0, u_texelSize.y));
+    vec3 south = fetch(v_uv - vec2(0.0, u_texelSize.y));
+    vec3 east = fetch(v_uv + vec2(u_texelSize.x, 0.0));
+    vec3 west = fetch(v_uv - vec2(u_texelSize.x, 0.0));
+
+    vec3 minimum = min(center, min(min(north, south), min(east, west)));
+    vec3 maximum = max(center, max(max(north, south), max(east, west)));
+    vec3 amplitude = sqrt(clamp(min(minimum, 1.0 - maximum) / max(maximum, 1e-4), 0.0, 1.0));
+    vec3 weight = amplitude * -mix(0.125, 0.2, u_sharpness) * step(1e-3, u_sharpness);
+
+    vec3 color = (center + (north + south + east + west) * weight) / (1.0 + 4.0 * weight);
+    fragColor = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
@@ -0,0 +1,14 @@
+#version 450
+
+out vec2 v_uv;
+
+// size of the rendered corner relative to the whole source texture
+uniform vec2 u_uvScale;
+
+void main()
+{
+    // one triangle covering the screen, no vertex buffer needed
+    vec2 position = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+    v_uv = (position * 0.5 + 0.5) * u_uvScale;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
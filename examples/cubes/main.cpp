@@ -1,16 +1,23 @@
-#pragma once
-
 #include <vector>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include "OpenGLExampleBase.h"
 #include "OpenGLUtils.h"
 
 #include <chrono>
 #include <memory>
-#include <windows.h>
+
+#include "Bvh.h"
+#include "DebugDraw.h"
+#include "EntityWorld.h"
+#include "RenderComponents.h"
+#include "RenderQueue.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+#include "VertexLayout.h"
 
 class Timer {
 public:
@@ -27,40 +34,6 @@ private:
     std::chrono::time_point<std::chrono::high_resolution_clock> tpStop;
 };
 
-	void mtxRotateXY(float* _result, float _ax, float _ay)
-	{
-		const float sx = sin(_ax);
-		const float cx = cos(_ax);
-		const float sy = sin(_ay);
-		const float cy = cos(_ay);
-
-		memset(_result, 0, sizeof(float)*16);
-		_result[ 0] = cy;
-		_result[ 2] = sy;
-		_result[ 4] = sx*sy;
-		_result[ 5] = cx;
-		_result[ 6] = -sx*cy;
-		_result[ 8] = -cx*sy;
-		_result[ 9] = sx;
-		_result[10] = cx*cy;
-		_result[15] = 1.0f;
-	}
-
-    int64_t getHPCounter()
-	{
-		LARGE_INTEGER li;
-		QueryPerformanceCounter(&li);
-		int64_t i64 = li.QuadPart;
-		return i64;
-	}
-
-    int64_t getHPFrequency()
-	{
-		LARGE_INTEGER li;
-		QueryPerformanceFrequency(&li);
-		return li.QuadPart;
-	}
-
 class CubesExample : public OpenGLExampleBase
 {
 public:
@@ -70,6 +43,8 @@ public:
         glm::vec4 color;
     };
 
+    using VertexLayout = utils::VertexLayout<Vertex, UTILS_VERTEX_ATTRIBUTE(Vertex, position), UTILS_VERTEX_ATTRIBUTE(Vertex, color)>;
+
     CubesExample()
     {
 
@@ -94,38 +69,6 @@ public:
             { { 1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f, 1.0f} },
         };
 
-        const uint32_t cubeTriList[] =
-        {
-            0, 1, 2, // 0
-            1, 3, 2,
-            4, 6, 5, // 2
-            5, 6, 7,
-            0, 2, 4, // 4
-            4, 2, 6,
-            1, 5, 3, // 6
-            5, 7, 3,
-            0, 4, 1, // 8
-            4, 5, 1,
-            2, 3, 6, // 10
-            6, 3, 7,
-        };
-
-        const uint16_t cubeTriStrip[] =
-        {
-            0, 1, 2,
-            3,
-            7,
-            1,
-            5,
-            0,
-            4,
-            2,
-            6,
-            7,
-            4,
-            5,
-        };
-
         const uint32_t cubeLineList[] =
         {
             0, 1,
@@ -142,61 +85,30 @@ public:
             6, 7,
         };
 
-        const uint16_t cubeLineStrip[] =
+        // picking intersects the cursor ray with the twelve triangles of the cube's faces
+        const uint32_t cubeTriangles[] =
         {
-            0, 2, 3, 1, 5, 7, 6, 4,
-            0, 2, 6, 4, 5, 7, 3, 1,
-            0,
-        };
-
-        const uint16_t cubePoints[] =
-        {
-            0, 1, 2, 3, 4, 5, 6, 7
+            0, 2, 1,  1, 2, 3,
+            4, 5, 6,  5, 7, 6,
+            0, 1, 4,  1, 5, 4,
+            2, 6, 3,  3, 6, 7,
+            0, 4, 2,  2, 4, 6,
+            1, 3, 5,  3, 7, 5,
         };
+        mCubeBvh.build(&cubeVertices[0].position.x, uint32_t(cubeVertices.size()), sizeof(Vertex) / sizeof(float), cubeTriangles, 36);
 
         glGenBuffers(1, &mVbo);
         glBindBuffer(GL_ARRAY_BUFFER, mVbo);
         glBufferData(GL_ARRAY_BUFFER, cubeVertices.size() * sizeof(Vertex), cubeVertices.data(), GL_STATIC_DRAW);
         glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-        glGenBuffers(1, &mIbo0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo0);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeTriList), cubeTriList, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glGenBuffers(1, &mIbo1);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo1);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeTriStrip), cubeTriStrip, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glGenBuffers(1, &mIbo2);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo2);
+        glGenBuffers(1, &mIbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo);
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeLineList), cubeLineList, GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-        glGenBuffers(1, &mIbo3);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo3);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeLineStrip), cubeLineStrip, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-        glGenBuffers(1, &mIbo4);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo4);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubePoints), cubePoints, GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-
-        glGenVertexArrays(1, &mVao);
-        glBindVertexArray(mVao);
-
-        glBindBuffer(GL_ARRAY_BUFFER, mVbo);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIbo2);
-
-        glBindVertexArray(0);
+        // shared by every mesh with this vertex layout, the render queue attaches the buffers per draw
+        mVao = utils::VertexArrayCache::global().acquire<VertexLayout>();
 
         auto vertexShader   = utils::OpenglShader::create(getShadersPath() + "cubes/cubes.vert", GL_VERTEX_SHADER);
         auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "cubes/cubes.frag", GL_FRAGMENT_SHADER);
@@ -205,10 +117,27 @@ public:
 
         mMVPMatrixLocation = glGetUniformLocation(mProgram->id, "u_modelViewProjectionMatrix");
 
-        mTimer.start();
-
-        m_timeOffset = getHPCounter();
+        // the same 11x11 grid of cubes as before, parented to a root that is shifted as a whole
+        mRoot = mTransforms.create({}, glm::vec3(-15.0f, -15.0f, 0.0f));
+        for (uint32_t yy = 0; yy < kGridSize; ++yy)
+        {
+            for (uint32_t xx = 0; xx < kGridSize; ++xx)
+            {
+                const utils::TransformHandle transform = mTransforms.create(mRoot, glm::vec3(float(xx) * 3.0f, float(yy) * 3.0f, 0.0f));
+                mCubes.push_back(transform);
+
+                mScene.create(utils::TransformComponent{ transform }, utils::WorldTransform(),
+                    utils::MeshComponent{ mVao, GL_LINES, 24, GL_UNSIGNED_INT, mVbo, mIbo, VertexLayout::stride },
+                    utils::MaterialComponent{ mProgram->id, mMVPMatrixLocation, 0 },
+                    utils::BoundsComponent{ glm::vec3(0.0f), std::sqrt(3.0f) });
+            }
+        }
+
+        auto debugVertexShader = utils::OpenglShader::create(getShadersPath() + "debug/debug.vert", GL_VERTEX_SHADER);
+        auto debugFragmentShader = utils::OpenglShader::create(getShadersPath() + "debug/debug.frag", GL_FRAGMENT_SHADER);
+        mDebugDraw.init(utils::OpenglProgram::create(debugVertexShader, debugFragmentShader));
 
+        mTimer.start();
     }
 
 
@@ -230,43 +159,135 @@ public:
         const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(mWidth)/float(mHeight), 0.1f, 100.0f);
 
 
-        //float time = (float)mTimer.getSeconds();
-        float time = (float)((getHPCounter() - m_timeOffset) / double(getHPFrequency()));
+        const float time = float(glfwGetTime());
 
-        float mtx[16];
-        mtxRotateXY(mtx, time + 1.0f * 0.21f, time + 1.0f * 0.37f);
-        mtx[12] = -15.0f + float(0) * 3.0f;
-        mtx[13] = -15.0f + float(0) * 3.0f;
-        mtx[14] = 0.0f;
+        for (uint32_t yy = 0; yy < kGridSize; ++yy)
+        {
+            for (uint32_t xx = 0; xx < kGridSize; ++xx)
+            {
+                const glm::vec3 angles(time + float(xx) * 0.21f, time + float(yy) * 0.37f, 0.0f);
+                mTransforms.setLocalRotation(mCubes[yy * kGridSize + xx], glm::quat(angles));
+            }
+        }
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "transforms");
+            mTransforms.update(proj * view, &utils::ThreadPool::global());
+            utils::syncTransforms(mScene, mTransforms);
+        }
 
-        auto model = glm::make_mat4(mtx);
-        const glm::mat4 mvp = proj * view * model;
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "picking");
+            updatePicking();
+            mViewProjection = proj * view;
 
-        glUniformMatrix4fv(mMVPMatrixLocation, 1, GL_FALSE, &mvp[0][0]);
+            // the cubes turn under a resting cursor as well
+            pick();
+        }
 
-		mProgram->use();
-		glBindVertexArray(mVao);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glDrawElements(GL_LINES, 24, GL_UNSIGNED_INT, 0);
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "cubes");
+            mQueue.reset(mScene.count<utils::MeshComponent>());
+            utils::submitRenderables(mScene, view, proj, mQueue);
+            mQueue.sort();
+            mQueue.execute();
+        }
+
+        UTILS_PROFILE_SCOPE(mProfiler, "debug draw");
+
+        // B toggles the bounding spheres used for culling
+        mDebugDraw.grid(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, 3.0f)) * glm::mat4_cast(glm::quat(glm::vec3(glm::radians(90.0f), 0.0f, 0.0f))),
+            36.0f, 12, glm::vec4(0.3f, 0.3f, 0.3f, 1.0f));
+        mDebugDraw.axis(mTransforms.getWorldMatrix(mRoot), 2.0f, false);
+        if (mShowBounds)
+        {
+            for (utils::TransformHandle cube : mCubes)
+            {
+                mDebugDraw.sphere(glm::vec3(mTransforms.getWorldMatrix(cube)[3]), std::sqrt(3.0f), glm::vec4(1.0f, 0.8f, 0.2f, 0.5f));
+            }
+        }
+        if (mPicked != utils::RayHit::kNone)
+        {
+            mDebugDraw.box(mTransforms.getWorldMatrix(mCubes[mPicked]) * glm::scale(glm::mat4(1.0f), glm::vec3(1.1f)),
+                glm::vec4(1.0f, 0.3f, 0.2f, 1.0f), false);
+        }
+        mDebugDraw.render(proj * view);
+    }
 
+    void onKeyDown(int key) override
+    {
+        if (key == GLFW_KEY_B)
+        {
+            mShowBounds = !mShowBounds;
+        }
+    }
+
+    void onMouseMove() override
+    {
+        pick();
     }
 
 
 private:
+    // the cube instances only rotate in place, refitting keeps the top level tight enough
+    void updatePicking()
+    {
+        mInstances.resize(mCubes.size());
+        for (size_t i = 0; i < mCubes.size(); ++i)
+        {
+            mInstances[i].mesh = &mCubeBvh;
+            mInstances[i].transform = mTransforms.getWorldMatrix(mCubes[i]);
+        }
+
+        if (mSceneBvh.getBvh().isEmpty())
+        {
+            mSceneBvh.build(mInstances.data(), uint32_t(mInstances.size()));
+        }
+        else
+        {
+            mSceneBvh.refit(mInstances.data());
+        }
+    }
+
+    void pick()
+    {
+        if (mSceneBvh.getBvh().isEmpty())
+        {
+            return;
+        }
+
+        utils::RayHit hit;
+        mSceneBvh.intersect(getMouseRay(mViewProjection), hit);
+        mPicked = hit.object;
+    }
+
     GLuint mVao;
     GLuint mVbo;
-    GLuint mIbo0;
-    GLuint mIbo1;
-    GLuint mIbo2;
-    GLuint mIbo3;
-    GLuint mIbo4;
+    GLuint mIbo;
 
     GLint mMVPMatrixLocation;
 
     std::shared_ptr<utils::OpenglProgram> mProgram;
 
+    static constexpr uint32_t kGridSize = 11;
+
+    utils::TransformHierarchy mTransforms;
+    utils::TransformHandle mRoot;
+    std::vector<utils::TransformHandle> mCubes;
+
+    utils::EntityWorld mScene;
+    utils::RenderQueue mQueue;
+
+    utils::DebugDraw mDebugDraw;
+    bool mShowBounds = false;
+
+    utils::MeshBvh mCubeBvh;
+    utils::SceneBvh mSceneBvh;
+    std::vector<utils::BvhInstance> mInstances;
+    glm::mat4 mViewProjection = glm::mat4(1.0f);
+    // index into mCubes of the cube under the cursor
+    uint32_t mPicked = utils::RayHit::kNone;
+
     Timer mTimer;
-    int64_t m_timeOffset;
 };
 
 
@@ -44,36 +44,25 @@ public:
         // create plane mesh
         auto plane = utils::Mesh::createPlane(mTexture->getWidth() / 2.0f, mTexture->getHeight() / 2.0f);
 
-        // create buffers
-        glGenBuffers(1, &mVerticesBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, mVerticesBuffer);
-        glBufferData(GL_ARRAY_BUFFER, plane->mVertices.size() * sizeof(float), plane->mVertices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glGenBuffers(1, &mTexCoordsBuffer);
-        glBindBuffer(GL_ARRAY_BUFFER, mTexCoordsBuffer);
-        glBufferData(GL_ARRAY_BUFFER, plane->mTextCoords.size() * sizeof(float), plane->mTextCoords.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        glGenBuffers(1, &mIndicesBuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, plane->mIndices.size() * sizeof(uint32_t), plane->mIndices.data(), GL_STATIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        // create buffers, the plane is static so GpuResidency may evict it while the example is idle
+        mVerticesBuffer = utils::VertexBuffer::create(plane->mVertices.size() * sizeof(float), plane->mVertices.data(), utils::BUFFER_NONE, true);
+        mTexCoordsBuffer = utils::VertexBuffer::create(plane->mTextCoords.size() * sizeof(float), plane->mTextCoords.data(), utils::BUFFER_NONE, true);
+        mIndicesBuffer = utils::IndexBuffer::create(plane->mIndices.size() * sizeof(uint32_t), plane->mIndices.data(), utils::BUFFER_NONE, true);
 
         
         // create vertext array and bind attribute buffers
         glGenVertexArrays(1, &mVAO);
         glBindVertexArray(mVAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, mVerticesBuffer);
+        mVerticesBuffer->bind();
         glVertexAttribPointer(mVertexLocation, 4, GL_FLOAT, GL_FALSE, 0, 0);
         glEnableVertexAttribArray(mVertexLocation);
 
-        glBindBuffer(GL_ARRAY_BUFFER, mTexCoordsBuffer);
+        mTexCoordsBuffer->bind();
         glVertexAttribPointer(mTexCoordLocation, 2, GL_FLOAT, GL_FALSE, 0, 0);
         glEnableVertexAttribArray(mTexCoordLocation);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndicesBuffer);
+        mIndicesBuffer->bind();
 
         glBindVertexArray(0);
     }
@@ -99,6 +88,11 @@ public:
 
         mProgram->use();
 
+        // the VAO keeps the buffer names, touching restreams them if they were evicted
+        mVerticesBuffer->touch();
+        mTexCoordsBuffer->touch();
+        mIndicesBuffer->touch();
+
         glBindVertexArray(mVAO);
         mTexture->bind(0);
         glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
@@ -107,9 +101,9 @@ public:
 
 private:
     GLuint mVAO;
-    GLuint mVerticesBuffer;
-    GLuint mTexCoordsBuffer;
-    GLuint mIndicesBuffer;
+    std::shared_ptr<utils::VertexBuffer> mVerticesBuffer;
+    std::shared_ptr<utils::VertexBuffer> mTexCoordsBuffer;
+    std::shared_ptr<utils::IndexBuffer> mIndicesBuffer;
 
     GLint mVertexLocation;
     GLint mTexCoordLocation;
@@ -0,0 +1,450 @@
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ClusteredLighting.h"
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+#include "ThreadPool.h"
+
+class LightsExample : public OpenGLExampleBase
+{
+public:
+    LightsExample(bool headless, uint64_t frameLimit, double resolutionTarget)
+    {
+        mHeadless = headless;
+        mFrameLimit = frameLimit;
+        mResolutionTarget = resolutionTarget;
+    }
+
+    ~LightsExample()
+    {
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(1, &mVertexBuffer);
+        glDeleteBuffers(1, &mIndexBuffer);
+        glDeleteBuffers(1, &mInstanceBuffer);
+    }
+
+    void prepare() override
+    {
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "lights/lit.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "lights/lit.frag", GL_FRAGMENT_SHADER);
+        mProgram = utils::OpenglProgram::create(vertexShader, fragmentShader);
+
+        utils::ClusterGridSettings settings;
+        settings.maxLights = kMaxLights;
+        mLighting.init(settings);
+
+        createBox();
+        createScene();
+        createLights();
+
+        if (mResolutionTarget > 0.0)
+        {
+            utils::DynamicResolutionSettings resolutionSettings;
+            resolutionSettings.targetGpuTime = mResolutionTarget;
+            enableDynamicResolution(resolutionSettings);
+        }
+
+        if (mHeadless)
+        {
+            reportAssignmentTimes();
+        }
+    }
+
+    void render() override
+    {
+        const uint64_t frame = mFramePacer.getStats().frameCount;
+        if (mHeadless)
+        {
+            // every phase gets an equal share of the frames
+            const uint64_t phaseFrames = std::max<uint64_t>(mFrameLimit / kPhaseCount, 1);
+            const uint32_t phase = uint32_t(std::min<uint64_t>(frame / phaseFrames, kPhaseCount - 1));
+            if (phase != mPhase)
+            {
+                reportPhase();
+                mPhase = phase;
+            }
+            mLightCount = kPhases[mPhase].lights;
+            mNaive = kPhases[mPhase].naive;
+        }
+
+        const float time = mHeadless ? float(frame) / 60.0f : float(glfwGetTime());
+        animateLights(time, mLightCount);
+
+        // orbiting high above the floor, looking down at the pillars
+        const glm::vec3 eye(std::sin(time * 0.1f) * 55.0f, 28.0f, std::cos(time * 0.1f) * 55.0f);
+        const glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(mWidth) / float(mHeight), 0.5f, 200.0f);
+
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "light assignment");
+            mLighting.update(view, projection, mLights.data(), mLightCount, &utils::ThreadPool::global());
+        }
+
+        const uint32_t width = getRenderWidth();
+        const uint32_t height = getRenderHeight();
+        glViewport(0, 0, width, height);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "shading");
+
+            mProgram->use();
+            mProgram->setMat4("u_viewProjection", projection * view);
+            mProgram->setVec3("u_eye", eye);
+            mProgram->setBool("u_naive", mNaive);
+            mLighting.bind(*mProgram, width, height);
+
+            glBindVertexArray(mVao);
+            glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, GLsizei(mInstanceCount));
+            glBindVertexArray(0);
+        }
+
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+
+        // profiler zones lag a few frames, skip those still measuring the previous phase
+        const utils::ClusteredLightingStats& stats = mLighting.getStats();
+        if (mSkipFrames > 0)
+        {
+            --mSkipFrames;
+        }
+        else
+        {
+            for (const utils::ProfileZone& zone : mProfiler.getZones())
+            {
+                if (zone.name == std::string("shading"))
+                {
+                    mShadingTime += zone.gpuTime;
+                }
+                else if (zone.name == std::string("frame"))
+                {
+                    mFrameTime += zone.gpuTime;
+                    mFrameTimeSquares += zone.gpuTime * zone.gpuTime;
+                    mMissedFrames += mResolutionTarget > 0.0 && zone.gpuTime > mResolutionTarget ? 1 : 0;
+                }
+            }
+            mScaleSum += mDynamicResolution.isEnabled() ? mDynamicResolution.getStats().scale : 1.0;
+            mAssignTime += stats.assignTime;
+            mUploadTime += stats.uploadTime;
+            mMaxPerCluster = std::max(mMaxPerCluster, stats.maxLightsPerCluster);
+            ++mPhaseFrames;
+        }
+
+        const double now = glfwGetTime();
+        if (!mHeadless && now - mLastReport >= 2.0)
+        {
+            std::cout << stats.lights << " lights, " << (mNaive ? "naive" : "clustered") << ": assignment " << stats.assignTime << " ms, upload "
+                << stats.uploadTime << " ms, " << stats.lightIndices << " light indices, at most " << stats.maxLightsPerCluster << " per cluster" << std::endl;
+            mLastReport = now;
+        }
+    }
+
+    void renderLoopFinished()
+    {
+        if (mHeadless)
+        {
+            reportPhase();
+        }
+    }
+
+    void onKeyDown(int key) override
+    {
+        if (key == GLFW_KEY_N)
+        {
+            mNaive = !mNaive;
+        }
+        else if (key == GLFW_KEY_L)
+        {
+            mLightCount = mLightCount == kMaxLights ? 1000 : std::min(mLightCount * 10, kMaxLights);
+        }
+    }
+
+private:
+    static constexpr uint32_t kMaxLights = 10000;
+    static constexpr uint32_t kPillars = 24;
+    static constexpr float kSpacing = 4.0f;
+
+    struct Phase
+    {
+        uint32_t lights;
+        bool naive;
+    };
+
+    static constexpr uint32_t kPhaseCount = 4;
+    static constexpr Phase kPhases[kPhaseCount] = { { 1000, false }, { 1000, true }, { 10000, false }, { 10000, true } };
+
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    // per instance, the unit box is scaled and moved into place in the vertex shader
+    struct Box
+    {
+        glm::vec4 center;
+        glm::vec4 halfExtent;
+    };
+
+    // a light wandering on a circle around its anchor
+    struct Wanderer
+    {
+        glm::vec3 anchor;
+        float radius;
+        float speed;
+        float phase;
+    };
+
+    void reportPhase()
+    {
+        if (mPhaseFrames > 0)
+        {
+            const Phase& phase = kPhases[mPhase];
+            std::cout << phase.lights << " lights, " << (phase.naive ? "naive" : "clustered") << ": shading gpu time "
+                << mShadingTime / double(mPhaseFrames) << " ms, assignment " << mAssignTime / double(mPhaseFrames) << " ms, upload "
+                << mUploadTime / double(mPhaseFrames) << " ms, at most " << mMaxPerCluster << " lights per cluster" << std::endl;
+
+            // the naive phases are load spikes, with dynamic resolution the frame time should stay near the target
+            const double frameTime = mFrameTime / double(mPhaseFrames);
+            const double variance = std::max(mFrameTimeSquares / double(mPhaseFrames) - frameTime * frameTime, 0.0);
+            std::cout << "  frame gpu time " << frameTime << " ms, stddev " << std::sqrt(variance) << " ms, resolution scale "
+                << mScaleSum / double(mPhaseFrames);
+            if (mResolutionTarget > 0.0)
+            {
+                std::cout << ", " << mMissedFrames << " of " << mPhaseFrames << " frames over " << mResolutionTarget << " ms";
+            }
+            std::cout << std::endl;
+        }
+        mShadingTime = 0.0;
+        mFrameTime = 0.0;
+        mFrameTimeSquares = 0.0;
+        mScaleSum = 0.0;
+        mMissedFrames = 0;
+        mAssignTime = 0.0;
+        mUploadTime = 0.0;
+        mMaxPerCluster = 0;
+        mPhaseFrames = 0;
+        mSkipFrames = utils::Profiler::kFrameLatency + 1;
+    }
+
+    // light assignment on the CPU only, per SIMD level and with and without the thread pool
+    void reportAssignmentTimes()
+    {
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 28.0f, 55.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(mWidth) / float(mHeight), 0.5f, 200.0f);
+        const utils::SimdLevel levels[] = { utils::SimdLevel::SIMD_SCALAR, utils::getSupportedSimdLevel() };
+
+        for (uint32_t count : { 1000u, 10000u })
+        {
+            for (utils::SimdLevel level : levels)
+            {
+                for (utils::ThreadPool* pool : { (utils::ThreadPool*)nullptr, &utils::ThreadPool::global() })
+                {
+                    mLighting.setSimdLevel(level);
+                    double best = 1e9;
+                    for (uint32_t run = 0; run < 20; ++run)
+                    {
+                        mLighting.update(view, projection, mLights.data(), count, pool);
+                        best = std::min(best, mLighting.getStats().assignTime);
+                    }
+                    std::cout << "assignment of " << count << " lights, " << utils::getSimdLevelName(level)
+                        << (pool != nullptr ? ", thread pool: " : ", one thread: ") << best << " ms, "
+                        << mLighting.getStats().lightIndices << " light indices" << std::endl;
+                }
+            }
+        }
+        mLighting.setSimdLevel(utils::getSupportedSimdLevel());
+    }
+
+    void createBox()
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                glm::vec3 normal(0.0f);
+                normal[axis] = side == 0 ? -1.0f : 1.0f;
+                const glm::vec3 u = glm::vec3(normal.y, normal.z, normal.x);
+                const glm::vec3 v = glm::cross(normal, u);
+
+                const uint32_t base = uint32_t(vertices.size());
+                vertices.push_back({ normal - u - v, normal });
+                vertices.push_back({ normal + u - v, normal });
+                vertices.push_back({ normal + u + v, normal });
+                vertices.push_back({ normal - u + v, normal });
+                indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+            }
+        }
+
+        glCreateBuffers(1, &mVertexBuffer);
+        glNamedBufferStorage(mVertexBuffer, GLsizeiptr(vertices.size() * sizeof(Vertex)), vertices.data(), 0);
+        glCreateBuffers(1, &mIndexBuffer);
+        glNamedBufferStorage(mIndexBuffer, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+    }
+
+    void createScene()
+    {
+        std::mt19937 random(5);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // a floor with a grid of pillars, lights wander between them
+        std::vector<Box> boxes;
+        const float half = float(kPillars) * kSpacing * 0.5f;
+        boxes.push_back({ glm::vec4(0.0f, -0.5f, 0.0f, -1.0f), glm::vec4(half + kSpacing, 0.5f, half + kSpacing, 0.0f) });
+        for (uint32_t z = 0; z < kPillars; ++z)
+        {
+            for (uint32_t x = 0; x < kPillars; ++x)
+            {
+                const float height = 1.0f + unit(random) * 5.0f;
+                const glm::vec2 position = (glm::vec2(float(x), float(z)) + 0.5f) * kSpacing - half;
+                boxes.push_back({ glm::vec4(position.x, height * 0.5f, position.y, unit(random)), glm::vec4(0.5f, height * 0.5f, 0.5f, 0.0f) });
+            }
+        }
+        mInstanceCount = uint32_t(boxes.size());
+
+        glCreateBuffers(1, &mInstanceBuffer);
+        glNamedBufferStorage(mInstanceBuffer, GLsizeiptr(boxes.size() * sizeof(Box)), boxes.data(), 0);
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mVertexBuffer, 0, sizeof(Vertex));
+        glVertexArrayVertexBuffer(mVao, 1, mInstanceBuffer, 0, sizeof(Box));
+        glVertexArrayBindingDivisor(mVao, 1, 1);
+        glVertexArrayElementBuffer(mVao, mIndexBuffer);
+
+        glVertexArrayAttribFormat(mVao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexArrayAttribFormat(mVao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        glVertexArrayAttribFormat(mVao, 2, 4, GL_FLOAT, GL_FALSE, offsetof(Box, center));
+        glVertexArrayAttribFormat(mVao, 3, 4, GL_FLOAT, GL_FALSE, offsetof(Box, halfExtent));
+        for (GLuint attribute = 0; attribute < 4; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, attribute < 2 ? 0 : 1);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+    }
+
+    void createLights()
+    {
+        std::mt19937 random(9);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // every fifth light is a spot light pointing down
+        const float half = float(kPillars) * kSpacing * 0.5f;
+        mLights.resize(kMaxLights);
+        mWanderers.resize(kMaxLights);
+        for (uint32_t i = 0; i < kMaxLights; ++i)
+        {
+            utils::Light& light = mLights[i];
+            light.color = glm::vec3(0.3f) + 0.7f * glm::vec3(unit(random), unit(random), unit(random));
+            light.range = 1.5f + unit(random) * 3.0f;
+            light.intensity = 2.0f;
+            if (i % 5 == 0)
+            {
+                light.type = utils::LIGHT_SPOT;
+                light.range *= 2.0f;
+                light.intensity = 6.0f;
+                light.innerAngle = 0.2f + unit(random) * 0.2f;
+                light.outerAngle = light.innerAngle + 0.2f;
+            }
+
+            Wanderer& wanderer = mWanderers[i];
+            wanderer.anchor = glm::vec3((unit(random) * 2.0f - 1.0f) * half, 0.5f + unit(random) * 3.0f, (unit(random) * 2.0f - 1.0f) * half);
+            wanderer.radius = 0.5f + unit(random) * 3.0f;
+            wanderer.speed = (unit(random) - 0.5f) * 1.5f;
+            wanderer.phase = unit(random) * 6.2831853f;
+        }
+        animateLights(0.0f, kMaxLights);
+    }
+
+    void animateLights(float time, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Wanderer& wanderer = mWanderers[i];
+            const float angle = wanderer.phase + wanderer.speed * time;
+            mLights[i].position = wanderer.anchor + glm::vec3(std::cos(angle), 0.0f, std::sin(angle)) * wanderer.radius;
+        }
+    }
+
+    std::shared_ptr<utils::OpenglProgram> mProgram;
+    utils::ClusteredLighting mLighting;
+    std::vector<utils::Light> mLights;
+    std::vector<Wanderer> mWanderers;
+    uint32_t mLightCount = 1000;
+    bool mNaive = false;
+
+    GLuint mVao = 0;
+    GLuint mVertexBuffer = 0;
+    GLuint mIndexBuffer = 0;
+    GLuint mInstanceBuffer = 0;
+    uint32_t mInstanceCount = 0;
+
+    double mLastReport = 0.0;
+    uint32_t mPhase = 0;
+    uint32_t mPhaseFrames = 0;
+    uint32_t mSkipFrames = utils::Profiler::kFrameLatency + 1;
+    uint32_t mMaxPerCluster = 0;
+    double mShadingTime = 0.0;
+    double mAssignTime = 0.0;
+    double mUploadTime = 0.0;
+    double mFrameTime = 0.0;
+    double mFrameTimeSquares = 0.0;
+    double mScaleSum = 0.0;
+    uint32_t mMissedFrames = 0;
+
+    // GPU milliseconds per frame dynamic resolution aims for, 0 renders at full resolution
+    double mResolutionTarget = 0.0;
+};
+
+
+int main(int argc, char** argv)
+{
+    bool headless = false;
+    uint64_t frameLimit = 0;
+    double resolutionTarget = 0.0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            headless = true;
+            frameLimit = 80;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                frameLimit = std::stoull(argv[++i]);
+        }
+        else if (arg == "--dynamic-resolution")
+        {
+            resolutionTarget = 14.0;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                resolutionTarget = std::stod(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Usage: lights [--headless [frames]] [--dynamic-resolution [target gpu ms]]" << std::endl;
+            return 1;
+        }
+    }
+
+    LightsExample lightsExample(headless, frameLimit, resolutionTarget);
+    lightsExample.setupWindow();
+    lightsExample.prepare();
+    lightsExample.renderLoop();
+    lightsExample.renderLoopFinished();
+
+    return 0;
+}
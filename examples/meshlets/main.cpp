@@ -0,0 +1,260 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Meshlets.h"
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+
+class MeshletsExample : public OpenGLExampleBase
+{
+public:
+    MeshletsExample(bool headless, uint64_t frameLimit, uint32_t resolution)
+    {
+        mHeadless = headless;
+        mFrameLimit = frameLimit;
+        mResolution = resolution;
+    }
+
+    ~MeshletsExample()
+    {
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(4, mBuffers);
+    }
+
+    void prepare() override
+    {
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "meshlets/meshlets.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "meshlets/meshlets.frag", GL_FRAGMENT_SHADER);
+        mProgram = utils::OpenglProgram::create(vertexShader, fragmentShader);
+
+        // a dense, bumpy sphere standing in for a scanned model
+        mMesh = utils::Mesh::createSphere(mResolution, 0.05f);
+        const double start = glfwGetTime();
+        utils::buildMeshlets(*mMesh, mMeshlets);
+        std::cout << mMesh->mIndices.size() / 3 << " triangles in " << mMeshlets.meshlets.size() << " meshlets, built in "
+            << (glfwGetTime() - start) * 1000.0 << " ms" << std::endl;
+
+        const uint32_t count = uint32_t(mMeshlets.meshlets.size());
+        auto cullShader = utils::OpenglShader::create(getShadersPath() + "meshlets/meshlet_cull.comp", GL_COMPUTE_SHADER);
+        mCuller.init(utils::OpenglProgram::create(cullShader), count);
+        mCuller.setMeshlets(mMeshlets.meshlets.data(), count);
+
+        createBuffers();
+
+        // headless runs measure the first half drawing the whole mesh and the second half culling meshlets
+        mCulling = !mHeadless;
+    }
+
+    void render() override
+    {
+        const uint64_t frame = mFramePacer.getStats().frameCount;
+        if (mHeadless && frame == mFrameLimit / 2)
+        {
+            reportTimes("whole mesh");
+            mCulling = true;
+        }
+
+        // orbiting close to the surface, so part of the sphere is outside the frustum as well as facing away
+        const float time = mHeadless ? float(frame) / 60.0f : float(glfwGetTime());
+        const glm::vec3 eye = glm::vec3(std::cos(time * 0.4f), 0.4f * std::sin(time * 0.3f), std::sin(time * 0.4f)) * 1.6f;
+        const glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), float(mWidth) / float(mHeight), 0.05f, 10.0f);
+        const glm::mat4 viewProjection = projection * view;
+
+        glViewport(0, 0, mWidth, mHeight);
+        glClearColor(0.1f, 0.1f, 0.12f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "scene");
+
+            // the mesh isn't transformed, world space is the meshlets' object space
+            if (mCulling)
+            {
+                mCuller.cull(viewProjection, eye);
+            }
+
+            mProgram->use();
+            mProgram->setMat4("u_viewProjection", viewProjection);
+            mProgram->setVec3("u_lightDirection", glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f)));
+            mProgram->setBool("u_showMeshlets", mShowMeshlets);
+            glBindVertexArray(mVao);
+            if (mCulling)
+            {
+                mCuller.draw();
+            }
+            else
+            {
+                // every meshlet's id is 0 without the culler's baseInstance
+                glDrawElements(GL_TRIANGLES, GLsizei(mMeshlets.indices.size()), GL_UNSIGNED_INT, nullptr);
+            }
+            glBindVertexArray(0);
+        }
+
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+
+        // timings and stats lag a few frames, skip those still measuring the previous mode
+        const utils::MeshletCullStats& stats = mCuller.getStats();
+        if (mSkipFrames > 0)
+        {
+            --mSkipFrames;
+        }
+        else
+        {
+            for (const utils::ProfileZone& zone : mProfiler.getZones())
+            {
+                if (zone.name == std::string("scene"))
+                {
+                    mSceneTime += zone.gpuTime;
+                    ++mSceneFrames;
+                }
+            }
+            mCulledTriangles += mCulling ? stats.triangles - stats.visibleTriangles : 0;
+        }
+
+        const double now = glfwGetTime();
+        if (!mHeadless && mCulling && now - mLastReport >= 2.0)
+        {
+            std::cout << "meshlets: " << stats.visibleMeshlets << " of " << stats.meshlets << " drawn, " << stats.frustumCulled
+                << " outside the frustum, " << stats.coneCulled << " facing away, " << stats.triangles - stats.visibleTriangles << " of "
+                << stats.triangles << " triangles culled" << std::endl;
+            mLastReport = now;
+        }
+    }
+
+    void renderLoopFinished()
+    {
+        if (mHeadless)
+        {
+            reportTimes("meshlet culling");
+        }
+    }
+
+    void onKeyDown(int key) override
+    {
+        if (key == GLFW_KEY_C)
+        {
+            mCulling = !mCulling;
+        }
+        else if (key == GLFW_KEY_V)
+        {
+            mCuller.setConeCullingEnabled(!mCuller.isConeCullingEnabled());
+        }
+        else if (key == GLFW_KEY_M)
+        {
+            mShowMeshlets = !mShowMeshlets;
+        }
+    }
+
+private:
+    void reportTimes(const char* mode)
+    {
+        if (mSceneFrames > 0)
+        {
+            const double triangles = double(mMesh->mIndices.size() / 3);
+            std::cout << mode << ": scene gpu time " << mSceneTime / double(mSceneFrames) << " ms, "
+                << 100.0 * double(mCulledTriangles) / double(mSceneFrames) / triangles << "% of triangles culled per frame" << std::endl;
+        }
+        mSceneTime = 0.0;
+        mSceneFrames = 0;
+        mCulledTriangles = 0;
+        mSkipFrames = utils::MeshletCuller::kFrameLatency + 1;
+    }
+
+    void createBuffers()
+    {
+        // the instanced attribute turns each command's baseInstance back into its meshlet's index
+        std::vector<uint32_t> ids(mMeshlets.meshlets.size());
+        for (uint32_t i = 0; i < uint32_t(ids.size()); ++i)
+        {
+            ids[i] = i;
+        }
+
+        glCreateBuffers(4, mBuffers);
+        glNamedBufferStorage(mBuffers[0], GLsizeiptr(mMesh->mVertices.size() * sizeof(float)), mMesh->mVertices.data(), 0);
+        glNamedBufferStorage(mBuffers[1], GLsizeiptr(mMesh->mNormals.size() * sizeof(float)), mMesh->mNormals.data(), 0);
+        glNamedBufferStorage(mBuffers[2], GLsizeiptr(ids.size() * sizeof(uint32_t)), ids.data(), 0);
+        glNamedBufferStorage(mBuffers[3], GLsizeiptr(mMeshlets.indices.size() * sizeof(uint32_t)), mMeshlets.indices.data(), 0);
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mBuffers[0], 0, 4 * sizeof(float));
+        glVertexArrayVertexBuffer(mVao, 1, mBuffers[1], 0, 3 * sizeof(float));
+        glVertexArrayVertexBuffer(mVao, 2, mBuffers[2], 0, sizeof(uint32_t));
+        glVertexArrayBindingDivisor(mVao, 2, 1);
+        glVertexArrayElementBuffer(mVao, mBuffers[3]);
+
+        glVertexArrayAttribFormat(mVao, 0, 4, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribFormat(mVao, 1, 3, GL_FLOAT, GL_FALSE, 0);
+        glVertexArrayAttribIFormat(mVao, 2, 1, GL_UNSIGNED_INT, 0);
+        for (GLuint attribute = 0; attribute < 3; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, attribute);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+    }
+
+    uint32_t mResolution = 0;
+    std::shared_ptr<utils::Mesh> mMesh;
+    utils::MeshletMesh mMeshlets;
+
+    std::shared_ptr<utils::OpenglProgram> mProgram;
+    utils::MeshletCuller mCuller;
+    bool mCulling = true;
+    bool mShowMeshlets = true;
+
+    GLuint mVao = 0;
+    // positions, normals, meshlet ids and the reordered indices
+    GLuint mBuffers[4] = {};
+
+    double mLastReport = 0.0;
+    double mSceneTime = 0.0;
+    uint32_t mSceneFrames = 0;
+    uint64_t mCulledTriangles = 0;
+    uint32_t mSkipFrames = utils::MeshletCuller::kFrameLatency + 1;
+};
+
+
+int main(int argc, char** argv)
+{
+    bool headless = false;
+    uint64_t frameLimit = 0;
+    uint32_t resolution = 400;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            headless = true;
+            frameLimit = 400;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                frameLimit = std::stoull(argv[++i]);
+        }
+        else if (arg == "--resolution" && i + 1 < argc)
+        {
+            resolution = uint32_t(std::stoul(argv[++i]));
+        }
+        else
+        {
+            std::cerr << "Usage: meshlets [--headless [frames]] [--resolution quads per cube face edge]" << std::endl;
+            return 1;
+        }
+    }
+
+    MeshletsExample meshletsExample(headless, frameLimit, resolution);
+    meshletsExample.setupWindow();
+    meshletsExample.prepare();
+    meshletsExample.renderLoop();
+    meshletsExample.renderLoopFinished();
+
+    return 0;
+}
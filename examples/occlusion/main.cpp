@@ -0,0 +1,334 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OcclusionCuller.h"
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+
+class OcclusionExample : public OpenGLExampleBase
+{
+public:
+    OcclusionExample(bool headless, uint64_t frameLimit)
+    {
+        mHeadless = headless;
+        mFrameLimit = frameLimit;
+    }
+
+    ~OcclusionExample()
+    {
+        glDeleteVertexArrays(1, &mVao);
+        glDeleteBuffers(1, &mVertexBuffer);
+        glDeleteBuffers(1, &mIndexBuffer);
+        glDeleteBuffers(1, &mInstanceBuffer);
+        glDeleteFramebuffers(1, &mFramebuffer);
+        glDeleteTextures(1, &mColor);
+        glDeleteTextures(1, &mDepth);
+    }
+
+    void prepare() override
+    {
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "occlusion/city.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "occlusion/city.frag", GL_FRAGMENT_SHADER);
+        mProgram = utils::OpenglProgram::create(vertexShader, fragmentShader);
+
+        auto pyramidShader = utils::OpenglShader::create(getShadersPath() + "occlusion/depth_pyramid.comp", GL_COMPUTE_SHADER);
+        auto cullShader = utils::OpenglShader::create(getShadersPath() + "occlusion/occlusion_cull.comp", GL_COMPUTE_SHADER);
+        mCuller.init(utils::OpenglProgram::create(pyramidShader), utils::OpenglProgram::create(cullShader), kBlocks * kBlocks * 4);
+        mCuller.resize(mWidth, mHeight);
+
+        createBox();
+        createCity();
+
+        glCreateTextures(GL_TEXTURE_2D, 1, &mColor);
+        glTextureStorage2D(mColor, 1, GL_RGBA8, mWidth, mHeight);
+        glCreateTextures(GL_TEXTURE_2D, 1, &mDepth);
+        glTextureStorage2D(mDepth, 1, GL_DEPTH_COMPONENT32F, mWidth, mHeight);
+        glCreateFramebuffers(1, &mFramebuffer);
+        glNamedFramebufferTexture(mFramebuffer, GL_COLOR_ATTACHMENT0, mColor, 0);
+        glNamedFramebufferTexture(mFramebuffer, GL_DEPTH_ATTACHMENT, mDepth, 0);
+
+        // headless runs measure the first half without and the second half with occlusion culling
+        mCuller.setOcclusionEnabled(!mHeadless);
+    }
+
+    void render() override
+    {
+        const uint64_t frame = mFramePacer.getStats().frameCount;
+        if (mHeadless && frame == mFrameLimit / 2)
+        {
+            reportTimes("frustum culling only");
+            mCuller.setOcclusionEnabled(true);
+        }
+
+        // a camera walking down the streets at eye height, turning slowly
+        const float time = mHeadless ? float(frame) / 60.0f : float(glfwGetTime());
+        const float street = kBlockSize - kStreetWidth * 0.5f;
+        const float half = kBlockSize * float(kBlocks) * 0.5f;
+        const glm::vec3 eye(street + std::sin(time * 0.3f) * 2.0f, 1.7f, -half + std::fmod(time * 8.0f, half * 2.0f));
+        const glm::vec3 forward(std::sin(time * 0.25f), -0.05f, std::cos(time * 0.25f));
+        const glm::mat4 view = glm::lookAt(eye, eye + forward, glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(70.0f), float(mWidth) / float(mHeight), 0.1f, 800.0f);
+        const glm::mat4 viewProjection = projection * view;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+        glViewport(0, 0, mWidth, mHeight);
+        glClearColor(0.55f, 0.65f, 0.8f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        {
+            UTILS_PROFILE_SCOPE(mProfiler, "scene");
+
+            // the culling passes bind their own compute programs
+            mCuller.cullEarly(viewProjection);
+
+            mProgram->use();
+            mProgram->setMat4("u_viewProjection", viewProjection);
+            mProgram->setVec3("u_eye", eye);
+            glBindVertexArray(mVao);
+
+            // the ground is the last instance and never culled
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, 36, GL_UNSIGNED_INT, nullptr, 1, mCuller.getObjectCount());
+            mCuller.draw(utils::OcclusionCuller::PHASE_EARLY);
+
+            mCuller.buildPyramid(mDepth);
+            mCuller.cullLate(viewProjection);
+
+            mProgram->use();
+            mCuller.draw(utils::OcclusionCuller::PHASE_LATE);
+
+            glBindVertexArray(0);
+        }
+
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBlitNamedFramebuffer(mFramebuffer, 0, 0, 0, mWidth, mHeight, 0, 0, mWidth, mHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+        // timings and stats lag a few frames, skip those still measuring the previous mode
+        const utils::OcclusionCullerStats& stats = mCuller.getStats();
+        if (mSkipFrames > 0)
+        {
+            --mSkipFrames;
+        }
+        else
+        {
+            for (const utils::ProfileZone& zone : mProfiler.getZones())
+            {
+                if (zone.name == std::string("scene"))
+                {
+                    mSceneTime += zone.gpuTime;
+                    ++mSceneFrames;
+                }
+            }
+            mCulledObjects += stats.objects - stats.earlyDrawn - stats.lateDrawn;
+        }
+
+        const double now = glfwGetTime();
+        if (!mHeadless && now - mLastReport >= 2.0)
+        {
+            std::cout << "occlusion " << (mCuller.isOcclusionEnabled() ? "on" : "off") << ": " << stats.objects << " objects, "
+                << stats.frustumCulled << " outside the frustum, " << stats.occluded << " occluded, "
+                << stats.earlyDrawn << " drawn early, " << stats.lateDrawn << " drawn late" << std::endl;
+            mLastReport = now;
+        }
+    }
+
+    void renderLoopFinished()
+    {
+        if (mHeadless)
+        {
+            reportTimes("hi-z occlusion culling");
+        }
+    }
+
+    void onKeyDown(int key) override
+    {
+        if (key == GLFW_KEY_C)
+        {
+            mCuller.setOcclusionEnabled(!mCuller.isOcclusionEnabled());
+        }
+    }
+
+private:
+    static constexpr uint32_t kBlocks = 48;
+    static constexpr float kBlockSize = 24.0f;
+    static constexpr float kStreetWidth = 8.0f;
+
+    struct Vertex
+    {
+        glm::vec3 position;
+        glm::vec3 normal;
+    };
+
+    // per instance, the unit box is scaled and moved into place in the vertex shader
+    struct Building
+    {
+        glm::vec4 center;
+        glm::vec4 halfExtent;
+    };
+
+    void reportTimes(const char* mode)
+    {
+        if (mSceneFrames > 0)
+        {
+            std::cout << mode << ": scene gpu time " << mSceneTime / double(mSceneFrames) << " ms, "
+                << double(mCulledObjects) / double(mSceneFrames) << " of " << mCuller.getObjectCount() << " objects culled per frame" << std::endl;
+        }
+        mSceneTime = 0.0;
+        mSceneFrames = 0;
+        mCulledObjects = 0;
+        mSkipFrames = utils::Profiler::kFrameLatency + 1;
+    }
+
+    void createBox()
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                glm::vec3 normal(0.0f);
+                normal[axis] = side == 0 ? -1.0f : 1.0f;
+                const glm::vec3 u = glm::vec3(normal.y, normal.z, normal.x);
+                const glm::vec3 v = glm::cross(normal, u);
+
+                const uint32_t base = uint32_t(vertices.size());
+                vertices.push_back({ normal - u - v, normal });
+                vertices.push_back({ normal + u - v, normal });
+                vertices.push_back({ normal + u + v, normal });
+                vertices.push_back({ normal - u + v, normal });
+                indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+            }
+        }
+
+        glCreateBuffers(1, &mVertexBuffer);
+        glNamedBufferStorage(mVertexBuffer, GLsizeiptr(vertices.size() * sizeof(Vertex)), vertices.data(), 0);
+        glCreateBuffers(1, &mIndexBuffer);
+        glNamedBufferStorage(mIndexBuffer, GLsizeiptr(indices.size() * sizeof(uint32_t)), indices.data(), 0);
+    }
+
+    void createCity()
+    {
+        std::mt19937 random(11);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+        // four buildings per block, blocks are separated by streets
+        std::vector<Building> buildings;
+        std::vector<utils::OcclusionObject> objects;
+        std::vector<utils::DrawElementsIndirectCommand> commands;
+        const float half = kBlockSize * float(kBlocks) * 0.5f;
+        for (uint32_t z = 0; z < kBlocks; ++z)
+        {
+            for (uint32_t x = 0; x < kBlocks; ++x)
+            {
+                const glm::vec2 corner(float(x) * kBlockSize - half, float(z) * kBlockSize - half);
+                const float lot = (kBlockSize - kStreetWidth) * 0.5f;
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    const float height = 6.0f + unit(random) * unit(random) * 60.0f;
+                    const glm::vec2 size = glm::vec2(lot) * (0.75f + 0.2f * unit(random));
+                    const glm::vec2 center = corner + glm::vec2(float(i & 1) + 0.5f, float(i >> 1) + 0.5f) * lot;
+
+                    Building building;
+                    building.center = glm::vec4(center.x, height * 0.5f, center.y, unit(random));
+                    building.halfExtent = glm::vec4(size.x * 0.5f, height * 0.5f, size.y * 0.5f, 0.0f);
+                    buildings.push_back(building);
+
+                    const glm::vec3 extent = glm::vec3(building.halfExtent);
+                    objects.push_back({ glm::vec4(glm::vec3(building.center) - extent, 0.0f), glm::vec4(glm::vec3(building.center) + extent, 0.0f) });
+
+                    utils::DrawElementsIndirectCommand command;
+                    command.count = 36;
+                    command.baseInstance = uint32_t(commands.size());
+                    commands.push_back(command);
+                }
+            }
+        }
+        mCuller.setObjects(objects.data(), commands.data(), uint32_t(objects.size()));
+
+        Building ground;
+        ground.center = glm::vec4(0.0f, -0.5f, 0.0f, -1.0f);
+        ground.halfExtent = glm::vec4(half + kBlockSize, 0.5f, half + kBlockSize, 0.0f);
+        buildings.push_back(ground);
+
+        glCreateBuffers(1, &mInstanceBuffer);
+        glNamedBufferStorage(mInstanceBuffer, GLsizeiptr(buildings.size() * sizeof(Building)), buildings.data(), 0);
+
+        glCreateVertexArrays(1, &mVao);
+        glVertexArrayVertexBuffer(mVao, 0, mVertexBuffer, 0, sizeof(Vertex));
+        glVertexArrayVertexBuffer(mVao, 1, mInstanceBuffer, 0, sizeof(Building));
+        glVertexArrayBindingDivisor(mVao, 1, 1);
+        glVertexArrayElementBuffer(mVao, mIndexBuffer);
+
+        glVertexArrayAttribFormat(mVao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+        glVertexArrayAttribFormat(mVao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+        glVertexArrayAttribFormat(mVao, 2, 4, GL_FLOAT, GL_FALSE, offsetof(Building, center));
+        glVertexArrayAttribFormat(mVao, 3, 4, GL_FLOAT, GL_FALSE, offsetof(Building, halfExtent));
+        for (GLuint attribute = 0; attribute < 4; ++attribute)
+        {
+            glVertexArrayAttribBinding(mVao, attribute, attribute < 2 ? 0 : 1);
+            glEnableVertexArrayAttrib(mVao, attribute);
+        }
+    }
+
+    std::shared_ptr<utils::OpenglProgram> mProgram;
+    utils::OcclusionCuller mCuller;
+
+    GLuint mVao = 0;
+    GLuint mVertexBuffer = 0;
+    GLuint mIndexBuffer = 0;
+    GLuint mInstanceBuffer = 0;
+
+    GLuint mFramebuffer = 0;
+    GLuint mColor = 0;
+    GLuint mDepth = 0;
+
+    double mLastReport = 0.0;
+    double mSceneTime = 0.0;
+    uint32_t mSceneFrames = 0;
+    uint64_t mCulledObjects = 0;
+    uint32_t mSkipFrames = utils::Profiler::kFrameLatency + 1;
+};
+
+
+int main(int argc, char** argv)
+{
+    bool headless = false;
+    uint64_t frameLimit = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            headless = true;
+            frameLimit = 400;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                frameLimit = std::stoull(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Usage: occlusion [--headless [frames]]" << std::endl;
+            return 1;
+        }
+    }
+
+    OcclusionExample occlusionExample(headless, frameLimit);
+    occlusionExample.setupWindow();
+    occlusionExample.prepare();
+    occlusionExample.renderLoop();
+    occlusionExample.renderLoopFinished();
+
+    return 0;
+}
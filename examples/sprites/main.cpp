@@ -0,0 +1,212 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+#include "SpriteBatch.h"
+#include "TextureAtlas.h"
+#include "ThreadPool.h"
+
+class SpritesExample : public OpenGLExampleBase
+{
+public:
+    SpritesExample(bool headless, uint64_t frameLimit)
+    {
+        mHeadless = headless;
+        mFrameLimit = frameLimit;
+    }
+
+    ~SpritesExample()
+    {
+        glDeleteTextures(GLsizei(mTextures.size()), mTextures.data());
+    }
+
+    void prepare() override
+    {
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "sprites/sprite.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "sprites/sprite.frag", GL_FRAGMENT_SHADER);
+        mBatch.init(utils::OpenglProgram::create(vertexShader, fragmentShader), kSpriteCount + 1024);
+
+        // a handful of loose textures and an atlas of small icons, so draws mix 2D textures and array layers
+        utils::Image image;
+        for (uint32_t i = 0; i < kTextureCount; ++i)
+        {
+            makePattern(image, 64, i);
+            GLuint texture = 0;
+            glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+            glTextureStorage2D(texture, 1, GL_RGBA8, image.mWidth, image.mHeight);
+            glTextureSubImage2D(texture, 0, 0, 0, image.mWidth, image.mHeight, GL_RGBA, GL_UNSIGNED_BYTE, image.mData);
+            glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            mTextures.push_back(texture);
+        }
+
+        utils::TextureAtlasSettings settings;
+        settings.pageSize = 512;
+        mAtlas.init(settings);
+        for (uint32_t i = 0; i < kIconCount; ++i)
+        {
+            makePattern(image, 24 + (i % 4) * 8, i + kTextureCount);
+            mAtlas.add(image, mIcons[i]);
+        }
+        mAtlas.generateMipmaps();
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        mParticles.resize(kSpriteCount);
+        for (Particle& particle : mParticles)
+        {
+            particle.position = glm::vec2(unit(random) * float(mWidth), unit(random) * float(mHeight));
+            particle.velocity = (glm::vec2(unit(random), unit(random)) - 0.5f) * 200.0f;
+            particle.spin = (unit(random) - 0.5f) * 4.0f;
+            particle.kind = uint32_t(random() % (kTextureCount + kIconCount + 1));
+        }
+
+        mLastReport = glfwGetTime();
+    }
+
+    void render() override
+    {
+        glClearColor(0.05f, 0.05f, 0.07f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(0, 0, mWidth, mHeight);
+
+        const double time = glfwGetTime();
+        const float deltaTime = 1.0f / 60.0f;
+
+        mBatch.begin(glm::ortho(0.0f, float(mWidth), float(mHeight), 0.0f));
+        for (uint32_t i = 0; i < kSpriteCount; ++i)
+        {
+            Particle& particle = mParticles[i];
+            particle.position += particle.velocity * deltaTime;
+            particle.position.x = std::fmod(particle.position.x + float(mWidth), float(mWidth));
+            particle.position.y = std::fmod(particle.position.y + float(mHeight), float(mHeight));
+
+            utils::Sprite sprite;
+            sprite.position = particle.position;
+            sprite.size = glm::vec2(12.0f + float(i % 8) * 2.0f);
+            sprite.rotation = particle.spin * float(time);
+            sprite.color = glm::vec4(0.5f + 0.5f * float(i % 3) / 2.0f, 0.7f, 0.5f + 0.5f * float(i % 5) / 4.0f, 0.8f);
+
+            if (particle.kind < kTextureCount)
+            {
+                sprite.texture = mTextures[particle.kind];
+            }
+            else if (particle.kind < kTextureCount + kIconCount)
+            {
+                const utils::TextureRegion& icon = mIcons[particle.kind - kTextureCount];
+                sprite.texture = mAtlas.getId();
+                sprite.target = GL_TEXTURE_2D_ARRAY;
+                sprite.layer = icon.layer;
+                sprite.uvRect = glm::vec4(icon.uvRect.x, icon.uvRect.y, icon.uvRect.x + icon.uvRect.z, icon.uvRect.y + icon.uvRect.w);
+            }
+
+            // every sixteenth sprite glows on top of the rest
+            if (i % 16 == 0)
+            {
+                sprite.blend = utils::SPRITE_BLEND_ADDITIVE;
+                sprite.order = 1;
+            }
+            mBatch.draw(sprite);
+        }
+        mBatch.end(&utils::ThreadPool::global());
+
+        const utils::SpriteBatchStats& stats = mBatch.getStats();
+        ++mReportFrames;
+        mBuildTime += stats.buildTime;
+        if (time - mLastReport >= 2.0)
+        {
+            std::cout << "sprites: " << stats.sprites << " in " << stats.drawCalls << " draws (" << stats.slotSplits
+                << " slot splits), " << mBuildTime / double(mReportFrames) << " ms build, "
+                << double(mReportFrames) / (time - mLastReport) << " fps" << std::endl;
+
+            mLastReport = time;
+            mReportFrames = 0;
+            mBuildTime = 0.0;
+        }
+    }
+
+private:
+    static constexpr uint32_t kSpriteCount = 100000;
+    static constexpr uint32_t kTextureCount = 6;
+    static constexpr uint32_t kIconCount = 32;
+
+    struct Particle
+    {
+        glm::vec2 position;
+        glm::vec2 velocity;
+        float spin;
+        uint32_t kind;
+    };
+
+    // soft disc with a seed dependent ring pattern
+    static void makePattern(utils::Image& image, int size, uint32_t seed)
+    {
+        image.create(size, size);
+        const glm::vec3 tint = glm::vec3(float(seed % 3), float(seed / 3 % 3), float(seed / 9 % 3)) * 0.5f;
+        for (int y = 0; y < size; ++y)
+        {
+            for (int x = 0; x < size; ++x)
+            {
+                const glm::vec2 p = (glm::vec2(float(x), float(y)) + 0.5f) / float(size) * 2.0f - 1.0f;
+                const float radius = glm::length(p);
+                const float ring = 0.5f + 0.5f * std::cos(radius * float(4 + seed % 5) * 3.14159265f);
+                const glm::vec3 color = glm::mix(glm::vec3(1.0f), tint, ring);
+                const float alpha = glm::clamp((1.0f - radius) * 8.0f, 0.0f, 1.0f);
+
+                unsigned char* texel = image.mData + (size_t(y) * size + x) * 4;
+                texel[0] = (unsigned char)(color.r * 255.0f);
+                texel[1] = (unsigned char)(color.g * 255.0f);
+                texel[2] = (unsigned char)(color.b * 255.0f);
+                texel[3] = (unsigned char)(alpha * 255.0f);
+            }
+        }
+    }
+
+    utils::SpriteBatch mBatch;
+    utils::TextureAtlas mAtlas;
+    utils::TextureRegion mIcons[kIconCount];
+    std::vector<GLuint> mTextures;
+    std::vector<Particle> mParticles;
+
+    double mLastReport = 0.0;
+    double mBuildTime = 0.0;
+    uint32_t mReportFrames = 0;
+};
+
+
+int main(int argc, char** argv)
+{
+    bool headless = false;
+    uint64_t frameLimit = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            headless = true;
+            frameLimit = 600;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                frameLimit = std::stoull(argv[++i]);
+        }
+        else
+        {
+            std::cerr << "Usage: sprites [--headless [frames]]" << std::endl;
+            return 1;
+        }
+    }
+
+    SpritesExample spritesExample(headless, frameLimit);
+    spritesExample.setupWindow();
+    spritesExample.prepare();
+    spritesExample.renderLoop();
+
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+#include "Terrain.h"
+#include "ThreadPool.h"
+
+namespace
+{
+    float hash(int x, int y)
+    {
+        uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return float(h ^ (h >> 16)) / 4294967295.0f;
+    }
+
+    float valueNoise(float x, float y)
+    {
+        const int ix = int(std::floor(x));
+        const int iy = int(std::floor(y));
+        const float fx = x - float(ix);
+        const float fy = y - float(iy);
+        const float sx = fx * fx * (3.0f - 2.0f * fx);
+        const float sy = fy * fy * (3.0f - 2.0f * fy);
+
+        const float top = glm::mix(hash(ix, iy), hash(ix + 1, iy), sx);
+        const float bottom = glm::mix(hash(ix, iy + 1), hash(ix + 1, iy + 1), sx);
+        return glm::mix(top, bottom, sy);
+    }
+
+    // fractal noise with ridges, stored as 16 bit heights in red and green
+    void generateHeightmap(utils::Image& image, int size)
+    {
+        image.create(size, size);
+        utils::ThreadPool::global().parallelFor(uint32_t(size), 16, [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; ++y)
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    float height = 0.0f;
+                    float amplitude = 0.5f;
+                    float frequency = 4.0f / float(size);
+                    for (int octave = 0; octave < 9; ++octave)
+                    {
+                        const float ridge = 1.0f - std::abs(valueNoise(float(x) * frequency, float(y) * frequency) * 2.0f - 1.0f);
+                        height += ridge * ridge * amplitude;
+                        amplitude *= 0.5f;
+                        frequency *= 2.0f;
+                    }
+
+                    const uint16_t value = uint16_t(glm::clamp(height, 0.0f, 1.0f) * 65535.0f);
+                    unsigned char* pixel = image.mData + (size_t(y) * size + x) * 4;
+                    pixel[0] = uint8_t(value >> 8);
+                    pixel[1] = uint8_t(value & 0xff);
+                    pixel[2] = 0;
+                    pixel[3] = 255;
+                }
+            }
+        });
+    }
+}
+
+class TerrainExample : public OpenGLExampleBase
+{
+public:
+    TerrainExample()
+    {
+
+    }
+
+    ~TerrainExample()
+    {
+
+    }
+
+    void prepare() override
+    {
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "opengl_terrain_tiles";
+        if (!std::filesystem::exists(directory / "terrain.txt"))
+        {
+            std::cout << "Baking terrain tiles into " << directory << std::endl;
+            std::filesystem::create_directories(directory);
+
+            utils::Image heightmap;
+            generateHeightmap(heightmap, kHeightmapSize);
+            utils::Terrain::bakeTiles(heightmap, directory.string(), 256);
+        }
+
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "terrain/terrain.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "terrain/terrain.frag", GL_FRAGMENT_SHADER);
+        mProgram = utils::OpenglProgram::create(vertexShader, fragmentShader);
+
+        utils::TerrainSettings settings;
+        settings.tileDirectory = directory.string();
+        settings.sampleSpacing = 2.0f;
+        settings.heightScale = 600.0f;
+        mTerrainReady = mTerrain.init(settings, mProgram);
+    }
+
+    void render() override
+    {
+        glClearColor(0.6f, 0.7f, 0.8f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glEnable(GL_CULL_FACE);
+        glViewport(0, 0, mWidth, mHeight);
+
+        if (!mTerrainReady)
+        {
+            return;
+        }
+
+        // circle the center of the terrain at a fixed height above it
+        const float time = float(glfwGetTime()) * 0.05f;
+        const float size = mTerrain.getSize();
+        const glm::vec3 center(size * 0.5f, 0.0f, size * 0.5f);
+        const glm::vec3 eye = center + glm::vec3(std::cos(time), 0.0f, std::sin(time)) * size * 0.3f + glm::vec3(0.0f, mTerrain.getHeightScale() * 0.9f, 0.0f);
+        const glm::vec3 at = center + glm::vec3(std::cos(time + 0.3f), 0.0f, std::sin(time + 0.3f)) * size * 0.3f + glm::vec3(0.0f, mTerrain.getHeightScale() * 0.6f, 0.0f);
+
+        const glm::mat4 view = glm::lookAt(eye, at, glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 proj = glm::perspective(glm::radians(60.0f), float(mWidth) / float(mHeight), 1.0f, size);
+        const glm::mat4 viewProjection = proj * view;
+
+        mTerrain.update(eye, viewProjection);
+        mTerrain.render(viewProjection, eye);
+
+        if (++mFrameCount % 300 == 0)
+        {
+            const utils::TerrainStats& stats = mTerrain.getStats();
+            std::cout << "terrain: " << stats.selectedNodes << " nodes, " << stats.drawnVertices << " vertices, "
+                << stats.residentTiles << " resident, " << stats.pendingTiles << " pending, "
+                << stats.loadedTiles << " loaded, " << stats.evictedTiles << " evicted" << std::endl;
+        }
+    }
+
+private:
+    static constexpr int kHeightmapSize = 2049;
+
+    std::shared_ptr<utils::OpenglProgram> mProgram;
+    utils::Terrain mTerrain;
+    bool mTerrainReady = false;
+    uint64_t mFrameCount = 0;
+};
+
+
+int main()
+{
+    TerrainExample terrainExample;
+    terrainExample.setupWindow();
+    terrainExample.prepare();
+    terrainExample.renderLoop();
+
+    return 0;
+}
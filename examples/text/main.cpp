@@ -0,0 +1,122 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GlyphAtlas.h"
+#include "OpenGLExampleBase.h"
+#include "OpenGLUtils.h"
+#include "TextRenderer.h"
+
+class TextExample : public OpenGLExampleBase
+{
+public:
+    TextExample()
+    {
+
+    }
+
+    ~TextExample()
+    {
+
+    }
+
+    void prepare() override
+    {
+        auto vertexShader = utils::OpenglShader::create(getShadersPath() + "text/text.vert", GL_VERTEX_SHADER);
+        auto fragmentShader = utils::OpenglShader::create(getShadersPath() + "text/text.frag", GL_FRAGMENT_SHADER);
+
+        mAtlas.init();
+        mText.init(utils::OpenglProgram::create(vertexShader, fragmentShader));
+
+        const std::string fontPath = getAssetPath() + "../assets/fonts/";
+        mFonts[0] = mAtlas.loadFont(fontPath + "Roboto-Medium.ttf");
+        mFonts[1] = mAtlas.loadFont(fontPath + "Cousine-Regular.ttf");
+        mFonts[2] = mAtlas.loadFont(fontPath + "Karla-Regular.ttf");
+
+        mLastReport = glfwGetTime();
+    }
+
+    void render() override
+    {
+        glClearColor(0.08f, 0.08f, 0.1f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(0, 0, mWidth, mHeight);
+
+        const double time = glfwGetTime();
+
+        mAtlas.update();
+        mText.begin();
+
+        // a wall of small labels that change every frame, space stacks twenty walls on top of each other
+        char label[32];
+        const uint32_t labelCount = mStress ? kLabelCount * 20 : kLabelCount;
+        for (uint32_t i = 0; i < labelCount; ++i)
+        {
+            const uint32_t wall = i / kLabelCount;
+            const float x = float(i % kColumns) * 64.0f + 4.0f + float(wall) * 2.0f;
+            const float y = float(i % kLabelCount / kColumns) * 11.0f + 120.0f + float(wall) * 2.0f;
+            std::snprintf(label, sizeof(label), "#%u %.2f", i, time + i * 0.01);
+            mText.addText(mAtlas, mFonts[i % 3], label, glm::vec2(x, y), 9.0f, glm::vec4(0.6f + 0.4f * float(i % 5) / 4.0f, 0.8f, 1.0f, 1.0f));
+        }
+
+        const float scale = 48.0f + 16.0f * float(std::sin(time));
+        mText.addText(mAtlas, mFonts[0], "Multi-channel distance field text", glm::vec2(16.0f, 64.0f), scale);
+        mText.addText(mAtlas, mFonts[1], "glyphs are rasterized on worker threads", glm::vec2(16.0f, 100.0f), 20.0f, glm::vec4(1.0f, 0.8f, 0.3f, 1.0f));
+
+        const glm::mat4 projection = glm::ortho(0.0f, float(mWidth), float(mHeight), 0.0f);
+        mText.render(mAtlas, projection);
+
+        mRenderedGlyphs += mText.getStats().glyphs;
+
+        if (time - mLastReport >= 2.0)
+        {
+            const utils::GlyphAtlasStats& stats = mAtlas.getStats();
+            const double seconds = time - mLastReport;
+            const double rasterized = double(stats.rasterizedGlyphs - mReportedRasterized);
+
+            std::cout << "text: " << uint64_t(double(mRenderedGlyphs) / seconds) << " glyphs/s rendered in "
+                << mText.getStats().drawCalls << " draw, " << uint64_t(rasterized / seconds) << " glyphs/s rasterized ("
+                << (stats.rasterTime > 0.0 ? double(stats.rasterizedGlyphs) * 1000.0 / stats.rasterTime : 0.0)
+                << " per worker second), " << stats.residentGlyphs << " resident, " << stats.evictedGlyphs << " evicted" << std::endl;
+
+            mLastReport = time;
+            mRenderedGlyphs = 0;
+            mReportedRasterized = stats.rasterizedGlyphs;
+        }
+    }
+
+    void onKeyDown(int key) override
+    {
+        if (key == GLFW_KEY_SPACE)
+        {
+            mStress = !mStress;
+        }
+    }
+
+private:
+    static constexpr uint32_t kColumns = 20;
+    static constexpr uint32_t kLabelCount = kColumns * 50;
+
+    utils::GlyphAtlas mAtlas;
+    utils::TextRenderer mText;
+    uint32_t mFonts[3] = {};
+
+    double mLastReport = 0.0;
+    uint64_t mRenderedGlyphs = 0;
+    uint64_t mReportedRasterized = 0;
+    bool mStress = false;
+};
+
+
+int main()
+{
+    TextExample textExample;
+    textExample.setupWindow();
+    textExample.prepare();
+    textExample.renderLoop();
+
+    return 0;
+}
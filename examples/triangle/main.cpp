@@ -4,6 +4,7 @@
 
 #include "OpenGLExampleBase.h"
 #include "OpenGLUtils.h"
+#include "VertexLayout.h"
 
 
 class TriangleExample : public OpenGLExampleBase
@@ -15,6 +16,8 @@ public:
 		std::array<float, 3> color;
 	};
 
+	using VertexLayout = utils::VertexLayout<Vertex, UTILS_VERTEX_ATTRIBUTE(Vertex, position), UTILS_VERTEX_ATTRIBUTE(Vertex, color)>;
+
 	explicit TriangleExample()
 	{
 
@@ -36,24 +39,14 @@ public:
 
 		std::vector<uint32_t> indices = {0 , 1, 2};
 
-		glGenVertexArrays(1,  &VAO);
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(), GL_STATIC_DRAW);
-
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (const GLvoid*)(3 * sizeof(float)));
+		glCreateBuffers(1, &VBO);
+		glNamedBufferStorage(VBO, vertices.size() * sizeof(Vertex), vertices.data(), 0);
+		glCreateBuffers(1, &EBO);
+		glNamedBufferStorage(EBO, indices.size() * sizeof(uint32_t), indices.data(), 0);
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindVertexArray(0);
+		VAO = utils::VertexArrayCache::global().acquire<VertexLayout>();
+		glVertexArrayVertexBuffer(VAO, 0, VBO, 0, VertexLayout::stride);
+		glVertexArrayElementBuffer(VAO, EBO);
 	}
 
 	void loadAssets()
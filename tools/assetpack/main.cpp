@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+
+namespace fs = std::filesystem;
+
+void printUsage()
+{
+    std::cout << "Usage: assetpack [options] <data dir> <output pack>\n"
+              << "  --store               keep every entry uncompressed\n"
+              << "  --quiet               only print errors" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    utils::AssetCodec codec = utils::ASSET_CODEC_DEFLATE;
+    bool quiet = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--store")
+            codec = utils::ASSET_CODEC_NONE;
+        else if (arg == "--quiet")
+            quiet = true;
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+        else
+            paths.push_back(arg);
+    }
+
+    if (paths.size() != 2 || !fs::is_directory(paths[0]))
+    {
+        printUsage();
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const fs::path root = paths[0];
+
+    // sorted so the same directory always produces the same pack
+    std::vector<fs::path> files;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(root, error), end; it != end && !error; it.increment(error))
+    {
+        // packs are never packed, the output may sit in the directory it is built from
+        if (it->is_regular_file() && it->path().extension() != ".pack")
+        {
+            files.push_back(it->path());
+        }
+    }
+    if (error)
+    {
+        std::cerr << "Cannot list " << root.string() << ": " << error.message() << std::endl;
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    utils::AssetArchiveWriter writer;
+    for (const fs::path& file : files)
+    {
+        if (!writer.addFile(fs::relative(file, root).generic_string(), file.string(), codec))
+        {
+            return 1;
+        }
+    }
+
+    if (!writer.write(paths[1]))
+    {
+        return 1;
+    }
+
+    if (!quiet)
+    {
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Packed " << files.size() << " files into " << paths[1] << ": "
+                  << writer.getSize() / 1024 << " KB -> " << writer.getStoredSize() / 1024 << " KB stored, "
+                  << fs::file_size(paths[1]) / 1024 << " KB on disk in " << seconds << " s" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,486 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BoundedQueue.h"
+#include "ImageFilters.h"
+#include "OpenGLUtils.h"
+
+namespace fs = std::filesystem;
+
+// Offline version of the grayfilter example: read -> decode -> filter -> encode -> write,
+// every stage on its own threads, connected by bounded queues.
+class ImageBatch
+{
+public:
+    struct Options
+    {
+        std::vector<std::string> inputs;
+        std::string listFile;
+        std::string outputDir;
+        std::string filter = "luminance";
+
+        uint32_t readers = 2;
+        uint32_t decoders = 0;
+        uint32_t filterers = 1;
+        uint32_t encoders = 0;
+        uint32_t writers = 2;
+
+        // jobs in flight, bounds memory no matter how many files are queued
+        uint32_t inFlight = 0;
+    };
+
+    // the free job queue holds every job at once, so it is sized after the defaults are filled in
+    explicit ImageBatch(const Options& options) : mOptions(resolveOptions(options)), mFreeJobs(mOptions.inFlight)
+    {
+    }
+
+    int run()
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // every job owns its buffers, they are reused for all files passing through it
+        mJobs.resize(mOptions.inFlight);
+        for (auto& job : mJobs)
+        {
+            job = std::make_unique<Job>();
+            mFreeJobs.push(job.get());
+        }
+
+        std::vector<std::thread> threads;
+        startStage(threads, mRead, mOptions.readers, [this]() { readLoop(); });
+        startStage(threads, mDecode, mOptions.decoders, [this]() { stageLoop(mDecode, mDecodeQueue, mFilterQueue, &ImageBatch::decode); });
+        startStage(threads, mFilter, mOptions.filterers, [this]() { stageLoop(mFilter, mFilterQueue, mEncodeQueue, &ImageBatch::filter); });
+        startStage(threads, mEncode, mOptions.encoders, [this]() { stageLoop(mEncode, mEncodeQueue, mWriteQueue, &ImageBatch::encode); });
+        startStage(threads, mWrite, mOptions.writers, [this]() { writeLoop(); });
+
+        enumerateInputs();
+        mItems.close();
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printSummary(seconds);
+
+        return mFailed.load() == 0 ? 0 : 1;
+    }
+
+private:
+    static Options resolveOptions(Options options)
+    {
+        const uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+        if (options.decoders == 0)
+        {
+            options.decoders = std::max(cores / 2, 1u);
+        }
+        if (options.encoders == 0)
+        {
+            options.encoders = std::max(cores / 2, 1u);
+        }
+        if (options.inFlight == 0)
+        {
+            options.inFlight = 2 * (options.readers + options.decoders + options.filterers + options.encoders + options.writers);
+        }
+        return options;
+    }
+
+    struct Item
+    {
+        std::string input;
+        std::string output;
+    };
+
+    struct Job
+    {
+        Item item;
+        std::vector<unsigned char> fileData;
+        utils::Image decoded;
+        utils::Image filtered;
+        std::vector<unsigned char> encoded;
+        std::string error;
+    };
+
+    using JobQueue = utils::BoundedQueue<Job*>;
+
+    struct Stage
+    {
+        const char* name;
+        uint32_t threads = 0;
+        std::atomic<uint32_t> active{ 0 };
+        std::atomic<uint64_t> busyNanoseconds{ 0 };
+        std::atomic<uint64_t> items{ 0 };
+    };
+
+    template<typename Function>
+    void startStage(std::vector<std::thread>& threads, Stage& stage, uint32_t count, Function function)
+    {
+        stage.threads = std::max(count, 1u);
+        stage.active = stage.threads;
+        for (uint32_t i = 0; i < stage.threads; ++i)
+        {
+            threads.emplace_back(function);
+        }
+    }
+
+    template<typename Function>
+    void timed(Stage& stage, Function function)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        stage.busyNanoseconds += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        ++stage.items;
+    }
+
+    // the last thread of a stage closes the queue feeding the next one
+    void finishStage(Stage& stage, JobQueue* output)
+    {
+        if (--stage.active == 0 && output != nullptr)
+        {
+            output->close();
+        }
+    }
+
+    void enumerateInputs()
+    {
+        if (!mOptions.listFile.empty())
+        {
+            std::ifstream list(mOptions.listFile);
+            if (!list.is_open())
+            {
+                std::cerr << "Cannot open the input list: " << mOptions.listFile << std::endl;
+                ++mFailed;
+            }
+
+            std::string line;
+            while (std::getline(list, line))
+            {
+                if (!line.empty())
+                {
+                    enqueue(fs::path(line), fs::path(line).filename());
+                }
+            }
+        }
+
+        for (const auto& input : mOptions.inputs)
+        {
+            std::error_code error;
+            const fs::path root(input);
+            if (fs::is_directory(root, error))
+            {
+                for (fs::recursive_directory_iterator it(root, error), end; it != end; it.increment(error))
+                {
+                    if (it->is_regular_file(error) && isImage(it->path()))
+                    {
+                        enqueue(it->path(), fs::relative(it->path(), root, error));
+                    }
+                }
+            }
+            else
+            {
+                enqueue(root, root.filename());
+            }
+        }
+    }
+
+    void enqueue(const fs::path& input, fs::path relative)
+    {
+        relative.replace_extension(".png");
+        mItems.push({ input.string(), (fs::path(mOptions.outputDir) / relative).string() });
+    }
+
+    static bool isImage(const fs::path& path)
+    {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+        return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp" || extension == ".psd" || extension == ".gif";
+    }
+
+    void readLoop()
+    {
+        Item item;
+        while (mItems.pop(item))
+        {
+            // blocks while every job is busy downstream
+            Job* job = nullptr;
+            mFreeJobs.pop(job);
+            job->item = std::move(item);
+            job->error.clear();
+
+            timed(mRead, [&]()
+            {
+                std::ifstream is(job->item.input, std::ios::binary | std::ios::ate);
+                if (!is.is_open())
+                {
+                    job->error = "cannot open file";
+                    return;
+                }
+
+                const std::streamsize size = is.tellg();
+                is.seekg(0);
+                job->fileData.resize(size_t(std::max<std::streamsize>(size, 0)));
+                if (!is.read(reinterpret_cast<char*>(job->fileData.data()), size))
+                {
+                    job->error = "read failed";
+                }
+            });
+
+            mDecodeQueue.push(job);
+        }
+        finishStage(mRead, &mDecodeQueue);
+    }
+
+    void stageLoop(Stage& stage, JobQueue& input, JobQueue& output, void (ImageBatch::*process)(Job&))
+    {
+        Job* job = nullptr;
+        while (input.pop(job))
+        {
+            // failed jobs travel on to the writer so errors are reported in one place
+            if (job->error.empty())
+            {
+                timed(stage, [&]() { (this->*process)(*job); });
+            }
+            output.push(job);
+        }
+        finishStage(stage, &output);
+    }
+
+    void decode(Job& job)
+    {
+        if (!job.decoded.loadFromMemory(job.fileData.data(), job.fileData.size()))
+        {
+            job.error = std::string("decode failed: ") + utils::Image::getLastError();
+        }
+    }
+
+    void filter(Job& job)
+    {
+        if (mOptions.filter == "luminance")
+        {
+            utils::filters::luminance(job.decoded, job.filtered);
+        }
+        else if (mOptions.filter == "sharpen")
+        {
+            utils::filters::sharpen(job.decoded, job.filtered, 1.0f);
+        }
+        else if (mOptions.filter == "blur")
+        {
+            utils::filters::gaussianBlur(job.decoded, job.filtered, 2.0f);
+        }
+        else if (mOptions.filter == "unsharp")
+        {
+            utils::filters::unsharpMask(job.decoded, job.filtered, 1.5f, 0.8f, 2);
+        }
+    }
+
+    void encode(Job& job)
+    {
+        if (!job.filtered.encodePng(job.encoded))
+        {
+            job.error = "encode failed";
+        }
+    }
+
+    void writeLoop()
+    {
+        Job* job = nullptr;
+        while (mWriteQueue.pop(job))
+        {
+            if (job->error.empty())
+            {
+                timed(mWrite, [&]()
+                {
+                    std::error_code error;
+                    fs::create_directories(fs::path(job->item.output).parent_path(), error);
+
+                    std::ofstream os(job->item.output, std::ios::binary);
+                    os.write(reinterpret_cast<const char*>(job->encoded.data()), job->encoded.size());
+                    if (!os)
+                    {
+                        job->error = "cannot write " + job->item.output;
+                    }
+                });
+            }
+
+            if (job->error.empty())
+            {
+                ++mSucceeded;
+            }
+            else
+            {
+                ++mFailed;
+                std::lock_guard<std::mutex> lock(mReportMutex);
+                std::cerr << "Failed: " << job->item.input << ": " << job->error << std::endl;
+            }
+
+            mFreeJobs.push(job);
+        }
+        finishStage(mWrite, nullptr);
+    }
+
+    void printSummary(double seconds) const
+    {
+        const uint64_t total = mSucceeded.load() + mFailed.load();
+        std::cout << "Processed " << total << " images (" << mFailed.load() << " failed) in " << seconds << " s, "
+                  << (seconds > 0.0 ? total / seconds : 0.0) << " images/s" << std::endl;
+
+        for (const Stage* stage : { &mRead, &mDecode, &mFilter, &mEncode, &mWrite })
+        {
+            const double busy = stage->busyNanoseconds.load() * 1e-9;
+            const double utilization = seconds > 0.0 ? busy / (seconds * stage->threads) * 100.0 : 0.0;
+            std::cout << "  " << stage->name << ": " << stage->threads << " threads, " << stage->items.load() << " items, "
+                      << busy << " s busy, " << utilization << "% utilization" << std::endl;
+        }
+
+        for (uint32_t i = 0; i < utils::filters::KERNEL_COUNT; ++i)
+        {
+            const auto kernel = utils::filters::FilterKernel(i);
+            const auto stats = utils::filters::getStats(kernel);
+            if (stats.invocations > 0)
+            {
+                std::cout << "  " << utils::filters::getKernelName(kernel) << ": " << stats.getMegapixelsPerSecond() << " MP/s" << std::endl;
+            }
+        }
+    }
+
+    Options mOptions;
+
+    std::vector<std::unique_ptr<Job>> mJobs;
+    JobQueue mFreeJobs;
+    utils::BoundedQueue<Item> mItems{ 1024 };
+    JobQueue mDecodeQueue{ 16 };
+    JobQueue mFilterQueue{ 16 };
+    JobQueue mEncodeQueue{ 16 };
+    JobQueue mWriteQueue{ 16 };
+
+    Stage mRead{ "read" };
+    Stage mDecode{ "decode" };
+    Stage mFilter{ "filter" };
+    Stage mEncode{ "encode" };
+    Stage mWrite{ "write" };
+
+    std::atomic<uint64_t> mSucceeded{ 0 };
+    std::atomic<uint64_t> mFailed{ 0 };
+    std::mutex mReportMutex;
+};
+
+// every in-flight job keeps its file and image buffers alive, thread counts beyond this only add contention
+constexpr uint32_t kMaxInFlight = 1u << 16;
+constexpr uint32_t kMaxThreads = 256;
+
+void printUsage()
+{
+    std::cout << "Usage: imagebatch -o <output dir> [options] <file or dir>...\n"
+              << "  -l <file>             read input paths from a file, one per line\n"
+              << "  --filter <name>       luminance (default), sharpen, blur, unsharp\n"
+              << "  --readers <n>         threads per stage, 0 picks a default\n"
+              << "  --decoders <n>\n"
+              << "  --filterers <n>\n"
+              << "  --encoders <n>\n"
+              << "  --writers <n>\n"
+              << "  --in-flight <n>       images in the pipeline at once, at most " << kMaxInFlight << std::endl;
+}
+
+// digits only and no more than maxValue, std::stoul alone throws on bad input and skips trailing garbage
+bool parseCount(const std::string& text, uint32_t maxValue, uint32_t& value)
+{
+    if (text.empty() || text.size() > 9 || !std::all_of(text.begin(), text.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }))
+    {
+        return false;
+    }
+
+    const unsigned long parsed = std::stoul(text);
+    if (parsed > maxValue)
+    {
+        return false;
+    }
+    value = uint32_t(parsed);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    ImageBatch::Options options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        uint32_t* count = nullptr;
+        uint32_t maxCount = kMaxThreads;
+        if (arg == "--readers")
+            count = &options.readers;
+        else if (arg == "--decoders")
+            count = &options.decoders;
+        else if (arg == "--filterers")
+            count = &options.filterers;
+        else if (arg == "--encoders")
+            count = &options.encoders;
+        else if (arg == "--writers")
+            count = &options.writers;
+        else if (arg == "--in-flight")
+        {
+            count = &options.inFlight;
+            maxCount = kMaxInFlight;
+        }
+
+        const bool takesValue = count != nullptr || arg == "-o" || arg == "-l" || arg == "--filter";
+        if (takesValue && !hasValue)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+
+        if (count != nullptr)
+        {
+            if (!parseCount(argv[++i], maxCount, *count))
+            {
+                std::cerr << "Invalid value for " << arg << ": " << argv[i] << std::endl;
+                printUsage();
+                return 1;
+            }
+        }
+        else if (arg == "-o")
+            options.outputDir = argv[++i];
+        else if (arg == "-l")
+            options.listFile = argv[++i];
+        else if (arg == "--filter")
+            options.filter = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            printUsage();
+            return 0;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+        else
+            options.inputs.push_back(arg);
+    }
+
+    const bool knownFilter = options.filter == "luminance" || options.filter == "sharpen" || options.filter == "blur" || options.filter == "unsharp";
+    if (options.outputDir.empty() || (options.inputs.empty() && options.listFile.empty()) || !knownFilter)
+    {
+        printUsage();
+        return 1;
+    }
+
+    ImageBatch batch(options);
+    return batch.run();
+}